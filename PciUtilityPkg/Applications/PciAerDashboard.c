@@ -0,0 +1,262 @@
+#include "PciUtility.h"
+
+#define EXT_CAP_AER         0x0001
+#define AER_UNC_STATUS      0x04
+#define AER_COR_STATUS      0x10
+
+#define AER_PAGE_SIZE       16
+#define AER_DEFAULT_SEC     1
+#define AER_MAX_SEC         60
+
+// Rates are per sample, fixed point x256. Fast/slow EWMA (1/4, 1/32):
+// a device is "rising" when the fast average runs well above the slow one.
+#define RATE_ONE            256
+#define RISING_MIN          (RATE_ONE / 4)
+
+typedef struct {
+  UINT16 Index;         // topology / list index
+  UINT16 Aer;           // AER capability offset
+  UINT32 Unc;           // last sampled status
+  UINT32 Cor;
+  UINT32 UncTotal;      // accumulated error events
+  UINT32 CorTotal;
+  UINT32 Fast;
+  UINT32 Slow;
+} AER_DEV;
+
+typedef struct {
+  PCI_TOPOLOGY *Topo;
+  AER_DEV      *Dev;
+  UINTN         Count;
+  UINT32        Samples;
+  UINTN         IntervalSec;
+  BOOLEAN       AutoClear;   // clear after each sample: count every occurrence
+  CONST CHAR16 *Note;        // result of the last clear / toggle
+} AER_DASH;
+
+STATIC
+UINT32
+BitCount32(UINT32 v)
+{
+  UINT32 n = 0;
+  while (v != 0) { v &= v - 1; n++; }
+  return n;
+}
+
+STATIC
+UINT32
+Ewma(UINT32 Avg, UINT32 Sample, UINTN Shift)
+{
+  INT64 Diff = (INT64)Sample * RATE_ONE - (INT64)Avg;
+  return (UINT32)((INT64)Avg + Diff / (1 << Shift));
+}
+
+STATIC
+BOOLEAN
+IsRising(AER_DEV *d)
+{
+  return d->Fast >= RISING_MIN && d->Fast > 2 * d->Slow;
+}
+
+// -----------------------------
+// Discovery (once) and sampling (2 DWORD reads per device)
+// -----------------------------
+STATIC
+UINTN
+FindAerDevices(PCI_TOPOLOGY *Topo, OUT AER_DEV *Dev)
+{
+  UINTN n = 0;
+  for (UINTN i = 0; i < Topo->Count; i++) {
+    if (Topo->Node[i].PcieCap == 0) continue;
+
+    PCI_DEV_INFO *p = &Topo->List[i];
+    UINT16 Off = PciCfgFindExtCapability(p->Bus, p->Dev, p->Func, EXT_CAP_AER);
+    if (Off == 0) continue;
+
+    ZeroMem(&Dev[n], sizeof(AER_DEV));
+    Dev[n].Index = (UINT16)i;
+    Dev[n].Aer   = Off;
+    PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(Off + AER_UNC_STATUS), &Dev[n].Unc);
+    PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(Off + AER_COR_STATUS), &Dev[n].Cor);
+    n++;
+  }
+  return n;
+}
+
+// AER status is RW1C inside a capability: without the F9 unlock the clear
+// is refused and d->Unc / d->Cor keep the sticky bits.
+STATIC
+EFI_STATUS
+ClearAer(AER_DASH *Dash, AER_DEV *d)
+{
+  PCI_DEV_INFO *p = &Dash->Topo->List[d->Index];
+  EFI_STATUS    St;
+
+  St = PolicyClearRw1c(p->Bus, p->Dev, p->Func, (UINT16)(d->Aer + AER_UNC_STATUS), DISP_DWORD, d->Unc, &d->Unc);
+  if (EFI_ERROR(St)) return St;
+  return PolicyClearRw1c(p->Bus, p->Dev, p->Func, (UINT16)(d->Aer + AER_COR_STATUS), DISP_DWORD, d->Cor, &d->Cor);
+}
+
+STATIC
+VOID
+SampleAer(AER_DASH *Dash)
+{
+  for (UINTN k = 0; k < Dash->Count; k++) {
+    AER_DEV      *d = &Dash->Dev[k];
+    PCI_DEV_INFO *p = &Dash->Topo->List[d->Index];
+    UINT32 Unc = 0, Cor = 0;
+
+    PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(d->Aer + AER_UNC_STATUS), &Unc);
+    PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(d->Aer + AER_COR_STATUS), &Cor);
+
+    // Sticky bits: only 0->1 transitions are new events. After a clear
+    // d->Unc / d->Cor hold the read-back (0), so a recurring error counts
+    // again; a refused clear leaves the old bits and nothing is recounted.
+    UINT32 NewUnc = Unc & ~d->Unc;
+    UINT32 NewCor = Cor & ~d->Cor;
+    UINT32 Events = BitCount32(NewUnc) + BitCount32(NewCor);
+
+    d->UncTotal += BitCount32(NewUnc);
+    d->CorTotal += BitCount32(NewCor);
+    d->Fast = Ewma(d->Fast, Events, 2);
+    d->Slow = Ewma(d->Slow, Events, 5);
+    d->Unc = Unc;
+    d->Cor = Cor;
+
+    if (Dash->AutoClear && (Unc | Cor) != 0 && EFI_ERROR(ClearAer(Dash, d))) {
+      Dash->AutoClear = FALSE;
+      Dash->Note      = L"Auto-clear stopped: clear refused (F9 to unlock)";
+    }
+  }
+  Dash->Samples++;
+}
+
+// -----------------------------
+// UI
+// -----------------------------
+STATIC
+VOID
+RenderAer(AER_DASH *Dash, UINTN Sel, UINTN Top)
+{
+  ScreenBegin();
+  ScreenLine(L"AER Dashboard   devices:%u  samples:%u  interval:%us  auto-clear:%s  writes:%s",
+             (UINT32)Dash->Count, Dash->Samples, (UINT32)Dash->IntervalSec,
+             Dash->AutoClear ? L"ON" : L"OFF", DangerousWritesUnlocked() ? L"UNLOCKED" : L"LOCKED");
+  ScreenLine(L"  B/D/F     UncSts    CorSts    UncCnt  CorCnt  Rate/s   Trend");
+  ScreenLine(L"------------------------------------------------------------------");
+
+  UINTN End = Top + AER_PAGE_SIZE;
+  if (End > Dash->Count) End = Dash->Count;
+
+  for (UINTN k = Top; k < End; k++) {
+    AER_DEV      *d = &Dash->Dev[k];
+    PCI_DEV_INFO *p = &Dash->Topo->List[d->Index];
+
+    // Rate per second, two decimals
+    UINT32 Centi = (UINT32)((d->Fast * 100) / (RATE_ONE * Dash->IntervalSec));
+
+    ScreenLine(L"%s%02x/%02x/%02x  %08x  %08x  %-6u  %-6u  %3u.%02u   %s",
+               (k == Sel) ? L"> " : L"  ",
+               p->Bus, p->Dev, p->Func, d->Unc, d->Cor, d->UncTotal, d->CorTotal,
+               Centi / 100, Centi % 100, IsRising(d) ? L"RISING" : ((d->Unc | d->Cor) != 0) ? L"set" : L"");
+  }
+
+  ScreenLine(L"");
+  ScreenLine(L"%s", (Dash->Note != NULL) ? Dash->Note : L"");
+  ScreenLine(L"Up/Down:Select  C:Clear selected  B:Clear all  T:Auto-clear  +/-:Interval  Esc:Back");
+  ScreenEnd();
+}
+
+STATIC
+VOID
+ArmTimer(EFI_EVENT Timer, UINTN Sec)
+{
+  gBS->SetTimer(Timer, TimerPeriodic, (UINT64)Sec * 10000000ULL);  // 100ns units
+}
+
+VOID
+PciAerDashboard(IN PCI_TOPOLOGY *Topo)
+{
+  AER_DASH Dash;
+  ZeroMem(&Dash, sizeof(Dash));
+  Dash.Topo        = Topo;
+  Dash.IntervalSec = AER_DEFAULT_SEC;
+
+  Dash.Dev = AllocatePool(sizeof(AER_DEV) * (Topo->Count ? Topo->Count : 1));
+  if (Dash.Dev == NULL) return;
+  Dash.Count = FindAerDevices(Topo, Dash.Dev);
+
+  if (Dash.Count == 0) {
+    ScreenBegin();
+    ScreenLine(L"No function exposes the AER extended capability.");
+    ScreenLine(L"Press any key...");
+    ScreenEnd();
+    EFI_INPUT_KEY K; WaitKey(&K);
+    FreePool(Dash.Dev);
+    return;
+  }
+
+  EFI_EVENT Timer = NULL;
+  if (EFI_ERROR(gBS->CreateEvent(EVT_TIMER, TPL_CALLBACK, NULL, NULL, &Timer))) {
+    FreePool(Dash.Dev);
+    return;
+  }
+  ArmTimer(Timer, Dash.IntervalSec);
+
+  UINTN Sel = 0, Top = 0;
+  EFI_EVENT Wait[2];
+  Wait[0] = Timer;
+  Wait[1] = gST->ConIn->WaitForKey;
+
+  while (TRUE) {
+    if (Sel < Top) Top = Sel;
+    if (Sel >= Top + AER_PAGE_SIZE) Top = Sel - AER_PAGE_SIZE + 1;
+    RenderAer(&Dash, Sel, Top);
+
+    UINTN Index = 0;
+    gBS->WaitForEvent(2, Wait, &Index);
+
+    if (Index == 0) {
+      SampleAer(&Dash);
+      continue;
+    }
+
+    EFI_INPUT_KEY Key;
+    if (EFI_ERROR(gST->ConIn->ReadKeyStroke(gST->ConIn, &Key))) continue;
+    if (IsEsc(&Key)) break;
+
+    Dash.Note = NULL;
+    switch (Key.UnicodeChar) {
+      case L'c': case L'C':
+        if (EFI_ERROR(ClearAer(&Dash, &Dash.Dev[Sel]))) Dash.Note = L"Clear refused: AER status is RW1C (F9 to unlock)";
+        break;
+      case L'b': case L'B':
+        for (UINTN k = 0; k < Dash.Count; k++) {
+          if (EFI_ERROR(ClearAer(&Dash, &Dash.Dev[k]))) {
+            Dash.Note = L"Clear refused: AER status is RW1C (F9 to unlock)";
+            break;
+          }
+        }
+        break;
+      case L't': case L'T':
+        // Auto-clear needs writes: refused while locked
+        if (!Dash.AutoClear && !DangerousWritesUnlocked()) Dash.Note = L"Auto-clear needs the F9 unlock";
+        else Dash.AutoClear = !Dash.AutoClear;
+        break;
+      case L'+':
+        if (Dash.IntervalSec < AER_MAX_SEC) ArmTimer(Timer, ++Dash.IntervalSec);
+        break;
+      case L'-':
+        if (Dash.IntervalSec > 1) ArmTimer(Timer, --Dash.IntervalSec);
+        break;
+      default:
+        if (Key.ScanCode == SCAN_UP && Sel > 0) Sel--;
+        if (Key.ScanCode == SCAN_DOWN && Sel + 1 < Dash.Count) Sel++;
+        break;
+    }
+  }
+
+  gBS->SetTimer(Timer, TimerCancel, 0);
+  gBS->CloseEvent(Timer);
+  FreePool(Dash.Dev);
+}
@@ -0,0 +1,238 @@
+#include "PciUtility.h"
+
+#define EXT_CAP_L1SS     0x001E
+#define NO_LIMIT         0xFFFFFFFF
+#define SWITCH_L1_NS     1000      // each switch on the path may add up to 1us of L1 exit
+
+typedef struct {
+  UINT32 LinkCap;
+  UINT16 LinkCtl;
+  UINT16 L1ss;          // L1 PM Substates capability offset, 0 = none
+  UINT32 L1ssCap;
+  UINT32 L1ssCtl1;
+} ASPM_END;
+
+typedef struct {
+  UINT16   Port;        // downstream port index
+  UINT16   Child;       // link partner index
+  ASPM_END Up;          // port end
+  ASPM_END Dn;          // device end
+  UINT32   L0sNs;       // worst L0s exit of the two ends
+  UINT32   L1Ns;        // worst L1 exit, incl. T_POWER_ON when L1.2 is enabled
+  BOOLEAN  L0sOn;
+  BOOLEAN  L1On;
+} ASPM_LINK;
+
+// -----------------------------
+// Encodings (PCIe Base 7.5.3.3 / 7.5.3.6, L1 PM Substates 7.8.3)
+// -----------------------------
+STATIC UINT32 L0sExitNs(UINT32 LinkCap) { UINT32 e = (LinkCap >> 12) & 7; return (e == 7) ? 5000  : (64U   << e); }
+STATIC UINT32 L1ExitNs (UINT32 LinkCap) { UINT32 e = (LinkCap >> 15) & 7; return (e == 7) ? 65000 : (1000U << e); }
+STATIC UINT32 L0sAcceptNs(UINT32 DevCap) { UINT32 e = (DevCap >> 6) & 7; return (e == 7) ? NO_LIMIT : (64U   << e); }
+STATIC UINT32 L1AcceptNs (UINT32 DevCap) { UINT32 e = (DevCap >> 9) & 7; return (e == 7) ? NO_LIMIT : (1000U << e); }
+
+// T_POWER_ON from L1SS Capabilities [17:16] scale / [23:19] value
+STATIC
+UINT32
+TPowerOnNs(UINT32 L1ssCap)
+{
+  STATIC CONST UINT32 ScaleUs[] = { 2, 10, 100, 0 };
+  return ScaleUs[(L1ssCap >> 16) & 3] * ((L1ssCap >> 19) & 0x1F) * 1000;
+}
+
+STATIC
+VOID
+FormatLatency(OUT CHAR16 *Buf, UINTN Size, UINT32 Ns)
+{
+  if (Ns == NO_LIMIT)   UnicodeSPrint(Buf, Size, L"any");
+  else if (Ns < 1000)   UnicodeSPrint(Buf, Size, L"%uns", Ns);
+  else                  UnicodeSPrint(Buf, Size, L"%uus", Ns / 1000);
+}
+
+STATIC
+VOID
+ReadAspmEnd(PCI_DEV_INFO *p, PCI_TOPO_NODE *n, OUT ASPM_END *E)
+{
+  ZeroMem(E, sizeof(*E));
+  PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x0C), &E->LinkCap);
+  PciCfgRead16(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x10), &E->LinkCtl);
+
+  E->L1ss = PciCfgFindExtCapability(p->Bus, p->Dev, p->Func, EXT_CAP_L1SS);
+  if (E->L1ss != 0) {
+    PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(E->L1ss + 0x04), &E->L1ssCap);
+    PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(E->L1ss + 0x08), &E->L1ssCtl1);
+  }
+}
+
+STATIC
+CONST CHAR16 *
+AspmName(UINT32 Bits)
+{
+  STATIC CONST CHAR16 *Name[] = { L"-", L"L0s", L"L1", L"L0s+L1" };
+  return Name[Bits & 3];
+}
+
+// "1.1/1.2" style summary of L1SS enables (ASPM L1.1 = bit3, ASPM L1.2 = bit2)
+STATIC
+CONST CHAR16 *
+L1ssName(ASPM_END *E)
+{
+  if (E->L1ss == 0) return L"n/a";
+  switch (E->L1ssCtl1 & 0x0C) {
+    case 0x0C: return L"1.1+1.2";
+    case 0x08: return L"1.1";
+    case 0x04: return L"1.2";
+    default:   return L"off";
+  }
+}
+
+// -----------------------------
+// Audit
+// -----------------------------
+// Link table is indexed by port (LinkOf[i] = link whose port is i) so the
+// per-endpoint path walk is a parent-pointer chase, no searching.
+UINTN
+PciAspmAudit(IN PCI_TOPOLOGY *Topo, OUT PCI_REPORT *Rep)
+{
+  UINTN Count = Topo->Count;
+  ASPM_LINK *Link  = AllocateZeroPool(sizeof(ASPM_LINK) * (Count ? Count : 1));
+  UINT16    *LinkOf = AllocatePool(sizeof(UINT16) * (Count ? Count : 1));
+  if (Link == NULL || LinkOf == NULL) {
+    if (Link) FreePool(Link);
+    if (LinkOf) FreePool(LinkOf);
+    ReportAdd(Rep, L"Out of resources");
+    return 0;
+  }
+  SetMem(LinkOf, sizeof(UINT16) * Count, 0xFF);
+
+  UINTN Links = 0;
+
+  ReportAdd(Rep, L"Port      Device    Sup(P/D)      En(P/D)       L0s    L1     L1SS(P/D)");
+
+  for (UINTN i = 0; i < Count; i++) {
+    UINT16 c = PciLinkPartner(Topo, i);
+    if (c == PCI_NO_NODE) continue;
+
+    ASPM_LINK *L = &Link[Links];
+    L->Port  = (UINT16)i;
+    L->Child = c;
+    ReadAspmEnd(&Topo->List[i], &Topo->Node[i], &L->Up);
+    ReadAspmEnd(&Topo->List[c], &Topo->Node[c], &L->Dn);
+
+    L->L0sNs = MAX(L0sExitNs(L->Up.LinkCap), L0sExitNs(L->Dn.LinkCap));
+    L->L1Ns  = MAX(L1ExitNs(L->Up.LinkCap),  L1ExitNs(L->Dn.LinkCap));
+    L->L0sOn = ((L->Up.LinkCtl | L->Dn.LinkCtl) & BIT0) != 0;
+    L->L1On  = ((L->Up.LinkCtl & L->Dn.LinkCtl) & BIT1) != 0;
+
+    // Exit from ASPM L1.2 also waits for T_POWER_ON of the slower end
+    if (L->L1On && (L->Up.L1ssCtl1 & L->Dn.L1ssCtl1 & BIT2) != 0) {
+      L->L1Ns += MAX(TPowerOnNs(L->Up.L1ssCap), TPowerOnNs(L->Dn.L1ssCap));
+    }
+
+    PCI_DEV_INFO *pp = &Topo->List[i];
+    PCI_DEV_INFO *cp = &Topo->List[c];
+    ReportAdd(Rep, L"%02x/%02x/%02x  %02x/%02x/%02x  %-6s/%-6s %-6s/%-6s %4uns %3uus %s/%s",
+              pp->Bus, pp->Dev, pp->Func, cp->Bus, cp->Dev, cp->Func,
+              AspmName(L->Up.LinkCap >> 10), AspmName(L->Dn.LinkCap >> 10),
+              AspmName(L->Up.LinkCtl), AspmName(L->Dn.LinkCtl),
+              L->L0sNs, L->L1Ns / 1000, L1ssName(&L->Up), L1ssName(&L->Dn));
+
+    LinkOf[i] = (UINT16)Links;
+    Links++;
+  }
+
+  // Endpoints: compare path exit latency with Device Cap acceptable latency
+  UINTN Bad = 0;
+  ReportAdd(Rep, L"");
+  ReportAdd(Rep, L"Endpoint  Accept L0s/L1     Path L0s/L1       Result");
+
+  for (UINTN i = 0; i < Count; i++) {
+    PCI_TOPO_NODE *n = &Topo->Node[i];
+    if (n->PcieCap == 0 || n->IsVf) continue;      // a VF's link is the PF's
+    if (n->PortType != PCIE_PORT_ENDPOINT && n->PortType != PCIE_PORT_LEGACY_ENDPOINT) continue;
+
+    PCI_DEV_INFO *p = &Topo->List[i];
+    UINT32 DevCap = 0;
+    PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x04), &DevCap);
+    UINT32 AccL0s = L0sAcceptNs(DevCap);
+    UINT32 AccL1  = L1AcceptNs(DevCap);
+
+    UINT32  WorstL0s = 0, PathL1 = 0, SwitchNs = 0;
+    BOOLEAN L0sBad = FALSE, L1Bad = FALSE, AnyOn = FALSE;
+
+    for (UINT16 up = n->Parent; up != PCI_NO_NODE; up = Topo->Node[up].Parent) {
+      if (LinkOf[up] == PCI_NO_NODE) continue;   // switch-internal hop
+      ASPM_LINK *L = &Link[LinkOf[up]];
+
+      if (L->L0sOn) {
+        AnyOn = TRUE;
+        WorstL0s = MAX(WorstL0s, L->L0sNs);
+        if (L->L0sNs > AccL0s) L0sBad = TRUE;   // L0s is checked per link
+      }
+      if (L->L1On) {
+        AnyOn = TRUE;
+        PathL1 = MAX(PathL1, L->L1Ns + SwitchNs);
+        if (L->L1Ns + SwitchNs > AccL1) L1Bad = TRUE;
+      }
+      SwitchNs += SWITCH_L1_NS;
+    }
+
+    if (!AnyOn) continue;
+    if (L0sBad || L1Bad) Bad++;
+
+    CHAR16 A0[12], A1[12], P0[12], P1[12];
+    FormatLatency(A0, sizeof(A0), AccL0s);
+    FormatLatency(A1, sizeof(A1), AccL1);
+    FormatLatency(P0, sizeof(P0), WorstL0s);
+    FormatLatency(P1, sizeof(P1), PathL1);
+
+    ReportAdd(Rep, L"%02x/%02x/%02x  %6s/%-8s  %6s/%-8s  %s",
+              p->Bus, p->Dev, p->Func, A0, A1, P0, P1,
+              (L0sBad && L1Bad) ? L"EXCEEDS L0s+L1" : L0sBad ? L"EXCEEDS L0s" : L1Bad ? L"EXCEEDS L1" : L"ok");
+  }
+
+  ReportAdd(Rep, L"");
+  ReportAdd(Rep, L"Links: %u   Endpoints over their acceptable latency: %u", (UINT32)Links, (UINT32)Bad);
+
+  FreePool(LinkOf);
+  FreePool(Link);
+  return Bad;
+}
+
+// -----------------------------
+// Bulk disable
+// -----------------------------
+// Clears ASPM L1.1/L1.2 and ASPM Control on Root (a bridge) and everything
+// below it. Children are handled before their ports, as the spec requires
+// when disabling L1 (downstream component first).
+UINTN
+PciAspmDisableSubtree(IN PCI_TOPOLOGY *Topo, UINTN Root, OUT PCI_REPORT *Rep)
+{
+  PCI_TOPO_NODE *rn = &Topo->Node[Root];
+  UINTN Failed = 0;
+
+  for (UINTN k = Topo->Count; k-- > 0; ) {
+    PCI_DEV_INFO  *p = &Topo->List[k];
+    PCI_TOPO_NODE *n = &Topo->Node[k];
+
+    BOOLEAN Inside = (k == Root) ||
+                     (rn->HdrType == 0x01 && rn->SecBus != 0 && p->Bus >= rn->SecBus && p->Bus <= rn->SubBus);
+    if (!Inside || n->PcieCap == 0 || n->IsVf) continue;   // VF Link Control ASPM is RsvdP
+
+    EFI_STATUS St = EFI_SUCCESS;
+    UINT32 Rb = 0;
+
+    UINT16 L1ss = PciCfgFindExtCapability(p->Bus, p->Dev, p->Func, EXT_CAP_L1SS);
+    if (L1ss != 0) {
+      St = PolicyWrite(p->Bus, p->Dev, p->Func, (UINT16)(L1ss + 0x08), DISP_DWORD, 0x0C, 0, &Rb);
+    }
+    if (!EFI_ERROR(St)) {
+      St = PolicyWrite(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x10), DISP_WORD, 0x03, 0, &Rb);
+    }
+
+    if (EFI_ERROR(St)) Failed++;
+    ReportAdd(Rep, L"%02x/%02x/%02x  LinkCtl=%04x  %r", p->Bus, p->Dev, p->Func, Rb, St);
+  }
+
+  return Failed;
+}
@@ -0,0 +1,154 @@
+#include "PciUtility.h"
+
+#define RATIO_ONE   100     // ratios are fixed point x100
+
+typedef struct {
+  UINT16 Node;          // root port or switch upstream port
+  UINT16 Ports;         // downstream ports / links in use
+  UINT16 Active;
+  UINT32 UpMBps;        // bandwidth of the link above the fan-out point
+  UINT32 DirectMBps;    // sum of the links one level down
+  UINT32 LeafMBps;      // sum of the links to end devices in the subtree
+  UINT32 Direct;        // DirectMBps / UpMBps, x100
+  UINT32 Leaf;          // LeafMBps / UpMBps, x100
+} OVERSUB_ENTRY;
+
+// Negotiated bandwidth of the link below a downstream port (Link Status).
+UINT32
+PciLinkCurrentMBps(IN PCI_TOPOLOGY *Topo, UINTN PortIndex)
+{
+  PCI_DEV_INFO  *p = &Topo->List[PortIndex];
+  PCI_TOPO_NODE *n = &Topo->Node[PortIndex];
+  UINT16 LinkSta = 0;
+
+  if (n->PcieCap == 0) return 0;
+  PciCfgRead16(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x12), &LinkSta);
+  return PcieLaneMBps((UINT8)(LinkSta & 0x0F)) * ((LinkSta >> 4) & 0x3F);
+}
+
+STATIC
+UINT32
+Ratio(UINT32 Num, UINT32 Den)
+{
+  return Den ? (UINT32)(((UINT64)Num * RATIO_ONE) / Den) : 0;
+}
+
+STATIC
+BOOLEAN
+IsSwitchUp(PCI_TOPOLOGY *Topo, UINT16 i)
+{
+  return i != PCI_NO_NODE && Topo->Node[i].PcieCap != 0 && Topo->Node[i].PortType == PCIE_PORT_SWITCH_UP;
+}
+
+STATIC
+INTN
+EFIAPI
+CompareOversubDesc(IN CONST VOID *A, IN CONST VOID *B)
+{
+  CONST OVERSUB_ENTRY *a = A;
+  CONST OVERSUB_ENTRY *b = B;
+  if (a->Leaf != b->Leaf) return (a->Leaf < b->Leaf) ? 1 : -1;
+  if (a->Direct != b->Direct) return (a->Direct < b->Direct) ? 1 : -1;
+  return 0;
+}
+
+// Walks the topology tree bottom-up once. Children always sit after their
+// parent in the bus-ordered list, so a reverse pass sees every subtree
+// complete before it is needed:
+//   port with a link  : Demand = partner is a switch ? Demand[switch] : link
+//   switch upstream   : Demand = sum of its downstream ports' Demand
+// Returns the number of oversubscribed fan-out points (leaf ratio > 1).
+UINTN
+PciOversubscription(IN PCI_TOPOLOGY *Topo, OUT PCI_REPORT *Rep)
+{
+  UINTN Count = Topo->Count;
+  UINT32        *Link   = AllocateZeroPool(sizeof(UINT32) * (Count ? Count : 1));
+  UINT32        *Demand = AllocateZeroPool(sizeof(UINT32) * (Count ? Count : 1));
+  OVERSUB_ENTRY *Ent    = AllocateZeroPool(sizeof(OVERSUB_ENTRY) * (Count ? Count : 1));
+  if (Link == NULL || Demand == NULL || Ent == NULL) {
+    if (Link) FreePool(Link);
+    if (Demand) FreePool(Demand);
+    if (Ent) FreePool(Ent);
+    ReportAdd(Rep, L"Out of resources");
+    return 0;
+  }
+
+  for (UINTN k = Count; k-- > 0; ) {
+    UINT16 c = PciLinkPartner(Topo, k);
+    if (c != PCI_NO_NODE) {
+      Link[k]   = PciLinkCurrentMBps(Topo, k);
+      Demand[k] = IsSwitchUp(Topo, c) ? Demand[c] : Link[k];
+    }
+    if (IsSwitchUp(Topo, (UINT16)k)) {
+      for (UINT16 d = Topo->Node[k].FirstChild; d != PCI_NO_NODE; d = Topo->Node[d].NextSibling) {
+        Demand[k] += Demand[d];
+      }
+    }
+  }
+
+  UINTN n = 0;
+  for (UINTN i = 0; i < Count; i++) {
+    PCI_TOPO_NODE *Node = &Topo->Node[i];
+    if (Node->PcieCap == 0) continue;
+
+    OVERSUB_ENTRY E;
+    ZeroMem(&E, sizeof(E));
+    E.Node = (UINT16)i;
+
+    if (Node->PortType == PCIE_PORT_ROOT) {
+      if (Link[i] == 0) continue;
+      E.Ports      = 1;
+      E.Active     = 1;
+      E.UpMBps     = Link[i];
+      E.DirectMBps = Link[i];
+    } else if (Node->PortType == PCIE_PORT_SWITCH_UP) {
+      if (Node->Parent == PCI_NO_NODE || Link[Node->Parent] == 0) continue;
+      E.UpMBps = Link[Node->Parent];
+      for (UINT16 d = Node->FirstChild; d != PCI_NO_NODE; d = Topo->Node[d].NextSibling) {
+        E.Ports++;
+        if (Link[d] == 0) continue;
+        E.Active++;
+        E.DirectMBps += Link[d];
+      }
+    } else {
+      continue;
+    }
+
+    E.LeafMBps = Demand[i];
+    E.Direct   = Ratio(E.DirectMBps, E.UpMBps);
+    E.Leaf     = Ratio(E.LeafMBps, E.UpMBps);
+    Ent[n++]   = E;
+  }
+
+  if (n > 1) {
+    OVERSUB_ENTRY Tmp;
+    QuickSort(Ent, n, sizeof(OVERSUB_ENTRY), CompareOversubDesc, &Tmp);
+  }
+
+  UINTN Over = 0;
+  for (UINTN k = 0; k < n; k++) {
+    if (Ent[k].Leaf > RATIO_ONE) Over++;
+  }
+
+  ReportAdd(Rep, L"Fan-out points: %u   Oversubscribed: %u   (current link speed x width)", (UINT32)n, (UINT32)Over);
+  ReportAdd(Rep, L"");
+  ReportAdd(Rep, L"Node       Type    Ports  Up(MB/s)  Down(MB/s)  Ratio   Leaves(MB/s)  Ratio");
+
+  for (UINTN k = 0; k < n; k++) {
+    OVERSUB_ENTRY *E = &Ent[k];
+    PCI_DEV_INFO  *p = &Topo->List[E->Node];
+
+    ReportAdd(Rep, L"%02x/%02x/%02x   %-6s  %2u/%-2u  %-8u  %-10u  %2u.%02ux  %-12u  %2u.%02ux%s",
+              p->Bus, p->Dev, p->Func,
+              (Topo->Node[E->Node].PortType == PCIE_PORT_ROOT) ? L"Root" : L"Switch",
+              E->Active, E->Ports, E->UpMBps,
+              E->DirectMBps, E->Direct / RATIO_ONE, E->Direct % RATIO_ONE,
+              E->LeafMBps, E->Leaf / RATIO_ONE, E->Leaf % RATIO_ONE,
+              (E->Leaf > RATIO_ONE) ? L"  <" : L"");
+  }
+
+  FreePool(Ent);
+  FreePool(Demand);
+  FreePool(Link);
+  return Over;
+}
@@ -0,0 +1,17 @@
+#include "PciUtility.h"
+
+// PCIe speed encoding (Link Cap/Status [3:0]) -> usable MB/s per lane,
+// after 8b/10b (Gen1/2), 128b/130b (Gen3-5) and FLIT (Gen6) overhead.
+UINT32
+PcieLaneMBps(UINT8 Speed)
+{
+  STATIC CONST UINT32 Table[] = { 0, 250, 500, 985, 1969, 3938, 7877 };
+  return (Speed < ARRAY_SIZE(Table)) ? Table[Speed] : 0;
+}
+
+CONST CHAR16 *
+PcieSpeedName(UINT8 Speed)
+{
+  STATIC CONST CHAR16 *Name[] = { L"?", L"Gen1", L"Gen2", L"Gen3", L"Gen4", L"Gen5", L"Gen6" };
+  return (Speed < ARRAY_SIZE(Name)) ? Name[Speed] : L"?";
+}
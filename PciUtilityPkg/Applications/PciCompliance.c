@@ -0,0 +1,416 @@
+#include "PciUtility.h"
+
+//
+// Golden-config rule file, one rule per line, '#' starts a comment:
+//
+//   <selector>  <offset>  <mask>  <expected>  [name]
+//
+//   selector : *  |  bb:dd.f  |  vvvv:dddd  |  vvvv:*        (hex)
+//   offset   : hex  |  capXX+hex  |  ecapXXXX+hex           (capability relative)
+//   mask / expected apply at offset (little endian, may be 1-4 bytes wide)
+//
+// Rules are compiled into (function, DWORD) checks, sorted so every DWORD
+// is read once no matter how many rules look at it.
+//
+#define SEL_ANY          0
+#define SEL_BDF          1
+#define SEL_ID           2
+
+#define OFF_ABS          0
+#define OFF_CAP          1
+#define OFF_ECAP         2
+
+#define GOLDEN_MAX_CAPS  32
+#define GOLDEN_NAME_LEN  32
+#define CHECK_GROW       256
+#define CAP_UNRESOLVED   0xFFFF
+
+typedef struct {
+  UINT32 Line;
+  UINT8  SelKind;
+  UINT8  Bus, Dev, Func;
+  UINT16 Vid, Did;        // Did 0xFFFF: any device of the vendor
+  UINT8  OffKind;
+  UINT8  CapSlot;         // index into the distinct capability list
+  UINT16 Offset;          // absolute, or relative to the capability
+  UINT32 Mask;            // shifted to the byte lane inside the DWORD
+  UINT32 Expect;
+  UINT32 Hits;            // functions the rule applied to
+  UINT32 Missing;         // selected, but capability absent
+  CHAR16 Name[GOLDEN_NAME_LEN];
+} GOLDEN_RULE;
+
+typedef struct {
+  UINT16 Func;            // list index
+  UINT16 Dword;           // DWORD-aligned offset
+  UINT16 Rule;
+} GOLDEN_CHECK;
+
+typedef struct {
+  GOLDEN_RULE  *Rule;
+  UINTN         RuleCount;
+  UINT16        CapKey[GOLDEN_MAX_CAPS];   // capability / extended capability id
+  UINT8         CapKind[GOLDEN_MAX_CAPS];  // OFF_CAP / OFF_ECAP
+  UINTN         CapCount;
+  GOLDEN_CHECK *Check;
+  UINTN         CheckCount;
+  UINTN         CheckCap;
+} GOLDEN_SET;
+
+// -----------------------------
+// Parsing
+// -----------------------------
+STATIC
+BOOLEAN
+IsBlank(CHAR16 c)
+{
+  return c == L' ' || c == L'\t' || c == L'\r';
+}
+
+// Splits off the next blank-separated token in place; NULL at end of line.
+CHAR16 *
+PciNextToken(IN OUT CHAR16 **Cursor)
+{
+  CHAR16 *s = *Cursor;
+  while (IsBlank(*s)) s++;
+  if (*s == L'\0') { *Cursor = s; return NULL; }
+
+  CHAR16 *Tok = s;
+  while (*s != L'\0' && !IsBlank(*s)) s++;
+  if (*s != L'\0') *s++ = L'\0';
+  *Cursor = s;
+  return Tok;
+}
+
+// Strict hex: optional 0x, 1..MaxDigits digits, stops at Stop (or end).
+BOOLEAN
+PciParseHex(IN CONST CHAR16 *s, UINTN MaxDigits, CHAR16 Stop, OUT UINT32 *Value, OUT CONST CHAR16 **End)
+{
+  if (s[0] == L'0' && (s[1] == L'x' || s[1] == L'X')) s += 2;
+
+  UINT32 v = 0;
+  UINTN  n = 0;
+  for (; *s != L'\0' && *s != Stop; s++, n++) {
+    CHAR16 c = CharToUpper(*s);
+    UINT32 d;
+    if (c >= L'0' && c <= L'9')      d = c - L'0';
+    else if (c >= L'A' && c <= L'F') d = c - L'A' + 10;
+    else return FALSE;
+    if (n >= MaxDigits) return FALSE;
+    v = (v << 4) | d;
+  }
+
+  if (n == 0) return FALSE;
+  *Value = v;
+  if (End != NULL) *End = s;
+  else if (*s != L'\0') return FALSE;
+  return TRUE;
+}
+
+STATIC
+BOOLEAN
+ParseSelector(IN CONST CHAR16 *Tok, OUT GOLDEN_RULE *r)
+{
+  UINT32 a, b, c;
+  CONST CHAR16 *e;
+
+  if (StrCmp(Tok, L"*") == 0) {
+    r->SelKind = SEL_ANY;
+    return TRUE;
+  }
+
+  if (!PciParseHex(Tok, 4, L':', &a, &e) || *e != L':') return FALSE;
+  e++;
+
+  if (StrStr(e, L".") != NULL) {               // bb:dd.f
+    if (a > 0xFF || !PciParseHex(e, 2, L'.', &b, &e) || b > 0x1F) return FALSE;
+    if (!PciParseHex(e + 1, 1, L'\0', &c, NULL) || c > 7) return FALSE;
+    r->SelKind = SEL_BDF;
+    r->Bus = (UINT8)a; r->Dev = (UINT8)b; r->Func = (UINT8)c;
+    return TRUE;
+  }
+
+  r->SelKind = SEL_ID;                          // vvvv:dddd / vvvv:*
+  r->Vid = (UINT16)a;
+  if (StrCmp(e, L"*") == 0) { r->Did = 0xFFFF; return TRUE; }
+  if (!PciParseHex(e, 4, L'\0', &b, NULL)) return FALSE;
+  r->Did = (UINT16)b;
+  return TRUE;
+}
+
+STATIC
+BOOLEAN
+ParseOffset(IN CONST CHAR16 *Tok, IN OUT GOLDEN_SET *Set, OUT GOLDEN_RULE *r)
+{
+  UINT32 Id = 0, Off = 0;
+  CONST CHAR16 *e;
+
+  if (StrnCmp(Tok, L"ecap", 4) == 0)     { r->OffKind = OFF_ECAP; Tok += 4; }
+  else if (StrnCmp(Tok, L"cap", 3) == 0) { r->OffKind = OFF_CAP;  Tok += 3; }
+  else                                   { r->OffKind = OFF_ABS; }
+
+  if (r->OffKind == OFF_ABS) {
+    if (!PciParseHex(Tok, 3, L'\0', &Off, NULL)) return FALSE;
+    r->Offset = (UINT16)Off;
+    return TRUE;
+  }
+
+  if (!PciParseHex(Tok, (r->OffKind == OFF_CAP) ? 2 : 4, L'+', &Id, &e)) return FALSE;
+  if (*e == L'+' && !PciParseHex(e + 1, 3, L'\0', &Off, NULL)) return FALSE;
+  r->Offset = (UINT16)Off;
+
+  // Distinct capabilities, so each function looks each one up at most once
+  UINTN s;
+  for (s = 0; s < Set->CapCount; s++) {
+    if (Set->CapKind[s] == r->OffKind && Set->CapKey[s] == (UINT16)Id) break;
+  }
+  if (s == Set->CapCount) {
+    if (s == GOLDEN_MAX_CAPS) return FALSE;
+    Set->CapKind[s] = r->OffKind;
+    Set->CapKey[s]  = (UINT16)Id;
+    Set->CapCount++;
+  }
+  r->CapSlot = (UINT8)s;
+  return TRUE;
+}
+
+STATIC
+EFI_STATUS
+ParseRules(IN CHAR16 *Text, IN OUT GOLDEN_SET *Set, OUT PCI_REPORT *Rep)
+{
+  UINTN Lines = 1;
+  for (CHAR16 *s = Text; *s != L'\0'; s++) if (*s == L'\n') Lines++;
+
+  if (Lines > MAX_UINT16) {
+    ReportAdd(Rep, L"Rule file has too many lines");
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Set->Rule = AllocateZeroPool(sizeof(GOLDEN_RULE) * Lines);
+  if (Set->Rule == NULL) return EFI_OUT_OF_RESOURCES;
+
+  CHAR16 *Line = Text;
+  for (UINT32 No = 1; Line != NULL; No++) {
+    CHAR16 *Next = StrStr(Line, L"\n");
+    if (Next != NULL) *Next++ = L'\0';
+
+    CHAR16 *Hash = StrStr(Line, L"#");
+    if (Hash != NULL) *Hash = L'\0';
+
+    CHAR16 *Cur = Line;
+    CHAR16 *Tok[4];
+    UINTN   n = 0;
+    while (n < 4 && (Tok[n] = PciNextToken(&Cur)) != NULL) n++;
+
+    Line = Next;
+    if (n == 0) continue;
+
+    GOLDEN_RULE *r = &Set->Rule[Set->RuleCount];
+    r->Line = No;
+
+    UINT32 Mask = 0, Expect = 0;
+    BOOLEAN Ok = (n == 4) &&
+                 ParseSelector(Tok[0], r) &&
+                 ParseOffset(Tok[1], Set, r) &&
+                 PciParseHex(Tok[2], 8, L'\0', &Mask, NULL) &&
+                 PciParseHex(Tok[3], 8, L'\0', &Expect, NULL);
+
+    // Mask must fit in the DWORD from the offset's byte lane
+    UINTN Shift = (r->Offset & 3) * 8;
+    if (Ok && Shift != 0 && (Mask >> (32 - Shift)) != 0) Ok = FALSE;
+
+    if (!Ok) {
+      ReportAdd(Rep, L"Rule file line %u: syntax error", No);
+      return EFI_INVALID_PARAMETER;
+    }
+
+    r->Mask   = Mask << Shift;
+    r->Expect = (Expect & Mask) << Shift;
+
+    while (IsBlank(*Cur)) Cur++;
+    StrnCpyS(r->Name, GOLDEN_NAME_LEN, Cur, GOLDEN_NAME_LEN - 1);
+    for (UINTN e = StrLen(r->Name); e > 0 && IsBlank(r->Name[e - 1]); e--) r->Name[e - 1] = L'\0';
+    Set->RuleCount++;
+  }
+
+  return EFI_SUCCESS;
+}
+
+// -----------------------------
+// Compile: rules -> sorted (function, DWORD) checks
+// -----------------------------
+STATIC
+BOOLEAN
+RuleSelects(GOLDEN_RULE *r, PCI_DEV_INFO *p)
+{
+  switch (r->SelKind) {
+    case SEL_BDF: return r->Bus == p->Bus && r->Dev == p->Dev && r->Func == p->Func;
+    case SEL_ID:  return r->Vid == p->Vid && (r->Did == 0xFFFF || r->Did == p->Did);
+    default:      return TRUE;
+  }
+}
+
+// Bytes from the rule's offset to the last byte its mask covers (1-4)
+STATIC
+UINTN
+RuleWidth(IN GOLDEN_RULE *r)
+{
+  UINTN Lane = r->Offset & 3, Last = Lane;
+  for (UINTN b = Lane; b < 4; b++) {
+    if (r->Mask & (0xFFU << (b * 8))) Last = b;
+  }
+  return Last - Lane + 1;
+}
+
+STATIC
+EFI_STATUS
+AddCheck(IN OUT GOLDEN_SET *Set, UINTN Func, UINT16 Dword, UINTN Rule)
+{
+  if (Set->CheckCount == Set->CheckCap) {
+    UINTN NewCap = Set->CheckCap + CHECK_GROW;
+    VOID *New = ReallocatePool(Set->CheckCap * sizeof(GOLDEN_CHECK), NewCap * sizeof(GOLDEN_CHECK), Set->Check);
+    if (New == NULL) return EFI_OUT_OF_RESOURCES;
+    Set->Check    = New;
+    Set->CheckCap = NewCap;
+  }
+
+  GOLDEN_CHECK *c = &Set->Check[Set->CheckCount++];
+  c->Func  = (UINT16)Func;
+  c->Dword = Dword;
+  c->Rule  = (UINT16)Rule;
+  return EFI_SUCCESS;
+}
+
+STATIC
+INTN
+EFIAPI
+CompareCheck(IN CONST VOID *A, IN CONST VOID *B)
+{
+  CONST GOLDEN_CHECK *a = A;
+  CONST GOLDEN_CHECK *b = B;
+  if (a->Func != b->Func)   return (a->Func < b->Func) ? -1 : 1;
+  if (a->Dword != b->Dword) return (a->Dword < b->Dword) ? -1 : 1;
+  return (a->Rule < b->Rule) ? -1 : (a->Rule > b->Rule) ? 1 : 0;
+}
+
+STATIC
+EFI_STATUS
+CompileChecks(IN PCI_DEV_INFO *List, UINTN Count, IN OUT GOLDEN_SET *Set)
+{
+  UINT16 CapOff[GOLDEN_MAX_CAPS];
+
+  for (UINTN i = 0; i < Count; i++) {
+    PCI_DEV_INFO *p = &List[i];
+    SetMem16(CapOff, sizeof(CapOff), CAP_UNRESOLVED);
+
+    for (UINTN k = 0; k < Set->RuleCount; k++) {
+      GOLDEN_RULE *r = &Set->Rule[k];
+      if (!RuleSelects(r, p)) continue;
+
+      UINT16 Base = 0;
+      if (r->OffKind != OFF_ABS) {
+        UINT16 *c = &CapOff[r->CapSlot];
+        if (*c == CAP_UNRESOLVED) {
+          *c = (r->OffKind == OFF_CAP)
+             ? PciCfgFindCapability(p->Bus, p->Dev, p->Func, (UINT8)Set->CapKey[r->CapSlot])
+             : PciCfgFindExtCapability(p->Bus, p->Dev, p->Func, Set->CapKey[r->CapSlot]);
+        }
+        if (*c == 0) { r->Missing++; continue; }
+        Base = *c;
+      }
+
+      UINTN Off = (UINTN)Base + r->Offset;
+      if (Off + RuleWidth(r) > 0x1000) { r->Missing++; continue; }
+
+      r->Hits++;
+      EFI_STATUS St = AddCheck(Set, i, (UINT16)(Off & 0xFFC), k);
+      if (EFI_ERROR(St)) return St;
+    }
+  }
+
+  if (Set->CheckCount > 1) {
+    GOLDEN_CHECK Tmp;
+    QuickSort(Set->Check, Set->CheckCount, sizeof(GOLDEN_CHECK), CompareCheck, &Tmp);
+  }
+  return EFI_SUCCESS;
+}
+
+// -----------------------------
+// Evaluate
+// -----------------------------
+STATIC
+UINTN
+EvaluateChecks(IN PCI_DEV_INFO *List, IN GOLDEN_SET *Set, OUT PCI_REPORT *Rep, OUT UINTN *Reads)
+{
+  UINTN  Failed = 0;
+  UINT32 Value  = 0;
+  *Reads = 0;
+
+  for (UINTN k = 0; k < Set->CheckCount; k++) {
+    GOLDEN_CHECK *c = &Set->Check[k];
+    PCI_DEV_INFO *p = &List[c->Func];
+    GOLDEN_RULE  *r = &Set->Rule[c->Rule];
+
+    if (k == 0 || c->Func != Set->Check[k - 1].Func || c->Dword != Set->Check[k - 1].Dword) {
+      Value = 0xFFFFFFFF;
+      PciCfgRead32(p->Bus, p->Dev, p->Func, c->Dword, &Value);
+      (*Reads)++;
+    }
+
+    if ((Value & r->Mask) == r->Expect) continue;
+
+    Failed++;
+    ReportAdd(Rep, L"FAIL %02x/%02x/%02x %04x:%04x  +%03x  %08x & %08x = %08x, want %08x  line %u %s",
+              p->Bus, p->Dev, p->Func, p->Vid, p->Did, c->Dword,
+              Value, r->Mask, Value & r->Mask, r->Expect, r->Line, r->Name);
+  }
+
+  return Failed;
+}
+
+// Loads Path, checks every function in List and reports failures.
+// *Failed receives the number of failing checks. Returns an error only
+// when the rule file cannot be used.
+EFI_STATUS
+PciComplianceRun(IN PCI_DEV_INFO *List, UINTN Count, IN CONST CHAR16 *Path, OUT PCI_REPORT *Rep, OUT UINTN *Failed)
+{
+  GOLDEN_SET Set;
+  CHAR16    *Text = NULL;
+
+  ZeroMem(&Set, sizeof(Set));
+  *Failed = 0;
+
+  EFI_STATUS St = PciFileReadText(Path, &Text);
+  if (EFI_ERROR(St)) {
+    ReportAdd(Rep, L"Cannot read rule file %s: %r", Path, St);
+    return St;
+  }
+
+  St = ParseRules(Text, &Set, Rep);
+  if (!EFI_ERROR(St)) St = CompileChecks(List, Count, &Set);
+
+  if (!EFI_ERROR(St)) {
+    UINTN Reads = 0;
+    *Failed = EvaluateChecks(List, &Set, Rep, &Reads);
+
+    for (UINTN k = 0; k < Set.RuleCount; k++) {
+      GOLDEN_RULE *r = &Set.Rule[k];
+      if (r->Hits == 0) {
+        ReportAdd(Rep, L"WARN line %u %s: matched no function%s", r->Line, r->Name,
+                  r->Missing ? L" with the capability" : L"");
+      }
+    }
+
+    ReportAdd(Rep, L"");
+    ReportAdd(Rep, L"Rules: %u  Functions: %u  Checks: %u  DWORD reads: %u  Failed: %u  Result: %s",
+              (UINT32)Set.RuleCount, (UINT32)Count, (UINT32)Set.CheckCount, (UINT32)Reads,
+              (UINT32)*Failed, (*Failed == 0) ? L"PASS" : L"FAIL");
+  } else if (St == EFI_OUT_OF_RESOURCES) {
+    ReportAdd(Rep, L"Out of resources");
+  }
+
+  if (Set.Check != NULL) FreePool(Set.Check);
+  if (Set.Rule != NULL)  FreePool(Set.Rule);
+  FreePool(Text);
+  return St;
+}
@@ -0,0 +1,321 @@
+#include "PciUtility.h"
+
+#include <Library/TimerLib.h>
+
+//
+// A function still initializing after reset answers config reads with
+// Configuration Request Retry Status. With CRS Software Visibility enabled
+// in its Root Port, a read of the Vendor ID returns 0x0001 instead. Such a
+// function goes into a deferred queue and the sweep moves on; the queue is
+// re-polled between buses and drained at the end, each entry backing off
+// from 1 ms to 100 ms, until it resolves or the global deadline passes.
+//
+#define CRS_MAX_ENTRIES      256
+#define CRS_MAX_SLOW         16
+#define CRS_FIRST_DELAY_US   1000
+#define CRS_MAX_DELAY_US     100000
+#define CRS_SLOW_PROBE_NS    1000000ULL     // device probes above 1 ms are logged
+
+typedef enum {
+  CRS_PENDING = 0,
+  CRS_PRESENT,
+  CRS_GONE,         // stopped answering CRS and reads as absent
+  CRS_TIMEOUT
+} CRS_STATE;
+
+typedef struct {
+  UINT8  Bus;
+  UINT8  Dev;
+  UINT8  Func;
+  UINT8  State;
+  UINT32 Polls;
+  UINT32 DelayUs;
+  UINT64 FirstNs;
+  UINT64 NextNs;
+  UINT64 DoneNs;
+} CRS_ENTRY;
+
+typedef struct {
+  UINT8  Bus;
+  UINT8  Dev;
+  UINT64 Ns;
+} CRS_SLOW;
+
+typedef struct {
+  // Monotonic clock built from performance counter deltas
+  UINT64    TickStart;
+  UINT64    TickEnd;
+  UINT64    LastTick;
+  UINT64    ClockNs;
+
+  UINT32    DeadlineMs;
+  UINT64    BeginNs;
+  UINT64    SweepNs;      // all buses probed once
+  UINT64    EndNs;        // queue drained or deadline hit
+  BOOLEAN   OutOfOrder;   // deferred results were appended after later buses
+
+  CRS_ENTRY Entry[CRS_MAX_ENTRIES];
+  UINTN     Count;
+  UINTN     Dropped;      // queue full: reported, never retried
+
+  CRS_SLOW  Slow[CRS_MAX_SLOW];   // slowest first
+  UINTN     SlowCount;
+} CRS_LOG;
+
+STATIC CRS_LOG mCrs;
+
+// -----------------------------
+// Clock
+// -----------------------------
+UINT64
+PciCrsNowNs(VOID)
+{
+  UINT64 Now = GetPerformanceCounter();
+  UINT64 Delta;
+
+  if (mCrs.TickEnd >= mCrs.TickStart) {
+    Delta = (Now >= mCrs.LastTick) ? Now - mCrs.LastTick
+                                   : (mCrs.TickEnd - mCrs.LastTick) + (Now - mCrs.TickStart);
+  } else {
+    // Counting down
+    Delta = (Now <= mCrs.LastTick) ? mCrs.LastTick - Now
+                                   : (mCrs.LastTick - mCrs.TickEnd) + (mCrs.TickStart - Now);
+  }
+
+  mCrs.LastTick = Now;
+  mCrs.ClockNs += GetTimeInNanoSecond(Delta);
+  return mCrs.ClockNs;
+}
+
+STATIC
+BOOLEAN
+PastDeadline(UINT64 Now)
+{
+  return Now - mCrs.BeginNs >= (UINT64)mCrs.DeadlineMs * 1000000ULL;
+}
+
+// -----------------------------
+// Queue
+// -----------------------------
+VOID
+PciCrsBegin(UINT32 DeadlineMs)
+{
+  ZeroMem(&mCrs, sizeof(mCrs));
+  GetPerformanceCounterProperties(&mCrs.TickStart, &mCrs.TickEnd);
+  mCrs.LastTick   = GetPerformanceCounter();
+  mCrs.DeadlineMs = DeadlineMs;
+  mCrs.BeginNs    = PciCrsNowNs();
+}
+
+VOID
+PciCrsDefer(UINT8 Bus, UINT8 Dev, UINT8 Func)
+{
+  if (mCrs.Count >= CRS_MAX_ENTRIES) {
+    mCrs.Dropped++;
+    return;
+  }
+
+  CRS_ENTRY *e = &mCrs.Entry[mCrs.Count++];
+  e->Bus = Bus; e->Dev = Dev; e->Func = Func;
+  e->State   = CRS_PENDING;
+  e->DelayUs = CRS_FIRST_DELAY_US;
+  e->FirstNs = PciCrsNowNs();
+  e->NextNs  = e->FirstNs + (UINT64)e->DelayUs * 1000;
+}
+
+// Keeps the CRS_MAX_SLOW slowest device probes, slowest first.
+VOID
+PciCrsNoteProbe(UINT8 Bus, UINT8 Dev, UINT64 Ns)
+{
+  if (Ns < CRS_SLOW_PROBE_NS) return;
+
+  UINTN i = MIN(mCrs.SlowCount, CRS_MAX_SLOW - 1);
+  if (mCrs.SlowCount == CRS_MAX_SLOW && mCrs.Slow[i].Ns >= Ns) return;
+
+  for (; i > 0 && mCrs.Slow[i - 1].Ns < Ns; i--) mCrs.Slow[i] = mCrs.Slow[i - 1];
+  mCrs.Slow[i].Bus = Bus;
+  mCrs.Slow[i].Dev = Dev;
+  mCrs.Slow[i].Ns  = Ns;
+  if (mCrs.SlowCount < CRS_MAX_SLOW) mCrs.SlowCount++;
+}
+
+// Re-polls every due entry once.
+STATIC
+VOID
+PollDue(PCI_DEV_INFO *List, IN OUT UINTN *Count, UINT64 Now)
+{
+  // Entries resolved here may queue new ones (functions 1-7); they are
+  // picked up on the next pass.
+  for (UINTN k = 0, n = mCrs.Count; k < n; k++) {
+    CRS_ENTRY *e = &mCrs.Entry[k];
+    if (e->State != CRS_PENDING) continue;
+    if (e->NextNs > Now) continue;
+
+    PCI_DEV_INFO Info;
+    PCI_PROBE    r = PciProbeFunc(e->Bus, e->Dev, e->Func, &Info);
+    e->Polls++;
+
+    if (r == PCI_PROBE_RETRY) {
+      e->DelayUs = MIN(e->DelayUs * 2, CRS_MAX_DELAY_US);
+      e->NextNs  = PciCrsNowNs() + (UINT64)e->DelayUs * 1000;
+      continue;
+    }
+
+    e->DoneNs = PciCrsNowNs();
+    if (r == PCI_PROBE_ABSENT) {
+      e->State = CRS_GONE;
+      continue;
+    }
+
+    e->State = CRS_PRESENT;
+    if (*Count < MAX_PCI_DEVS) List[(*Count)++] = Info;
+    mCrs.OutOfOrder = TRUE;
+    if (e->Func == 0) ScanPciDevFuncs(e->Bus, e->Dev, List, Count);
+  }
+}
+
+// Non-blocking: called between buses during the sweep.
+VOID
+PciCrsPoll(PCI_DEV_INFO *List, IN OUT UINTN *Count)
+{
+  if (mCrs.Count == 0) return;
+  PollDue(List, Count, PciCrsNowNs());
+}
+
+STATIC
+INTN
+EFIAPI
+CompareBdf(IN CONST VOID *A, IN CONST VOID *B)
+{
+  CONST PCI_DEV_INFO *a = (CONST PCI_DEV_INFO *)A;
+  CONST PCI_DEV_INFO *b = (CONST PCI_DEV_INFO *)B;
+  UINT32 ka = ((UINT32)a->Bus << 8) | ((UINT32)a->Dev << 3) | a->Func;
+  UINT32 kb = ((UINT32)b->Bus << 8) | ((UINT32)b->Dev << 3) | b->Func;
+  return (ka < kb) ? -1 : (ka > kb) ? 1 : 0;
+}
+
+// Ends the sweep: drains the queue until empty or the deadline, then
+// restores bus order (topology relies on it). Returns the timed out count.
+UINTN
+PciCrsFinish(PCI_DEV_INFO *List, IN OUT UINTN *Count)
+{
+  mCrs.SweepNs = PciCrsNowNs();
+
+  while (TRUE) {
+    UINT64 Now = PciCrsNowNs();
+    if (PastDeadline(Now)) break;
+
+    UINTN Pending = 0;
+    PollDue(List, Count, Now);
+
+    // Sleep until the earliest retry, never past the deadline.
+    UINT64 Wake = MAX_UINT64;
+    for (UINTN k = 0; k < mCrs.Count; k++) {
+      if (mCrs.Entry[k].State != CRS_PENDING) continue;
+      Pending++;
+      Wake = MIN(Wake, mCrs.Entry[k].NextNs);
+    }
+    if (Pending == 0) break;
+
+    UINT64 Limit = mCrs.BeginNs + (UINT64)mCrs.DeadlineMs * 1000000ULL;
+    Now = PciCrsNowNs();
+    Wake = MIN(Wake, Limit);
+    if (Wake > Now) MicroSecondDelay((UINTN)DivU64x32(Wake - Now + 999, 1000));
+  }
+
+  UINTN TimedOut = 0;
+  mCrs.EndNs = PciCrsNowNs();
+  for (UINTN k = 0; k < mCrs.Count; k++) {
+    if (mCrs.Entry[k].State != CRS_PENDING) continue;
+    mCrs.Entry[k].State  = CRS_TIMEOUT;
+    mCrs.Entry[k].DoneNs = mCrs.EndNs;
+    TimedOut++;
+  }
+
+  if (mCrs.OutOfOrder) {
+    PCI_DEV_INFO Tmp;
+    QuickSort(List, *Count, sizeof(PCI_DEV_INFO), CompareBdf, &Tmp);
+  }
+
+  TimedOut += mCrs.Dropped;
+  if (TimedOut > 0) {
+    Print(L"CRS: %u function(s) still not ready after %u ms, not listed.\n", (UINT32)TimedOut, mCrs.DeadlineMs);
+  }
+  return TimedOut;
+}
+
+// -----------------------------
+// Report
+// -----------------------------
+STATIC
+CONST CHAR16 *
+CrsStateName(UINT8 State)
+{
+  switch (State) {
+    case CRS_PRESENT: return L"present";
+    case CRS_GONE:    return L"absent";
+    case CRS_TIMEOUT: return L"TIMEOUT";
+    default:          return L"pending";
+  }
+}
+
+// Without CRS Software Visibility the Root Complex retries on its own and
+// the CPU stalls in the read, so a slow device cannot be deferred.
+STATIC
+VOID
+ReportCrsVisibility(IN PCI_TOPOLOGY *Topo, OUT PCI_REPORT *Rep)
+{
+  BOOLEAN Header = FALSE;
+
+  for (UINTN i = 0; i < Topo->Count; i++) {
+    PCI_TOPO_NODE *n = &Topo->Node[i];
+    if (n->PcieCap == 0 || n->PortType != PCIE_PORT_ROOT) continue;
+
+    PCI_DEV_INFO *p = &Topo->List[i];
+    UINT16 RootCtl = 0, RootCap = 0;
+    PciCfgRead16(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x1C), &RootCtl);
+    PciCfgRead16(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x1E), &RootCap);
+
+    if (!Header) {
+      ReportAdd(Rep, L"");
+      ReportAdd(Rep, L"Root Port       CRS SV capable  enabled");
+      Header = TRUE;
+    }
+    ReportAdd(Rep, L"%02x/%02x/%02x        %-14s  %s",
+              p->Bus, p->Dev, p->Func,
+              (RootCap & BIT0) ? L"yes" : L"no",
+              (RootCtl & BIT4) ? L"yes" : L"no (below here a slow device stalls the scan)");
+  }
+}
+
+VOID
+PciCrsReport(IN PCI_TOPOLOGY *Topo, OUT PCI_REPORT *Rep)
+{
+  UINT64 Sweep = mCrs.SweepNs - mCrs.BeginNs;
+  UINT64 Total = mCrs.EndNs - mCrs.BeginNs;
+
+  ReportAdd(Rep, L"Sweep %lu us, total %lu us, deadline %u ms",
+            DivU64x32(Sweep, 1000), DivU64x32(Total, 1000), mCrs.DeadlineMs);
+  ReportAdd(Rep, L"Deferred (CRS) functions: %u%s", (UINT32)mCrs.Count,
+            mCrs.Dropped ? L"  (queue full, some not retried)" : L"");
+
+  if (mCrs.Count > 0) {
+    ReportAdd(Rep, L"");
+    ReportAdd(Rep, L"B/D/F      Polls  Waited(us)  Result");
+    for (UINTN k = 0; k < mCrs.Count; k++) {
+      CRS_ENTRY *e = &mCrs.Entry[k];
+      ReportAdd(Rep, L"%02x/%02x/%02x   %5u  %10lu  %s", e->Bus, e->Dev, e->Func,
+                e->Polls, DivU64x32(e->DoneNs - e->FirstNs, 1000), CrsStateName(e->State));
+    }
+  }
+
+  if (mCrs.SlowCount > 0) {
+    ReportAdd(Rep, L"");
+    ReportAdd(Rep, L"Slowest device probes (> %u us):", (UINT32)(CRS_SLOW_PROBE_NS / 1000));
+    for (UINTN k = 0; k < mCrs.SlowCount; k++) {
+      ReportAdd(Rep, L"  %02x/%02x    %lu us", mCrs.Slow[k].Bus, mCrs.Slow[k].Dev, DivU64x32(mCrs.Slow[k].Ns, 1000));
+    }
+  }
+
+  ReportCrsVisibility(Topo, Rep);
+}
@@ -0,0 +1,181 @@
+#include "PciUtility.h"
+
+//
+// DMA request features a function supports but has left disabled:
+//
+// - Extended Tag (8-bit tags): Device Capabilities [5] -> Device Control [8]
+// - 10-Bit Tag requester: Device Capabilities 2 [17] -> Device Control 2 [12],
+//   only when the Root Port and every switch port on the way up advertise
+//   10-Bit Tag Completer Supported (Device Capabilities 2 [16])
+// - Relaxed Ordering / No Snoop: Device Control [4] / [11]. There is no
+//   capability bit: a function that never sets the attribute may hardwire
+//   the enable to 0, which the apply read-back reports.
+//
+// Only endpoints (the DMA requesters) are changed; ports are listed for
+// the 10-bit completer path. VFs are skipped, their Device Control
+// fields are reserved and follow the PF.
+//
+#define DEVCAP_EXT_TAG      BIT5
+#define DEVCTL_RO           BIT4
+#define DEVCTL_EXT_TAG      BIT8
+#define DEVCTL_NO_SNOOP     BIT11
+#define DEVCAP2_10BIT_CPL   BIT16
+#define DEVCAP2_10BIT_REQ   BIT17
+#define DEVCTL2_10BIT_REQ   BIT12
+
+typedef struct {
+  UINT32  DevCap;
+  UINT32  DevCap2;          // 0 before PCIe capability version 2
+  UINT16  DevCtl;
+  UINT16  DevCtl2;
+  BOOLEAN Path10;           // this port and every port above it complete 10-bit tags
+} DMA_INFO;
+
+STATIC
+BOOLEAN
+IsRequester(IN PCI_TOPO_NODE *n)
+{
+  return n->PortType == PCIE_PORT_ENDPOINT || n->PortType == PCIE_PORT_LEGACY_ENDPOINT ||
+         n->PortType == PCIE_PORT_RCIEP;
+}
+
+// Device Control bits to set / Device Control 2 bits to set for function i
+STATIC
+VOID
+Wanted(IN PCI_TOPOLOGY *Topo, IN DMA_INFO *Info, UINTN i, OUT UINT16 *Ctl, OUT UINT16 *Ctl2)
+{
+  PCI_TOPO_NODE *n = &Topo->Node[i];
+  DMA_INFO      *d = &Info[i];
+
+  *Ctl  = 0;
+  *Ctl2 = 0;
+  if (n->PcieCap == 0 || n->IsVf || !IsRequester(n)) return;
+
+  *Ctl = (UINT16)(((d->DevCap & DEVCAP_EXT_TAG) ? DEVCTL_EXT_TAG : 0) | DEVCTL_RO | DEVCTL_NO_SNOOP);
+  *Ctl = (UINT16)(*Ctl & ~d->DevCtl);
+
+  if ((d->DevCap2 & DEVCAP2_10BIT_REQ) && (d->DevCtl2 & DEVCTL2_10BIT_REQ) == 0 &&
+      n->Parent != PCI_NO_NODE && Info[n->Parent].Path10) {
+    *Ctl2 = DEVCTL2_10BIT_REQ;
+  }
+}
+
+STATIC
+CONST CHAR16 *
+State(BOOLEAN Capable, BOOLEAN On)
+{
+  return !Capable ? L"-" : On ? L"on" : L"OFF";
+}
+
+// Bit names for the apply result, e.g. "ExtTag RO"
+STATIC
+VOID
+BitNames(UINT16 Ctl, UINT16 Ctl2, OUT CHAR16 *Out, UINTN OutSize)
+{
+  UINTN Len = 0;
+
+  Out[0] = L'\0';
+  if (Ctl & DEVCTL_EXT_TAG)     Len += UnicodeSPrint(Out + Len, OutSize - Len * sizeof(CHAR16), L" ExtTag");
+  if (Ctl2 & DEVCTL2_10BIT_REQ) Len += UnicodeSPrint(Out + Len, OutSize - Len * sizeof(CHAR16), L" 10bit");
+  if (Ctl & DEVCTL_RO)          Len += UnicodeSPrint(Out + Len, OutSize - Len * sizeof(CHAR16), L" RO");
+  if (Ctl & DEVCTL_NO_SNOOP)    Len += UnicodeSPrint(Out + Len, OutSize - Len * sizeof(CHAR16), L" NS");
+}
+
+// Lists every PCIe function; with Apply set, enables the missing features
+// on endpoints through PolicyWrite and reports what did not stick.
+// Returns the number of endpoints with something to enable.
+UINTN
+PciDmaAudit(IN PCI_TOPOLOGY *Topo, BOOLEAN Apply, OUT PCI_REPORT *Rep)
+{
+  UINTN     Count = Topo->Count;
+  DMA_INFO *Info  = AllocateZeroPool(sizeof(DMA_INFO) * (Count ? Count : 1));
+  if (Info == NULL) {
+    ReportAdd(Rep, L"Out of resources");
+    return 0;
+  }
+
+  // Parents precede children in the bus-ordered list: one pass reads the
+  // registers and carries the 10-bit completer path down
+  for (UINTN i = 0; i < Count; i++) {
+    PCI_DEV_INFO  *p = &Topo->List[i];
+    PCI_TOPO_NODE *n = &Topo->Node[i];
+    DMA_INFO      *d = &Info[i];
+    if (n->PcieCap == 0) continue;
+
+    PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x04), &d->DevCap);
+    PciCfgRead16(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x08), &d->DevCtl);
+    if (n->PcieVer >= 2) {
+      PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x24), &d->DevCap2);
+      PciCfgRead16(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x28), &d->DevCtl2);
+    }
+
+    BOOLEAN Cpl = (d->DevCap2 & DEVCAP2_10BIT_CPL) != 0;
+    if (n->PortType == PCIE_PORT_ROOT) {
+      d->Path10 = Cpl;
+    } else if (n->PortType == PCIE_PORT_SWITCH_UP || n->PortType == PCIE_PORT_SWITCH_DOWN) {
+      d->Path10 = Cpl && n->Parent != PCI_NO_NODE && n->Parent < i && Info[n->Parent].Path10;
+    }
+  }
+
+  UINTN Changes = 0;
+
+  ReportAdd(Rep, L"OFF = supported (or no capability bit: RO / NS) but disabled;  - = not supported");
+  ReportAdd(Rep, L"  B/D/F     Type         ExtTag  10bit  RO   NS   Note");
+
+  for (UINTN i = 0; i < Count; i++) {
+    PCI_DEV_INFO  *p = &Topo->List[i];
+    PCI_TOPO_NODE *n = &Topo->Node[i];
+    DMA_INFO      *d = &Info[i];
+    if (n->PcieCap == 0 || n->IsVf) continue;
+
+    UINT16 Ctl, Ctl2;
+    Wanted(Topo, Info, i, &Ctl, &Ctl2);
+
+    CONST CHAR16 *Note = L"";
+    BOOLEAN       Req10 = (d->DevCap2 & DEVCAP2_10BIT_REQ) != 0;
+    if (!IsRequester(n)) {
+      Note = ((d->DevCap2 & DEVCAP2_10BIT_CPL) == 0) ? L"port: no 10-bit completer"
+           : d->Path10 ? L"port: 10-bit path ok" : L"port: 10-bit stops above";
+    } else if (Req10 && (d->DevCtl2 & DEVCTL2_10BIT_REQ) == 0 && Ctl2 == 0) {
+      Note = L"10-bit: no completer on the path";
+    } else if (Ctl != 0 || Ctl2 != 0) {
+      Note = L"can enable";
+    }
+
+    ReportAdd(Rep, L"  %02x/%02x/%02x  %-12s %-6s  %-5s  %-3s  %-3s  %s",
+              p->Bus, p->Dev, p->Func, PortTypeName(n),
+              State((d->DevCap & DEVCAP_EXT_TAG) != 0, (d->DevCtl & DEVCTL_EXT_TAG) != 0),
+              State(Req10, (d->DevCtl2 & DEVCTL2_10BIT_REQ) != 0),
+              State(TRUE, (d->DevCtl & DEVCTL_RO) != 0),
+              State(TRUE, (d->DevCtl & DEVCTL_NO_SNOOP) != 0),
+              Note);
+
+    if (Ctl == 0 && Ctl2 == 0) continue;
+    Changes++;
+    if (!Apply) continue;
+
+    // Only the missing bits are written (RMW); PolicyWrite reads them back
+    UINT32     Rb = d->DevCtl, Rb2 = d->DevCtl2;
+    EFI_STATUS St = EFI_SUCCESS, St2 = EFI_SUCCESS;
+    CHAR16     Stuck[32];
+
+    if (Ctl != 0)  St  = PolicyWrite(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x08), DISP_WORD, Ctl, Ctl, &Rb);
+    if (Ctl2 != 0) St2 = PolicyWrite(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x28), DISP_WORD, Ctl2, Ctl2, &Rb2);
+
+    if (St == EFI_ACCESS_DENIED || St2 == EFI_ACCESS_DENIED) {
+      ReportAdd(Rep, L"            -> blocked (Device Control is in the CAP area, F9 to unlock)");
+      continue;
+    }
+
+    BitNames((UINT16)(Ctl & ~Rb), (UINT16)(Ctl2 & ~Rb2), Stuck, sizeof(Stuck));
+    ReportAdd(Rep, L"            -> DevCtl %04x  DevCtl2 %04x  %r%s%s", (UINT16)Rb, (UINT16)Rb2,
+              EFI_ERROR(St) ? St : St2, (Stuck[0] != L'\0') ? L"  hardwired 0:" : L"", Stuck);
+  }
+
+  ReportAdd(Rep, L"");
+  if (Changes == 0) ReportAdd(Rep, L"Every endpoint already uses the DMA features it supports.");
+  else              ReportAdd(Rep, L"%u endpoint(s) with features left off", (UINT32)Changes);
+
+  FreePool(Info);
+  return Changes;
+}
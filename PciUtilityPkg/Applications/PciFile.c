@@ -0,0 +1,102 @@
+#include "PciUtility.h"
+
+#include <Protocol/Shell.h>
+
+// -----------------------------
+// Shell file access (paths like fs0:\golden.txt)
+// -----------------------------
+STATIC
+EFI_SHELL_PROTOCOL *
+GetShell(VOID)
+{
+  STATIC EFI_SHELL_PROTOCOL *Shell = NULL;
+  if (Shell == NULL) {
+    gBS->LocateProtocol(&gEfiShellProtocolGuid, NULL, (VOID**)&Shell);
+  }
+  return Shell;
+}
+
+// Reads a whole file (up to MaxSize bytes) into pool memory, with
+// sizeof(CHAR16) zero bytes after the data. Caller frees *Data.
+EFI_STATUS
+PciFileRead(IN CONST CHAR16 *Path, UINTN MaxSize, OUT UINT8 **Data, OUT UINTN *Size)
+{
+  EFI_SHELL_PROTOCOL *Shell = GetShell();
+  SHELL_FILE_HANDLE   File  = NULL;
+  UINT64              FileSize = 0;
+
+  *Data = NULL;
+  *Size = 0;
+  if (Shell == NULL) return EFI_UNSUPPORTED;
+
+  EFI_STATUS St = Shell->OpenFileByName(Path, &File, EFI_FILE_MODE_READ);
+  if (EFI_ERROR(St)) return St;
+
+  St = Shell->GetFileSize(File, &FileSize);
+  if (!EFI_ERROR(St) && FileSize > MaxSize) St = EFI_BAD_BUFFER_SIZE;
+
+  UINT8 *Raw = NULL;
+  UINTN  Len = (UINTN)FileSize;
+  if (!EFI_ERROR(St)) {
+    Raw = AllocateZeroPool(Len + sizeof(CHAR16));
+    St  = (Raw == NULL) ? EFI_OUT_OF_RESOURCES : Shell->ReadFile(File, &Len, Raw);
+  }
+  Shell->CloseFile(File);
+
+  if (EFI_ERROR(St)) {
+    if (Raw) FreePool(Raw);
+    return St;
+  }
+
+  *Data = Raw;
+  *Size = Len;
+  return EFI_SUCCESS;
+}
+
+// Reads a whole text file, ASCII or UCS-2 (with BOM), as a NUL-terminated
+// CHAR16 string. Caller frees *Text.
+EFI_STATUS
+PciFileReadText(IN CONST CHAR16 *Path, OUT CHAR16 **Text)
+{
+  UINT8 *Raw = NULL;
+  UINTN  Len = 0;
+
+  *Text = NULL;
+  EFI_STATUS St = PciFileRead(Path, SIZE_1MB, &Raw, &Len);
+  if (EFI_ERROR(St)) return St;
+
+  if (Len >= 2 && Raw[0] == 0xFF && Raw[1] == 0xFE) {
+    *Text = AllocateCopyPool(Len, Raw + 2);   // UCS-2 LE: drop the BOM, keep the NUL
+    if (*Text != NULL) (*Text)[(Len - 2) / 2] = L'\0';
+  } else {
+    *Text = AllocatePool((Len + 1) * sizeof(CHAR16));
+    if (*Text != NULL) {
+      for (UINTN i = 0; i < Len; i++) (*Text)[i] = (CHAR16)Raw[i];
+      (*Text)[Len] = L'\0';
+    }
+  }
+
+  FreePool(Raw);
+  return (*Text == NULL) ? EFI_OUT_OF_RESOURCES : EFI_SUCCESS;
+}
+
+// Creates or replaces Path with Size bytes of Data.
+EFI_STATUS
+PciFileWrite(IN CONST CHAR16 *Path, IN CONST VOID *Data, UINTN Size)
+{
+  EFI_SHELL_PROTOCOL *Shell = GetShell();
+  SHELL_FILE_HANDLE   File  = NULL;
+
+  if (Shell == NULL) return EFI_UNSUPPORTED;
+
+  // CreateFile opens an existing file as is: drop it first so nothing stale is left at the end
+  Shell->DeleteFileByName(Path);
+  EFI_STATUS St = Shell->CreateFile(Path, 0, &File);
+  if (EFI_ERROR(St)) return St;
+
+  UINTN Len = Size;
+  St = Shell->WriteFile(File, &Len, (VOID *)Data);
+  if (!EFI_ERROR(St) && Len != Size) St = EFI_VOLUME_FULL;
+  Shell->CloseFile(File);
+  return St;
+}
@@ -0,0 +1,276 @@
+#include "PciUtility.h"
+
+#define FIND_MAX_HITS    1024
+#define FIND_MAX_BYTES   16
+#define FIND_PAGE_SIZE   18
+#define FIND_CONTEXT     8       // bytes shown per hit
+
+#define ONES64           0x0101010101010101ULL
+#define HIGH64           0x8080808080808080ULL
+#define HAS_ZERO_BYTE(x) ((((x) - ONES64) & ~(x) & HIGH64) != 0)
+
+typedef struct {
+  BOOLEAN IsValue;
+  UINT8   Width;                 // value: 1 / 2 / 4, naturally aligned
+  UINT32  Mask;
+  UINT32  Value;
+  UINT8   Bytes[FIND_MAX_BYTES]; // pattern: any offset
+  UINTN   Length;
+} FIND_QUERY;
+
+typedef struct {
+  UINT16 Func;                   // snapshot list index
+  UINT16 Offset;
+} FIND_HIT;
+
+typedef struct {
+  CONST PCI_SNAPSHOT *Snap;
+  CONST FIND_QUERY   *Q;
+  FIND_HIT           *Hit;
+  UINTN               Count;
+  UINTN               Total;
+} FIND_RESULT;
+
+STATIC
+VOID
+AddHit(FIND_RESULT *R, UINTN Func, UINTN Offset)
+{
+  if (R->Count < FIND_MAX_HITS) {
+    R->Hit[R->Count].Func   = (UINT16)Func;
+    R->Hit[R->Count].Offset = (UINT16)Offset;
+    R->Count++;
+  }
+  R->Total++;
+}
+
+// -----------------------------
+// Block scanners (8 bytes per step)
+// -----------------------------
+// Both return FALSE when the block holds no candidate at all, so the caller
+// can skip every other function that shares the same block.
+
+// Lanes of Width bytes match when ((word & Mask) ^ Value) is zero there;
+// a word with no zero byte cannot contain a matching lane.
+STATIC
+BOOLEAN
+ScanValue(FIND_RESULT *R, CONST UINT8 *Blk, UINTN Func, UINTN Base)
+{
+  CONST FIND_QUERY *Q = R->Q;
+  UINT64 LaneMask = (Q->Width == 4) ? 0xFFFFFFFFULL : (Q->Width == 2) ? 0xFFFFULL : 0xFFULL;
+  UINT64 M = 0, V = 0;
+  BOOLEAN Any = FALSE;
+
+  for (UINTN l = 0; l < 8; l += Q->Width) {
+    M |= ((UINT64)Q->Mask  & LaneMask) << (l * 8);
+    V |= ((UINT64)Q->Value & LaneMask) << (l * 8);
+  }
+
+  for (UINTN q = 0; q < SNAP_BLOCK_SIZE; q += 8) {
+    UINT64 x = (ReadUnaligned64((CONST UINT64 *)(Blk + q)) & M) ^ V;
+    if (!HAS_ZERO_BYTE(x)) continue;
+
+    for (UINTN l = 0; l < 8; l += Q->Width) {
+      if (((x >> (l * 8)) & LaneMask) == 0) {
+        AddHit(R, Func, Base + q + l);
+        Any = TRUE;
+      }
+    }
+  }
+  return Any;
+}
+
+// Candidates are positions of the first pattern byte; the rest is compared
+// in place, or through PciSnapshotCopy when it runs into the next block.
+STATIC
+BOOLEAN
+ScanBytes(FIND_RESULT *R, CONST UINT8 *Blk, UINTN Func, UINTN Base)
+{
+  CONST FIND_QUERY *Q = R->Q;
+  UINT64  First = Q->Bytes[0] * ONES64;
+  BOOLEAN Any   = FALSE;
+  UINT8   Tmp[FIND_MAX_BYTES];
+
+  for (UINTN q = 0; q < SNAP_BLOCK_SIZE; q += 8) {
+    if (!HAS_ZERO_BYTE(ReadUnaligned64((CONST UINT64 *)(Blk + q)) ^ First)) continue;
+
+    for (UINTN l = 0; l < 8; l++) {
+      UINTN In = q + l;
+      if (Blk[In] != Q->Bytes[0]) continue;
+      Any = TRUE;
+
+      if (Base + In + Q->Length > SNAP_FUNC_SIZE) continue;
+
+      CONST UINT8 *Cmp = Blk + In;
+      if (In + Q->Length > SNAP_BLOCK_SIZE) {
+        PciSnapshotCopy(R->Snap, Func, (UINT16)(Base + In), Q->Length, Tmp);
+        Cmp = Tmp;
+      }
+      if (CompareMem(Cmp, Q->Bytes, Q->Length) == 0) AddHit(R, Func, Base + In);
+    }
+  }
+  return Any;
+}
+
+STATIC
+EFI_STATUS
+RunFind(IN OUT FIND_RESULT *R)
+{
+  CONST PCI_SNAPSHOT *Snap = R->Snap;
+  UINT8 *Skip = AllocateZeroPool(Snap->PoolCount + SNAP_BLOCK_FIRST);  // per block id
+  if (Skip == NULL) return EFI_OUT_OF_RESOURCES;
+
+  for (UINTN i = 0; i < Snap->Count; i++) {
+    for (UINTN b = 0; b < SNAP_BLOCKS_PER_FUNC; b++) {
+      UINT32 Id = Snap->Map[i * SNAP_BLOCKS_PER_FUNC + b];
+      if (Skip[Id]) continue;
+
+      UINTN        Base = b * SNAP_BLOCK_SIZE;
+      CONST UINT8 *Blk  = PciSnapshotBlock(Snap, i, (UINT16)Base);
+      BOOLEAN      Any  = R->Q->IsValue ? ScanValue(R, Blk, i, Base) : ScanBytes(R, Blk, i, Base);
+      if (!Any) Skip[Id] = 1;
+    }
+  }
+
+  FreePool(Skip);
+  return EFI_SUCCESS;
+}
+
+// -----------------------------
+// UI
+// -----------------------------
+STATIC
+VOID
+RenderHits(FIND_RESULT *R, CONST CHAR16 *What, UINTN Sel, UINTN Top)
+{
+  CHAR16 Line[REPORT_LINE_LEN];
+
+  ScreenBegin();
+  ScreenLine(L"Find %s   hits:%u%s", What, (UINT32)R->Total, (R->Total > R->Count) ? L" (list truncated)" : L"");
+  ScreenLine(L"  B/D/F     VID:DID    Offset  Bytes at offset");
+  ScreenLine(L"----------------------------------------------------------");
+
+  UINTN End = MIN(Top + FIND_PAGE_SIZE, R->Count);
+  for (UINTN k = Top; k < End; k++) {
+    FIND_HIT     *h = &R->Hit[k];
+    PCI_DEV_INFO *p = &R->Snap->List[h->Func];
+    UINT8 Ctx[FIND_CONTEXT];
+    UINTN n = MIN(FIND_CONTEXT, SNAP_FUNC_SIZE - h->Offset);
+
+    PciSnapshotCopy(R->Snap, h->Func, h->Offset, n, Ctx);
+    UINTN Len = UnicodeSPrint(Line, sizeof(Line), L"%s%02x/%02x/%02x  %04x:%04x  +%03x   ", (k == Sel) ? L"> " : L"  ",
+                              p->Bus, p->Dev, p->Func, p->Vid, p->Did, h->Offset);
+    for (UINTN j = 0; j < n; j++) {
+      Len += UnicodeSPrint(Line + Len, sizeof(Line) - Len * sizeof(CHAR16), L"%02x ", Ctx[j]);
+    }
+    ScreenLine(L"%s", Line);
+  }
+
+  if (R->Count == 0) ScreenLine(L"  (no match)");
+  ScreenLine(L"");
+  ScreenLine(L"Up/Down:Select  F1:PgDn  F2:PgUp  Enter:Open at offset  Esc:Back");
+  ScreenEnd();
+}
+
+STATIC
+VOID
+HitListLoop(FIND_RESULT *R, CONST CHAR16 *What)
+{
+  UINTN Sel = 0, Top = 0;
+
+  while (TRUE) {
+    if (Sel < Top) Top = Sel;
+    if (Sel >= Top + FIND_PAGE_SIZE) Top = Sel - FIND_PAGE_SIZE + 1;
+    RenderHits(R, What, Sel, Top);
+
+    EFI_INPUT_KEY Key;
+    WaitKey(&Key);
+    if (IsEsc(&Key)) return;
+
+    if (Key.UnicodeChar == CHAR_CARRIAGE_RETURN && R->Count > 0) {
+      FIND_HIT     *h = &R->Hit[Sel];
+      PCI_DEV_INFO *p = &R->Snap->List[h->Func];
+      ConfigViewLoop(p->Bus, p->Dev, p->Func, h->Offset);
+      continue;
+    }
+
+    switch (Key.ScanCode) {
+      case SCAN_UP:   if (Sel > 0) Sel--; break;
+      case SCAN_DOWN: if (Sel + 1 < R->Count) Sel++; break;
+      case SCAN_F1:   Sel = MIN(Sel + FIND_PAGE_SIZE, R->Count ? R->Count - 1 : 0); break;
+      case SCAN_F2:   Sel = (Sel > FIND_PAGE_SIZE) ? Sel - FIND_PAGE_SIZE : 0; break;
+      default: break;
+    }
+  }
+}
+
+STATIC
+BOOLEAN
+ReadQuery(IN CONST PCI_SNAPSHOT *Snap, OUT FIND_QUERY *Q, OUT CHAR16 *What, UINTN WhatSize)
+{
+  UINT64 v = 0;
+  ZeroMem(Q, sizeof(*Q));
+
+  ScreenBegin();
+  ScreenLine(L"FIND in snapshot (%u functions, hardware is not read)", (UINT32)Snap->Count);
+  ScreenLine(L"");
+  ScreenLine(L"V:Value (width / mask)   B:Byte pattern   Esc:Cancel");
+  ScreenEnd();
+  ScreenPrompt();
+
+  EFI_INPUT_KEY Key;
+  WaitKey(&Key);
+  CHAR16 Kind = CharToUpper(Key.UnicodeChar);
+
+  if (Kind == L'V') {
+    Q->IsValue = TRUE;
+    Print(L"Width (1/2/4): ");
+    if (EFI_ERROR(ReadFixedHex(1, &v)) || (v != 1 && v != 2 && v != 4)) return FALSE;
+    Q->Width = (UINT8)v;
+    Print(L"\nValue (%u hex): ", (UINT32)(Q->Width * 2));
+    if (EFI_ERROR(ReadFixedHex(Q->Width * 2, &v))) return FALSE;
+    Q->Value = (UINT32)v;
+    Print(L"\nMask  (%u hex): ", (UINT32)(Q->Width * 2));
+    if (EFI_ERROR(ReadFixedHex(Q->Width * 2, &v))) return FALSE;
+    Q->Mask  = (UINT32)v;
+    Q->Value &= Q->Mask;
+    UnicodeSPrint(What, WhatSize, L"value %x mask %x (%u byte)", Q->Value, Q->Mask, Q->Width);
+    return TRUE;
+  }
+
+  if (Kind == L'B') {
+    Print(L"Length (2 hex, 01-%02x): ", FIND_MAX_BYTES);
+    if (EFI_ERROR(ReadFixedHex(2, &v)) || v == 0 || v > FIND_MAX_BYTES) return FALSE;
+    Q->Length = (UINTN)v;
+    Print(L"\nBytes: ");
+    UINTN Len = UnicodeSPrint(What, WhatSize, L"bytes");
+    for (UINTN k = 0; k < Q->Length; k++) {
+      if (EFI_ERROR(ReadFixedHex(2, &v))) return FALSE;
+      Print(L" ");
+      Q->Bytes[k] = (UINT8)v;
+      Len += UnicodeSPrint(What + Len, WhatSize - Len * sizeof(CHAR16), L" %02x", Q->Bytes[k]);
+    }
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+// Cross-device find over a snapshot; hits open the config view at the offset.
+VOID
+PciFindDialog(IN CONST PCI_SNAPSHOT *Snap)
+{
+  FIND_QUERY Q;
+  CHAR16     What[80];
+
+  if (!ReadQuery(Snap, &Q, What, sizeof(What))) return;
+
+  FIND_RESULT R;
+  ZeroMem(&R, sizeof(R));
+  R.Snap = Snap;
+  R.Q    = &Q;
+  R.Hit  = AllocatePool(sizeof(FIND_HIT) * FIND_MAX_HITS);
+  if (R.Hit == NULL) return;
+
+  if (!EFI_ERROR(RunFind(&R))) HitListLoop(&R, What);
+  FreePool(R.Hit);
+}
@@ -0,0 +1,378 @@
+#include "PciUtility.h"
+
+#include <Protocol/GraphicsOutput.h>
+#include <Protocol/HiiFont.h>
+
+//
+// Text rendering straight on EFI_GRAPHICS_OUTPUT_PROTOCOL.
+//
+// Every printable ASCII glyph is fetched once from the HII system font and
+// stored pre-coloured for each palette, so drawing a character is GlyphH
+// row copies into an off-screen back buffer. Drawing only widens a dirty
+// rectangle; GopFlush() sends that rectangle with a single Blt.
+//
+#define GLYPH_FIRST  0x20
+#define GLYPH_LAST   0x7E
+#define GLYPH_COUNT  (GLYPH_LAST - GLYPH_FIRST + 1)
+
+typedef struct {
+  UINTN                          W;
+  UINTN                          H;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Pix[GOP_PALETTES];   // glyph-major, W * H each
+} GLYPH_SET;
+
+typedef struct {
+  EFI_GRAPHICS_OUTPUT_PROTOCOL  *Gop;
+  UINTN                          Width;
+  UINTN                          Height;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Back;        // Width * Height
+  GLYPH_SET                      Text;
+  UINTN                          DirtyX0;     // empty when X0 >= X1
+  UINTN                          DirtyY0;
+  UINTN                          DirtyX1;
+  UINTN                          DirtyY1;
+} GOP_RENDER;
+
+STATIC GOP_RENDER mGop;
+
+// Normal, Hilite (cursor), Dim (offsets, all-ones registers)
+STATIC CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL mFg[GOP_PALETTES] = { { 0xC0, 0xC0, 0xC0, 0 }, { 0x00, 0x00, 0x00, 0 }, { 0x60, 0x60, 0x60, 0 } };
+STATIC CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL mBg[GOP_PALETTES] = { { 0x00, 0x00, 0x00, 0 }, { 0xC0, 0xC0, 0x00, 0 }, { 0x00, 0x00, 0x00, 0 } };
+
+// -----------------------------
+// Glyph sets
+// -----------------------------
+STATIC
+VOID
+FreeGlyphSet(IN OUT GLYPH_SET *Set)
+{
+  for (UINTN p = 0; p < GOP_PALETTES; p++) {
+    if (Set->Pix[p] != NULL) FreePool(Set->Pix[p]);
+  }
+  ZeroMem(Set, sizeof(*Set));
+}
+
+STATIC
+EFI_STATUS
+AllocGlyphSet(OUT GLYPH_SET *Set, UINTN Count, UINTN W, UINTN H)
+{
+  ZeroMem(Set, sizeof(*Set));
+  Set->W = W;
+  Set->H = H;
+  for (UINTN p = 0; p < GOP_PALETTES; p++) {
+    Set->Pix[p] = AllocatePool(Count * W * H * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
+    if (Set->Pix[p] == NULL) {
+      FreeGlyphSet(Set);
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+SetGlyphPixel(IN OUT GLYPH_SET *Set, UINTN Index, UINTN x, UINTN y, BOOLEAN On)
+{
+  UINTN At = (Index * Set->H + y) * Set->W + x;
+  for (UINTN p = 0; p < GOP_PALETTES; p++) {
+    Set->Pix[p][At] = On ? mFg[p] : mBg[p];
+  }
+}
+
+STATIC
+VOID
+DrawGlyph(IN GLYPH_SET *Set, UINTN Index, UINTN X, UINTN Y, GOP_PALETTE Palette)
+{
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Src = Set->Pix[Palette] + Index * Set->W * Set->H;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dst = mGop.Back + Y * mGop.Width + X;
+
+  for (UINTN y = 0; y < Set->H; y++) {
+    CopyMem(Dst, Src, Set->W * sizeof(*Dst));
+    Dst += mGop.Width;
+    Src += Set->W;
+  }
+}
+
+STATIC
+VOID
+FreeImageOutput(IN EFI_IMAGE_OUTPUT *Img)
+{
+  if (Img->Image.Bitmap != NULL) FreePool(Img->Image.Bitmap);
+  FreePool(Img);
+}
+
+// The space glyph fixes the cell size and tells background from ink.
+STATIC
+EFI_STATUS
+BuildTextGlyphs(IN EFI_HII_FONT_PROTOCOL *Font)
+{
+  EFI_IMAGE_OUTPUT *Img = NULL;
+
+  if (EFI_ERROR(Font->GetGlyph(Font, L' ', NULL, &Img, NULL)) || Img == NULL) return EFI_NOT_FOUND;
+  UINTN W = Img->Width;
+  UINTN H = Img->Height;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL Bg = Img->Image.Bitmap[0];
+  FreeImageOutput(Img);
+
+  if (W == 0 || H == 0) return EFI_NOT_FOUND;
+  EFI_STATUS St = AllocGlyphSet(&mGop.Text, GLYPH_COUNT, W, H);
+  if (EFI_ERROR(St)) return St;
+
+  for (UINTN c = GLYPH_FIRST; c <= GLYPH_LAST; c++) {
+    Img = NULL;
+    // Unknown glyphs come back as a warning with a placeholder image
+    if (EFI_ERROR(Font->GetGlyph(Font, (CHAR16)c, NULL, &Img, NULL))) Img = NULL;
+
+    for (UINTN y = 0; y < H; y++) {
+      for (UINTN x = 0; x < W; x++) {
+        BOOLEAN On = FALSE;
+        if (Img != NULL && x < Img->Width && y < Img->Height) {
+          EFI_GRAPHICS_OUTPUT_BLT_PIXEL *q = &Img->Image.Bitmap[y * Img->Width + x];
+          On = (q->Red != Bg.Red || q->Green != Bg.Green || q->Blue != Bg.Blue);
+        }
+        SetGlyphPixel(&mGop.Text, c - GLYPH_FIRST, x, y, On);
+      }
+    }
+    if (Img != NULL) FreeImageOutput(Img);
+  }
+  return EFI_SUCCESS;
+}
+
+// -----------------------------
+// Setup
+// -----------------------------
+VOID
+GopFree(VOID)
+{
+  FreeGlyphSet(&mGop.Text);
+  if (mGop.Back != NULL) FreePool(mGop.Back);
+  ZeroMem(&mGop, sizeof(mGop));
+}
+
+EFI_STATUS
+GopInit(VOID)
+{
+  EFI_HII_FONT_PROTOCOL *Font = NULL;
+  EFI_STATUS             St;
+
+  if (mGop.Gop != NULL) return EFI_SUCCESS;
+
+  // Prefer the GOP behind the console; any instance otherwise
+  St = gBS->HandleProtocol(gST->ConsoleOutHandle, &gEfiGraphicsOutputProtocolGuid, (VOID **)&mGop.Gop);
+  if (EFI_ERROR(St)) St = gBS->LocateProtocol(&gEfiGraphicsOutputProtocolGuid, NULL, (VOID **)&mGop.Gop);
+  if (EFI_ERROR(St)) return St;
+
+  St = gBS->LocateProtocol(&gEfiHiiFontProtocolGuid, NULL, (VOID **)&Font);
+  if (!EFI_ERROR(St)) {
+    mGop.Width  = mGop.Gop->Mode->Info->HorizontalResolution;
+    mGop.Height = mGop.Gop->Mode->Info->VerticalResolution;
+    mGop.Back   = AllocateZeroPool(mGop.Width * mGop.Height * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
+    St = (mGop.Back == NULL) ? EFI_OUT_OF_RESOURCES : BuildTextGlyphs(Font);
+  }
+
+  if (EFI_ERROR(St)) {
+    GopFree();
+    return St;
+  }
+  GopClear();
+  return EFI_SUCCESS;
+}
+
+UINTN
+GopCols(VOID)
+{
+  return (mGop.Text.W == 0) ? 0 : mGop.Width / mGop.Text.W;
+}
+
+UINTN
+GopRows(VOID)
+{
+  return (mGop.Text.H == 0) ? 0 : mGop.Height / mGop.Text.H;
+}
+
+// -----------------------------
+// Drawing
+// -----------------------------
+STATIC
+VOID
+MarkDirty(UINTN X, UINTN Y, UINTN W, UINTN H)
+{
+  if (mGop.DirtyX0 >= mGop.DirtyX1) {
+    mGop.DirtyX0 = X;
+    mGop.DirtyY0 = Y;
+    mGop.DirtyX1 = X + W;
+    mGop.DirtyY1 = Y + H;
+    return;
+  }
+  mGop.DirtyX0 = MIN(mGop.DirtyX0, X);
+  mGop.DirtyY0 = MIN(mGop.DirtyY0, Y);
+  mGop.DirtyX1 = MAX(mGop.DirtyX1, X + W);
+  mGop.DirtyY1 = MAX(mGop.DirtyY1, Y + H);
+}
+
+VOID
+GopClear(VOID)
+{
+  if (mGop.Back == NULL) return;
+  ZeroMem(mGop.Back, mGop.Width * mGop.Height * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL));   // mBg[GOP_NORMAL]
+  MarkDirty(0, 0, mGop.Width, mGop.Height);
+}
+
+// Width cells from (Col, Row); Text shorter than Width is padded with blanks.
+VOID
+GopDrawText(UINTN Col, UINTN Row, IN CONST CHAR16 *Text, UINTN Width, GOP_PALETTE Palette)
+{
+  UINTN Cols = GopCols();
+
+  if (mGop.Back == NULL || Row >= GopRows() || Col >= Cols) return;
+  Width = MIN(Width, Cols - Col);
+
+  for (UINTN i = 0; i < Width; i++) {
+    CHAR16 c = (*Text != L'\0') ? *Text++ : L' ';
+    if (c < GLYPH_FIRST || c > GLYPH_LAST) c = L'?';
+    DrawGlyph(&mGop.Text, c - GLYPH_FIRST, (Col + i) * mGop.Text.W, Row * mGop.Text.H, Palette);
+  }
+  MarkDirty(Col * mGop.Text.W, Row * mGop.Text.H, Width * mGop.Text.W, mGop.Text.H);
+}
+
+// One Blt per frame: the bounding box of everything drawn since the last flush.
+VOID
+GopFlush(VOID)
+{
+  if (mGop.Back == NULL || mGop.DirtyX0 >= mGop.DirtyX1) return;
+
+  mGop.Gop->Blt(mGop.Gop, mGop.Back, EfiBltBufferToVideo,
+                mGop.DirtyX0, mGop.DirtyY0, mGop.DirtyX0, mGop.DirtyY0,
+                mGop.DirtyX1 - mGop.DirtyX0, mGop.DirtyY1 - mGop.DirtyY0,
+                mGop.Width * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
+  mGop.DirtyX0 = mGop.DirtyX1 = 0;
+}
+
+// -----------------------------
+// Dense 4 KB hex view
+// -----------------------------
+// 3x5 hex digits in a 4x6 cell, scaled by an integer factor to fit the
+// mode: 64 rows of 64 bytes (16 DWORDs) put the whole extended space on
+// one screen (592x384 at scale 1).
+#define HEX_CELL_W     4
+#define HEX_CELL_H     6
+#define HEX_ROW_BYTES  0x40
+#define HEX_ROWS       (0x1000 / HEX_ROW_BYTES)
+#define HEX_ROW_CELLS  (3 + 1 + (HEX_ROW_BYTES / 4) * 9)   // offset, gap, DWORDs + gaps
+
+STATIC CONST UINT16 mHexFont[16] = {   // row major, MSB first, 3 bits per row
+  0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9, 0x79CF, 0x79EF, 0x7249,
+  0x7BEF, 0x7BCF, 0x2BED, 0x6BAE, 0x3923, 0x6B6E, 0x79A7, 0x79A4
+};
+
+typedef struct {
+  GLYPH_SET     Hex;
+  UINTN         Top;     // first pixel row of the grid
+  CONST UINT32 *Cfg;
+} HEX_VIEW;
+
+STATIC
+EFI_STATUS
+BuildHexGlyphs(OUT GLYPH_SET *Set, UINTN Scale)
+{
+  EFI_STATUS St = AllocGlyphSet(Set, 16, HEX_CELL_W * Scale, HEX_CELL_H * Scale);
+  if (EFI_ERROR(St)) return St;
+
+  for (UINTN d = 0; d < 16; d++) {
+    for (UINTN y = 0; y < Set->H; y++) {
+      for (UINTN x = 0; x < Set->W; x++) {
+        UINTN   gx = x / Scale, gy = y / Scale;
+        BOOLEAN On = (gx < 3 && gy < 5 && (mHexFont[d] & (1u << (14 - (gy * 3 + gx)))) != 0);
+        SetGlyphPixel(Set, d, x, y, On);
+      }
+    }
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+HexDrawNumber(HEX_VIEW *V, UINTN Cell, UINTN Row, UINT32 Value, UINTN Digits, GOP_PALETTE Palette)
+{
+  UINTN X = Cell * V->Hex.W;
+  UINTN Y = V->Top + Row * V->Hex.H;
+
+  for (UINTN k = 0; k < Digits; k++) {
+    DrawGlyph(&V->Hex, (Value >> ((Digits - 1 - k) * 4)) & 0xF, X + k * V->Hex.W, Y, Palette);
+  }
+  MarkDirty(X, Y, Digits * V->Hex.W, V->Hex.H);
+}
+
+STATIC
+VOID
+HexDrawDword(HEX_VIEW *V, UINT16 Off, UINT16 Cursor)
+{
+  UINT32      Val = V->Cfg[Off / 4];
+  GOP_PALETTE Pal = (Off == Cursor) ? GOP_HILITE : (Val == 0xFFFFFFFF) ? GOP_DIM : GOP_NORMAL;
+
+  HexDrawNumber(V, 4 + ((Off % HEX_ROW_BYTES) / 4) * 9, Off / HEX_ROW_BYTES, Val, 8, Pal);
+}
+
+STATIC
+VOID
+HexDrawStatus(UINT8 Bus, UINT8 Dev, UINT8 Func, HEX_VIEW *V, UINT16 Cursor)
+{
+  CHAR16 Line[REPORT_LINE_LEN];
+  UnicodeSPrint(Line, sizeof(Line), L"%02x:%02x.%x  4KB config  @%03x = %08x   Arrows:Move  Enter/Esc:Back",
+                Bus, Dev, Func, Cursor, V->Cfg[Cursor / 4]);
+  GopDrawText(0, 0, Line, GopCols(), GOP_NORMAL);
+}
+
+// Cfg holds the 1024 DWORDs; Cursor (DWORD aligned) comes back moved.
+EFI_STATUS
+PciGopHex4K(UINT8 Bus, UINT8 Dev, UINT8 Func, IN CONST UINT32 *Cfg, IN OUT UINT16 *Cursor)
+{
+  HEX_VIEW V;
+
+  if (mGop.Back == NULL) return EFI_NOT_READY;
+
+  V.Cfg = Cfg;
+  V.Top = 2 * mGop.Text.H;
+  UINTN Scale = MIN(mGop.Width / (HEX_ROW_CELLS * HEX_CELL_W), (mGop.Height - V.Top) / (HEX_ROWS * HEX_CELL_H));
+  if (Scale == 0) return EFI_BUFFER_TOO_SMALL;
+
+  EFI_STATUS St = BuildHexGlyphs(&V.Hex, Scale);
+  if (EFI_ERROR(St)) return St;
+
+  UINT16 Cur = (UINT16)(*Cursor & 0xFFC);
+
+  GopClear();
+  HexDrawStatus(Bus, Dev, Func, &V, Cur);
+  for (UINTN r = 0; r < HEX_ROWS; r++) {
+    HexDrawNumber(&V, 0, r, (UINT32)(r * HEX_ROW_BYTES), 3, GOP_DIM);
+  }
+  for (UINT16 Off = 0; Off < 0x1000; Off += 4) HexDrawDword(&V, Off, Cur);
+  GopFlush();
+
+  while (TRUE) {
+    EFI_INPUT_KEY Key;
+    WaitKey(&Key);
+    if (IsEsc(&Key) || Key.UnicodeChar == CHAR_CARRIAGE_RETURN) break;
+
+    UINT16 Old = Cur;
+    switch (Key.ScanCode) {
+      case SCAN_UP:    if (Cur >= HEX_ROW_BYTES) Cur = (UINT16)(Cur - HEX_ROW_BYTES); break;
+      case SCAN_DOWN:  if (Cur + HEX_ROW_BYTES < 0x1000) Cur = (UINT16)(Cur + HEX_ROW_BYTES); break;
+      case SCAN_LEFT:  if (Cur >= 4) Cur = (UINT16)(Cur - 4); break;
+      case SCAN_RIGHT: if (Cur + 4 < 0x1000) Cur = (UINT16)(Cur + 4); break;
+      default: break;
+    }
+    if (Cur == Old) continue;
+
+    // Two cells and the status row, one Blt
+    HexDrawDword(&V, Old, Cur);
+    HexDrawDword(&V, Cur, Cur);
+    HexDrawStatus(Bus, Dev, Func, &V, Cur);
+    GopFlush();
+  }
+
+  FreeGlyphSet(&V.Hex);
+  ScreenInvalidate();
+  *Cursor = Cur;
+  return EFI_SUCCESS;
+}
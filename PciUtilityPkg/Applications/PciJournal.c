@@ -0,0 +1,409 @@
+#include "PciUtility.h"
+
+//
+// Write journal. Every config write made through the guarded paths
+// (DoWriteAtCursor, PolicyWrite / PolicyClearRw1c, range writes) is
+// appended with the value it replaced, so an experiment can be undone in
+// one step. Nothing is ever removed: a rollback appends its inverse writes
+// (UNDO) and flags the entries it reverted (UNDONE), so the log and the
+// file keep the whole session.
+//
+#define JOURNAL_GROW           256
+#define JOURNAL_MAX_MARKS      15      // picked with one hex digit
+#define JOURNAL_MAX_MISMATCH   16
+#define JOURNAL_DEFAULT_FILE   L"PciJournal.csv"
+#define JOURNAL_ROW_SIZE       80
+
+#define JF_CLEAR    0x01      // RW1C clear: the bits cannot be set back
+#define JF_UNDO     0x02      // written by a rollback
+#define JF_UNDONE   0x04      // reverted by a later rollback
+
+typedef struct {
+  UINT64 Ns;                  // PciCrsNowNs at the write
+  UINT16 Off;
+  UINT8  Bus;
+  UINT8  Dev;
+  UINT8  Func;
+  UINT8  Width;               // 1 / 2 / 4
+  UINT8  Flags;
+  UINT32 Old;
+  UINT32 New;                 // value written (the clear mask for JF_CLEAR)
+} JOURNAL_ENTRY;
+
+typedef struct {
+  JOURNAL_ENTRY *Entry;
+  UINTN          Count;
+  UINTN          Capacity;
+  UINTN          Dropped;     // out of pool: not recorded
+  UINTN          Mark[JOURNAL_MAX_MARKS];   // entry index, oldest first
+  UINTN          MarkCount;
+  CONST CHAR16  *Path;        // -journal: flushed after each rollback and on exit
+} JOURNAL;
+
+// One DWORD touched by a rollback: expected bytes, and the bits to compare
+typedef struct {
+  UINT32 Rid;
+  UINT16 Off;
+  UINT32 Expect;
+  UINT32 Check;
+} JOURNAL_VERIFY;
+
+STATIC JOURNAL mJnl;
+
+// -----------------------------
+// Helpers
+// -----------------------------
+STATIC
+UINT8
+WidthOf(DISP_MODE Mode)
+{
+  return (Mode == DISP_BYTE) ? 1 : (Mode == DISP_WORD) ? 2 : 4;
+}
+
+STATIC
+DISP_MODE
+ModeOf(UINT8 Width)
+{
+  return (Width == 1) ? DISP_BYTE : (Width == 2) ? DISP_WORD : DISP_DWORD;
+}
+
+STATIC
+UINT32
+WidthMask(UINT8 Width)
+{
+  return (Width == 4) ? 0xFFFFFFFF : ((1U << (Width * 8)) - 1);
+}
+
+STATIC
+CONST CHAR16 *
+FlagText(UINT8 Flags)
+{
+  if (Flags & JF_UNDO)   return L"undo";
+  if (Flags & JF_UNDONE) return L"undone";
+  if (Flags & JF_CLEAR)  return L"clear";
+  return L"";
+}
+
+STATIC
+EFI_STATUS
+Grow(UINTN Count)
+{
+  if (mJnl.Count + Count <= mJnl.Capacity) return EFI_SUCCESS;
+
+  UINTN NewCap = mJnl.Count + Count + JOURNAL_GROW;
+  VOID *New2 = ReallocatePool(mJnl.Capacity * sizeof(JOURNAL_ENTRY), NewCap * sizeof(JOURNAL_ENTRY), mJnl.Entry);
+  if (New2 == NULL) return EFI_OUT_OF_RESOURCES;
+  mJnl.Entry    = New2;
+  mJnl.Capacity = NewCap;
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+Append(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, UINT8 Width, UINT32 Old, UINT32 New, UINT8 Flags)
+{
+  if (EFI_ERROR(Grow(1))) {
+    mJnl.Dropped++;
+    return;
+  }
+
+  JOURNAL_ENTRY *e = &mJnl.Entry[mJnl.Count++];
+  e->Ns    = PciCrsNowNs();
+  e->Off   = Off;
+  e->Bus   = Bus;
+  e->Dev   = Dev;
+  e->Func  = Func;
+  e->Width = Width;
+  e->Flags = Flags;
+  e->Old   = Old;
+  e->New   = New;
+}
+
+// -----------------------------
+// Recording
+// -----------------------------
+// Called after a successful write. Old is what the register held before,
+// New what was written; Clear marks an RW1C clear (not undoable).
+VOID
+JournalAdd(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode,
+           UINT32 Old, UINT32 New, BOOLEAN Clear)
+{
+  UINT8 Width = WidthOf(Mode);
+  Append(Bus, Dev, Func, Off, Width, Old & WidthMask(Width), New & WidthMask(Width), Clear ? JF_CLEAR : 0);
+}
+
+// Room for Count more entries, so that writes made at TPL_HIGH_LEVEL
+// (pool services are not allowed there) are recorded without allocating.
+EFI_STATUS
+JournalReserve(UINTN Count)
+{
+  return Grow(Count);
+}
+
+// Returns the mark number (1-based), or 0 when all marks are in use.
+UINTN
+JournalSetMark(VOID)
+{
+  if (mJnl.MarkCount == JOURNAL_MAX_MARKS) return 0;
+  mJnl.Mark[mJnl.MarkCount++] = mJnl.Count;
+  return mJnl.MarkCount;
+}
+
+VOID
+JournalSetFile(IN CONST CHAR16 *Path)
+{
+  mJnl.Path = Path;
+}
+
+// -----------------------------
+// Rollback
+// -----------------------------
+// Byte lanes of a write at Off, in DWORD coordinates
+STATIC
+VOID
+NoteVerify(JOURNAL_VERIFY *Slot, IN OUT UINTN *Slots, UINT32 Rid, UINT16 Off, UINT8 Width,
+           UINT32 Value, UINT32 Rw1c)
+{
+  UINT16 Dw    = (UINT16)(Off & ~3);
+  UINTN  Shift = (Off & 3) * 8;
+  UINT32 Lanes = WidthMask(Width) << Shift;
+  UINTN  s;
+
+  // Rollbacks touch the same few registers over and over: search from the newest slot
+  for (s = *Slots; s > 0; s--) {
+    if (Slot[s - 1].Rid == Rid && Slot[s - 1].Off == Dw) break;
+  }
+  if (s == 0) {
+    s = ++(*Slots);
+    Slot[s - 1].Rid    = Rid;
+    Slot[s - 1].Off    = Dw;
+    Slot[s - 1].Expect = 0;
+    Slot[s - 1].Check  = 0;
+  }
+
+  // Replay runs newest first, so a later (older) entry owns the lanes it covers
+  JOURNAL_VERIFY *v = &Slot[s - 1];
+  v->Expect = (v->Expect & ~Lanes) | ((Value << Shift) & Lanes);
+  v->Check  = (v->Check & ~Lanes) | (Lanes & ~(Rw1c << Shift));
+}
+
+// Writes back the old value of every live entry at or after From, newest
+// first, then reads each touched DWORD once and compares. RW1C clears are
+// skipped (counted), RW1C lanes of mixed registers are written as 0 and
+// not compared. Returns the number of DWORDs that did not read back.
+UINTN
+JournalRollback(UINTN From, OUT PCI_REPORT *Rep)
+{
+  UINTN End = mJnl.Count;   // the UNDO entries appended below are not replayed
+  UINTN Undone = 0, Skipped = 0, Failed = 0, Slots = 0;
+
+  if (From >= End) {
+    ReportAdd(Rep, L"Nothing to roll back");
+    return 0;
+  }
+
+  JOURNAL_VERIFY *Slot = AllocatePool((End - From) * sizeof(JOURNAL_VERIFY));
+  if (Slot == NULL) {
+    ReportAdd(Rep, L"Out of resources");
+    return End - From;
+  }
+
+  for (UINTN i = End; i-- > From; ) {
+    JOURNAL_ENTRY e = mJnl.Entry[i];   // copy: Append may move the array
+
+    if (e.Flags & (JF_UNDO | JF_UNDONE)) continue;
+    if (e.Flags & JF_CLEAR) {
+      Skipped++;
+      continue;
+    }
+
+    DISP_MODE  Mode  = ModeOf(e.Width);
+    UINT32     Rw1c  = PolicyRw1cLanes(e.Bus, e.Dev, e.Func, e.Off, Mode);
+    UINT32     Value = e.Old & ~Rw1c;
+    EFI_STATUS St;
+
+    if (Mode == DISP_BYTE)      St = PciCfgWrite8 (e.Bus, e.Dev, e.Func, e.Off, (UINT8)Value);
+    else if (Mode == DISP_WORD) St = PciCfgWrite16(e.Bus, e.Dev, e.Func, e.Off, (UINT16)Value);
+    else                        St = PciCfgWrite32(e.Bus, e.Dev, e.Func, e.Off, Value);
+
+    if (EFI_ERROR(St)) {
+      ReportAdd(Rep, L"  %02x/%02x/%02x +%03x  write failed: %r", e.Bus, e.Dev, e.Func, e.Off, St);
+      Failed++;
+      continue;
+    }
+
+    mJnl.Entry[i].Flags |= JF_UNDONE;
+    Append(e.Bus, e.Dev, e.Func, e.Off, e.Width, e.New, Value, JF_UNDO);
+    NoteVerify(Slot, &Slots, (UINT32)((e.Bus << 8) | (e.Dev << 3) | e.Func), e.Off, e.Width, Value, Rw1c);
+    Undone++;
+  }
+
+  // Batched verify: nothing is read back until every write is done
+  UINTN Mismatch = 0;
+  for (UINTN s = 0; s < Slots; s++) {
+    JOURNAL_VERIFY *v = &Slot[s];
+    UINT8  Bus = (UINT8)(v->Rid >> 8), Dev = (UINT8)((v->Rid >> 3) & 0x1F), Func = (UINT8)(v->Rid & 7);
+    UINT32 Rb  = 0;
+
+    PciCfgRead32(Bus, Dev, Func, v->Off, &Rb);
+    if (((Rb ^ v->Expect) & v->Check) == 0) continue;
+
+    if (Mismatch < JOURNAL_MAX_MISMATCH) {
+      ReportAdd(Rep, L"  %02x/%02x/%02x +%03x  want %08x  read %08x  (differs %08x)",
+                Bus, Dev, Func, v->Off, v->Expect & v->Check, Rb & v->Check, (Rb ^ v->Expect) & v->Check);
+    }
+    Mismatch++;
+  }
+  FreePool(Slot);
+
+  ReportAdd(Rep, L"%u write(s) reverted, %u DWORD(s) verified, %u differ, %u failed",
+            (UINT32)Undone, (UINT32)Slots, (UINT32)Mismatch, (UINT32)Failed);
+  if (Skipped != 0) {
+    ReportAdd(Rep, L"%u RW1C clear(s) cannot be undone (status bits stay cleared)", (UINT32)Skipped);
+  }
+
+  if (mJnl.Path != NULL) {
+    EFI_STATUS St = JournalFlush();
+    if (EFI_ERROR(St)) ReportAdd(Rep, L"Journal file %s: %r", mJnl.Path, St);
+  }
+  return Mismatch + Failed;
+}
+
+// -----------------------------
+// Output
+// -----------------------------
+// CSV: seq, us, bus, dev, func, off, width, old, new, flag; a mark is a row
+// with only seq and "markN". The whole journal is rewritten each time.
+EFI_STATUS
+JournalFlush(VOID)
+{
+  CONST CHAR16 *Path = (mJnl.Path != NULL) ? mJnl.Path : JOURNAL_DEFAULT_FILE;
+  UINTN  Cap = (mJnl.Count + mJnl.MarkCount + 2) * JOURNAL_ROW_SIZE;
+  CHAR8 *Buf = AllocatePool(Cap);
+  UINTN  Len = 0, m = 0;
+
+  if (Buf == NULL) return EFI_OUT_OF_RESOURCES;
+
+  Len += AsciiSPrint(Buf + Len, Cap - Len, "seq,us,bus,dev,func,off,width,old,new,flag\r\n");
+  for (UINTN i = 0; i <= mJnl.Count; i++) {
+    for (; m < mJnl.MarkCount && mJnl.Mark[m] == i; m++) {
+      Len += AsciiSPrint(Buf + Len, Cap - Len, "%u,,,,,,,,,mark%u\r\n", (UINT32)i, (UINT32)(m + 1));
+    }
+    if (i == mJnl.Count) break;
+
+    JOURNAL_ENTRY *e = &mJnl.Entry[i];
+    Len += AsciiSPrint(Buf + Len, Cap - Len, "%u,%lu,%02x,%02x,%x,%03x,%u,%0*x,%0*x,%s\r\n",
+                       (UINT32)i, DivU64x32(e->Ns, 1000), e->Bus, e->Dev, e->Func, e->Off, e->Width,
+                       (UINTN)e->Width * 2, e->Old, (UINTN)e->Width * 2, e->New, FlagText(e->Flags));
+  }
+
+  EFI_STATUS St = PciFileWrite(Path, Buf, Len);
+  FreePool(Buf);
+  return St;
+}
+
+// Newest first, with the marks between the entries.
+STATIC
+VOID
+JournalReport(OUT PCI_REPORT *Rep)
+{
+  UINTN m = mJnl.MarkCount;
+
+  if (mJnl.Dropped != 0) ReportAdd(Rep, L"%u write(s) not recorded (out of pool)", (UINT32)mJnl.Dropped);
+  if (mJnl.Count == 0)   ReportAdd(Rep, L"No writes recorded");
+
+  for (UINTN i = mJnl.Count; ; i--) {
+    for (; m > 0 && mJnl.Mark[m - 1] == i; m--) {
+      ReportAdd(Rep, L"---- mark %u ----", (UINT32)m);
+    }
+    if (i == 0) break;
+
+    JOURNAL_ENTRY *e = &mJnl.Entry[i - 1];
+    ReportAdd(Rep, L"%5u %10luus  %02x/%02x/%02x +%03x %c  %0*x -> %0*x  %s",
+              (UINT32)(i - 1), DivU64x32(e->Ns, 1000), e->Bus, e->Dev, e->Func, e->Off,
+              (e->Width == 1) ? L'B' : (e->Width == 2) ? L'W' : L'D',
+              (UINTN)e->Width * 2, e->Old, (UINTN)e->Width * 2, e->New, FlagText(e->Flags));
+  }
+}
+
+// -----------------------------
+// Dialog (J in the device list / Config View)
+// -----------------------------
+STATIC
+VOID
+RunRollback(UINTN From, IN CONST CHAR16 *Title)
+{
+  PCI_REPORT Rep;
+
+  ScreenPrompt();
+  Print(L"\n");
+  if (!ConfirmKey(L"Write the old values back?")) return;
+
+  ReportInit(&Rep);
+  JournalRollback(From, &Rep);
+  ReportShow(Title, &Rep);
+  ReportFree(&Rep);
+}
+
+// Results of M / W are a note under the menu of the next frame.
+VOID
+PciJournalDialog(VOID)
+{
+  CHAR16 Note[80];
+
+  Note[0] = L'\0';
+  while (TRUE) {
+    UINTN Live = 0;
+    for (UINTN i = 0; i < mJnl.Count; i++) {
+      if ((mJnl.Entry[i].Flags & (JF_UNDO | JF_UNDONE | JF_CLEAR)) == 0) Live++;
+    }
+
+    ScreenBegin();
+    ScreenLine(L"WRITE JOURNAL  %u entries, %u can be rolled back, %u mark(s)",
+               (UINT32)mJnl.Count, (UINT32)Live, (UINT32)mJnl.MarkCount);
+    ScreenLine(L"File: %s", (mJnl.Path != NULL) ? mJnl.Path : JOURNAL_DEFAULT_FILE);
+    ScreenLine(L"");
+    ScreenLine(L"L:List  M:Set mark  R:Rollback to mark  U:Undo all  W:Write file  Esc:Back");
+    if (Note[0] != L'\0') {
+      ScreenLine(L"");
+      ScreenLine(L"%s", Note);
+    }
+    ScreenEnd();
+    Note[0] = L'\0';
+
+    EFI_INPUT_KEY Key;
+    WaitKey(&Key);
+    if (IsEsc(&Key)) return;
+
+    CHAR16 Op = CharToUpper(Key.UnicodeChar);
+
+    if (Op == L'L') {
+      PCI_REPORT Rep;
+      ReportInit(&Rep);
+      JournalReport(&Rep);
+      ReportShow(L"Write journal (newest first)", &Rep);
+      ReportFree(&Rep);
+    } else if (Op == L'M') {
+      UINTN n = JournalSetMark();
+      if (n == 0) UnicodeSPrint(Note, sizeof(Note), L"All %u marks are in use.", JOURNAL_MAX_MARKS);
+      else        UnicodeSPrint(Note, sizeof(Note), L"Mark %u set at entry %u.", (UINT32)n, (UINT32)mJnl.Count);
+    } else if (Op == L'R') {
+      UINT64 n = mJnl.MarkCount;
+      if (n == 0) {
+        UnicodeSPrint(Note, sizeof(Note), L"No mark set (M).");
+        continue;
+      }
+      if (n > 1) {
+        ScreenPrompt();
+        Print(L"\nMark (1 hex, 1-%x): ", (UINT32)mJnl.MarkCount);
+        if (EFI_ERROR(ReadFixedHex(1, &n)) || n == 0 || n > mJnl.MarkCount) continue;
+      }
+      RunRollback(mJnl.Mark[n - 1], L"Rollback to mark");
+    } else if (Op == L'U') {
+      RunRollback(0, L"Rollback of all writes");
+    } else if (Op == L'W') {
+      EFI_STATUS St = JournalFlush();
+      UnicodeSPrint(Note, sizeof(Note), L"Write %s: %r", (mJnl.Path != NULL) ? mJnl.Path : JOURNAL_DEFAULT_FILE, St);
+    }
+  }
+}
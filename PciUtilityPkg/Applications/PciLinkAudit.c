@@ -0,0 +1,112 @@
+#include "PciUtility.h"
+
+typedef struct {
+  UINT16 Port;          // downstream port (root / switch DSP)
+  UINT16 Child;         // upstream end of the link
+  UINT8  CapSpeed;      // min of both ends' max speed
+  UINT8  CapWidth;      // min of both ends' max width
+  UINT8  CurSpeed;
+  UINT8  CurWidth;
+  UINT32 CapMBps;
+  UINT32 LostMBps;
+} LINK_AUDIT_ENTRY;
+
+// Highest supported speed: Link Cap 2 vector (PCIe 3.0+), else Link Cap [3:0].
+STATIC
+UINT8
+MaxLinkSpeed(PCI_DEV_INFO *p, PCI_TOPO_NODE *n, UINT32 LinkCap)
+{
+  if (n->PcieVer >= 2) {
+    UINT32 LinkCap2 = 0;
+    PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x2C), &LinkCap2);
+    UINT32 Vec = (LinkCap2 >> 1) & 0x7F;
+    if (Vec != 0) return (UINT8)(HighBitSet32(Vec) + 1);
+  }
+  return (UINT8)(LinkCap & 0x0F);
+}
+
+STATIC
+INTN
+EFIAPI
+CompareLostDesc(IN CONST VOID *A, IN CONST VOID *B)
+{
+  UINT32 La = ((CONST LINK_AUDIT_ENTRY *)A)->LostMBps;
+  UINT32 Lb = ((CONST LINK_AUDIT_ENTRY *)B)->LostMBps;
+  return (La < Lb) ? 1 : (La > Lb) ? -1 : 0;
+}
+
+// One pass over the topology: 4-6 config reads per link.
+// Returns the number of downtrained links; details go to Rep.
+UINTN
+PciLinkAudit(IN PCI_TOPOLOGY *Topo, OUT PCI_REPORT *Rep)
+{
+  LINK_AUDIT_ENTRY *Ent = AllocateZeroPool(sizeof(LINK_AUDIT_ENTRY) * (Topo->Count ? Topo->Count : 1));
+  if (Ent == NULL) {
+    ReportAdd(Rep, L"Out of resources");
+    return 0;
+  }
+
+  UINTN Links = 0, Down = 0;
+
+  for (UINTN i = 0; i < Topo->Count; i++) {
+    UINT16 c = PciLinkPartner(Topo, i);
+    if (c == PCI_NO_NODE) continue;
+
+    PCI_DEV_INFO  *pp = &Topo->List[i];
+    PCI_DEV_INFO  *cp = &Topo->List[c];
+    PCI_TOPO_NODE *pn = &Topo->Node[i];
+    PCI_TOPO_NODE *cn = &Topo->Node[c];
+
+    UINT32 PortCap = 0, ChildCap = 0;
+    UINT16 LinkSta = 0;
+    PciCfgRead32(pp->Bus, pp->Dev, pp->Func, (UINT16)(pn->PcieCap + 0x0C), &PortCap);
+    PciCfgRead32(cp->Bus, cp->Dev, cp->Func, (UINT16)(cn->PcieCap + 0x0C), &ChildCap);
+    PciCfgRead16(pp->Bus, pp->Dev, pp->Func, (UINT16)(pn->PcieCap + 0x12), &LinkSta);
+
+    UINT8 PortSpeed  = MaxLinkSpeed(pp, pn, PortCap);
+    UINT8 ChildSpeed = MaxLinkSpeed(cp, cn, ChildCap);
+    UINT8 PortWidth  = (UINT8)((PortCap  >> 4) & 0x3F);
+    UINT8 ChildWidth = (UINT8)((ChildCap >> 4) & 0x3F);
+
+    LINK_AUDIT_ENTRY E;
+    E.Port     = (UINT16)i;
+    E.Child    = c;
+    E.CapSpeed = MIN(PortSpeed, ChildSpeed);
+    E.CapWidth = MIN(PortWidth, ChildWidth);
+    E.CurSpeed = (UINT8)(LinkSta & 0x0F);
+    E.CurWidth = (UINT8)((LinkSta >> 4) & 0x3F);
+    E.CapMBps  = PcieLaneMBps(E.CapSpeed) * E.CapWidth;
+
+    UINT32 CurMBps = PcieLaneMBps(E.CurSpeed) * E.CurWidth;
+    E.LostMBps = (E.CapMBps > CurMBps) ? (E.CapMBps - CurMBps) : 0;
+
+    Links++;
+    if (E.CurSpeed < E.CapSpeed || E.CurWidth < E.CapWidth) {
+      Ent[Down++] = E;
+    }
+  }
+
+  if (Down > 1) {
+    LINK_AUDIT_ENTRY Tmp;
+    QuickSort(Ent, Down, sizeof(LINK_AUDIT_ENTRY), CompareLostDesc, &Tmp);
+  }
+
+  ReportAdd(Rep, L"Links checked: %u   Downtrained: %u", (UINT32)Links, (UINT32)Down);
+  ReportAdd(Rep, L"");
+  ReportAdd(Rep, L"Port       Device     Capable     Running     Lost(MB/s)");
+
+  for (UINTN k = 0; k < Down; k++) {
+    LINK_AUDIT_ENTRY *E = &Ent[k];
+    PCI_DEV_INFO *pp = &Topo->List[E->Port];
+    PCI_DEV_INFO *cp = &Topo->List[E->Child];
+
+    ReportAdd(Rep, L"%02x/%02x/%02x   %02x/%02x/%02x   %s x%-2u    %s x%-2u    %u (%u%%)",
+              pp->Bus, pp->Dev, pp->Func, cp->Bus, cp->Dev, cp->Func,
+              PcieSpeedName(E->CapSpeed), E->CapWidth,
+              PcieSpeedName(E->CurSpeed), E->CurWidth,
+              E->LostMBps, E->CapMBps ? (E->LostMBps * 100) / E->CapMBps : 0);
+  }
+
+  FreePool(Ent);
+  return Down;
+}
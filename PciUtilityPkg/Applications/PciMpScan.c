@@ -0,0 +1,297 @@
+#include "PciUtility.h"
+
+#include <Protocol/MpService.h>
+
+//
+// Work is handed out through InterlockedIncrement counters so fast CPUs
+// pick up more buses/devices.  Everything the APs touch is preallocated on
+// the BSP; APs only do MMIO (ECAM) reads and write to their own slot.
+//
+#define MP_SCAN_MAX_WORKERS  32
+#define MP_DUMP_CHUNK        8
+#define MP_SCAN_MAX_CRS      32
+
+typedef struct {
+  PCI_DEV_INFO *Buf;      // per-worker result buffer (MAX_PCI_DEVS entries)
+  UINTN         Count;
+  UINT16        Crs[MP_SCAN_MAX_CRS];   // bus << 8 | dev << 3 | func, queued on the BSP
+  UINTN         CrsCount;
+} MP_SCAN_SLOT;
+
+typedef struct {
+  volatile UINT32 NextSlot;
+  volatile UINT32 NextBus;
+  UINT32          LastBus;
+  UINT32          SlotCount;
+  MP_SCAN_SLOT    Slot[MP_SCAN_MAX_WORKERS];
+  UINT8           BusOwner[256];   // slot that scanned the bus
+  UINT16          BusFirst[256];   // first entry in the owner's buffer
+  UINT16          BusCount[256];
+} MP_SCAN_CTX;
+
+typedef struct {
+  volatile UINT32 NextIndex;
+  UINT32          Count;
+  PCI_DEV_INFO   *List;
+  UINT8          *Buf;             // Count * 0x100, one slice per device
+} MP_DUMP_CTX;
+
+// -----------------------------
+// Dispatch helper
+// -----------------------------
+STATIC
+UINTN
+GetWorkerCount(OUT EFI_MP_SERVICES_PROTOCOL **OutMp)
+{
+  EFI_MP_SERVICES_PROTOCOL *Mp = NULL;
+  UINTN Total = 1, Enabled = 1;
+
+  *OutMp = NULL;
+  if (EFI_ERROR(gBS->LocateProtocol(&gEfiMpServiceProtocolGuid, NULL, (VOID**)&Mp)) || Mp == NULL) {
+    return 1;
+  }
+  if (EFI_ERROR(Mp->GetNumberOfProcessors(Mp, &Total, &Enabled)) || Enabled == 0) {
+    return 1;
+  }
+
+  *OutMp = Mp;
+  return (Enabled > MP_SCAN_MAX_WORKERS) ? MP_SCAN_MAX_WORKERS : Enabled;
+}
+
+// Run Proc on every enabled AP and on the BSP, return when all are done.
+STATIC
+VOID
+RunOnAllCpus(EFI_MP_SERVICES_PROTOCOL *Mp, EFI_AP_PROCEDURE Proc, VOID *Arg)
+{
+  EFI_EVENT  Done = NULL;
+  EFI_STATUS Status = EFI_NOT_STARTED;
+
+  if (Mp != NULL && !EFI_ERROR(gBS->CreateEvent(0, TPL_CALLBACK, NULL, NULL, &Done))) {
+    // Non-blocking: the BSP works too instead of idling in StartupAllAPs.
+    Status = Mp->StartupAllAPs(Mp, Proc, FALSE, Done, 0, Arg, NULL);
+  }
+
+  Proc(Arg);
+
+  if (!EFI_ERROR(Status)) {
+    UINTN Index;
+    gBS->WaitForEvent(1, &Done, &Index);
+  }
+  if (Done != NULL) gBS->CloseEvent(Done);
+}
+
+// -----------------------------
+// Scan
+// -----------------------------
+// APs cannot touch the CRS queue; retrying functions are kept per slot.
+STATIC
+BOOLEAN
+EcamReadFuncInfo(UINT8 Bus, UINT8 Dev, UINT8 Func, OUT PCI_DEV_INFO *Out, MP_SCAN_SLOT *Slot)
+{
+  UINT32 Id = PciCfgEcamRead32(Bus, Dev, Func, 0x00);
+  if ((Id & 0xFFFF) == 0xFFFF) {
+    return FALSE;
+  }
+  if ((Id & 0xFFFF) == 0x0001) {
+    if (Slot->CrsCount < MP_SCAN_MAX_CRS) {
+      Slot->Crs[Slot->CrsCount++] = (UINT16)((Bus << 8) | (Dev << 3) | Func);
+    }
+    return FALSE;
+  }
+
+  UINT32 ClassRev = PciCfgEcamRead32(Bus, Dev, Func, 0x08);
+
+  Out->Bus = Bus; Out->Dev = Dev; Out->Func = Func;
+  Out->Vid = (UINT16)Id; Out->Did = (UINT16)(Id >> 16);
+  Out->ProgIf    = (UINT8)(ClassRev >> 8);
+  Out->SubClass  = (UINT8)(ClassRev >> 16);
+  Out->BaseClass = (UINT8)(ClassRev >> 24);
+  return TRUE;
+}
+
+STATIC
+VOID
+EcamScanBus(UINT8 Bus, MP_SCAN_SLOT *Slot)
+{
+  for (UINT8 Dev = 0; Dev <= 31; Dev++) {
+    PCI_DEV_INFO Info;
+    if (!EcamReadFuncInfo(Bus, Dev, 0, &Info, Slot)) {
+      continue;
+    }
+    if (Slot->Count < MAX_PCI_DEVS) Slot->Buf[Slot->Count++] = Info;
+
+    UINT8 HdrType = (UINT8)(PciCfgEcamRead32(Bus, Dev, 0, 0x0C) >> 16);
+    if ((HdrType & 0x80) == 0) {
+      continue;
+    }
+
+    for (UINT8 Func = 1; Func <= 7; Func++) {
+      if (EcamReadFuncInfo(Bus, Dev, Func, &Info, Slot)) {
+        if (Slot->Count < MAX_PCI_DEVS) Slot->Buf[Slot->Count++] = Info;
+      }
+    }
+  }
+}
+
+STATIC
+VOID
+EFIAPI
+MpScanWorker(IN OUT VOID *Arg)
+{
+  MP_SCAN_CTX *Ctx = (MP_SCAN_CTX *)Arg;
+
+  UINT32 SlotIdx = InterlockedIncrement(&Ctx->NextSlot) - 1;
+  if (SlotIdx >= Ctx->SlotCount) return;
+
+  MP_SCAN_SLOT *Slot = &Ctx->Slot[SlotIdx];
+
+  while (TRUE) {
+    UINT32 Bus = InterlockedIncrement(&Ctx->NextBus) - 1;
+    if (Bus > Ctx->LastBus) break;
+
+    UINTN First = Slot->Count;
+    EcamScanBus((UINT8)Bus, Slot);
+
+    Ctx->BusOwner[Bus] = (UINT8)SlotIdx;
+    Ctx->BusFirst[Bus] = (UINT16)First;
+    Ctx->BusCount[Bus] = (UINT16)(Slot->Count - First);
+  }
+}
+
+UINTN
+ScanAllPciMp(OUT PCI_DEV_INFO **OutList)
+{
+  EFI_MP_SERVICES_PROTOCOL *Mp;
+  UINTN Workers = GetWorkerCount(&Mp);
+
+  MP_SCAN_CTX *Ctx = AllocateZeroPool(sizeof(MP_SCAN_CTX));
+  PCI_DEV_INFO *List = AllocateZeroPool(sizeof(PCI_DEV_INFO) * MAX_PCI_DEVS);
+  if (Ctx == NULL || List == NULL) goto Fail;
+
+  for (UINTN i = 0; i < Workers; i++) {
+    Ctx->Slot[i].Buf = AllocatePool(sizeof(PCI_DEV_INFO) * MAX_PCI_DEVS);
+    if (Ctx->Slot[i].Buf == NULL) goto Fail;
+  }
+  Ctx->SlotCount = (UINT32)Workers;
+
+  // ECAM may not decode every bus; those go through RBIO on the BSP below.
+  UINT32 FirstBus = 0, LastBus = 255;
+  while (FirstBus <= 255 && !PciCfgEcamCoversBus((UINT8)FirstBus)) FirstBus++;
+  while (LastBus > FirstBus && !PciCfgEcamCoversBus((UINT8)LastBus)) LastBus--;
+  Ctx->NextBus = FirstBus;
+  Ctx->LastBus = LastBus;
+
+  if (FirstBus <= 255) {
+    RunOnAllCpus(Mp, MpScanWorker, Ctx);
+  }
+
+  // Merge in bus order so the list matches the serial scan.
+  UINTN Count = 0;
+  for (UINT32 Bus = 0; Bus <= 255; Bus++) {
+    if (FirstBus > 255 || Bus < FirstBus || Bus > LastBus) {
+      ScanPciBus((UINT8)Bus, List, &Count);
+      continue;
+    }
+
+    MP_SCAN_SLOT *Slot = &Ctx->Slot[Ctx->BusOwner[Bus]];
+    for (UINTN i = 0; i < Ctx->BusCount[Bus] && Count < MAX_PCI_DEVS; i++) {
+      List[Count++] = Slot->Buf[Ctx->BusFirst[Bus] + i];
+    }
+  }
+
+  for (UINTN i = 0; i < Workers; i++) {
+    for (UINTN k = 0; k < Ctx->Slot[i].CrsCount; k++) {
+      UINT16 Bdf = Ctx->Slot[i].Crs[k];
+      PciCrsDefer((UINT8)(Bdf >> 8), (UINT8)((Bdf >> 3) & 0x1F), (UINT8)(Bdf & 7));
+    }
+  }
+  PciCrsFinish(List, &Count);
+
+  for (UINTN i = 0; i < Workers; i++) FreePool(Ctx->Slot[i].Buf);
+  FreePool(Ctx);
+
+  *OutList = List;
+  return Count;
+
+Fail:
+  if (Ctx != NULL) {
+    for (UINTN i = 0; i < MP_SCAN_MAX_WORKERS; i++) {
+      if (Ctx->Slot[i].Buf != NULL) FreePool(Ctx->Slot[i].Buf);
+    }
+    FreePool(Ctx);
+  }
+  if (List != NULL) FreePool(List);
+  return 0;
+}
+
+// -----------------------------
+// Dump
+// -----------------------------
+STATIC
+VOID
+EFIAPI
+MpDumpWorker(IN OUT VOID *Arg)
+{
+  MP_DUMP_CTX *Ctx = (MP_DUMP_CTX *)Arg;
+
+  while (TRUE) {
+    UINT32 Start = InterlockedIncrement(&Ctx->NextIndex) - 1;
+    Start *= MP_DUMP_CHUNK;
+    if (Start >= Ctx->Count) break;
+
+    UINT32 End = Start + MP_DUMP_CHUNK;
+    if (End > Ctx->Count) End = Ctx->Count;
+
+    for (UINT32 i = Start; i < End; i++) {
+      PCI_DEV_INFO *p = &Ctx->List[i];
+      if (!PciCfgEcamCoversBus(p->Bus)) continue; // BSP reads it via RBIO
+
+      UINT32 *Dst = (UINT32 *)(Ctx->Buf + (UINTN)i * 0x100);
+      for (UINT16 off = 0; off < 0x100; off += 4) {
+        Dst[off / 4] = PciCfgEcamRead32(p->Bus, p->Dev, p->Func, off);
+      }
+    }
+  }
+}
+
+EFI_STATUS
+DumpAllPci(PCI_DEV_INFO *List, UINTN Count, BOOLEAN UseMp)
+{
+  UINT8 *Buf = AllocateZeroPool(Count * 0x100);
+  if (Buf == NULL) return EFI_OUT_OF_RESOURCES;
+
+  if (UseMp && PciCfgEcamAvailable()) {
+    EFI_MP_SERVICES_PROTOCOL *Mp;
+    GetWorkerCount(&Mp);
+
+    MP_DUMP_CTX Ctx;
+    Ctx.NextIndex = 0;
+    Ctx.Count     = (UINT32)Count;
+    Ctx.List      = List;
+    Ctx.Buf       = Buf;
+    RunOnAllCpus(Mp, MpDumpWorker, &Ctx);
+  }
+
+  for (UINTN i = 0; i < Count; i++) {
+    PCI_DEV_INFO *p = &List[i];
+    UINT8 *Cfg = Buf + i * 0x100;
+
+    if (!UseMp || !PciCfgEcamCoversBus(p->Bus)) {
+      ReadConfig256(p->Bus, p->Dev, p->Func, Cfg);
+    }
+
+    Print(L"\nBus:%02x Dev:%02x Func:%02x  VID:%04x DID:%04x  Class:%02x%02x%02x\n",
+          p->Bus, p->Dev, p->Func, p->Vid, p->Did, p->BaseClass, p->SubClass, p->ProgIf);
+
+    for (UINT16 row = 0; row < 0x100; row += 0x10) {
+      Print(L"%02x  ", row);
+      for (UINT16 j = 0; j < 0x10; j++) {
+        Print(L"%02x ", Cfg[row + j]);
+      }
+      Print(L"\n");
+    }
+  }
+
+  FreePool(Buf);
+  return EFI_SUCCESS;
+}
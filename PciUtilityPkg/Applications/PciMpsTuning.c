@@ -0,0 +1,147 @@
+#include "PciUtility.h"
+
+// Device Capabilities [2:0], Device Control [7:5] / [14:12]: 128 << n bytes
+#define DEVCTL_MPS_MASK   0x00E0
+#define DEVCTL_MRRS_MASK  0x7000
+
+typedef struct {
+  UINT8  Mpss;      // supported (encoded)
+  UINT8  Mps;       // current (encoded)
+  UINT8  Mrrs;      // current (encoded)
+  UINT16 Root;      // root port index of this function's subtree
+} MPS_INFO;
+
+STATIC
+UINT32
+MpsBytes(UINT8 Enc)
+{
+  return 128U << Enc;
+}
+
+// Root port of every PCIe function. Parents precede children in the
+// bus-ordered list, so one forward pass is enough.
+STATIC
+VOID
+ResolveRoots(IN PCI_TOPOLOGY *Topo, IN OUT MPS_INFO *Info)
+{
+  for (UINTN i = 0; i < Topo->Count; i++) {
+    PCI_TOPO_NODE *n = &Topo->Node[i];
+
+    if (n->PcieCap != 0 && n->PortType == PCIE_PORT_ROOT) {
+      Info[i].Root = (UINT16)i;
+    } else if (n->Parent != PCI_NO_NODE && n->Parent < i) {
+      Info[i].Root = Info[n->Parent].Root;
+    } else {
+      Info[i].Root = PCI_NO_NODE;
+    }
+  }
+}
+
+// Analyze every root-port subtree; with Apply set, program the
+// recommended MPS/MRRS top-down through PolicyWrite.
+// Returns the number of functions that need (or got) a change.
+UINTN
+PciMpsAnalyze(IN PCI_TOPOLOGY *Topo, BOOLEAN Apply, OUT PCI_REPORT *Rep)
+{
+  UINTN Count = Topo->Count;
+  MPS_INFO *Info = AllocateZeroPool(sizeof(MPS_INFO) * (Count ? Count : 1));
+  UINT8    *Best = AllocatePool(Count ? Count : 1);   // per root port: legal MPS
+  if (Info == NULL || Best == NULL) {
+    if (Info) FreePool(Info);
+    if (Best) FreePool(Best);
+    ReportAdd(Rep, L"Out of resources");
+    return 0;
+  }
+
+  // Read DevCap/DevCtl once per function. VFs are skipped everywhere:
+  // their MPS / MRRS fields are RsvdP and follow the PF.
+  for (UINTN i = 0; i < Count; i++) {
+    PCI_DEV_INFO  *p = &Topo->List[i];
+    PCI_TOPO_NODE *n = &Topo->Node[i];
+    if (n->PcieCap == 0 || n->IsVf) continue;
+
+    UINT32 DevCap = 0;
+    UINT16 DevCtl = 0;
+    PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x04), &DevCap);
+    PciCfgRead16(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x08), &DevCtl);
+
+    Info[i].Mpss = (UINT8)(DevCap & 0x7);
+    Info[i].Mps  = (UINT8)((DevCtl >> 5) & 0x7);
+    Info[i].Mrrs = (UINT8)((DevCtl >> 12) & 0x7);
+  }
+
+  ResolveRoots(Topo, Info);
+
+  // Largest legal MPS per subtree = smallest MPSS of any member
+  SetMem(Best, Count, 0xFF);
+  for (UINTN i = 0; i < Count; i++) {
+    UINT16 r = Info[i].Root;
+    if (r == PCI_NO_NODE || Topo->Node[i].PcieCap == 0 || Topo->Node[i].IsVf) continue;
+    if (Info[i].Mpss < Best[r]) Best[r] = Info[i].Mpss;
+  }
+
+  UINTN Changes = 0;
+
+  for (UINTN r = 0; r < Count; r++) {
+    if (Info[r].Root != (UINT16)r) continue;   // not a root port
+
+    PCI_DEV_INFO  *rp = &Topo->List[r];
+    PCI_TOPO_NODE *rn = &Topo->Node[r];
+
+    ReportAdd(Rep, L"Root Port %02x/%02x/%02x  buses %02x-%02x  legal MPS %u",
+              rp->Bus, rp->Dev, rp->Func, rn->SecBus, rn->SubBus, MpsBytes(Best[r]));
+    ReportAdd(Rep, L"  B/D/F     MPSS  MPS   MRRS  Note");
+
+    for (UINTN i = r; i < Count; i++) {
+      if (Info[i].Root != (UINT16)r || Topo->Node[i].PcieCap == 0 || Topo->Node[i].IsVf) continue;
+
+      PCI_DEV_INFO  *p = &Topo->List[i];
+      PCI_TOPO_NODE *n = &Topo->Node[i];
+      MPS_INFO      *m = &Info[i];
+
+      UINT8 WantMps  = Best[r];
+      UINT8 WantMrrs = (m->Mrrs < WantMps) ? WantMps : m->Mrrs;
+
+      CONST CHAR16 *Note = L"ok";
+      if (n->Parent != PCI_NO_NODE && i != r && m->Mps > Info[n->Parent].Mps) Note = L"ABOVE parent MPS";
+      else if (m->Mps < WantMps)  Note = L"below subtree max";
+      else if (m->Mps > WantMps)  Note = L"above subtree max";
+      else if (m->Mrrs < m->Mps)  Note = L"MRRS < MPS";
+
+      BOOLEAN Need = (m->Mps != WantMps) || (m->Mrrs != WantMrrs);
+
+      if (!Need) {
+        ReportAdd(Rep, L"  %02x/%02x/%02x  %-4u  %-4u  %-4u  %s",
+                  p->Bus, p->Dev, p->Func, MpsBytes(m->Mpss), MpsBytes(m->Mps), MpsBytes(m->Mrrs), Note);
+        continue;
+      }
+
+      Changes++;
+
+      if (!Apply) {
+        ReportAdd(Rep, L"  %02x/%02x/%02x  %-4u  %-4u  %-4u  %s -> MPS %u MRRS %u",
+                  p->Bus, p->Dev, p->Func, MpsBytes(m->Mpss), MpsBytes(m->Mps), MpsBytes(m->Mrrs),
+                  Note, MpsBytes(WantMps), MpsBytes(WantMrrs));
+        continue;
+      }
+
+      UINT32 Rb = 0;
+      UINT32 Val = ((UINT32)WantMps << 5) | ((UINT32)WantMrrs << 12);
+      EFI_STATUS St = PolicyWrite(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x08), DISP_WORD,
+                                  DEVCTL_MPS_MASK | DEVCTL_MRRS_MASK, Val, &Rb);
+      if (!EFI_ERROR(St)) {
+        m->Mps  = WantMps;
+        m->Mrrs = WantMrrs;
+      }
+      ReportAdd(Rep, L"  %02x/%02x/%02x  MPS %u MRRS %u  DevCtl=%04x  %r",
+                p->Bus, p->Dev, p->Func, MpsBytes(WantMps), MpsBytes(WantMrrs), Rb, St);
+    }
+    ReportAdd(Rep, L"");
+  }
+
+  if (Changes == 0) ReportAdd(Rep, L"All subtrees already at their legal MPS.");
+
+  FreePool(Best);
+  FreePool(Info);
+  return Changes;
+}
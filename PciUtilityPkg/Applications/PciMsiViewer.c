@@ -0,0 +1,266 @@
+#include "PciUtility.h"
+
+#define CAP_ID_MSI    0x05
+#define CAP_ID_MSIX   0x11
+
+#define MSIX_ENTRY_SIZE  16
+
+typedef struct {
+  UINT16  Vectors;
+  BOOLEAN Enabled;
+  BOOLEAN FuncMask;
+  UINT8   TableBir;
+  UINT8   PbaBir;
+  UINT32  TableOff;
+  UINT32  PbaOff;
+  UINT64  TableAddr;   // 0 if the BAR is not usable
+  UINT64  PbaAddr;
+} MSIX_INFO;
+
+// -----------------------------
+// BAR memory access
+// -----------------------------
+STATIC
+EFI_STATUS
+ReadMemBarBase(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT8 Bir, OUT UINT64 *Base)
+{
+  *Base = 0;
+  if (Bir > 5) return EFI_UNSUPPORTED;
+
+  UINT32 Lo = 0, Hi = 0;
+  PciCfgRead32(Bus, Dev, Func, (UINT16)(0x10 + Bir * 4), &Lo);
+  if (Lo & BIT0) return EFI_UNSUPPORTED;               // I/O BAR
+
+  if (((Lo >> 1) & 0x3) == 0x2) {                      // 64-bit
+    if (Bir == 5) return EFI_UNSUPPORTED;
+    PciCfgRead32(Bus, Dev, Func, (UINT16)(0x10 + (Bir + 1) * 4), &Hi);
+  }
+
+  *Base = ((UINT64)Hi << 32) | (Lo & ~0xFU);
+  return (*Base != 0) ? EFI_SUCCESS : EFI_NOT_READY;
+}
+
+// Bulk read: one multi-count RBIO Mem.Read per 4 KB page instead of one per DWORD.
+EFI_STATUS
+PciMemReadBulk32(UINT64 Addr, UINTN Count, OUT UINT32 *Buf)
+{
+  if (mRbIo == NULL) return EFI_UNSUPPORTED;   // -image: no hardware behind the BARs
+
+  while (Count > 0) {
+    UINTN InPage = (UINTN)((EFI_PAGE_SIZE - (Addr & (EFI_PAGE_SIZE - 1))) / sizeof(UINT32));
+    UINTN Chunk  = (Count < InPage) ? Count : InPage;
+
+    EFI_STATUS Status = mRbIo->Mem.Read(mRbIo, EfiPciWidthUint32, Addr, Chunk, Buf);
+    if (EFI_ERROR(Status)) return Status;
+
+    Addr  += Chunk * sizeof(UINT32);
+    Buf   += Chunk;
+    Count -= Chunk;
+  }
+  return EFI_SUCCESS;
+}
+
+// -----------------------------
+// Capability decode
+// -----------------------------
+STATIC
+EFI_STATUS
+ReadMsix(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT8 Cap, OUT MSIX_INFO *Info)
+{
+  UINT16 Ctl = 0;
+  UINT32 Tbl = 0, Pba = 0;
+
+  ZeroMem(Info, sizeof(*Info));
+  PciCfgRead16(Bus, Dev, Func, (UINT16)(Cap + 0x02), &Ctl);
+  PciCfgRead32(Bus, Dev, Func, (UINT16)(Cap + 0x04), &Tbl);
+  PciCfgRead32(Bus, Dev, Func, (UINT16)(Cap + 0x08), &Pba);
+
+  Info->Vectors  = (UINT16)((Ctl & 0x7FF) + 1);
+  Info->FuncMask = (Ctl & BIT14) != 0;
+  Info->Enabled  = (Ctl & BIT15) != 0;
+  Info->TableBir = (UINT8)(Tbl & 0x7);
+  Info->TableOff = Tbl & ~0x7U;
+  Info->PbaBir   = (UINT8)(Pba & 0x7);
+  Info->PbaOff   = Pba & ~0x7U;
+
+  // Table lives in BAR memory: needs Memory Space Enable to be decoded
+  UINT16 Cmd = 0;
+  PciCfgRead16(Bus, Dev, Func, 0x04, &Cmd);
+  if ((Cmd & BIT1) == 0) return EFI_NOT_READY;
+
+  UINT64 Base;
+  if (EFI_ERROR(ReadMemBarBase(Bus, Dev, Func, Info->TableBir, &Base))) return EFI_UNSUPPORTED;
+  Info->TableAddr = Base + Info->TableOff;
+
+  if (EFI_ERROR(ReadMemBarBase(Bus, Dev, Func, Info->PbaBir, &Base))) return EFI_UNSUPPORTED;
+  Info->PbaAddr = Base + Info->PbaOff;
+
+  return EFI_SUCCESS;
+}
+
+// Table (16 bytes/vector) and PBA (1 bit/vector) in two bulk reads.
+STATIC
+EFI_STATUS
+ReadMsixTable(MSIX_INFO *Info, OUT UINT32 **Table, OUT UINT32 **Pba)
+{
+  UINTN TblDw = (UINTN)Info->Vectors * (MSIX_ENTRY_SIZE / 4);
+  UINTN PbaDw = (((UINTN)Info->Vectors + 63) / 64) * 2;
+
+  *Table = AllocatePool(TblDw * sizeof(UINT32));
+  *Pba   = AllocatePool(PbaDw * sizeof(UINT32));
+  if (*Table == NULL || *Pba == NULL) goto Fail;
+
+  if (EFI_ERROR(PciMemReadBulk32(Info->TableAddr, TblDw, *Table))) goto Fail;
+  if (EFI_ERROR(PciMemReadBulk32(Info->PbaAddr, PbaDw, *Pba))) goto Fail;
+  return EFI_SUCCESS;
+
+Fail:
+  if (*Table) FreePool(*Table);
+  if (*Pba)   FreePool(*Pba);
+  *Table = *Pba = NULL;
+  return EFI_DEVICE_ERROR;
+}
+
+STATIC
+VOID
+ReportMsi(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT8 Cap, OUT PCI_REPORT *Rep)
+{
+  UINT16 Ctl = 0;
+  PciCfgRead16(Bus, Dev, Func, (UINT16)(Cap + 0x02), &Ctl);
+
+  BOOLEAN Is64    = (Ctl & BIT7) != 0;
+  BOOLEAN PvMask  = (Ctl & BIT8) != 0;
+  UINT32  AddrLo = 0, AddrHi = 0, Mask = 0, Pend = 0;
+  UINT16  Data   = 0;
+  UINT16  DataOff = Is64 ? 0x0C : 0x08;
+
+  PciCfgRead32(Bus, Dev, Func, (UINT16)(Cap + 0x04), &AddrLo);
+  if (Is64) PciCfgRead32(Bus, Dev, Func, (UINT16)(Cap + 0x08), &AddrHi);
+  PciCfgRead16(Bus, Dev, Func, (UINT16)(Cap + DataOff), &Data);
+  if (PvMask) {
+    PciCfgRead32(Bus, Dev, Func, (UINT16)(Cap + DataOff + 0x04), &Mask);
+    PciCfgRead32(Bus, Dev, Func, (UINT16)(Cap + DataOff + 0x08), &Pend);
+  }
+
+  ReportAdd(Rep, L"MSI @%02x  %s  capable:%u  enabled:%u  %s  per-vector mask:%s",
+            Cap, (Ctl & BIT0) ? L"ON" : L"off",
+            1U << ((Ctl >> 1) & 7), 1U << ((Ctl >> 4) & 7),
+            Is64 ? L"64-bit" : L"32-bit", PvMask ? L"yes" : L"no");
+  ReportAdd(Rep, L"  Addr:%08x%08x  Data:%04x  Mask:%08x  Pending:%08x", AddrHi, AddrLo, Data, Mask, Pend);
+}
+
+// -----------------------------
+// Views
+// -----------------------------
+// Per-vector view for one function.
+VOID
+PciMsiDetail(UINT8 Bus, UINT8 Dev, UINT8 Func, OUT PCI_REPORT *Rep)
+{
+  UINT8 Msi  = PciCfgFindCapability(Bus, Dev, Func, CAP_ID_MSI);
+  UINT8 Msix = PciCfgFindCapability(Bus, Dev, Func, CAP_ID_MSIX);
+
+  if (Msi == 0 && Msix == 0) {
+    ReportAdd(Rep, L"No MSI / MSI-X capability.");
+    return;
+  }
+  if (Msi != 0) {
+    ReportMsi(Bus, Dev, Func, Msi, Rep);
+    ReportAdd(Rep, L"");
+  }
+  if (Msix == 0) return;
+
+  MSIX_INFO Info;
+  EFI_STATUS Status = ReadMsix(Bus, Dev, Func, Msix, &Info);
+
+  ReportAdd(Rep, L"MSI-X @%02x  %s  FuncMask:%s  vectors:%u  table BIR%u+%x  PBA BIR%u+%x",
+            Msix, Info.Enabled ? L"ON" : L"off", Info.FuncMask ? L"yes" : L"no", Info.Vectors,
+            Info.TableBir, Info.TableOff, Info.PbaBir, Info.PbaOff);
+
+  if (Status == EFI_NOT_READY) {
+    ReportAdd(Rep, L"  Memory Space Enable is off: table not decoded.");
+    return;
+  }
+  if (EFI_ERROR(Status)) {
+    ReportAdd(Rep, L"  Table BAR not usable: %r", Status);
+    return;
+  }
+
+  UINT32 *Table, *Pba;
+  if (EFI_ERROR(ReadMsixTable(&Info, &Table, &Pba))) {
+    ReportAdd(Rep, L"  Table read failed at %lx", Info.TableAddr);
+    return;
+  }
+
+  ReportAdd(Rep, L"  Vec   Address            Data      Mask  Pend");
+  for (UINTN v = 0; v < Info.Vectors; v++) {
+    UINT32 *e = &Table[v * 4];
+    BOOLEAN Pend = (Pba[v / 32] >> (v % 32)) & 1;
+    ReportAdd(Rep, L"  %-4u  %08x%08x   %08x  %-4s  %s",
+              (UINT32)v, e[1], e[0], e[2], (e[3] & BIT0) ? L"M" : L"-", Pend ? L"P" : L"-");
+  }
+
+  FreePool(Table);
+  FreePool(Pba);
+}
+
+// One line per MSI/MSI-X capable function.
+VOID
+PciMsiSummary(IN PCI_TOPOLOGY *Topo, OUT PCI_REPORT *Rep)
+{
+  UINTN Devs = 0, TotalVec = 0, TotalLive = 0;
+
+  ReportAdd(Rep, L"B/D/F     Type   State  Vectors  Unmasked  Masked  Pending");
+
+  for (UINTN i = 0; i < Topo->Count; i++) {
+    PCI_DEV_INFO *p = &Topo->List[i];
+    UINT8 Msix = PciCfgFindCapability(p->Bus, p->Dev, p->Func, CAP_ID_MSIX);
+
+    if (Msix == 0) {
+      UINT8 Msi = PciCfgFindCapability(p->Bus, p->Dev, p->Func, CAP_ID_MSI);
+      if (Msi == 0) continue;
+
+      UINT16 Ctl = 0;
+      PciCfgRead16(p->Bus, p->Dev, p->Func, (UINT16)(Msi + 0x02), &Ctl);
+      UINT32 En = (Ctl & BIT0) ? (1U << ((Ctl >> 4) & 7)) : 0;
+      ReportAdd(Rep, L"%02x/%02x/%02x  MSI    %-5s  %-7u  %-8u  -       -",
+                p->Bus, p->Dev, p->Func, (Ctl & BIT0) ? L"ON" : L"off", 1U << ((Ctl >> 1) & 7), En);
+      Devs++;
+      TotalVec  += 1U << ((Ctl >> 1) & 7);
+      TotalLive += En;
+      continue;
+    }
+
+    MSIX_INFO Info;
+    UINT32 *Table = NULL, *Pba = NULL;
+    EFI_STATUS Status = ReadMsix(p->Bus, p->Dev, p->Func, Msix, &Info);
+    if (!EFI_ERROR(Status)) Status = ReadMsixTable(&Info, &Table, &Pba);
+
+    Devs++;
+    TotalVec += Info.Vectors;
+
+    if (EFI_ERROR(Status)) {
+      ReportAdd(Rep, L"%02x/%02x/%02x  MSI-X  %-5s  %-7u  (table unreadable: %r)",
+                p->Bus, p->Dev, p->Func, Info.Enabled ? L"ON" : L"off", Info.Vectors, Status);
+      continue;
+    }
+
+    UINT32 Masked = 0, Pending = 0;
+    for (UINTN v = 0; v < Info.Vectors; v++) {
+      if (Table[v * 4 + 3] & BIT0) Masked++;
+      if ((Pba[v / 32] >> (v % 32)) & 1) Pending++;
+    }
+    UINT32 Live = (Info.Enabled && !Info.FuncMask) ? (Info.Vectors - Masked) : 0;
+    TotalLive += Live;
+
+    ReportAdd(Rep, L"%02x/%02x/%02x  MSI-X  %-5s  %-7u  %-8u  %-6u  %u%s",
+              p->Bus, p->Dev, p->Func, Info.Enabled ? L"ON" : L"off", Info.Vectors,
+              Live, Masked, Pending, Info.FuncMask ? L"  (function masked)" : L"");
+
+    FreePool(Table);
+    FreePool(Pba);
+  }
+
+  ReportAdd(Rep, L"");
+  ReportAdd(Rep, L"Functions: %u   Vectors: %u   Live (enabled & unmasked): %u",
+            (UINT32)Devs, (UINT32)TotalVec, (UINT32)TotalLive);
+}
@@ -0,0 +1,492 @@
+#include "PciUtility.h"
+
+//
+// Peer-to-peer routing between two functions, from the topology and ACS.
+//
+// The request from A climbs until it reaches the lowest bridge above both
+// functions:
+//
+// - a switch upstream port: the request turns on the switch's internal
+//   bus, entering at the downstream port above A (ingress) and leaving at
+//   the one above B. ACS at the ingress port decides: P2P Request Redirect
+//   sends it up to the root complex, Egress Control can block that egress
+//   port, otherwise it goes straight across
+// - no common bridge (different root ports / RCiEPs): the root complex
+//   has to route it, which is platform specific
+// - the same device (functions of one multi-function device, PF and its
+//   VFs): stays inside unless the function's own ACS redirects it
+//
+// ACS offsets, capability bits, egress vectors, port numbers, depths and
+// the GPU / NVMe / NIC members are indexed once per session, so the
+// all-pairs matrix is memory only. ACS Control is re-read on every visit.
+//
+#define ACS_CAP_ID          0x000D
+#define ACS_SV              BIT0
+#define ACS_TB              BIT1
+#define ACS_RR              BIT2        // P2P Request Redirect
+#define ACS_CR              BIT3        // P2P Completion Redirect
+#define ACS_UF              BIT4
+#define ACS_EC              BIT5        // P2P Egress Control
+#define ACS_DT              BIT6        // Direct Translated P2P
+#define ACS_EGRESS_DWORDS   8           // vector up to 256 ports
+
+#define P2P_NO_EGRESS       0xFFFF
+#define P2P_MATRIX_COLS     40          // columns per block: 2 chars each on a 100-char line
+
+typedef enum {
+  P2P_OTHER = 0,
+  P2P_GPU,                              // display / processing accelerator
+  P2P_NVME,
+  P2P_NIC
+} P2P_KIND;
+
+typedef enum {
+  ROUTE_SELF = 0,
+  ROUTE_DEVICE,                         // inside one device
+  ROUTE_DEVICE_REDIRECT,                // the function's ACS sends it upstream
+  ROUTE_SWITCH,                         // turns in a switch
+  ROUTE_REDIRECT,                       // ACS RR at the ingress port: up to the root complex
+  ROUTE_EGRESS_BLOCKED,                 // ACS Egress Control at the ingress port
+  ROUTE_ROOT_COMPLEX,                   // no common bridge
+  ROUTE_SHARED_BUS                      // conventional PCI bus below a bridge
+} P2P_ROUTE;
+
+STATIC CONST CHAR16 mRouteMark[] = L".dRSRXC=";   // matrix cell per P2P_ROUTE
+
+typedef struct {
+  UINT16 AcsCap;                        // 0 = no ACS
+  UINT16 AcsBits;                       // ACS Capability [7:0]
+  UINT16 AcsCtl;                        // ACS Control
+  UINT16 EgressBits;                    // egress vector size
+  UINT16 Egress;                        // block in Egress[], P2P_NO_EGRESS
+  UINT16 Up;                            // bridge above (a VF uses its PF's)
+  UINT8  PortNum;                       // Link Capabilities [31:24]
+  UINT8  Depth;                         // bridges above
+  UINT8  Kind;
+} P2P_NODE;
+
+typedef struct {
+  PCI_TOPOLOGY *Topo;
+  P2P_NODE     *Node;
+  UINT32      (*Egress)[ACS_EGRESS_DWORDS];
+  UINT16       *Member;                 // GPU / NVMe / NIC, bus order
+  UINTN         Members;
+  UINTN         AcsCount;
+} P2P_INDEX;
+
+typedef struct {
+  P2P_ROUTE Route;
+  UINT16    Common;                     // lowest common bridge, PCI_NO_NODE
+  UINT16    In;                         // ingress port at the turn
+  UINT16    Out;                        // egress port at the turn
+} P2P_PATH;
+
+STATIC P2P_INDEX mP2p;
+
+// -----------------------------
+// Index
+// -----------------------------
+STATIC
+UINT8
+KindOf(IN PCI_DEV_INFO *p)
+{
+  if (p->BaseClass == 0x03 || p->BaseClass == 0x12) return P2P_GPU;
+  if (p->BaseClass == 0x01 && p->SubClass == 0x08 && p->ProgIf == 0x02) return P2P_NVME;
+  if (p->BaseClass == 0x02) return P2P_NIC;
+  return P2P_OTHER;
+}
+
+STATIC
+VOID
+ReadAcsControl(UINTN i)
+{
+  PCI_DEV_INFO *p = &mP2p.Topo->List[i];
+  P2P_NODE     *x = &mP2p.Node[i];
+
+  PciCfgRead16(p->Bus, p->Dev, p->Func, (UINT16)(x->AcsCap + 6), &x->AcsCtl);
+  if (x->Egress != P2P_NO_EGRESS) {
+    PciCfgReadBulk32(p->Bus, p->Dev, p->Func, (UINT16)(x->AcsCap + 8),
+                     (x->EgressBits + 31) / 32, mP2p.Egress[x->Egress]);
+  }
+}
+
+STATIC
+EFI_STATUS
+BuildIndex(IN PCI_TOPOLOGY *Topo)
+{
+  UINTN Count = Topo->Count, Egress = 0;
+
+  mP2p.Topo   = Topo;
+  mP2p.Node   = AllocateZeroPool(sizeof(P2P_NODE) * (Count ? Count : 1));
+  mP2p.Member = AllocatePool(sizeof(UINT16) * (Count ? Count : 1));
+  if (mP2p.Node == NULL || mP2p.Member == NULL) return EFI_OUT_OF_RESOURCES;
+
+  // Parents precede children (VFs follow their PF): one pass for depth
+  for (UINTN i = 0; i < Count; i++) {
+    PCI_DEV_INFO  *p = &Topo->List[i];
+    PCI_TOPO_NODE *n = &Topo->Node[i];
+    P2P_NODE      *x = &mP2p.Node[i];
+
+    x->Egress = P2P_NO_EGRESS;
+    x->Up     = n->IsVf ? mP2p.Node[n->Parent].Up : n->Parent;
+    x->Depth  = (x->Up == PCI_NO_NODE) ? 0 : (UINT8)(mP2p.Node[x->Up].Depth + 1);
+    x->Kind   = KindOf(p);
+    if (x->Kind != P2P_OTHER) mP2p.Member[mP2p.Members++] = (UINT16)i;
+
+    if (n->PcieCap == 0) continue;
+
+    UINT32 LinkCap = 0;
+    PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x0C), &LinkCap);
+    x->PortNum = (UINT8)(LinkCap >> 24);
+
+    x->AcsCap = PciCfgFindExtCapability(p->Bus, p->Dev, p->Func, ACS_CAP_ID);
+    if (x->AcsCap == 0) continue;
+
+    PciCfgRead16(p->Bus, p->Dev, p->Func, (UINT16)(x->AcsCap + 4), &x->AcsBits);
+    x->EgressBits = (UINT16)(x->AcsBits >> 8);
+    if (x->EgressBits == 0) x->EgressBits = 256;
+    x->AcsBits &= 0xFF;
+    if (x->AcsBits & ACS_EC) Egress++;
+    mP2p.AcsCount++;
+  }
+
+  if (Egress != 0) {
+    mP2p.Egress = AllocateZeroPool(Egress * sizeof(*mP2p.Egress));
+    if (mP2p.Egress == NULL) return EFI_OUT_OF_RESOURCES;
+  }
+
+  UINTN e = 0;
+  for (UINTN i = 0; i < Count; i++) {
+    P2P_NODE *x = &mP2p.Node[i];
+    if (x->AcsCap == 0) continue;
+    if (x->AcsBits & ACS_EC) x->Egress = (UINT16)e++;
+    ReadAcsControl(i);
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+FreeIndex(VOID)
+{
+  if (mP2p.Node != NULL)   FreePool(mP2p.Node);
+  if (mP2p.Member != NULL) FreePool(mP2p.Member);
+  if (mP2p.Egress != NULL) FreePool(mP2p.Egress);
+  ZeroMem(&mP2p, sizeof(mP2p));
+}
+
+// Built on first use; afterwards only ACS Control (and egress vectors)
+// are read again, they are what a user or the OS changes.
+STATIC
+EFI_STATUS
+UseIndex(IN PCI_TOPOLOGY *Topo)
+{
+  if (mP2p.Topo != Topo) {
+    FreeIndex();
+    EFI_STATUS St = BuildIndex(Topo);
+    if (EFI_ERROR(St)) FreeIndex();
+    return St;
+  }
+
+  for (UINTN i = 0; i < Topo->Count; i++) {
+    if (mP2p.Node[i].AcsCap != 0) ReadAcsControl(i);
+  }
+  return EFI_SUCCESS;
+}
+
+// -----------------------------
+// Routing
+// -----------------------------
+// Same device: bus / device of the function, or of the PF for a VF.
+// Below a Root Port or switch downstream port the link carries one
+// device, so the bus alone is the key (with ARI, functions 8 and up have
+// nonzero device bits).
+STATIC
+UINT32
+DeviceKey(UINTN i)
+{
+  PCI_TOPOLOGY *Topo = mP2p.Topo;
+  UINT16        Up   = mP2p.Node[i].Up;
+
+  if (Topo->Node[i].IsVf) i = Topo->Node[i].Parent;
+  if (Up != PCI_NO_NODE && Topo->Node[Up].PcieCap != 0 &&
+      (Topo->Node[Up].PortType == PCIE_PORT_ROOT || Topo->Node[Up].PortType == PCIE_PORT_SWITCH_DOWN)) {
+    return ((UINT32)Topo->List[i].Bus << 8) | 0xFF;
+  }
+  return ((UINT32)Topo->List[i].Bus << 8) | Topo->List[i].Dev;
+}
+
+STATIC
+BOOLEAN
+EgressBlocked(IN P2P_NODE *In, UINT8 PortNum)
+{
+  if (In->Egress == P2P_NO_EGRESS || PortNum >= In->EgressBits) return FALSE;
+  return (mP2p.Egress[In->Egress][PortNum / 32] & (1U << (PortNum % 32))) != 0;
+}
+
+STATIC
+VOID
+Route(UINT16 A, UINT16 B, OUT P2P_PATH *Path)
+{
+  P2P_NODE *N = mP2p.Node;
+
+  Path->Common = PCI_NO_NODE;
+  Path->In     = PCI_NO_NODE;
+  Path->Out    = PCI_NO_NODE;
+
+  if (A == B) {
+    Path->Route = ROUTE_SELF;
+    return;
+  }
+  if (DeviceKey(A) == DeviceKey(B)) {
+    Path->Route = ((N[A].AcsCtl & ACS_RR) != 0) ? ROUTE_DEVICE_REDIRECT : ROUTE_DEVICE;
+    return;
+  }
+
+  // Climb to the same depth, then together; In / Out end up one below the common bridge
+  UINT16 a = N[A].Up, b = N[B].Up, In = A, Out = B;
+  while (a != PCI_NO_NODE && (b == PCI_NO_NODE || N[a].Depth > N[b].Depth)) { In = a;  a = N[a].Up; }
+  while (b != PCI_NO_NODE && (a == PCI_NO_NODE || N[b].Depth > N[a].Depth)) { Out = b; b = N[b].Up; }
+  while (a != b) {
+    In = a;  a = N[a].Up;
+    Out = b; b = N[b].Up;
+  }
+
+  Path->Common = a;
+  Path->In     = In;
+  Path->Out    = Out;
+
+  PCI_TOPO_NODE *c = (a != PCI_NO_NODE) ? &mP2p.Topo->Node[a] : NULL;
+  if (c == NULL) {
+    Path->Route = ROUTE_ROOT_COMPLEX;
+  } else if (c->PcieCap == 0 || c->PortType != PCIE_PORT_SWITCH_UP) {
+    Path->Route = ROUTE_SHARED_BUS;
+  } else if (N[In].AcsCtl & ACS_RR) {
+    Path->Route = ROUTE_REDIRECT;
+  } else if ((N[In].AcsCtl & ACS_EC) && EgressBlocked(&N[In], N[Out].PortNum)) {
+    Path->Route = ROUTE_EGRESS_BLOCKED;
+  } else {
+    Path->Route = ROUTE_SWITCH;
+  }
+}
+
+// -----------------------------
+// Report
+// -----------------------------
+STATIC
+VOID
+AcsText(UINT16 Bits, OUT CHAR16 *Out, UINTN OutSize)
+{
+  STATIC CONST CHAR16 *Name[] = { L"SV", L"TB", L"RR", L"CR", L"UF", L"EC", L"DT" };
+  UINTN Len = 0;
+
+  Out[0] = L'\0';
+  for (UINTN k = 0; k < ARRAY_SIZE(Name); k++) {
+    if (Bits & (1U << k)) Len += UnicodeSPrint(Out + Len, OutSize - Len * sizeof(CHAR16), L"%s ", Name[k]);
+  }
+  if (Len == 0) UnicodeSPrint(Out, OutSize, L"-");
+}
+
+STATIC
+CONST CHAR16 *
+KindName(UINT8 Kind)
+{
+  return (Kind == P2P_GPU) ? L"GPU" : (Kind == P2P_NVME) ? L"NVMe" : (Kind == P2P_NIC) ? L"NIC" : L"";
+}
+
+STATIC
+VOID
+AddHop(CONST CHAR16 *Dir, UINT16 i, OUT PCI_REPORT *Rep)
+{
+  PCI_DEV_INFO *p = &mP2p.Topo->List[i];
+  P2P_NODE     *x = &mP2p.Node[i];
+  CHAR16        Ctl[32], Cap[32];
+
+  if (x->AcsCap == 0) {
+    ReportAdd(Rep, L"  %-5s %02x/%02x/%02x  %-11s  no ACS", Dir, p->Bus, p->Dev, p->Func,
+              PortTypeName(&mP2p.Topo->Node[i]));
+    return;
+  }
+  AcsText(x->AcsCtl, Ctl, sizeof(Ctl));
+  AcsText(x->AcsBits, Cap, sizeof(Cap));
+  ReportAdd(Rep, L"  %-5s %02x/%02x/%02x  %-11s  ACS on: %-21s cap: %s", Dir, p->Bus, p->Dev, p->Func,
+            PortTypeName(&mP2p.Topo->Node[i]), Ctl, Cap);
+}
+
+STATIC
+VOID
+PathReport(UINT16 A, UINT16 B, OUT PCI_REPORT *Rep)
+{
+  P2P_NODE *N = mP2p.Node;
+  P2P_PATH  Path;
+  UINT16    Down[64];
+  UINTN     nDown = 0;
+
+  Route(A, B, &Path);
+
+  AddHop(L"from", A, Rep);
+  if (Path.Route == ROUTE_DEVICE || Path.Route == ROUTE_DEVICE_REDIRECT) {
+    AddHop(L"to", B, Rep);
+  } else {
+    for (UINT16 a = N[A].Up; a != Path.Common; a = N[a].Up) AddHop(L"up", a, Rep);
+    if (Path.Common != PCI_NO_NODE) AddHop(L"turn", Path.Common, Rep);
+    else                            ReportAdd(Rep, L"  turn  root complex");
+    for (UINT16 b = N[B].Up; b != Path.Common && nDown < ARRAY_SIZE(Down); b = N[b].Up) Down[nDown++] = b;
+    while (nDown > 0) AddHop(L"down", Down[--nDown], Rep);
+    AddHop(L"to", B, Rep);
+  }
+
+  ReportAdd(Rep, L"");
+  PCI_DEV_INFO *in = (Path.In != PCI_NO_NODE) ? &mP2p.Topo->List[Path.In] : NULL;
+  switch (Path.Route) {
+    case ROUTE_SELF:
+      ReportAdd(Rep, L"Same function");
+      break;
+    case ROUTE_DEVICE:
+      ReportAdd(Rep, L"DIRECT inside the device (no ACS redirect in the function)");
+      break;
+    case ROUTE_DEVICE_REDIRECT:
+      ReportAdd(Rep, L"REDIRECTED: the function's ACS P2P Request Redirect sends it to the upstream port");
+      break;
+    case ROUTE_SWITCH:
+      ReportAdd(Rep, L"DIRECT: turns in the switch at ingress port %02x/%02x/%02x, never reaches the root complex",
+                in->Bus, in->Dev, in->Func);
+      break;
+    case ROUTE_REDIRECT:
+      ReportAdd(Rep, L"REDIRECTED: ACS RR at %02x/%02x/%02x sends it up to the root complex and back",
+                in->Bus, in->Dev, in->Func);
+      if (N[Path.In].AcsCtl & ACS_DT) ReportAdd(Rep, L"  (DT on: ATS-translated requests still go direct)");
+      break;
+    case ROUTE_EGRESS_BLOCKED:
+      ReportAdd(Rep, L"BLOCKED: ACS Egress Control at %02x/%02x/%02x masks egress port %u",
+                in->Bus, in->Dev, in->Func, N[Path.Out].PortNum);
+      break;
+    case ROUTE_ROOT_COMPLEX:
+      ReportAdd(Rep, L"ROOT COMPLEX: no common switch; P2P between root ports depends on the platform");
+      break;
+    default:
+      ReportAdd(Rep, L"SHARED BUS: both sit on the conventional bus below the common bridge");
+      break;
+  }
+  if (Path.Route == ROUTE_SWITCH && (N[Path.Out].AcsCtl & ACS_CR)) {
+    ReportAdd(Rep, L"  note: ACS CR at the egress port sends the completions back through the root complex");
+  }
+}
+
+// Members down, peers across: cell = route of a request from the row to
+// the column. Blocks of P2P_MATRIX_COLS columns.
+STATIC
+VOID
+MatrixReport(OUT PCI_REPORT *Rep)
+{
+  UINTN  Tally[ARRAY_SIZE(mRouteMark)] = { 0 };
+  CHAR16 Line[REPORT_LINE_LEN];
+
+  ReportAdd(Rep, L"Row -> column.  d: same device  R: redirected (ACS RR)  S: switch, direct");
+  ReportAdd(Rep, L"X: egress blocked  C: via root complex  =: shared PCI bus");
+  ReportAdd(Rep, L"");
+  for (UINTN m = 0; m < mP2p.Members; m++) {
+    PCI_DEV_INFO *p = &mP2p.Topo->List[mP2p.Member[m]];
+    ReportAdd(Rep, L"%3x  %02x/%02x/%02x  %04x:%04x  %s", (UINT32)m, p->Bus, p->Dev, p->Func, p->Vid, p->Did,
+              KindName(mP2p.Node[mP2p.Member[m]].Kind));
+  }
+
+  for (UINTN c0 = 0; c0 < mP2p.Members; c0 += P2P_MATRIX_COLS) {
+    UINTN c1 = MIN(c0 + P2P_MATRIX_COLS, mP2p.Members);
+    UINTN Len;
+
+    ReportAdd(Rep, L"");
+    Len = UnicodeSPrint(Line, sizeof(Line), L"     ");
+    for (UINTN c = c0; c < c1; c++) Len += UnicodeSPrint(Line + Len, sizeof(Line) - Len * sizeof(CHAR16), L"%2x", (UINT32)(c & 0xFF));
+    ReportAdd(Rep, L"%s", Line);
+
+    for (UINTN r = 0; r < mP2p.Members; r++) {
+      Len = UnicodeSPrint(Line, sizeof(Line), L"%3x  ", (UINT32)r);
+      for (UINTN c = c0; c < c1; c++) {
+        P2P_PATH Path;
+        Route(mP2p.Member[r], mP2p.Member[c], &Path);
+        Line[Len++] = L' ';
+        Line[Len++] = mRouteMark[Path.Route];
+        Tally[Path.Route]++;
+      }
+      Line[Len] = L'\0';
+      ReportAdd(Rep, L"%s", Line);
+    }
+  }
+
+  ReportAdd(Rep, L"");
+  ReportAdd(Rep, L"%u pairs: %u switch, %u redirected, %u blocked, %u RC, %u in-device, %u shared bus",
+            (UINT32)(mP2p.Members * (mP2p.Members ? mP2p.Members - 1 : 0)),
+            (UINT32)Tally[ROUTE_SWITCH], (UINT32)(Tally[ROUTE_REDIRECT] + Tally[ROUTE_DEVICE_REDIRECT]),
+            (UINT32)Tally[ROUTE_EGRESS_BLOCKED], (UINT32)Tally[ROUTE_ROOT_COMPLEX], (UINT32)Tally[ROUTE_DEVICE],
+            (UINT32)Tally[ROUTE_SHARED_BUS]);
+}
+
+// -----------------------------
+// Dialog (P in the device list; Sel is the "from" function)
+// -----------------------------
+VOID
+PciP2pDialog(IN PCI_TOPOLOGY *Topo, UINTN Sel)
+{
+  PCI_REPORT Rep;
+  CHAR16     Note[40];
+
+  EFI_STATUS St = UseIndex(Topo);
+  if (EFI_ERROR(St)) {
+    ReportInit(&Rep);
+    ReportAdd(&Rep, L"P2P index failed: %r", St);
+    ReportShow(L"Peer-to-peer / ACS", &Rep);
+    ReportFree(&Rep);
+    return;
+  }
+
+  Note[0] = L'\0';
+  while (TRUE) {
+    PCI_DEV_INFO *s = &Topo->List[Sel];
+
+    ScreenBegin();
+    ScreenLine(L"PEER-TO-PEER / ACS   %u GPU/NVMe/NIC function(s), %u function(s) with ACS",
+               (UINT32)mP2p.Members, (UINT32)mP2p.AcsCount);
+    ScreenLine(L"");
+    ScreenLine(L"Q:Path from %02x/%02x/%02x to ...   M:Matrix (GPU / NVMe / NIC)   Esc:Back", s->Bus, s->Dev, s->Func);
+    if (Note[0] != L'\0') {
+      ScreenLine(L"");
+      ScreenLine(L"%s", Note);
+    }
+    ScreenEnd();
+    Note[0] = L'\0';
+
+    EFI_INPUT_KEY Key;
+    WaitKey(&Key);
+    if (IsEsc(&Key)) return;
+
+    CHAR16 Op = CharToUpper(Key.UnicodeChar);
+
+    if (Op == L'Q') {
+      UINT64 Bdf = 0;
+      ScreenPrompt();
+      Print(L"\nTo Bus/Dev/Func (6 hex, BBDDFF): ");
+      if (EFI_ERROR(ReadFixedHex(6, &Bdf))) continue;
+
+      UINTN t;
+      for (t = 0; t < Topo->Count; t++) {
+        PCI_DEV_INFO *p = &Topo->List[t];
+        if (p->Bus == (UINT8)(Bdf >> 16) && p->Dev == (UINT8)(Bdf >> 8) && p->Func == (UINT8)Bdf) break;
+      }
+      if (t == Topo->Count) {
+        UnicodeSPrint(Note, sizeof(Note), L"%06lx is not in the scan.", Bdf);
+        continue;
+      }
+
+      ReportInit(&Rep);
+      PathReport((UINT16)Sel, (UINT16)t, &Rep);
+      ReportShow(L"Peer-to-peer path (request direction)", &Rep);
+      ReportFree(&Rep);
+    } else if (Op == L'M') {
+      ReportInit(&Rep);
+      MatrixReport(&Rep);
+      ReportShow(L"Peer-to-peer matrix", &Rep);
+      ReportFree(&Rep);
+    }
+  }
+}
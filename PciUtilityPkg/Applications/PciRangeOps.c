@@ -0,0 +1,139 @@
+#include "PciUtility.h"
+
+#define RANGE_MAX_MISMATCH_LINES  16
+
+// -----------------------------
+// Common path: policy -> old values (journal) -> one bulk write -> one bulk read-back -> compare
+// -----------------------------
+// Start / Length are DWORD aligned, within 0x000-0xFFF. Data holds the
+// expected content; with Fill set only Data[0] is written (FillUint32).
+STATIC
+EFI_STATUS
+RangeWrite(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Start, UINTN Length,
+           IN UINT32 *Data, BOOLEAN Fill, OUT PCI_REPORT *Rep)
+{
+  if ((Start & 3) != 0 || (Length & 3) != 0 || Length == 0 || Start + Length > 0x1000) {
+    ReportAdd(Rep, L"Range %03x+%x: start and length must be DWORD aligned, inside 0x000-0xFFF", Start, (UINT32)Length);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  UINT16 Bad = 0;
+  EFI_STATUS St = PolicyCheckRange(Bus, Dev, Func, Start, Length, &Bad);
+  if (EFI_ERROR(St)) {
+    ReportAdd(Rep, L"Blocked at +%03x (RO / RW1C, or BAR/CAP while locked)", Bad);
+    return St;
+  }
+
+  // Mixed bytes (PMCSR) pass the check above: a 1 in one of their RW1C
+  // bits would clear it, and those bits are not compared on read-back
+  UINTN   Count = Length / 4;
+  UINT32  Rw1c[0x400];
+  for (UINTN k = 0; k < Count; k++) {
+    Rw1c[k] = PolicyRw1cLanes(Bus, Dev, Func, (UINT16)(Start + k * 4), DISP_DWORD);
+    if ((Rw1c[k] & (Fill ? Data[0] : Data[k])) != 0) {
+      ReportAdd(Rep, L"Blocked at +%03x: the data sets RW1C bits %08x", (UINT32)(Start + k * 4), Rw1c[k]);
+      return EFI_ACCESS_DENIED;
+    }
+  }
+
+  UINT32 *Rb    = AllocatePool(Length * 2);
+  if (Rb == NULL) {
+    ReportAdd(Rep, L"Out of resources");
+    return EFI_OUT_OF_RESOURCES;
+  }
+  UINT32 *Old = Rb + Count;   // for the write journal
+
+  St = PciCfgReadBulk32(Bus, Dev, Func, Start, Count, Old);
+  if (!EFI_ERROR(St)) {
+    St = Fill ? PciCfgFill32(Bus, Dev, Func, Start, Count, Data[0])
+              : PciCfgWriteBulk32(Bus, Dev, Func, Start, Count, Data);
+    if (!EFI_ERROR(St)) {
+      for (UINTN k = 0; k < Count; k++) {
+        JournalAdd(Bus, Dev, Func, (UINT16)(Start + k * 4), DISP_DWORD, Old[k], Fill ? Data[0] : Data[k], FALSE);
+      }
+    }
+  }
+  if (!EFI_ERROR(St)) St = PciCfgReadBulk32(Bus, Dev, Func, Start, Count, Rb);
+
+  if (EFI_ERROR(St)) {
+    ReportAdd(Rep, L"%02x/%02x/%02x  +%03x..+%03x  %r", Bus, Dev, Func, Start, (UINT32)(Start + Length - 1), St);
+    FreePool(Rb);
+    return St;
+  }
+
+  UINTN Mismatch = 0;
+  for (UINTN k = 0; k < Count; k++) {
+    UINT32 Want = Fill ? Data[0] : Data[k];
+    if (((Rb[k] ^ Want) & ~Rw1c[k]) == 0) continue;
+
+    if (Mismatch < RANGE_MAX_MISMATCH_LINES) {
+      ReportAdd(Rep, L"  +%03x  wrote %08x  read %08x  (differs %08x: RO / masked)",
+                (UINT32)(Start + k * 4), Want, Rb[k], Want ^ Rb[k]);
+    }
+    Mismatch++;
+  }
+
+  ReportAdd(Rep, L"%02x/%02x/%02x  +%03x..+%03x  %u DWORD(s) written, %u read back different",
+            Bus, Dev, Func, Start, (UINT32)(Start + Length - 1), (UINT32)Count, (UINT32)Mismatch);
+
+  FreePool(Rb);
+  return (Mismatch == 0) ? EFI_SUCCESS : EFI_DEVICE_ERROR;
+}
+
+// -----------------------------
+// Operations
+// -----------------------------
+EFI_STATUS
+PciRangeFill(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Start, UINTN Length, UINT32 Value, OUT PCI_REPORT *Rep)
+{
+  ReportAdd(Rep, L"Fill %08x", Value);
+  return RangeWrite(Bus, Dev, Func, Start, Length, &Value, TRUE, Rep);
+}
+
+// Pattern bytes repeat from Start, so a 3-byte pattern still lines up on bytes.
+EFI_STATUS
+PciRangePattern(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Start, UINTN Length,
+                IN CONST UINT8 *Pattern, UINTN PatternLength, OUT PCI_REPORT *Rep)
+{
+  if (PatternLength == 0) return EFI_INVALID_PARAMETER;
+
+  UINT8 *Buf = AllocatePool(Length ? Length : 1);
+  if (Buf == NULL) {
+    ReportAdd(Rep, L"Out of resources");
+    return EFI_OUT_OF_RESOURCES;
+  }
+  for (UINTN k = 0; k < Length; k++) Buf[k] = Pattern[k % PatternLength];
+
+  ReportAdd(Rep, L"Pattern of %u byte(s)", (UINT32)PatternLength);
+  EFI_STATUS St = RangeWrite(Bus, Dev, Func, Start, Length, (UINT32 *)Buf, FALSE, Rep);
+  FreePool(Buf);
+  return St;
+}
+
+// Restores the range from the same B/D/F in a snapshot.
+EFI_STATUS
+PciRangeCopy(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Start, UINTN Length,
+             IN CONST PCI_SNAPSHOT *Snap, OUT PCI_REPORT *Rep)
+{
+  UINTN i;
+  for (i = 0; i < Snap->Count; i++) {
+    PCI_DEV_INFO *p = &Snap->List[i];
+    if (p->Bus == Bus && p->Dev == Dev && p->Func == Func) break;
+  }
+  if (i == Snap->Count) {
+    ReportAdd(Rep, L"%02x/%02x/%02x is not in the snapshot", Bus, Dev, Func);
+    return EFI_NOT_FOUND;
+  }
+
+  UINT8 *Buf = AllocatePool(Length ? Length : 1);
+  if (Buf == NULL) {
+    ReportAdd(Rep, L"Out of resources");
+    return EFI_OUT_OF_RESOURCES;
+  }
+  PciSnapshotCopy(Snap, i, Start, Length, Buf);
+
+  ReportAdd(Rep, L"Copy from snapshot");
+  EFI_STATUS St = RangeWrite(Bus, Dev, Func, Start, Length, (UINT32 *)Buf, FALSE, Rep);
+  FreePool(Buf);
+  return St;
+}
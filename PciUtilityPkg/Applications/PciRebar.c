@@ -0,0 +1,563 @@
+#include "PciUtility.h"
+
+//
+// Resizable BAR (extended capability 0x0015). For every resizable BAR:
+// the sizes the function supports, the size programmed now, and the
+// largest supported size that still fits where the BAR sits:
+//
+// - the BAR keeps its base rounded down to the new size (a BAR is
+//   naturally aligned), so the new range is [Base & ~(Size - 1), +Size)
+// - that range must stay inside the window routing the BAR today at every
+//   upstream bridge (prefetchable or not, whichever holds it now)
+// - no other BAR base, VF BAR base or bridge window on the same bus may
+//   fall inside it (sizes of the neighbours are not probed here; B has
+//   the full map)
+// - a 32-bit BAR cannot go past 4 GB
+//
+// A resize turns memory decode off, writes the new size into the control
+// register, programs the base again (moved if the alignment requires it)
+// and restores decode, all through PolicyWrite (F9 unlock, write journal).
+//
+#define REBAR_CAP_ID       0x0015
+#define REBAR_MAX_BARS     6
+#define REBAR_MIN_SHIFT    20           // size index 0 = 1 MB
+#define REBAR_SIZES        44           // cap bits 31:4 (1 MB-128 TB), control bits 31:16 (256 TB-8 EB)
+#define REBAR_SIZE_MASK    0x00003F00   // control [13:8]
+#define REBAR_WRITES       10           // journaled writes of one resize, worst case
+
+#define CMD_MEM            BIT1
+
+typedef enum {
+  REBAR_FITS = 0,
+  REBAR_UNASSIGNED,
+  REBAR_32BIT,
+  REBAR_ROUTE,                          // the current range is not inside the bridge's windows
+  REBAR_WINDOW,                         // the new range leaves the bridge's window
+  REBAR_CONFLICT                        // the new range covers a neighbour
+} REBAR_WHY;
+
+typedef struct {
+  UINT64  Supported;                    // bit k: 2^(20 + k) bytes
+  UINT64  Base;
+  UINT16  Node;
+  UINT16  Cap;
+  UINT16  Who;                          // bridge / neighbour behind Why
+  UINT8   Entry;                        // control register at Cap + 8 + 8 * Entry
+  UINT8   BarIndex;
+  UINT8   CurIdx;
+  UINT8   FitIdx;                       // largest size that fits, >= CurIdx
+  UINT8   Why;                          // why the next larger size does not fit
+  BOOLEAN Is64;
+  BOOLEAN Pref;
+} REBAR_INFO;
+
+// -----------------------------
+// Capability
+// -----------------------------
+STATIC
+UINT64
+SizeOf(UINTN Idx)
+{
+  return LShiftU64(1, REBAR_MIN_SHIFT + Idx);
+}
+
+STATIC
+UINT16
+CtlReg(IN REBAR_INFO *r)
+{
+  return (UINT16)(r->Cap + 8 + r->Entry * 8);
+}
+
+STATIC
+UINT16
+BarReg(IN REBAR_INFO *r)
+{
+  return (UINT16)(0x10 + r->BarIndex * 4);
+}
+
+STATIC
+UINTN
+EntryCount(IN PCI_DEV_INFO *p, UINT16 Cap)
+{
+  UINT32 Ctl = 0;
+  PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(Cap + 8), &Ctl);
+  return MIN((UINTN)((Ctl >> 5) & 0x7), (UINTN)REBAR_MAX_BARS);
+}
+
+STATIC
+VOID
+ReadEntry(IN PCI_DEV_INFO *p, OUT REBAR_INFO *r)
+{
+  UINT32 CapReg = 0, Ctl = 0, Lo = 0, Hi = 0;
+
+  PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(r->Cap + 4 + r->Entry * 8), &CapReg);
+  PciCfgRead32(p->Bus, p->Dev, p->Func, CtlReg(r), &Ctl);
+
+  r->Supported = ((CapReg >> 4) & 0x0FFFFFFF) | LShiftU64(Ctl >> 16, 28);
+  r->BarIndex  = (UINT8)(Ctl & 0x7);
+  r->CurIdx    = (UINT8)((Ctl >> 8) & 0x3F);
+
+  PciCfgRead32(p->Bus, p->Dev, p->Func, BarReg(r), &Lo);
+  r->Is64 = ((Lo & 0x6) == 0x4) && r->BarIndex < 5;
+  r->Pref = (Lo & BIT3) != 0;
+  if (r->Is64) PciCfgRead32(p->Bus, p->Dev, p->Func, (UINT16)(BarReg(r) + 4), &Hi);
+  r->Base = LShiftU64(Hi, 32) | (Lo & ~0xFU);
+}
+
+// -----------------------------
+// Fit check
+// -----------------------------
+// TRUE when a memory BAR base among Reg[0..Count) lies in [Lo, Hi];
+// Skip is the register index of the BAR being resized (or Count).
+STATIC
+BOOLEAN
+BarBaseIn(IN UINT32 *Reg, UINTN Count, UINTN Skip, UINT64 Lo, UINT64 Hi)
+{
+  for (UINTN b = 0; b < Count; b++) {
+    if (Reg[b] & BIT0) continue;                  // I/O
+
+    BOOLEAN Is64 = ((Reg[b] & 0x6) == 0x4) && b + 1 < Count;
+    UINT64  Base = Reg[b] & ~0xFULL;
+    if (Is64) Base |= LShiftU64(Reg[b + 1], 32);
+
+    if (b != Skip && Base != 0 && Base >= Lo && Base <= Hi) return TRUE;
+    if (Is64) b++;
+  }
+  return FALSE;
+}
+
+// A function on the BAR's bus that decodes something starting in [Lo, Hi],
+// or PCI_NO_NODE.
+STATIC
+UINT16
+Neighbour(IN PCI_TOPOLOGY *Topo, IN REBAR_INFO *r, UINT64 Lo, UINT64 Hi)
+{
+  UINT16 Parent = Topo->Node[r->Node].Parent;
+  UINT16 s      = (Parent == PCI_NO_NODE) ? Topo->FirstRoot : Topo->Node[Parent].FirstChild;
+
+  for (; s != PCI_NO_NODE; s = Topo->Node[s].NextSibling) {
+    PCI_DEV_INFO  *p = &Topo->List[s];
+    PCI_TOPO_NODE *n = &Topo->Node[s];
+    UINTN          Bars = (n->HdrType == 0x00) ? 6 : (n->HdrType == 0x01) ? 2 : 0;
+    UINT32         Reg[6];
+    UINT64         WBase, WLimit;
+
+    if (Bars != 0) {
+      PciCfgReadBulk32(p->Bus, p->Dev, p->Func, 0x10, Bars, Reg);
+      if (BarBaseIn(Reg, Bars, (s == r->Node) ? r->BarIndex : Bars, Lo, Hi)) return s;
+    }
+    if (n->SriovCap != 0) {
+      PciCfgReadBulk32(p->Bus, p->Dev, p->Func, (UINT16)(n->SriovCap + 0x24), 6, Reg);
+      if (BarBaseIn(Reg, 6, 6, Lo, Hi)) return s;
+    }
+    if (n->HdrType == 0x01) {
+      for (UINTN w = 0; w < 2; w++) {
+        if (PciResMapWindow(p, w == 1, &WBase, &WLimit) && WBase <= Hi && WLimit >= Lo) return s;
+      }
+    }
+  }
+  return PCI_NO_NODE;
+}
+
+// Can the BAR be Size index Idx at its current base? *Who is the bridge or
+// neighbour that stops it.
+STATIC
+REBAR_WHY
+Fit(IN PCI_TOPOLOGY *Topo, IN REBAR_INFO *r, UINTN Idx, OUT UINT16 *Who)
+{
+  UINT64 Size  = SizeOf(Idx);
+  UINT64 Lo    = r->Base & ~(Size - 1);
+  UINT64 Hi    = Lo + Size - 1;
+  UINT64 CurHi = r->Base + SizeOf(r->CurIdx) - 1;
+
+  *Who = PCI_NO_NODE;
+  if (r->Base == 0) return REBAR_UNASSIGNED;
+  if (!r->Is64 && Hi > MAX_UINT32) return REBAR_32BIT;
+
+  for (UINT16 a = Topo->Node[r->Node].Parent; a != PCI_NO_NODE; a = Topo->Node[a].Parent) {
+    if (Topo->Node[a].HdrType != 0x01) break;
+
+    UINT64  WBase = 0, WLimit = 0;
+    BOOLEAN Open  = r->Pref && PciResMapWindow(&Topo->List[a], TRUE, &WBase, &WLimit) &&
+                    r->Base >= WBase && CurHi <= WLimit;
+    if (!Open) {
+      Open = PciResMapWindow(&Topo->List[a], FALSE, &WBase, &WLimit) && r->Base >= WBase && CurHi <= WLimit;
+    }
+
+    *Who = a;
+    if (!Open) return REBAR_ROUTE;
+    if (Lo < WBase || Hi > WLimit) return REBAR_WINDOW;
+  }
+
+  *Who = Neighbour(Topo, r, Lo, Hi);
+  return (*Who == PCI_NO_NODE) ? REBAR_FITS : REBAR_CONFLICT;
+}
+
+// Largest supported size that fits (never below the current one, which
+// is in use already), and why the next one up does not.
+STATIC
+VOID
+FindFit(IN PCI_TOPOLOGY *Topo, IN OUT REBAR_INFO *r)
+{
+  r->FitIdx = r->CurIdx;
+  r->Why    = REBAR_FITS;
+  r->Who    = PCI_NO_NODE;
+
+  for (UINTN k = r->CurIdx + 1; k < REBAR_SIZES; k++) {
+    if ((r->Supported & LShiftU64(1, k)) == 0) continue;
+
+    UINT16    Who;
+    REBAR_WHY Why = Fit(Topo, r, k, &Who);
+    if (Why != REBAR_FITS) {
+      r->Why = (UINT8)Why;
+      r->Who = Who;
+      break;   // a larger size only covers more
+    }
+    r->FitIdx = (UINT8)k;
+  }
+}
+
+STATIC
+UINTN
+Collect(IN PCI_TOPOLOGY *Topo, OUT REBAR_INFO **Out)
+{
+  UINTN Total = 0, n = 0;
+
+  *Out = NULL;
+  for (UINTN i = 0; i < Topo->Count; i++) {
+    if (Topo->Node[i].IsVf) continue;
+    PCI_DEV_INFO *p   = &Topo->List[i];
+    UINT16        Cap = PciCfgFindExtCapability(p->Bus, p->Dev, p->Func, REBAR_CAP_ID);
+    if (Cap != 0) Total += EntryCount(p, Cap);
+  }
+  if (Total == 0) return 0;
+
+  REBAR_INFO *Info = AllocateZeroPool(Total * sizeof(REBAR_INFO));
+  if (Info == NULL) return 0;
+
+  for (UINTN i = 0; i < Topo->Count && n < Total; i++) {
+    if (Topo->Node[i].IsVf) continue;
+    PCI_DEV_INFO *p   = &Topo->List[i];
+    UINT16        Cap = PciCfgFindExtCapability(p->Bus, p->Dev, p->Func, REBAR_CAP_ID);
+    if (Cap == 0) continue;
+
+    UINTN Entries = EntryCount(p, Cap);
+    for (UINTN k = 0; k < Entries && n < Total; k++, n++) {
+      Info[n].Node  = (UINT16)i;
+      Info[n].Cap   = Cap;
+      Info[n].Entry = (UINT8)k;
+      ReadEntry(p, &Info[n]);
+      FindFit(Topo, &Info[n]);
+    }
+  }
+
+  *Out = Info;
+  return n;
+}
+
+// -----------------------------
+// Report
+// -----------------------------
+STATIC
+VOID
+WhyText(IN PCI_TOPOLOGY *Topo, IN REBAR_INFO *r, OUT CHAR16 *Out, UINTN OutSize)
+{
+  PCI_DEV_INFO *w = (r->Who != PCI_NO_NODE) ? &Topo->List[r->Who] : NULL;
+
+  switch (r->Why) {
+    case REBAR_UNASSIGNED: UnicodeSPrint(Out, OutSize, L"unassigned"); break;
+    case REBAR_32BIT:      UnicodeSPrint(Out, OutSize, L"next: 32-bit BAR"); break;
+    case REBAR_ROUTE:      UnicodeSPrint(Out, OutSize, L"not routed by %02x/%02x/%02x", w->Bus, w->Dev, w->Func); break;
+    case REBAR_WINDOW:     UnicodeSPrint(Out, OutSize, L"next: window of %02x/%02x/%02x", w->Bus, w->Dev, w->Func); break;
+    case REBAR_CONFLICT:   UnicodeSPrint(Out, OutSize, L"next: covers %02x/%02x/%02x", w->Bus, w->Dev, w->Func); break;
+    default:               Out[0] = L'\0'; break;
+  }
+}
+
+STATIC
+VOID
+AddInfoLine(IN PCI_TOPOLOGY *Topo, IN REBAR_INFO *r, UINTN Num, OUT PCI_REPORT *Rep)
+{
+  PCI_DEV_INFO *p = &Topo->List[r->Node];
+  CHAR16        Cur[16], Max[16], Fits[16], Why[40];
+  UINTN         Top = 0;
+
+  for (UINTN k = 0; k < REBAR_SIZES; k++) {
+    if (r->Supported & LShiftU64(1, k)) Top = k;
+  }
+  ReportSizeText(SizeOf(r->CurIdx), Cur, sizeof(Cur));
+  ReportSizeText(SizeOf(Top), Max, sizeof(Max));
+  ReportSizeText(SizeOf(r->FitIdx), Fits, sizeof(Fits));
+  WhyText(Topo, r, Why, sizeof(Why));
+
+  ReportAdd(Rep, L"%2x %02x/%02x/%02x %04x:%04x BAR%u %s%s  now %-5s max %-5s fits %-5s %s",
+            (UINT32)Num, p->Bus, p->Dev, p->Func, p->Vid, p->Did, r->BarIndex,
+            r->Is64 ? L"64" : L"32", r->Pref ? L"P" : L" ", Cur, Max, Fits, Why);
+}
+
+STATIC
+VOID
+AddSizes(IN REBAR_INFO *r, OUT PCI_REPORT *Rep)
+{
+  CHAR16 Line[REPORT_LINE_LEN], Size[16];
+  UINTN  Len = UnicodeSPrint(Line, sizeof(Line), L"   sizes:");
+
+  for (UINTN k = 0; k < REBAR_SIZES; k++) {
+    if ((r->Supported & LShiftU64(1, k)) == 0) continue;
+    if (Len + 12 >= REPORT_LINE_LEN) {
+      ReportAdd(Rep, L"%s", Line);
+      Len = UnicodeSPrint(Line, sizeof(Line), L"         ");
+    }
+    ReportSizeText(SizeOf(k), Size, sizeof(Size));
+    Len += UnicodeSPrint(Line + Len, sizeof(Line) - Len * sizeof(CHAR16), L" %02x:%s%s",
+                         (UINT32)k, Size, (k == r->CurIdx) ? L"*" : L"");
+  }
+  ReportAdd(Rep, L"%s", Line);
+}
+
+// -----------------------------
+// Resize
+// -----------------------------
+// Both DWORDs of a 64-bit BAR, through PolicyWrite
+STATIC
+EFI_STATUS
+WriteBase(IN PCI_DEV_INFO *p, IN REBAR_INFO *r, UINT64 Base)
+{
+  EFI_STATUS St = PolicyWrite(p->Bus, p->Dev, p->Func, BarReg(r), DISP_DWORD, 0xFFFFFFF0, (UINT32)Base, NULL);
+  if (!EFI_ERROR(St) && r->Is64) {
+    St = PolicyWrite(p->Bus, p->Dev, p->Func, (UINT16)(BarReg(r) + 4), DISP_DWORD, 0xFFFFFFFF,
+                     (UINT32)RShiftU64(Base, 32), NULL);
+  }
+  return St;
+}
+
+// The BAR is undefined once the size field is written, so it is always
+// programmed again after the size, before decode comes back. It is also
+// written before the size: the journal then holds the old base after the
+// old size, and a rollback (newest first) restores a defined BAR.
+//
+// The lock is checked before the Command register is touched, and the
+// window with memory decode off runs at TPL_HIGH_LEVEL so no timer
+// callback reaches the device meanwhile (as the B map size probe); the
+// journal room is reserved first because pool services are not allowed
+// there.
+STATIC
+EFI_STATUS
+Resize(IN PCI_TOPOLOGY *Topo, IN OUT REBAR_INFO *r, UINT8 Idx, OUT PCI_REPORT *Rep)
+{
+  PCI_DEV_INFO *p = &Topo->List[r->Node];
+  CHAR16        From[16], To[16], Why[40];
+  UINT16        Cmd = 0;
+  EFI_STATUS    St;
+
+  ReportSizeText(SizeOf(r->CurIdx), From, sizeof(From));
+  ReportSizeText(SizeOf(Idx), To, sizeof(To));
+
+  if (Idx == r->CurIdx) return EFI_SUCCESS;
+  if (Idx >= REBAR_SIZES || (r->Supported & LShiftU64(1, Idx)) == 0) {
+    ReportAdd(Rep, L"%02x/%02x/%02x BAR%u: %s is not a supported size", p->Bus, p->Dev, p->Func, r->BarIndex, To);
+    return EFI_UNSUPPORTED;
+  }
+
+  REBAR_WHY Fits = Fit(Topo, r, Idx, &r->Who);
+  if (Fits != REBAR_FITS) {
+    r->Why = (UINT8)Fits;
+    WhyText(Topo, r, Why, sizeof(Why));
+    ReportAdd(Rep, L"%02x/%02x/%02x BAR%u %s -> %s: does not fit (%s)", p->Bus, p->Dev, p->Func,
+              r->BarIndex, From, To, Why);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (!DangerousWritesUnlocked()) {
+    ReportAdd(Rep, L"%02x/%02x/%02x BAR%u %s -> %s: blocked, F9 to unlock", p->Bus, p->Dev, p->Func,
+              r->BarIndex, From, To);
+    return EFI_ACCESS_DENIED;
+  }
+  if (EFI_ERROR(JournalReserve(REBAR_WRITES))) {
+    ReportAdd(Rep, L"%02x/%02x/%02x BAR%u: out of resources", p->Bus, p->Dev, p->Func, r->BarIndex);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  UINT64  NewBase = r->Base & ~(SizeOf(Idx) - 1);
+  EFI_TPL OldTpl  = gBS->RaiseTPL(TPL_HIGH_LEVEL);
+
+  PciCfgRead16(p->Bus, p->Dev, p->Func, 0x04, &Cmd);
+  EFI_STATUS Decode = PolicyWrite(p->Bus, p->Dev, p->Func, 0x04, DISP_WORD, CMD_MEM, 0, NULL);
+  St = Decode;
+  if (!EFI_ERROR(St)) {
+    St = WriteBase(p, r, NewBase);
+    if (!EFI_ERROR(St)) {
+      St = PolicyWrite(p->Bus, p->Dev, p->Func, CtlReg(r), DISP_DWORD, REBAR_SIZE_MASK, (UINT32)Idx << 8, NULL);
+    }
+    if (!EFI_ERROR(St)) St = WriteBase(p, r, NewBase);
+
+    if (EFI_ERROR(St)) {
+      // Old size first (it frees the low base bits), then the old base
+      PolicyWrite(p->Bus, p->Dev, p->Func, CtlReg(r), DISP_DWORD, REBAR_SIZE_MASK, (UINT32)r->CurIdx << 8, NULL);
+      WriteBase(p, r, r->Base);
+    }
+
+    PolicyWrite(p->Bus, p->Dev, p->Func, 0x04, DISP_WORD, CMD_MEM, Cmd & CMD_MEM, NULL);
+  }
+
+  gBS->RestoreTPL(OldTpl);
+
+  if (EFI_ERROR(Decode)) {
+    ReportAdd(Rep, L"%02x/%02x/%02x BAR%u: memory decode off: %r", p->Bus, p->Dev, p->Func, r->BarIndex, Decode);
+    return Decode;
+  }
+  PciResMapInvalidate();                // cached BAR sizes in the B map are stale
+
+  if (EFI_ERROR(St)) {
+    ReportAdd(Rep, L"%02x/%02x/%02x BAR%u %s -> %s failed: %r (old size written back)",
+              p->Bus, p->Dev, p->Func, r->BarIndex, From, To, St);
+    return St;
+  }
+
+  ReadEntry(p, r);
+  ReportAdd(Rep, L"%02x/%02x/%02x BAR%u %s -> %s at %016lx%s", p->Bus, p->Dev, p->Func, r->BarIndex,
+            From, To, r->Base, (r->CurIdx == Idx) ? L"" : L"  (size did not read back)");
+  return (r->CurIdx == Idx) ? EFI_SUCCESS : EFI_DEVICE_ERROR;
+}
+
+// -----------------------------
+// Dialog (R in the device list)
+// -----------------------------
+STATIC
+VOID
+ShowList(IN PCI_TOPOLOGY *Topo, IN REBAR_INFO *Info, UINTN Count)
+{
+  PCI_REPORT Rep;
+  ReportInit(&Rep);
+  ReportAdd(&Rep, L"fits: largest supported size at the current base, inside every upstream window,");
+  ReportAdd(&Rep, L"      not covering another BAR / window on the bus.  P = prefetchable");
+  ReportAdd(&Rep, L"");
+  for (UINTN k = 0; k < Count; k++) {
+    AddInfoLine(Topo, &Info[k], k, &Rep);
+    AddSizes(&Info[k], &Rep);
+  }
+  ReportShow(L"Resizable BAR", &Rep);
+  ReportFree(&Rep);
+}
+
+STATIC
+VOID
+ResizeOne(IN PCI_TOPOLOGY *Topo, IN REBAR_INFO *Info, UINTN Count)
+{
+  UINT64     Num = 0, Idx = 0;
+  PCI_REPORT Rep;
+
+  ScreenPrompt();
+  Print(L"\nEntry (2 hex): ");
+  if (EFI_ERROR(ReadFixedHex(2, &Num)) || Num >= Count) return;
+
+  REBAR_INFO *r = &Info[(UINTN)Num];
+
+  ReportInit(&Rep);
+  AddInfoLine(Topo, r, (UINTN)Num, &Rep);
+  AddSizes(r, &Rep);
+  ScreenBegin();
+  ScreenLine(L"RESIZABLE BAR  resize one   Dangerous Writes: %s", DangerousWritesUnlocked() ? L"UNLOCKED" : L"LOCKED");
+  ScreenLine(L"");
+  for (UINTN k = 0; k < Rep.Count; k++) ScreenLine(L"%s", Rep.Line[k]);
+  ScreenLine(L"");
+  ScreenLine(L"Device memory behind the BAR is not preserved; drivers must re-map it.");
+  ScreenEnd();
+  ReportFree(&Rep);
+
+  ScreenPrompt();
+  Print(L"\nSize index (2 hex, FF = largest that fits): ");
+  if (EFI_ERROR(ReadFixedHex(2, &Idx))) return;
+  if (Idx == 0xFF) Idx = r->FitIdx;
+
+  Print(L"\n");
+  if (!ConfirmKey(L"Resize?")) return;
+
+  ReportInit(&Rep);
+  Resize(Topo, r, (UINT8)Idx, &Rep);
+  ReportShow(L"Resizable BAR: resize", &Rep);
+  ReportFree(&Rep);
+}
+
+// Every matching BAR to the largest size that fits. Entries run in list
+// order and each fit is checked again right before its resize, so an
+// earlier resize on the same bus is taken into account.
+STATIC
+VOID
+ResizeAll(IN PCI_TOPOLOGY *Topo, IN REBAR_INFO *Info, UINTN Count)
+{
+  UINT64     Id = 0;
+  UINTN      Match = 0;
+  PCI_REPORT Rep;
+
+  ScreenPrompt();
+  Print(L"\nVendor:Device (8 hex, FFFF = any): ");
+  if (EFI_ERROR(ReadFixedHex(8, &Id))) return;
+
+  UINT16 Vid = (UINT16)(Id >> 16), Did = (UINT16)Id;
+  for (UINTN k = 0; k < Count; k++) {
+    PCI_DEV_INFO *p = &Topo->List[Info[k].Node];
+    if ((Vid == 0xFFFF || p->Vid == Vid) && (Did == 0xFFFF || p->Did == Did) && Info[k].FitIdx > Info[k].CurIdx) {
+      Match++;
+    }
+  }
+
+  if (Match == 0) {
+    ReportInit(&Rep);
+    ReportAdd(&Rep, L"No BAR of %04x:%04x can grow.", Vid, Did);
+    ReportShow(L"Resizable BAR: batch resize", &Rep);
+    ReportFree(&Rep);
+    return;
+  }
+
+  ScreenBegin();
+  ScreenLine(L"RESIZABLE BAR  resize all matching %04x:%04x", Vid, Did);
+  ScreenLine(L"");
+  ScreenLine(L"%u BAR(s) can grow.  Dangerous Writes: %s", (UINT32)Match,
+             DangerousWritesUnlocked() ? L"UNLOCKED" : L"LOCKED - writes will be blocked, F9 to unlock");
+  ScreenEnd();
+  ScreenPrompt();
+  if (!ConfirmKey(L"Resize all of them to the largest size that fits?")) return;
+
+  ReportInit(&Rep);
+  UINTN Done = 0;
+  for (UINTN k = 0; k < Count; k++) {
+    PCI_DEV_INFO *p = &Topo->List[Info[k].Node];
+    if ((Vid != 0xFFFF && p->Vid != Vid) || (Did != 0xFFFF && p->Did != Did)) continue;
+
+    FindFit(Topo, &Info[k]);
+    if (Info[k].FitIdx <= Info[k].CurIdx) continue;
+    if (!EFI_ERROR(Resize(Topo, &Info[k], Info[k].FitIdx, &Rep))) Done++;
+  }
+  ReportAdd(&Rep, L"%u of %u BAR(s) resized", (UINT32)Done, (UINT32)Match);
+  ReportShow(L"Resizable BAR: batch resize", &Rep);
+  ReportFree(&Rep);
+}
+
+VOID
+PciRebarDialog(IN PCI_TOPOLOGY *Topo)
+{
+  while (TRUE) {
+    REBAR_INFO *Info  = NULL;
+    UINTN       Count = Collect(Topo, &Info);
+
+    ScreenBegin();
+    ScreenLine(L"RESIZABLE BAR  %u resizable BAR(s)   Dangerous Writes: %s",
+               (UINT32)Count, DangerousWritesUnlocked() ? L"UNLOCKED" : L"LOCKED");
+    ScreenLine(L"");
+    ScreenLine(L"L:List   R:Resize one   A:Resize all matching (Vendor:Device)   Esc:Back");
+    ScreenEnd();
+
+    EFI_INPUT_KEY Key;
+    WaitKey(&Key);
+    CHAR16 Op = CharToUpper(Key.UnicodeChar);
+
+    if (Count != 0) {
+      if (Op == L'L')      ShowList(Topo, Info, Count);
+      else if (Op == L'R') ResizeOne(Topo, Info, Count);
+      else if (Op == L'A') ResizeAll(Topo, Info, Count);
+    }
+    if (Info != NULL) FreePool(Info);
+    if (IsEsc(&Key)) return;
+  }
+}
@@ -0,0 +1,109 @@
+#include "PciUtility.h"
+
+#define REPORT_GROW      64
+#define REPORT_PAGE_SIZE 20
+
+// -----------------------------
+// Line buffer
+// -----------------------------
+VOID
+ReportInit(OUT PCI_REPORT *Rep)
+{
+  Rep->Line = NULL;
+  Rep->Count = 0;
+  Rep->Capacity = 0;
+}
+
+VOID
+ReportFree(IN OUT PCI_REPORT *Rep)
+{
+  if (Rep->Line != NULL) FreePool(Rep->Line);
+  ReportInit(Rep);
+}
+
+VOID
+EFIAPI
+ReportAdd(IN OUT PCI_REPORT *Rep, IN CONST CHAR16 *Fmt, ...)
+{
+  if (Rep->Count == Rep->Capacity) {
+    UINTN NewCap = Rep->Capacity + REPORT_GROW;
+    VOID *New = ReallocatePool(Rep->Capacity * sizeof(*Rep->Line), NewCap * sizeof(*Rep->Line), Rep->Line);
+    if (New == NULL) return; // out of pool: drop the line, keep what we have
+    Rep->Line = New;
+    Rep->Capacity = NewCap;
+  }
+
+  VA_LIST Args;
+  VA_START(Args, Fmt);
+  UnicodeVSPrint(Rep->Line[Rep->Count], sizeof(Rep->Line[0]), Fmt, Args);
+  VA_END(Args);
+  Rep->Count++;
+}
+
+// Byte count in the largest unit that divides it: 4K, 256M, 8G, 24.
+VOID
+ReportSizeText(UINT64 Size, OUT CHAR16 *Out, UINTN OutSize)
+{
+  if (Size >= SIZE_1GB && (Size & (SIZE_1GB - 1)) == 0) UnicodeSPrint(Out, OutSize, L"%luG", RShiftU64(Size, 30));
+  else if (Size >= SIZE_1MB && (Size & (SIZE_1MB - 1)) == 0) UnicodeSPrint(Out, OutSize, L"%luM", RShiftU64(Size, 20));
+  else if (Size >= SIZE_1KB && (Size & (SIZE_1KB - 1)) == 0) UnicodeSPrint(Out, OutSize, L"%luK", RShiftU64(Size, 10));
+  else UnicodeSPrint(Out, OutSize, L"%lu", Size);
+}
+
+// -----------------------------
+// Output
+// -----------------------------
+VOID
+ReportPrint(IN PCI_REPORT *Rep)
+{
+  for (UINTN i = 0; i < Rep->Count; i++) {
+    Print(L"%s\n", Rep->Line[i]);
+  }
+}
+
+// Scrollable view (diff-painted in headless mode). Returns when Esc is pressed.
+VOID
+ReportShow(IN CONST CHAR16 *Title, IN PCI_REPORT *Rep)
+{
+  UINTN Top = 0;
+
+  while (TRUE) {
+    ScreenBegin();
+    ScreenLine(L"%s", Title);
+    ScreenLine(L"------------------------------------------------------------");
+
+    UINTN End = Top + REPORT_PAGE_SIZE;
+    if (End > Rep->Count) End = Rep->Count;
+    for (UINTN i = Top; i < End; i++) {
+      ScreenLine(L"%s", Rep->Line[i]);
+    }
+    if (Rep->Count == 0) ScreenLine(L"(empty)");
+
+    ScreenLine(L"");
+    ScreenLine(L"Up/Down:Scroll  F1:PgDn  F2:PgUp  Esc:Back   [%u-%u/%u]",
+               (UINT32)(Rep->Count ? Top + 1 : 0), (UINT32)End, (UINT32)Rep->Count);
+    ScreenEnd();
+
+    EFI_INPUT_KEY Key;
+    WaitKey(&Key);
+
+    if (IsEsc(&Key)) return;
+
+    switch (Key.ScanCode) {
+      case SCAN_UP:
+        if (Top > 0) Top--;
+        break;
+      case SCAN_DOWN:
+        if (Top + REPORT_PAGE_SIZE < Rep->Count) Top++;
+        break;
+      case SCAN_F1:
+        if (Top + REPORT_PAGE_SIZE < Rep->Count) Top += REPORT_PAGE_SIZE;
+        break;
+      case SCAN_F2:
+        Top = (Top > REPORT_PAGE_SIZE) ? Top - REPORT_PAGE_SIZE : 0;
+        break;
+      default:
+        break;
+    }
+  }
+}
@@ -0,0 +1,724 @@
+#include "PciUtility.h"
+
+//
+// System resource map: every BAR, expansion ROM and bridge I/O / memory /
+// prefetchable window as one interval.
+//
+// - BAR sizes are probed once per session (decode off, all ones, restore,
+//   each function at TPL_HIGH_LEVEL) and cached; later builds only read
+//   the base registers. The probe writes every function, so it needs the
+//   F9 unlock and a confirmation; without it BARs are listed by base only
+//   (one-byte intervals marked "size ?").
+// - Entries are sorted by (space, base, largest first) with a running
+//   maximum of the limits, so "what decodes this address" is one binary
+//   search plus a walk back over the intervals that can still reach it.
+// - Overlaps: entries behind the same bridge (same Group) decode side by
+//   side and must be disjoint; one sweep per group, comparing each entry
+//   with the earlier entry that reaches furthest.
+// - Placement: each BAR / window must sit inside the matching window of
+//   its parent bridge; a prefetchable range that is only routed by the
+//   parent's non-prefetchable window is flagged separately.
+//
+#define RES_REGS           7        // BAR0-5, ROM
+#define RES_ROM_REG        6
+#define RES_MAX_DEPTH      8
+
+#define CMD_IO             BIT0
+#define CMD_MEM            BIT1
+
+typedef enum {
+  RES_IO = 0,
+  RES_MEM,
+  RES_PMEM,
+  RES_SPACES
+} RES_SPACE;
+
+typedef enum {
+  RES_BAR = 0,
+  RES_ROM,
+  RES_WIN
+} RES_KIND;
+
+#define RES_F_64           BIT0
+#define RES_F_OFF          BIT1     // decode disabled in Command
+#define RES_F_UNASSIGNED   BIT2     // sized, base 0
+#define RES_F_NOSIZE       BIT3     // not probed: Limit = Base
+
+#define RES_I_OVERLAP      BIT0
+#define RES_I_OUTSIDE      BIT1
+#define RES_I_NONPREF      BIT2     // prefetchable range routed by a non-prefetchable window
+
+typedef struct {
+  UINT64 Base;
+  UINT64 Limit;                     // inclusive
+  UINT16 Node;
+  UINT16 Group;                     // parent bridge: entries decoded side by side
+  UINT16 OtherNode;                 // overlap partner
+  UINT8  OtherReg;
+  UINT8  Reg;                       // config offset of the BAR / window base
+  UINT8  Kind;
+  UINT8  Space;
+  UINT8  Flags;
+  UINT8  Issue;
+} RES_ENTRY;
+
+typedef struct {
+  UINT64 Base[RES_SPACES];
+  UINT64 Limit[RES_SPACES];         // Base > Limit: window closed
+} RES_WINDOWS;
+
+typedef struct {
+  PCI_TOPOLOGY *Topo;
+  RES_ENTRY    *Entry;
+  UINT64       *Reach;              // Reach[k] = max Limit of Entry[First..k] in the same class
+  UINTN         Count;
+  UINTN         Capacity;
+  UINTN         Issues[3];          // overlap, outside, non-prefetchable
+} RES_MAP;
+
+// Size masks, probed once: mMask[Node * RES_REGS + r]
+STATIC UINT32 *mMask      = NULL;
+STATIC UINTN   mMaskCount = 0;
+
+STATIC CONST CHAR16 *mSpaceName[RES_SPACES] = { L"IO", L"MEM", L"PMEM" };
+
+// I/O and memory are separate address spaces; MEM and PMEM are one.
+#define RES_CLASS(Space)   ((Space) == RES_IO ? 0 : 1)
+
+// -----------------------------
+// Probe
+// -----------------------------
+STATIC
+UINT8
+BarReg(UINT8 HdrType, UINTN r)
+{
+  if (r == RES_ROM_REG) return (HdrType == 0x01) ? 0x38 : 0x30;
+  return (UINT8)(0x10 + r * 4);
+}
+
+STATIC
+UINTN
+BarCount(UINT8 HdrType)
+{
+  return (HdrType == 0x00) ? 6 : (HdrType == 0x01) ? 2 : 0;
+}
+
+// All ones into every BAR with decode off, then restore. VFs have no BARs
+// of their own (the PF's SR-IOV capability holds them). Runs at
+// TPL_HIGH_LEVEL: while a bridge has decode off, the GOP framebuffer, USB
+// and storage behind it must not be touched by timer callbacks.
+STATIC
+VOID
+ProbeFunction(IN PCI_TOPOLOGY *Topo, UINTN i, OUT UINT32 *Mask)
+{
+  PCI_DEV_INFO  *p = &Topo->List[i];
+  PCI_TOPO_NODE *n = &Topo->Node[i];
+  UINTN          Bars = BarCount(n->HdrType);
+  UINT16         Cmd  = 0;
+
+  if (n->IsVf || Bars == 0) return;
+
+  EFI_TPL OldTpl = gBS->RaiseTPL(TPL_HIGH_LEVEL);
+
+  PciCfgRead16(p->Bus, p->Dev, p->Func, 0x04, &Cmd);
+  if (Cmd & (CMD_IO | CMD_MEM)) PciCfgWrite16(p->Bus, p->Dev, p->Func, 0x04, (UINT16)(Cmd & ~(CMD_IO | CMD_MEM)));
+
+  for (UINTN r = 0; r < Bars; r++) {
+    UINT8  Reg = BarReg(n->HdrType, r);
+    UINT32 Old = 0;
+    PciCfgRead32(p->Bus, p->Dev, p->Func, Reg, &Old);
+    PciCfgWrite32(p->Bus, p->Dev, p->Func, Reg, 0xFFFFFFFF);
+    PciCfgRead32(p->Bus, p->Dev, p->Func, Reg, &Mask[r]);
+    PciCfgWrite32(p->Bus, p->Dev, p->Func, Reg, Old);
+
+    if ((Old & BIT0) == 0 && (Old & 0x6) == 0x4 && r + 1 < Bars) {
+      r++;                                      // upper half of a 64-bit BAR
+      Reg = BarReg(n->HdrType, r);
+      PciCfgRead32(p->Bus, p->Dev, p->Func, Reg, &Old);
+      PciCfgWrite32(p->Bus, p->Dev, p->Func, Reg, 0xFFFFFFFF);
+      PciCfgRead32(p->Bus, p->Dev, p->Func, Reg, &Mask[r]);
+      PciCfgWrite32(p->Bus, p->Dev, p->Func, Reg, Old);
+    }
+  }
+
+  UINT8  Rom = BarReg(n->HdrType, RES_ROM_REG);
+  UINT32 Old = 0;
+  PciCfgRead32(p->Bus, p->Dev, p->Func, Rom, &Old);
+  PciCfgWrite32(p->Bus, p->Dev, p->Func, Rom, 0xFFFFF800);
+  PciCfgRead32(p->Bus, p->Dev, p->Func, Rom, &Mask[RES_ROM_REG]);
+  PciCfgWrite32(p->Bus, p->Dev, p->Func, Rom, Old);
+
+  if (Cmd & (CMD_IO | CMD_MEM)) PciCfgWrite16(p->Bus, p->Dev, p->Func, 0x04, Cmd);
+
+  gBS->RestoreTPL(OldTpl);
+}
+
+STATIC
+BOOLEAN
+Probed(IN PCI_TOPOLOGY *Topo)
+{
+  return mMask != NULL && mMaskCount == Topo->Count;
+}
+
+STATIC
+EFI_STATUS
+ProbeAll(IN PCI_TOPOLOGY *Topo)
+{
+  if (Probed(Topo)) return EFI_SUCCESS;
+  if (mMask != NULL) FreePool(mMask);
+
+  mMask = AllocateZeroPool(sizeof(UINT32) * RES_REGS * (Topo->Count ? Topo->Count : 1));
+  mMaskCount = 0;
+  if (mMask == NULL) return EFI_OUT_OF_RESOURCES;
+
+  for (UINTN i = 0; i < Topo->Count; i++) ProbeFunction(Topo, i, &mMask[i * RES_REGS]);
+  mMaskCount = Topo->Count;
+  return EFI_SUCCESS;
+}
+
+// Drops the probed sizes (a ReBAR resize changed one); the next map
+// probes again, behind the same unlock and confirmation.
+VOID
+PciResMapInvalidate(VOID)
+{
+  if (mMask != NULL) FreePool(mMask);
+  mMask      = NULL;
+  mMaskCount = 0;
+}
+
+// -----------------------------
+// Build
+// -----------------------------
+STATIC
+RES_ENTRY *
+AddEntry(IN OUT RES_MAP *Map, UINTN Node, UINT8 Kind, UINT8 Space, UINT8 Reg, UINT64 Base, UINT64 Limit)
+{
+  if (Map->Count == Map->Capacity) {
+    UINTN NewCap = Map->Capacity + 256;
+    VOID *New = ReallocatePool(Map->Capacity * sizeof(RES_ENTRY), NewCap * sizeof(RES_ENTRY), Map->Entry);
+    if (New == NULL) return NULL;
+    Map->Entry    = New;
+    Map->Capacity = NewCap;
+  }
+
+  RES_ENTRY *e = &Map->Entry[Map->Count++];
+  ZeroMem(e, sizeof(*e));
+  e->Node      = (UINT16)Node;
+  e->Group     = Map->Topo->Node[Node].Parent;
+  e->OtherNode = PCI_NO_NODE;
+  e->Kind      = Kind;
+  e->Space     = Space;
+  e->Reg       = Reg;
+  e->Base      = Base;
+  e->Limit     = Limit;
+  return e;
+}
+
+// Without probed sizes (Mask NULL) a BAR is listed at its base only, and
+// a zero register is taken as not implemented.
+STATIC
+VOID
+AddBars(IN OUT RES_MAP *Map, UINTN i, UINT16 Cmd)
+{
+  PCI_DEV_INFO  *p    = &Map->Topo->List[i];
+  PCI_TOPO_NODE *n    = &Map->Topo->Node[i];
+  UINT32        *Mask = Probed(Map->Topo) ? &mMask[i * RES_REGS] : NULL;
+  UINTN          Bars = BarCount(n->HdrType);
+  UINT32         Reg[6];
+
+  if (n->IsVf || Bars == 0) return;
+  PciCfgReadBulk32(p->Bus, p->Dev, p->Func, 0x10, Bars, Reg);
+
+  for (UINTN r = 0; r < Bars; r++) {
+    UINT32     Lo = Reg[r];
+    RES_ENTRY *e;
+
+    if (Lo & BIT0) {
+      UINT32 m = (Mask != NULL) ? (Mask[r] & ~0x3U) : 0xFFFFFFFF;
+      if (m == 0 || (Mask == NULL && (Lo & ~0x3U) == 0)) continue;
+      if ((m & 0xFFFF0000) == 0) m |= 0xFFFF0000;  // 16-bit I/O decode
+      e = AddEntry(Map, i, RES_BAR, RES_IO, BarReg(n->HdrType, r), Lo & ~0x3U, (Lo & ~0x3U) + (~m));
+      if (e == NULL) return;
+      if (Mask == NULL) e->Flags |= RES_F_NOSIZE;
+      if ((Cmd & CMD_IO) == 0) e->Flags |= RES_F_OFF;
+      if ((Lo & ~0x3U) == 0) e->Flags |= RES_F_UNASSIGNED;
+      continue;
+    }
+
+    BOOLEAN Is64  = ((Lo & 0x6) == 0x4) && r + 1 < Bars;
+    UINT64  Base  = Lo & ~0xFULL;
+    if (Is64) Base |= LShiftU64(Reg[r + 1], 32);
+
+    if (Mask == NULL) {
+      if (Base != 0) {
+        e = AddEntry(Map, i, RES_BAR, (Lo & BIT3) ? RES_PMEM : RES_MEM, BarReg(n->HdrType, r), Base, Base);
+        if (e == NULL) return;
+        e->Flags |= RES_F_NOSIZE | (Is64 ? RES_F_64 : 0);
+        if ((Cmd & CMD_MEM) == 0) e->Flags |= RES_F_OFF;
+      }
+      if (Is64) r++;
+      continue;
+    }
+
+    UINT64  MaskV = LShiftU64(Is64 ? Mask[r + 1] : 0xFFFFFFFF, 32) | (Mask[r] & ~0xFU);
+
+    // A 64-bit BAR of 4 GB or more has no size bits in the low half
+    if (Is64 ? (MaskV != 0) : ((Mask[r] & ~0xFU) != 0)) {
+      e = AddEntry(Map, i, RES_BAR, (Lo & BIT3) ? RES_PMEM : RES_MEM, BarReg(n->HdrType, r), Base, Base + ~MaskV);
+      if (e == NULL) return;
+      if (Is64) e->Flags |= RES_F_64;
+      if ((Cmd & CMD_MEM) == 0) e->Flags |= RES_F_OFF;
+      if (Base == 0) e->Flags |= RES_F_UNASSIGNED;
+    }
+    if (Is64) r++;
+  }
+
+  // Expansion ROM: listed only while its own enable bit is set
+  UINT32 Rom = 0, m = (Mask != NULL) ? (Mask[RES_ROM_REG] & 0xFFFFF800) : 0xFFFFFFFF;
+  PciCfgRead32(p->Bus, p->Dev, p->Func, BarReg(n->HdrType, RES_ROM_REG), &Rom);
+  if (m != 0 && (Rom & BIT0) && (Mask != NULL || (Rom & 0xFFFFF800) != 0)) {
+    RES_ENTRY *e = AddEntry(Map, i, RES_ROM, RES_MEM, BarReg(n->HdrType, RES_ROM_REG),
+                            Rom & 0xFFFFF800, (Rom & 0xFFFFF800) + (UINT32)~m);
+    if (e != NULL && Mask == NULL) e->Flags |= RES_F_NOSIZE;
+    if (e != NULL && (Cmd & CMD_MEM) == 0) e->Flags |= RES_F_OFF;
+  }
+}
+
+// Type 1 forwarding windows; closed windows (base > limit) are not listed.
+STATIC
+VOID
+ReadWindows(IN PCI_DEV_INFO *p, OUT RES_WINDOWS *W)
+{
+  UINT32 Cfg[0x10];      // 0x00-0x3F
+
+  PciCfgReadBulk32(p->Bus, p->Dev, p->Func, 0, ARRAY_SIZE(Cfg), Cfg);
+
+  UINT8  IoBase  = (UINT8)(Cfg[7]);
+  UINT8  IoLimit = (UINT8)(Cfg[7] >> 8);
+  UINT64 IoUpper = ((IoBase & 0xF) == 1) ? LShiftU64(Cfg[12] & 0xFFFF, 16) : 0;
+  UINT64 IoUpLim = ((IoBase & 0xF) == 1) ? LShiftU64(Cfg[12] >> 16, 16) : 0;
+  W->Base[RES_IO]  = IoUpper | ((UINT64)(IoBase & 0xF0) << 8);
+  W->Limit[RES_IO] = IoUpLim | ((UINT64)(IoLimit & 0xF0) << 8) | 0xFFF;
+
+  W->Base[RES_MEM]  = (UINT64)(Cfg[8] & 0xFFF0) << 16;
+  W->Limit[RES_MEM] = ((UINT64)((Cfg[8] >> 16) & 0xFFF0) << 16) | 0xFFFFF;
+
+  UINT16 PBase  = (UINT16)Cfg[9];
+  UINT16 PLimit = (UINT16)(Cfg[9] >> 16);
+  W->Base[RES_PMEM]  = ((UINT64)(PBase & 0xFFF0) << 16);
+  W->Limit[RES_PMEM] = ((UINT64)(PLimit & 0xFFF0) << 16) | 0xFFFFF;
+  if ((PBase & 0xF) == 1) {
+    W->Base[RES_PMEM]  |= LShiftU64(Cfg[10], 32);
+    W->Limit[RES_PMEM] |= LShiftU64(Cfg[11], 32);
+  }
+}
+
+// Memory window of a type 1 function (Pref: the prefetchable one), for
+// callers outside the map. FALSE when that window is closed.
+BOOLEAN
+PciResMapWindow(IN PCI_DEV_INFO *p, BOOLEAN Pref, OUT UINT64 *Base, OUT UINT64 *Limit)
+{
+  RES_WINDOWS W;
+  UINTN       s = Pref ? RES_PMEM : RES_MEM;
+
+  ReadWindows(p, &W);
+  *Base  = W.Base[s];
+  *Limit = W.Limit[s];
+  return W.Base[s] <= W.Limit[s];
+}
+
+STATIC
+VOID
+AddWindows(IN OUT RES_MAP *Map, UINTN i, UINT16 Cmd, OUT RES_WINDOWS *W)
+{
+  STATIC CONST UINT8 WinReg[RES_SPACES] = { 0x1C, 0x20, 0x24 };
+
+  ReadWindows(&Map->Topo->List[i], W);
+
+  for (UINTN s = 0; s < RES_SPACES; s++) {
+    if (W->Base[s] > W->Limit[s]) continue;
+    RES_ENTRY *e = AddEntry(Map, i, RES_WIN, (UINT8)s, WinReg[s], W->Base[s], W->Limit[s]);
+    if (e == NULL) return;
+    if (s == RES_PMEM && W->Limit[s] > MAX_UINT32) e->Flags |= RES_F_64;
+    if ((Cmd & ((s == RES_IO) ? CMD_IO : CMD_MEM)) == 0) e->Flags |= RES_F_OFF;
+  }
+}
+
+STATIC
+BOOLEAN
+Inside(IN RES_WINDOWS *W, UINTN Space, UINT64 Base, UINT64 Limit)
+{
+  return W->Base[Space] <= W->Limit[Space] && Base >= W->Base[Space] && Limit <= W->Limit[Space];
+}
+
+// Every live entry against its parent bridge's windows.
+STATIC
+VOID
+CheckPlacement(IN OUT RES_MAP *Map, IN RES_WINDOWS *Win)
+{
+  for (UINTN k = 0; k < Map->Count; k++) {
+    RES_ENTRY *e = &Map->Entry[k];
+    if (e->Flags & (RES_F_OFF | RES_F_UNASSIGNED)) continue;
+    if (e->Group == PCI_NO_NODE) continue;                              // root bus
+    if (Map->Topo->Node[e->Group].HdrType != 0x01) continue;            // PF of a VF
+
+    RES_WINDOWS *W = &Win[e->Group];
+    if (Inside(W, e->Space, e->Base, e->Limit)) continue;
+
+    if (e->Space == RES_PMEM && Inside(W, RES_MEM, e->Base, e->Limit)) {
+      e->Issue |= RES_I_NONPREF;
+      Map->Issues[2]++;
+    } else if (e->Space == RES_MEM && Inside(W, RES_PMEM, e->Base, e->Limit)) {
+      e->Issue |= RES_I_OUTSIDE;   // non-prefetchable BAR behind a prefetchable window
+      Map->Issues[1]++;
+    } else {
+      e->Issue |= RES_I_OUTSIDE;
+      Map->Issues[1]++;
+    }
+  }
+}
+
+STATIC
+INTN
+EFIAPI
+CompareGroup(IN CONST VOID *A, IN CONST VOID *B)
+{
+  CONST RES_ENTRY *a = (CONST RES_ENTRY *)A;
+  CONST RES_ENTRY *b = (CONST RES_ENTRY *)B;
+
+  if (RES_CLASS(a->Space) != RES_CLASS(b->Space)) return RES_CLASS(a->Space) - RES_CLASS(b->Space);
+  if (a->Group != b->Group) return (a->Group < b->Group) ? -1 : 1;
+  if (a->Base != b->Base) return (a->Base < b->Base) ? -1 : 1;
+  return 0;
+}
+
+// Map order: class, base, then the larger interval first (outer windows above inner ones).
+STATIC
+INTN
+EFIAPI
+CompareBase(IN CONST VOID *A, IN CONST VOID *B)
+{
+  CONST RES_ENTRY *a = (CONST RES_ENTRY *)A;
+  CONST RES_ENTRY *b = (CONST RES_ENTRY *)B;
+
+  if (RES_CLASS(a->Space) != RES_CLASS(b->Space)) return RES_CLASS(a->Space) - RES_CLASS(b->Space);
+  if (a->Base != b->Base) return (a->Base < b->Base) ? -1 : 1;
+  if (a->Limit != b->Limit) return (a->Limit > b->Limit) ? -1 : 1;
+  return (a->Kind == RES_WIN) ? -1 : (b->Kind == RES_WIN) ? 1 : 0;
+}
+
+STATIC
+BOOLEAN
+Live(IN RES_ENTRY *e)
+{
+  return (e->Flags & (RES_F_OFF | RES_F_UNASSIGNED)) == 0;
+}
+
+// Map->Entry in CompareGroup order.
+STATIC
+VOID
+CheckOverlap(IN OUT RES_MAP *Map)
+{
+  RES_ENTRY *Far = NULL;     // entry reaching furthest in the current group
+
+  for (UINTN k = 0; k < Map->Count; k++) {
+    RES_ENTRY *e = &Map->Entry[k];
+    if (!Live(e)) continue;
+
+    if (Far != NULL && (RES_CLASS(Far->Space) != RES_CLASS(e->Space) || Far->Group != e->Group)) Far = NULL;
+
+    if (Far != NULL && e->Base <= Far->Limit) {
+      if (!(e->Issue & RES_I_OVERLAP)) Map->Issues[0]++;
+      if (!(Far->Issue & RES_I_OVERLAP)) Map->Issues[0]++;
+      e->Issue   |= RES_I_OVERLAP;
+      Far->Issue |= RES_I_OVERLAP;
+      e->OtherNode = Far->Node; e->OtherReg = Far->Reg;
+      if (Far->OtherNode == PCI_NO_NODE) { Far->OtherNode = e->Node; Far->OtherReg = e->Reg; }
+    }
+    if (Far == NULL || e->Limit > Far->Limit) Far = e;
+  }
+}
+
+STATIC
+VOID
+ResMapFree(IN OUT RES_MAP *Map)
+{
+  if (Map->Entry != NULL) FreePool(Map->Entry);
+  if (Map->Reach != NULL) FreePool(Map->Reach);
+  ZeroMem(Map, sizeof(*Map));
+}
+
+STATIC
+EFI_STATUS
+ResMapBuild(IN PCI_TOPOLOGY *Topo, OUT RES_MAP *Map)
+{
+  RES_WINDOWS *Win;
+
+  ZeroMem(Map, sizeof(*Map));
+  Map->Topo = Topo;
+
+  Win = AllocatePool(sizeof(RES_WINDOWS) * (Topo->Count ? Topo->Count : 1));
+  if (Win == NULL) return EFI_OUT_OF_RESOURCES;
+
+  for (UINTN i = 0; i < Topo->Count; i++) {
+    PCI_DEV_INFO *p   = &Topo->List[i];
+    UINT16        Cmd = 0;
+
+    PciCfgRead16(p->Bus, p->Dev, p->Func, 0x04, &Cmd);
+    AddBars(Map, i, Cmd);
+    if (Topo->Node[i].HdrType == 0x01) AddWindows(Map, i, Cmd, &Win[i]);
+  }
+
+  CheckPlacement(Map, Win);
+  FreePool(Win);
+
+  RES_ENTRY Tmp;
+  QuickSort(Map->Entry, Map->Count, sizeof(RES_ENTRY), CompareGroup, &Tmp);
+  CheckOverlap(Map);
+  QuickSort(Map->Entry, Map->Count, sizeof(RES_ENTRY), CompareBase, &Tmp);
+
+  // Running maximum of Limit over live entries, restarted per class
+  Map->Reach = AllocatePool(sizeof(UINT64) * (Map->Count ? Map->Count : 1));
+  if (Map->Reach == NULL) {
+    ResMapFree(Map);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  for (UINTN k = 0; k < Map->Count; k++) {
+    RES_ENTRY *e    = &Map->Entry[k];
+    BOOLEAN    New  = (k == 0) || RES_CLASS(Map->Entry[k - 1].Space) != RES_CLASS(e->Space);
+    UINT64     Prev = New ? 0 : Map->Reach[k - 1];
+    Map->Reach[k] = Live(e) ? MAX(Prev, e->Limit) : Prev;
+  }
+  return EFI_SUCCESS;
+}
+
+// -----------------------------
+// Lookup
+// -----------------------------
+// Live entries containing Addr, outermost first. Returns the count found.
+STATIC
+UINTN
+ResMapLookup(IN RES_MAP *Map, BOOLEAN Io, UINT64 Addr, OUT UINTN *Hit, UINTN Max)
+{
+  UINTN Class = Io ? 0 : 1;
+  UINTN Lo = 0, Hi = Map->Count, n = 0;
+
+  // Last entry with (class, Base) <= (Class, Addr)
+  while (Lo < Hi) {
+    UINTN      Mid = (Lo + Hi) / 2;
+    RES_ENTRY *e   = &Map->Entry[Mid];
+    if (RES_CLASS(e->Space) < Class || (RES_CLASS(e->Space) == Class && e->Base <= Addr)) Lo = Mid + 1;
+    else Hi = Mid;
+  }
+
+  for (UINTN k = Lo; k-- > 0 && n < Max; ) {
+    RES_ENTRY *e = &Map->Entry[k];
+    if (RES_CLASS(e->Space) != Class || Map->Reach[k] < Addr) break;
+    if (Live(e) && e->Limit >= Addr) Hit[n++] = k;
+  }
+
+  // Found innermost first
+  for (UINTN a = 0, b = n; a + 1 < b; a++, b--) {
+    UINTN t = Hit[a]; Hit[a] = Hit[b - 1]; Hit[b - 1] = t;
+  }
+  return n;
+}
+
+// -----------------------------
+// Report
+// -----------------------------
+STATIC
+UINTN
+NodeDepth(IN PCI_TOPOLOGY *Topo, UINT16 i)
+{
+  UINTN d = 0;
+  for (UINT16 a = Topo->Node[i].Parent; a != PCI_NO_NODE && d < RES_MAX_DEPTH; a = Topo->Node[a].Parent) d++;
+  return d;
+}
+
+STATIC
+VOID
+EntryName(IN RES_ENTRY *e, OUT CHAR16 *Out, UINTN OutSize)
+{
+  if (e->Kind == RES_WIN) UnicodeSPrint(Out, OutSize, L"%s window", mSpaceName[e->Space]);
+  else if (e->Kind == RES_ROM) UnicodeSPrint(Out, OutSize, L"ROM");
+  else UnicodeSPrint(Out, OutSize, L"BAR%u %s%s", (UINT32)((e->Reg - 0x10) / 4),
+                     (e->Space == RES_IO) ? L"io" : (e->Flags & RES_F_64) ? L"m64" : L"m32",
+                     (e->Space == RES_PMEM) ? L"p" : L"");
+}
+
+STATIC
+VOID
+AddEntryLine(IN RES_MAP *Map, IN RES_ENTRY *e, BOOLEAN Indent, OUT PCI_REPORT *Rep)
+{
+  PCI_DEV_INFO *p = &Map->Topo->List[e->Node];
+  CHAR16        Size[16], Name[24], Note[40];
+  CHAR16        Pad[RES_MAX_DEPTH + 1];
+  UINTN         Depth = Indent ? NodeDepth(Map->Topo, e->Node) : 0;
+
+  SetMem16(Pad, Depth * sizeof(CHAR16), L' ');
+  Pad[Depth] = L'\0';
+  if (e->Flags & RES_F_NOSIZE) StrCpyS(Size, ARRAY_SIZE(Size), L"?");
+  else                         ReportSizeText(e->Limit - e->Base + 1, Size, sizeof(Size));
+  EntryName(e, Name, sizeof(Name));
+
+  Note[0] = L'\0';
+  if (e->Flags & RES_F_OFF)        StrCatS(Note, ARRAY_SIZE(Note), L" off");
+  if (e->Flags & RES_F_UNASSIGNED) StrCatS(Note, ARRAY_SIZE(Note), L" unassigned");
+  if (e->Issue & RES_I_OVERLAP)    StrCatS(Note, ARRAY_SIZE(Note), L" !OVERLAP");
+  if (e->Issue & RES_I_OUTSIDE)    StrCatS(Note, ARRAY_SIZE(Note), L" !OUTSIDE");
+  if (e->Issue & RES_I_NONPREF)    StrCatS(Note, ARRAY_SIZE(Note), L" !NON-PREF");
+
+  ReportAdd(Rep, L"%016lx-%016lx %5s %s%02x:%02x.%x %s%s",
+            e->Base, e->Limit, Size, Pad, p->Bus, p->Dev, p->Func, Name, Note);
+}
+
+STATIC
+VOID
+AddSummary(IN RES_MAP *Map, OUT PCI_REPORT *Rep)
+{
+  ReportAdd(Rep, L"Ranges: %u  overlapping: %u  outside parent window: %u  pref via non-pref window: %u",
+            (UINT32)Map->Count, (UINT32)Map->Issues[0], (UINT32)Map->Issues[1], (UINT32)Map->Issues[2]);
+}
+
+// Every range in address order, windows above what they contain.
+STATIC
+VOID
+ResMapReport(IN RES_MAP *Map, OUT PCI_REPORT *Rep)
+{
+  AddSummary(Map, Rep);
+  for (UINTN k = 0; k < Map->Count; k++) {
+    if (k == 0 || RES_CLASS(Map->Entry[k - 1].Space) != RES_CLASS(Map->Entry[k].Space)) {
+      ReportAdd(Rep, L"");
+      ReportAdd(Rep, RES_CLASS(Map->Entry[k].Space) == 0 ? L"-- I/O space --" : L"-- Memory space --");
+    }
+    AddEntryLine(Map, &Map->Entry[k], TRUE, Rep);
+  }
+}
+
+STATIC
+VOID
+ResMapProblems(IN RES_MAP *Map, OUT PCI_REPORT *Rep)
+{
+  AddSummary(Map, Rep);
+  ReportAdd(Rep, L"");
+
+  for (UINTN k = 0; k < Map->Count; k++) {
+    RES_ENTRY *e = &Map->Entry[k];
+    if (e->Issue == 0) continue;
+
+    AddEntryLine(Map, e, FALSE, Rep);
+    if ((e->Issue & RES_I_OVERLAP) && e->OtherNode != PCI_NO_NODE) {
+      PCI_DEV_INFO *o = &Map->Topo->List[e->OtherNode];
+      ReportAdd(Rep, L"    overlaps %02x:%02x.%x register %02x", o->Bus, o->Dev, o->Func, e->OtherReg);
+    }
+    if (e->Issue & RES_I_OUTSIDE) {
+      ReportAdd(Rep, L"    not inside the matching window of the parent bridge: unreachable or claimed elsewhere");
+    }
+    if (e->Issue & RES_I_NONPREF) {
+      ReportAdd(Rep, L"    prefetchable, but only the parent's non-prefetchable window routes it");
+    }
+  }
+  if (Map->Issues[0] + Map->Issues[1] + Map->Issues[2] == 0) ReportAdd(Rep, L"No problems found.");
+}
+
+STATIC
+VOID
+ResMapAddress(IN RES_MAP *Map, BOOLEAN Io, UINT64 Addr, OUT PCI_REPORT *Rep)
+{
+  UINTN Hit[RES_MAX_DEPTH * 2];
+  UINTN n = ResMapLookup(Map, Io, Addr, Hit, ARRAY_SIZE(Hit));
+
+  ReportAdd(Rep, L"%s address %016lx", Io ? L"I/O" : L"Memory", Addr);
+  ReportAdd(Rep, L"");
+  if (n == 0) {
+    ReportAdd(Rep, L"No BAR or bridge window decodes it (system memory, root bridge aperture or unused).");
+    return;
+  }
+
+  for (UINTN k = 0; k < n; k++) AddEntryLine(Map, &Map->Entry[Hit[k]], FALSE, Rep);
+
+  RES_ENTRY    *Last = &Map->Entry[Hit[n - 1]];
+  PCI_DEV_INFO *p    = &Map->Topo->List[Last->Node];
+  CHAR16        Name[24];
+  EntryName(Last, Name, sizeof(Name));
+  ReportAdd(Rep, L"");
+  ReportAdd(Rep, L"Decoded by %02x:%02x.%x %s at offset %lx%s", p->Bus, p->Dev, p->Func, Name, Addr - Last->Base,
+            (Last->Kind == RES_WIN) ? L" (no BAR behind the window claims it)" : L"");
+}
+
+// -----------------------------
+// Dialog
+// -----------------------------
+VOID
+PciResMapDialog(IN PCI_TOPOLOGY *Topo)
+{
+  RES_MAP    Map;
+  PCI_REPORT Rep;
+  CHAR16     Note[80];
+
+  Note[0] = L'\0';
+  if (!Probed(Topo)) {
+    if (!DangerousWritesUnlocked()) {
+      UnicodeSPrint(Note, sizeof(Note), L"BAR sizes are probed with decode off: F9 to unlock, then B again.");
+    } else {
+      ScreenBegin();
+      ScreenLine(L"RESOURCE MAP");
+      ScreenLine(L"");
+      ScreenLine(L"BAR sizes are not probed yet; without them only BAR bases are shown.");
+      ScreenEnd();
+      ScreenPrompt();
+      if (ConfirmKey(L"Probe BAR sizes (decode off and all ones on every function, then restored)?")) {
+        EFI_STATUS Pr = ProbeAll(Topo);
+        if (EFI_ERROR(Pr)) UnicodeSPrint(Note, sizeof(Note), L"BAR probe failed: %r, showing BAR bases only", Pr);
+      }
+    }
+  }
+
+  EFI_STATUS St = ResMapBuild(Topo, &Map);
+  if (EFI_ERROR(St)) {
+    ReportInit(&Rep);
+    ReportAdd(&Rep, L"Resource map failed: %r", St);
+    ReportShow(L"Resource map", &Rep);
+    ReportFree(&Rep);
+    return;
+  }
+
+  while (TRUE) {
+    ScreenBegin();
+    ScreenLine(L"RESOURCE MAP  %u ranges%s", (UINT32)Map.Count, Probed(Topo) ? L"" : L"  (BAR sizes not probed)");
+    ScreenLine(L"");
+    ScreenLine(L"M:Sorted map   P:Problems   A:Memory address   I:I/O address   Esc:Back");
+    if (Note[0] != L'\0') {
+      ScreenLine(L"");
+      ScreenLine(L"%s", Note);
+    }
+    ScreenEnd();
+
+    EFI_INPUT_KEY Key;
+    WaitKey(&Key);
+    if (IsEsc(&Key)) break;
+
+    CHAR16 Kind = CharToUpper(Key.UnicodeChar);
+    ReportInit(&Rep);
+
+    if (Kind == L'M') {
+      ResMapReport(&Map, &Rep);
+      ReportShow(L"Resource map (address order)", &Rep);
+    } else if (Kind == L'P') {
+      ResMapProblems(&Map, &Rep);
+      ReportShow(L"Resource map problems", &Rep);
+    } else if (Kind == L'A' || Kind == L'I') {
+      UINT64 Addr = 0;
+      ScreenPrompt();
+      Print(L"\nAddress (%u hex): ", (Kind == L'I') ? 4U : 16U);
+      if (!EFI_ERROR(ReadFixedHex((Kind == L'I') ? 4 : 16, &Addr))) {
+        ResMapAddress(&Map, Kind == L'I', Addr, &Rep);
+        ReportShow(L"What decodes this address", &Rep);
+      }
+    }
+    ReportFree(&Rep);
+  }
+
+  ResMapFree(&Map);
+}
@@ -0,0 +1,413 @@
+#include "PciUtility.h"
+
+#include <Library/TimerLib.h>
+
+//
+// High-rate register sampler. Spec file, one directive per line, '#'
+// starts a comment:
+//
+//   target   bb:dd.f  <offset>  <width 1|2|4>  [name]
+//   trigger  <target#>  <mask>  <value>  [eq|ne|change]
+//   time     <ms>          sampling limit (default 1000)
+//   depth    <sets>        ring size, rounded up to a power of two (default 65536)
+//   pre      <sets>        sets kept before the trigger (default depth / 2)
+//   out      <file>        CSV of the window
+//
+//   offset   : hex  |  capXX+hex  |  ecapXXXX+hex   (resolved once, before sampling)
+//
+// Targets become packed backend addresses up front; the loop then only
+// reads the performance counter, calls the backend directly and stores
+// into a preallocated ring. No allocation, console output or division
+// happens until the run ends.
+//
+#define SAMPLE_MAX_TARGETS    16
+#define SAMPLE_NAME_LEN       16
+#define SAMPLE_DEFAULT_MS     1000
+#define SAMPLE_DEFAULT_DEPTH  65536
+#define SAMPLE_MAX_RING       SIZE_64MB
+#define SAMPLE_SHOW_ROWS      16      // rows around the trigger when there is no out file
+
+typedef enum {
+  TRIG_NONE = 0,
+  TRIG_EQ,
+  TRIG_NE,
+  TRIG_CHANGE
+} TRIG_KIND;
+
+typedef struct {
+  UINT8  Bus, Dev, Func;
+  UINT8  Width;
+  UINT16 Reg;
+  UINT32 Address;          // PCI_CFG_ADDRESS of Reg
+  CHAR16 Name[SAMPLE_NAME_LEN];
+} SAMPLE_TARGET;
+
+typedef struct {
+  SAMPLE_TARGET  Target[SAMPLE_MAX_TARGETS];
+  UINTN          Count;
+  UINT8          TrigKind;
+  UINT8          TrigTarget;
+  UINT32         TrigMask;
+  UINT32         TrigValue;
+  UINT32         TimeMs;
+  UINT32         Depth;
+  UINT32         Pre;
+  CHAR16        *Out;      // points into the spec text
+
+  // Ring: Depth sets of one timestamp and Count values
+  UINT64        *Stamp;    // ticks since start
+  UINT32        *Value;
+  UINT32         Mask;     // Depth - 1
+
+  // Result
+  UINT64         Sets;
+  UINT64         Ticks;
+  BOOLEAN        Triggered;
+  UINT64         TrigSet;
+} SAMPLER;
+
+// -----------------------------
+// Spec file
+// -----------------------------
+STATIC
+BOOLEAN
+ParseTarget(IN CHAR16 **Tok, UINTN n, IN CHAR16 *Rest, OUT SAMPLE_TARGET *t)
+{
+  UINT32 a, b, c, Id = 0, Off = 0, W;
+  CONST CHAR16 *e;
+
+  if (n < 4) return FALSE;
+  if (!PciParseHex(Tok[1], 2, L':', &a, &e) || *e != L':') return FALSE;
+  if (!PciParseHex(e + 1, 2, L'.', &b, &e) || *e != L'.' || b > 0x1F) return FALSE;
+  if (!PciParseHex(e + 1, 1, L'\0', &c, NULL) || c > 7) return FALSE;
+  if (!PciParseHex(Tok[3], 1, L'\0', &W, NULL) || (W != 1 && W != 2 && W != 4)) return FALSE;
+
+  t->Bus = (UINT8)a; t->Dev = (UINT8)b; t->Func = (UINT8)c;
+  t->Width = (UINT8)W;
+
+  CONST CHAR16 *o = Tok[2];
+  if (StrnCmp(o, L"ecap", 4) == 0 || StrnCmp(o, L"cap", 3) == 0) {
+    BOOLEAN Ext = (o[0] == L'e');
+    if (!PciParseHex(o + (Ext ? 4 : 3), Ext ? 4 : 2, L'+', &Id, &e)) return FALSE;
+    if (*e == L'+' && !PciParseHex(e + 1, 3, L'\0', &Off, NULL)) return FALSE;
+
+    UINT16 Base = Ext ? PciCfgFindExtCapability(t->Bus, t->Dev, t->Func, (UINT16)Id)
+                      : PciCfgFindCapability(t->Bus, t->Dev, t->Func, (UINT8)Id);
+    if (Base == 0) return FALSE;
+    Off += Base;
+  } else if (!PciParseHex(o, 3, L'\0', &Off, NULL)) {
+    return FALSE;
+  }
+
+  if (Off + W > 0x1000 || (Off & (W - 1)) != 0) return FALSE;
+  t->Reg     = (UINT16)Off;
+  t->Address = PCI_CFG_ADDRESS(t->Bus, t->Dev, t->Func, t->Reg);
+
+  while (*Rest == L' ' || *Rest == L'\t') Rest++;
+  if (*Rest != L'\0') StrnCpyS(t->Name, SAMPLE_NAME_LEN, Rest, SAMPLE_NAME_LEN - 1);
+  else UnicodeSPrint(t->Name, sizeof(t->Name), L"%02x:%02x.%x+%03x", t->Bus, t->Dev, t->Func, t->Reg);
+  return TRUE;
+}
+
+STATIC
+EFI_STATUS
+ParseSpec(IN CHAR16 *Text, OUT SAMPLER *S, OUT PCI_REPORT *Rep)
+{
+  UINT32 v;
+  BOOLEAN PreSet = FALSE;
+
+  S->TimeMs = SAMPLE_DEFAULT_MS;
+  S->Depth  = SAMPLE_DEFAULT_DEPTH;
+
+  CHAR16 *Line = Text;
+  for (UINT32 No = 1; Line != NULL; No++) {
+    CHAR16 *Next = StrStr(Line, L"\n");
+    if (Next != NULL) *Next++ = L'\0';
+
+    CHAR16 *Hash = StrStr(Line, L"#");
+    if (Hash != NULL) *Hash = L'\0';
+
+    CHAR16 *Cur = Line;
+    CHAR16 *Tok[4];
+    UINTN   n = 0;
+    while (n < 4 && (Tok[n] = PciNextToken(&Cur)) != NULL) n++;
+
+    Line = Next;
+    if (n == 0) continue;
+
+    BOOLEAN Ok = FALSE;
+    if (StrCmp(Tok[0], L"target") == 0) {
+      if (S->Count == SAMPLE_MAX_TARGETS) {
+        ReportAdd(Rep, L"Spec line %u: more than %u targets", No, SAMPLE_MAX_TARGETS);
+        return EFI_INVALID_PARAMETER;
+      }
+      Ok = ParseTarget(Tok, n, Cur, &S->Target[S->Count]);
+      if (Ok) S->Count++;
+    } else if (StrCmp(Tok[0], L"trigger") == 0) {
+      CHAR16 *Cond = (n == 4) ? PciNextToken(&Cur) : NULL;
+      Ok = (n == 4) &&
+           PciParseHex(Tok[1], 2, L'\0', &v, NULL) && v < S->Count &&
+           PciParseHex(Tok[2], 8, L'\0', &S->TrigMask, NULL) &&
+           PciParseHex(Tok[3], 8, L'\0', &S->TrigValue, NULL);
+      S->TrigTarget = (UINT8)v;
+      if (Cond == NULL || StrCmp(Cond, L"eq") == 0) S->TrigKind = TRIG_EQ;
+      else if (StrCmp(Cond, L"ne") == 0)            S->TrigKind = TRIG_NE;
+      else if (StrCmp(Cond, L"change") == 0)        S->TrigKind = TRIG_CHANGE;
+      else Ok = FALSE;
+      S->TrigValue &= S->TrigMask;
+    } else if (n == 2 && StrCmp(Tok[0], L"time") == 0) {
+      S->TimeMs = (UINT32)StrDecimalToUintn(Tok[1]);
+      Ok = (S->TimeMs != 0);
+    } else if (n == 2 && StrCmp(Tok[0], L"depth") == 0) {
+      S->Depth = (UINT32)StrDecimalToUintn(Tok[1]);
+      Ok = (S->Depth >= 2 && S->Depth <= SIZE_16MB);
+    } else if (n == 2 && StrCmp(Tok[0], L"pre") == 0) {
+      S->Pre = (UINT32)StrDecimalToUintn(Tok[1]);
+      Ok = PreSet = TRUE;
+    } else if (n == 2 && StrCmp(Tok[0], L"out") == 0) {
+      S->Out = Tok[1];
+      Ok = TRUE;
+    }
+
+    if (!Ok) {
+      ReportAdd(Rep, L"Spec line %u: syntax error (or capability / register not found)", No);
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  if (S->Count == 0) {
+    ReportAdd(Rep, L"Spec has no target");
+    return EFI_INVALID_PARAMETER;
+  }
+
+  // Power of two: the ring index is a mask
+  S->Depth = (UINT32)GetPowerOfTwo32(S->Depth) << ((S->Depth & (S->Depth - 1)) ? 1 : 0);
+  S->Mask  = S->Depth - 1;
+  if (!PreSet) S->Pre = S->Depth / 2;
+  if (S->Pre >= S->Depth) S->Pre = S->Depth - 1;
+  return EFI_SUCCESS;
+}
+
+// -----------------------------
+// Sampling loop
+// -----------------------------
+STATIC
+VOID
+RunSampler(IN OUT SAMPLER *S)
+{
+  PCI_CFG_BACKEND *Be = PciCfgGetBackend();
+  UINT64 TickStart, TickEnd;
+  UINT64 Hz    = GetPerformanceCounterProperties(&TickStart, &TickEnd);
+  UINT64 Limit = DivU64x32(MultU64x32(Hz, S->TimeMs), 1000);
+  UINT64 Stop  = MAX_UINT64;
+  UINT64 Sets  = 0;
+  UINT64 Ticks = 0;
+  UINT32 Prev  = 0;
+  BOOLEAN Up   = (TickEnd >= TickStart);
+  UINTN  Count = S->Count;
+
+  UINT64 Last = GetPerformanceCounter();
+  while (TRUE) {
+    UINT64 Now = GetPerformanceCounter();
+    if (Up) Ticks += (Now >= Last) ? Now - Last : (TickEnd - Last) + (Now - TickStart);
+    else    Ticks += (Now <= Last) ? Last - Now : (Last - TickEnd) + (TickStart - Now);
+    Last = Now;
+    if (Ticks >= Limit || Sets == Stop) break;
+
+    UINT32 *Row = S->Value + (UINTN)(Sets & S->Mask) * Count;
+    S->Stamp[Sets & S->Mask] = Ticks;
+    for (UINTN t = 0; t < Count; t++) {
+      UINT32 v = 0;
+      Be->Read(Be, S->Target[t].Address, S->Target[t].Width, 1, &v);
+      Row[t] = v;
+    }
+
+    if (S->TrigKind != TRIG_NONE && !S->Triggered) {
+      UINT32 v   = Row[S->TrigTarget] & S->TrigMask;
+      BOOLEAN Hit = (S->TrigKind == TRIG_EQ) ? (v == S->TrigValue)
+                  : (S->TrigKind == TRIG_NE) ? (v != S->TrigValue)
+                  : (Sets != 0 && v != Prev);
+      Prev = v;
+      if (Hit) {
+        S->Triggered = TRUE;
+        S->TrigSet   = Sets;
+        Stop         = Sets + (S->Depth - S->Pre);
+      }
+    }
+    Sets++;
+  }
+
+  S->Sets  = Sets;
+  S->Ticks = Ticks;
+}
+
+// -----------------------------
+// Results
+// -----------------------------
+// Sets [First, Sets) are still in the ring.
+STATIC
+UINT64
+WindowFirst(IN SAMPLER *S)
+{
+  return (S->Sets > S->Depth) ? S->Sets - S->Depth : 0;
+}
+
+STATIC
+UINT64
+SetUs(IN SAMPLER *S, UINT64 Set)
+{
+  return DivU64x32(GetTimeInNanoSecond(S->Stamp[Set & S->Mask]), 1000);
+}
+
+STATIC
+VOID
+ReportTargets(IN SAMPLER *S, OUT PCI_REPORT *Rep)
+{
+  UINT64 First = WindowFirst(S);
+
+  ReportAdd(Rep, L"#  Target           B/D/F     Reg  W  First     Last      Min       Max       Changes");
+  for (UINTN t = 0; t < S->Count; t++) {
+    SAMPLE_TARGET *g = &S->Target[t];
+    UINT32 Min = MAX_UINT32, Max = 0, Changes = 0;
+    UINT32 Fv = S->Value[(UINTN)(First & S->Mask) * S->Count + t];
+    UINT32 Pv = Fv;
+
+    for (UINT64 n = First; n < S->Sets; n++) {
+      UINT32 v = S->Value[(UINTN)(n & S->Mask) * S->Count + t];
+      Min = MIN(Min, v);
+      Max = MAX(Max, v);
+      if (v != Pv) Changes++;
+      Pv = v;
+    }
+
+    ReportAdd(Rep, L"%-2u %-16s %02x:%02x.%x  %03x  %u  %08x  %08x  %08x  %08x  %u",
+              (UINT32)t, g->Name, g->Bus, g->Dev, g->Func, g->Reg, g->Width, Fv, Pv, Min, Max, Changes);
+  }
+}
+
+STATIC
+VOID
+ReportRows(IN SAMPLER *S, UINT64 From, UINT64 To, OUT PCI_REPORT *Rep)
+{
+  for (UINT64 n = From; n < To; n++) {
+    CHAR16 Line[REPORT_LINE_LEN];
+    UINTN  Len = UnicodeSPrint(Line, sizeof(Line), L"%c %10lu us ",
+                               (S->Triggered && n == S->TrigSet) ? L'>' : L' ', SetUs(S, n));
+    for (UINTN t = 0; t < S->Count && Len + 10 < REPORT_LINE_LEN; t++) {
+      Len += UnicodeSPrint(Line + Len, sizeof(Line) - Len * sizeof(CHAR16), L" %08x",
+                           S->Value[(UINTN)(n & S->Mask) * S->Count + t]);
+    }
+    ReportAdd(Rep, L"%s", Line);
+  }
+}
+
+// CSV: us, one hex column per target; the trigger row is marked with '*'.
+STATIC
+EFI_STATUS
+WriteWindow(IN SAMPLER *S, IN CONST CHAR16 *Path, OUT UINTN *Rows)
+{
+  UINT64 First   = WindowFirst(S);
+  UINTN  RowSize = 24 + 11 * S->Count;
+  UINTN  Cap     = (UINTN)(S->Sets - First + 1) * RowSize + 32;
+  CHAR8 *Buf     = AllocatePool(Cap);
+  UINTN  Len     = 0;
+
+  *Rows = 0;
+  if (Buf == NULL) return EFI_OUT_OF_RESOURCES;
+
+  Len += AsciiSPrint(Buf + Len, Cap - Len, "us,trigger");
+  for (UINTN t = 0; t < S->Count; t++) Len += AsciiSPrint(Buf + Len, Cap - Len, ",%s", S->Target[t].Name);
+  Len += AsciiSPrint(Buf + Len, Cap - Len, "\r\n");
+
+  for (UINT64 n = First; n < S->Sets; n++) {
+    Len += AsciiSPrint(Buf + Len, Cap - Len, "%lu,%a", SetUs(S, n), (S->Triggered && n == S->TrigSet) ? "*" : "");
+    for (UINTN t = 0; t < S->Count; t++) {
+      Len += AsciiSPrint(Buf + Len, Cap - Len, ",%08x", S->Value[(UINTN)(n & S->Mask) * S->Count + t]);
+    }
+    Len += AsciiSPrint(Buf + Len, Cap - Len, "\r\n");
+    (*Rows)++;
+  }
+
+  EFI_STATUS St = PciFileWrite(Path, Buf, Len);
+  FreePool(Buf);
+  return St;
+}
+
+// Loads the spec, samples and reports. Errors only for an unusable spec
+// or when the ring cannot be allocated.
+EFI_STATUS
+PciSamplerRun(IN CONST CHAR16 *Path, OUT PCI_REPORT *Rep)
+{
+  SAMPLER *S    = AllocateZeroPool(sizeof(SAMPLER));
+  CHAR16  *Text = NULL;
+
+  if (S == NULL) return EFI_OUT_OF_RESOURCES;
+
+  EFI_STATUS St = PciFileReadText(Path, &Text);
+  if (EFI_ERROR(St)) {
+    ReportAdd(Rep, L"Cannot read sampler spec %s: %r", Path, St);
+    FreePool(S);
+    return St;
+  }
+
+  St = ParseSpec(Text, S, Rep);
+  if (!EFI_ERROR(St)) {
+    UINT64 Bytes = MultU64x32(S->Depth, (UINT32)(sizeof(UINT64) + S->Count * sizeof(UINT32)));
+    if (Bytes > SAMPLE_MAX_RING) {
+      ReportAdd(Rep, L"Ring of %u sets x %u targets exceeds %u MB", S->Depth, (UINT32)S->Count, SAMPLE_MAX_RING >> 20);
+      St = EFI_BAD_BUFFER_SIZE;
+    } else {
+      S->Stamp = AllocatePool(S->Depth * sizeof(UINT64));
+      S->Value = AllocatePool(S->Depth * S->Count * sizeof(UINT32));
+      if (S->Stamp == NULL || S->Value == NULL) St = EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  if (!EFI_ERROR(St)) {
+    RunSampler(S);
+
+    UINT64 Ns    = GetTimeInNanoSecond(S->Ticks);
+    UINT64 Rate  = (Ns == 0) ? 0 : DivU64x64Remainder(MultU64x32(S->Sets, 1000000000), Ns, NULL);
+    UINT64 First = WindowFirst(S);
+
+    ReportAdd(Rep, L"Access: %s  Targets: %u  Ring: %u sets  Time: %lu us",
+              PciCfgGetBackend()->Name, (UINT32)S->Count, S->Depth, DivU64x32(Ns, 1000));
+    ReportAdd(Rep, L"Sets: %lu  Rate: %lu sets/s  (%lu reads/s, %lu ns per read)",
+              S->Sets, Rate, MultU64x32(Rate, (UINT32)S->Count),
+              (S->Sets == 0) ? 0 : DivU64x64Remainder(Ns, MultU64x32(S->Sets, (UINT32)S->Count), NULL));
+
+    if (S->TrigKind == TRIG_NONE) {
+      ReportAdd(Rep, L"No trigger: the window is the last %lu sets", S->Sets - First);
+    } else if (!S->Triggered) {
+      ReportAdd(Rep, L"Trigger never fired: the window is the last %lu sets", S->Sets - First);
+    } else {
+      ReportAdd(Rep, L"Trigger at set %lu, %lu us: %s = %08x  (%lu sets before, %lu after in the window)",
+                S->TrigSet, SetUs(S, S->TrigSet), S->Target[S->TrigTarget].Name,
+                S->Value[(UINTN)(S->TrigSet & S->Mask) * S->Count + S->TrigTarget],
+                S->TrigSet - First, S->Sets - S->TrigSet - 1);
+    }
+    ReportAdd(Rep, L"");
+    ReportTargets(S, Rep);
+    ReportAdd(Rep, L"");
+
+    if (S->Out != NULL && S->Sets != 0) {
+      UINTN      Rows = 0;
+      EFI_STATUS Ws   = WriteWindow(S, S->Out, &Rows);
+      if (EFI_ERROR(Ws)) ReportAdd(Rep, L"Writing %s: %r", S->Out, Ws);
+      else               ReportAdd(Rep, L"Window written to %s (%u rows)", S->Out, (UINT32)Rows);
+    } else if (S->Sets != 0) {
+      UINT64 Mid  = S->Triggered ? S->TrigSet : S->Sets - 1;
+      UINT64 From = MAX(First, (Mid > SAMPLE_SHOW_ROWS / 2) ? Mid - SAMPLE_SHOW_ROWS / 2 : 0);
+      UINT64 To   = MIN(S->Sets, From + SAMPLE_SHOW_ROWS);
+      ReportRows(S, From, To, Rep);
+    }
+  } else if (St == EFI_OUT_OF_RESOURCES) {
+    ReportAdd(Rep, L"Out of resources");
+  }
+
+  if (S->Stamp != NULL) FreePool(S->Stamp);
+  if (S->Value != NULL) FreePool(S->Value);
+  FreePool(S);
+  FreePool(Text);
+  return St;
+}
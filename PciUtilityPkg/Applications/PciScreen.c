@@ -0,0 +1,235 @@
+#include "PciUtility.h"
+
+//
+// Frame output for the list / config screens.
+//
+// Normal mode: ScreenBegin() clears, every ScreenLine() is printed as is.
+// Headless mode (-serial): lines are collected into a frame and compared
+// with what the terminal already shows; only changed rows are sent, runs
+// of adjacent rows go out as one OutputString joined by CR LF, and a
+// pending keystroke abandons the rest of the frame so navigation never
+// waits behind a stale repaint. At 115200 baud one full 80x24 frame is
+// about 170 ms of wire time; moving the selection costs two rows.
+// GOP mode (-gop): the same row diff, drawn from the glyph cache in
+// PciGop.c and sent with one Blt per frame; the grid is the full mode.
+//
+#define SCREEN_MAX_ROWS  64
+#define SCREEN_CHUNK     1024   // chars per write, ~90 ms at 115200: the interrupt granularity
+
+typedef struct {
+  SCREEN_MODE Mode;
+  BOOLEAN     Valid;            // Shown[] matches the terminal
+  UINTN       Cols;
+  UINTN       Rows;
+  UINTN       Count;            // rows in the frame being built
+  UINTN       ShownCount;       // rows that may be non-blank on the terminal
+  CHAR16      Line[SCREEN_MAX_ROWS][REPORT_LINE_LEN];
+  CHAR16      Shown[SCREEN_MAX_ROWS][REPORT_LINE_LEN];
+  CHAR16      Out[SCREEN_CHUNK + REPORT_LINE_LEN + 4];
+  UINTN       OutLen;
+  UINTN       RunFirst;         // rows held in Out
+  UINTN       RunEnd;
+} PCI_SCREEN;
+
+STATIC PCI_SCREEN mScr;
+
+// -----------------------------
+// Mode
+// -----------------------------
+// SCREEN_GOP falls back to SCREEN_TEXT when there is no GOP / HII font.
+EFI_STATUS
+ScreenSetMode(SCREEN_MODE Mode)
+{
+  EFI_STATUS St = EFI_SUCCESS;
+  UINTN      Cols = 80, Rows = 25;
+
+  if (mScr.Mode == SCREEN_GOP && Mode != SCREEN_GOP) GopFree();
+
+  if (Mode == SCREEN_GOP) {
+    St = GopInit();
+    if (EFI_ERROR(St)) Mode = SCREEN_TEXT;
+  }
+
+  if (Mode != mScr.Mode) gST->ConOut->EnableCursor(gST->ConOut, Mode == SCREEN_TEXT);
+  mScr.Mode  = Mode;
+  mScr.Valid = FALSE;
+
+  if (Mode == SCREEN_GOP) {
+    // Pixels, not a terminal: every cell is usable
+    mScr.Cols = MIN(GopCols(), (UINTN)REPORT_LINE_LEN - 1);
+    mScr.Rows = MIN(GopRows(), (UINTN)SCREEN_MAX_ROWS);
+  } else if (Mode == SCREEN_SERIAL) {
+    if (EFI_ERROR(gST->ConOut->QueryMode(gST->ConOut, gST->ConOut->Mode->Mode, &Cols, &Rows))) {
+      Cols = 80;
+      Rows = 25;
+    }
+    // Never write the last column or row: the terminal would wrap or scroll
+    mScr.Cols = MIN(Cols - 1, (UINTN)REPORT_LINE_LEN - 1);
+    mScr.Rows = MIN(Rows - 1, (UINTN)SCREEN_MAX_ROWS);
+  }
+  return St;
+}
+
+SCREEN_MODE
+ScreenGetMode(VOID)
+{
+  return mScr.Mode;
+}
+
+BOOLEAN
+ScreenHeadless(VOID)
+{
+  return mScr.Mode == SCREEN_SERIAL;
+}
+
+// Rows a frame may use; 0 in text mode (the console scrolls).
+UINTN
+ScreenRows(VOID)
+{
+  return (mScr.Mode == SCREEN_TEXT) ? 0 : mScr.Rows;
+}
+
+// Something else drew on the terminal: the next frame starts from a clear screen.
+VOID
+ScreenInvalidate(VOID)
+{
+  mScr.Valid = FALSE;
+}
+
+// -----------------------------
+// Frame
+// -----------------------------
+VOID
+ScreenBegin(VOID)
+{
+  mScr.Count = 0;
+  if (mScr.Mode == SCREEN_TEXT) ClearScreen();
+}
+
+VOID
+EFIAPI
+ScreenLine(IN CONST CHAR16 *Fmt, ...)
+{
+  CHAR16  Buf[REPORT_LINE_LEN];
+  VA_LIST Args;
+
+  VA_START(Args, Fmt);
+  UnicodeVSPrint(Buf, sizeof(Buf), Fmt, Args);
+  VA_END(Args);
+
+  if (mScr.Mode == SCREEN_TEXT) {
+    Print(L"%s\n", Buf);
+    return;
+  }
+
+  if (mScr.Count >= mScr.Rows) return;
+  StrnCpyS(mScr.Line[mScr.Count], REPORT_LINE_LEN, Buf, mScr.Cols);
+  mScr.Count++;
+}
+
+STATIC
+BOOLEAN
+KeyPending(VOID)
+{
+  return !EFI_ERROR(gBS->CheckEvent(gST->ConIn->WaitForKey));
+}
+
+// Sends the held run and records it as shown. FALSE: a key arrived first.
+STATIC
+BOOLEAN
+FlushRun(VOID)
+{
+  if (mScr.OutLen == 0) return TRUE;
+  if (KeyPending()) return FALSE;
+
+  mScr.Out[mScr.OutLen] = L'\0';
+  gST->ConOut->SetCursorPosition(gST->ConOut, 0, mScr.RunFirst);
+  gST->ConOut->OutputString(gST->ConOut, mScr.Out);
+
+  for (UINTN r = mScr.RunFirst; r < mScr.RunEnd; r++) {
+    StrCpyS(mScr.Shown[r], REPORT_LINE_LEN, mScr.Line[r]);
+  }
+  mScr.ShownCount = MAX(mScr.ShownCount, mScr.RunEnd);
+  mScr.OutLen = 0;
+  return TRUE;
+}
+
+// Appends row r, padded over the old text, to the held run.
+STATIC
+VOID
+QueueRow(UINTN r)
+{
+  if (mScr.OutLen == 0) {
+    mScr.RunFirst = r;
+  } else {
+    mScr.Out[mScr.OutLen++] = L'\r';
+    mScr.Out[mScr.OutLen++] = L'\n';
+  }
+
+  UINTN New = StrLen(mScr.Line[r]);
+  UINTN Old = StrLen(mScr.Shown[r]);
+  CopyMem(&mScr.Out[mScr.OutLen], mScr.Line[r], New * sizeof(CHAR16));
+  mScr.OutLen += New;
+  for (UINTN k = New; k < Old; k++) mScr.Out[mScr.OutLen++] = L' ';
+
+  mScr.RunEnd = r + 1;
+}
+
+// Input after the frame (ReadFixedHex, ConfirmKey) is echoed by Print:
+// the cursor goes to the row below the frame, and since the echo is not
+// in Shown[] the next frame starts from a clear screen.
+VOID
+ScreenPrompt(VOID)
+{
+  if (mScr.Mode == SCREEN_TEXT) return;
+  gST->ConOut->SetCursorPosition(gST->ConOut, 0, MIN(mScr.Count, mScr.Rows - 1));
+  mScr.Valid = FALSE;
+}
+
+// Returns FALSE when the frame was cut short by a keystroke; the rows not
+// sent keep their old Shown[] text and are compared again next frame.
+BOOLEAN
+ScreenEnd(VOID)
+{
+  if (mScr.Mode == SCREEN_TEXT) return TRUE;
+
+  if (!mScr.Valid) {
+    if (mScr.Mode == SCREEN_GOP) {
+      GopClear();
+    } else {
+      if (KeyPending()) return FALSE;
+      gST->ConOut->ClearScreen(gST->ConOut);
+    }
+    ZeroMem(mScr.Shown, sizeof(mScr.Shown));
+    mScr.ShownCount = 0;
+    mScr.Valid = TRUE;
+  }
+
+  UINTN Total = MAX(mScr.Count, mScr.ShownCount);
+  for (UINTN r = mScr.Count; r < Total; r++) mScr.Line[r][0] = L'\0';
+
+  if (mScr.Mode == SCREEN_GOP) {
+    for (UINTN r = 0; r < Total; r++) {
+      if (StrCmp(mScr.Line[r], mScr.Shown[r]) == 0) continue;
+      GopDrawText(0, r, mScr.Line[r], mScr.Cols, GOP_NORMAL);
+      StrCpyS(mScr.Shown[r], REPORT_LINE_LEN, mScr.Line[r]);
+    }
+    GopFlush();
+    mScr.ShownCount = mScr.Count;
+    return TRUE;
+  }
+
+  mScr.OutLen = 0;
+  for (UINTN r = 0; r < Total; r++) {
+    if (StrCmp(mScr.Line[r], mScr.Shown[r]) == 0) {
+      if (!FlushRun()) return FALSE;
+      continue;
+    }
+    QueueRow(r);
+    if (mScr.OutLen >= SCREEN_CHUNK && !FlushRun()) return FALSE;
+  }
+  if (!FlushRun()) return FALSE;
+
+  mScr.ShownCount = mScr.Count;
+  return TRUE;
+}
@@ -0,0 +1,263 @@
+#include "PciUtility.h"
+
+//
+// Config space snapshots, deduplicated per 256-byte block.
+//
+// Every function maps to SNAP_BLOCKS_PER_FUNC block ids. Ids 0 and 1 are the
+// implicit all-0x00 / all-0xFF blocks and take no storage; other ids index
+// the block pool. Identical blocks (sibling functions, VFs, empty capability
+// pages) are stored once, found through an FNV-1a keyed open-addressing table.
+// Reading any byte is two array lookups.
+//
+#define SNAP_POOL_GROW       64      // blocks
+#define SNAP_HASH_MIN        256     // slots, power of two
+#define SNAP_HASH_EMPTY      0xFFFFFFFF
+
+STATIC CONST UINT8 mZeroBlock[SNAP_BLOCK_SIZE] = { 0 };
+STATIC UINT8       mOnesBlock[SNAP_BLOCK_SIZE];
+
+STATIC
+UINT32
+HashBlock(CONST UINT8 *Data)
+{
+  UINT32 h = 0x811C9DC5;
+  for (UINTN i = 0; i < SNAP_BLOCK_SIZE; i++) {
+    h = (h ^ Data[i]) * 0x01000193;
+  }
+  return h;
+}
+
+STATIC
+BOOLEAN
+IsFilled(CONST UINT8 *Data, UINT8 Value)
+{
+  for (UINTN i = 0; i < SNAP_BLOCK_SIZE; i++) {
+    if (Data[i] != Value) return FALSE;
+  }
+  return TRUE;
+}
+
+STATIC
+CONST UINT8 *
+PoolBlock(CONST PCI_SNAPSHOT *Snap, UINT32 Id)
+{
+  return Snap->Pool + (UINTN)(Id - SNAP_BLOCK_FIRST) * SNAP_BLOCK_SIZE;
+}
+
+// Hash slots hold pool ids; rebuilt when the load passes 3/4.
+STATIC
+EFI_STATUS
+GrowHash(IN OUT PCI_SNAPSHOT *Snap)
+{
+  UINT32 NewSize = Snap->HashSize ? Snap->HashSize * 2 : SNAP_HASH_MIN;
+  UINT32 *New = AllocatePool(sizeof(UINT32) * NewSize);
+  if (New == NULL) return EFI_OUT_OF_RESOURCES;
+  SetMem32(New, sizeof(UINT32) * NewSize, SNAP_HASH_EMPTY);
+
+  for (UINT32 b = 0; b < Snap->PoolCount; b++) {
+    UINT32 Id = b + SNAP_BLOCK_FIRST;
+    UINT32 s  = HashBlock(PoolBlock(Snap, Id)) & (NewSize - 1);
+    while (New[s] != SNAP_HASH_EMPTY) s = (s + 1) & (NewSize - 1);
+    New[s] = Id;
+  }
+
+  if (Snap->Hash != NULL) FreePool(Snap->Hash);
+  Snap->Hash     = New;
+  Snap->HashSize = NewSize;
+  return EFI_SUCCESS;
+}
+
+// Returns the id of a block equal to Data, storing it if it is new.
+STATIC
+EFI_STATUS
+InternBlock(IN OUT PCI_SNAPSHOT *Snap, CONST UINT8 *Data, OUT UINT32 *Id)
+{
+  if (IsFilled(Data, 0x00)) { *Id = SNAP_BLOCK_ZERO; Snap->Implicit++; return EFI_SUCCESS; }
+  if (IsFilled(Data, 0xFF)) { *Id = SNAP_BLOCK_ONES; Snap->Implicit++; return EFI_SUCCESS; }
+
+  if ((Snap->PoolCount + 1) * 4 > Snap->HashSize * 3) {
+    EFI_STATUS St = GrowHash(Snap);
+    if (EFI_ERROR(St)) return St;
+  }
+
+  UINT32 Mask = Snap->HashSize - 1;
+  UINT32 s    = HashBlock(Data) & Mask;
+  for (; Snap->Hash[s] != SNAP_HASH_EMPTY; s = (s + 1) & Mask) {
+    if (CompareMem(PoolBlock(Snap, Snap->Hash[s]), Data, SNAP_BLOCK_SIZE) == 0) {
+      *Id = Snap->Hash[s];
+      Snap->Shared++;
+      return EFI_SUCCESS;
+    }
+  }
+
+  if (Snap->PoolCount == Snap->PoolCap) {
+    UINTN NewCap = Snap->PoolCap + SNAP_POOL_GROW;
+    VOID *New = ReallocatePool(Snap->PoolCap * SNAP_BLOCK_SIZE, NewCap * SNAP_BLOCK_SIZE, Snap->Pool);
+    if (New == NULL) return EFI_OUT_OF_RESOURCES;
+    Snap->Pool    = New;
+    Snap->PoolCap = (UINT32)NewCap;
+  }
+
+  *Id = Snap->PoolCount + SNAP_BLOCK_FIRST;
+  CopyMem(Snap->Pool + (UINTN)Snap->PoolCount * SNAP_BLOCK_SIZE, Data, SNAP_BLOCK_SIZE);
+  Snap->PoolCount++;
+  Snap->Hash[s] = *Id;
+  return EFI_SUCCESS;
+}
+
+// One function's 4KB: ECAM when it decodes the bus, else RBIO. Extended
+// space is only read for PCIe functions; others get implicit 0xFF blocks.
+STATIC
+VOID
+ReadFunctionConfig(PCI_DEV_INFO *p, OUT UINT8 *Cfg)
+{
+  BOOLEAN Ecam = PciCfgEcamCoversBus(p->Bus);
+  UINT32 *Dw   = (UINT32 *)Cfg;
+  UINT16  Size = (PciCfgFindCapability(p->Bus, p->Dev, p->Func, 0x10) != 0) ? SNAP_FUNC_SIZE : 0x100;
+
+  for (UINT16 off = 0; off < Size; off += 4) {
+    if (Ecam) Dw[off / 4] = PciCfgEcamRead32(p->Bus, p->Dev, p->Func, off);
+    else      PciCfgRead32(p->Bus, p->Dev, p->Func, off, &Dw[off / 4]);
+  }
+
+  if (Size < SNAP_FUNC_SIZE) SetMem(Cfg + Size, SNAP_FUNC_SIZE - Size, 0xFF);
+}
+
+// -----------------------------
+// Public API
+// -----------------------------
+EFI_STATUS
+PciSnapshotCapture(IN PCI_DEV_INFO *List, UINTN Count, OUT PCI_SNAPSHOT *Snap)
+{
+  ZeroMem(Snap, sizeof(*Snap));
+  SetMem(mOnesBlock, sizeof(mOnesBlock), 0xFF);
+
+  Snap->List  = AllocateCopyPool(sizeof(PCI_DEV_INFO) * (Count ? Count : 1), List);
+  Snap->Map   = AllocatePool(sizeof(UINT32) * SNAP_BLOCKS_PER_FUNC * (Count ? Count : 1));
+  UINT8 *Cfg  = AllocatePool(SNAP_FUNC_SIZE);
+  if (Snap->List == NULL || Snap->Map == NULL || Cfg == NULL) {
+    if (Cfg) FreePool(Cfg);
+    PciSnapshotFree(Snap);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Snap->Count = Count;
+
+  EFI_STATUS St = GrowHash(Snap);
+  for (UINTN i = 0; i < Count && !EFI_ERROR(St); i++) {
+    ReadFunctionConfig(&List[i], Cfg);
+    for (UINTN b = 0; b < SNAP_BLOCKS_PER_FUNC && !EFI_ERROR(St); b++) {
+      St = InternBlock(Snap, Cfg + b * SNAP_BLOCK_SIZE, &Snap->Map[i * SNAP_BLOCKS_PER_FUNC + b]);
+    }
+  }
+
+  FreePool(Cfg);
+  if (EFI_ERROR(St)) PciSnapshotFree(Snap);
+  return St;
+}
+
+VOID
+PciSnapshotFree(IN OUT PCI_SNAPSHOT *Snap)
+{
+  if (Snap->List != NULL) FreePool(Snap->List);
+  if (Snap->Map != NULL)  FreePool(Snap->Map);
+  if (Snap->Pool != NULL) FreePool(Snap->Pool);
+  if (Snap->Hash != NULL) FreePool(Snap->Hash);
+  ZeroMem(Snap, sizeof(*Snap));
+}
+
+// Block containing Offset of function Index (never NULL for valid input).
+CONST UINT8 *
+PciSnapshotBlock(IN CONST PCI_SNAPSHOT *Snap, UINTN Index, UINT16 Offset)
+{
+  UINT32 Id = Snap->Map[Index * SNAP_BLOCKS_PER_FUNC + (Offset & (SNAP_FUNC_SIZE - 1)) / SNAP_BLOCK_SIZE];
+  if (Id == SNAP_BLOCK_ZERO) return mZeroBlock;
+  if (Id == SNAP_BLOCK_ONES) return mOnesBlock;
+  return PoolBlock(Snap, Id);
+}
+
+UINT32
+PciSnapshotRead32(IN CONST PCI_SNAPSHOT *Snap, UINTN Index, UINT16 Offset)
+{
+  Offset &= 0xFFC;
+  return ReadUnaligned32((CONST UINT32 *)(PciSnapshotBlock(Snap, Index, Offset) + (Offset % SNAP_BLOCK_SIZE)));
+}
+
+// Copies Length bytes starting at Offset (may cross blocks).
+VOID
+PciSnapshotCopy(IN CONST PCI_SNAPSHOT *Snap, UINTN Index, UINT16 Offset, UINTN Length, OUT UINT8 *Buf)
+{
+  while (Length > 0 && Offset < SNAP_FUNC_SIZE) {
+    UINTN In = Offset % SNAP_BLOCK_SIZE;
+    UINTN n  = MIN(Length, SNAP_BLOCK_SIZE - In);
+    CopyMem(Buf, PciSnapshotBlock(Snap, Index, Offset) + In, n);
+    Buf += n; Offset = (UINT16)(Offset + n); Length -= n;
+  }
+}
+
+// Block ids are per snapshot, so equal ids only mean equal data within
+// one snapshot; across snapshots compare implicit blocks by id, else bytes.
+BOOLEAN
+PciSnapshotBlockEqual(IN CONST PCI_SNAPSHOT *A, UINTN Ia, IN CONST PCI_SNAPSHOT *B, UINTN Ib, UINTN Block)
+{
+  UINT32 Ida = A->Map[Ia * SNAP_BLOCKS_PER_FUNC + Block];
+  UINT32 Idb = B->Map[Ib * SNAP_BLOCKS_PER_FUNC + Block];
+
+  if (Ida < SNAP_BLOCK_FIRST || Idb < SNAP_BLOCK_FIRST) return Ida == Idb;
+  return CompareMem(PoolBlock(A, Ida), PoolBlock(B, Idb), SNAP_BLOCK_SIZE) == 0;
+}
+
+// Functions are matched by B/D/F; both lists are bus ordered.
+UINTN
+PciSnapshotDiff(IN CONST PCI_SNAPSHOT *Old, IN CONST PCI_SNAPSHOT *New, OUT PCI_REPORT *Rep)
+{
+  UINTN a = 0, b = 0, Changes = 0;
+
+  while (a < Old->Count || b < New->Count) {
+    UINT32 Ka = (a < Old->Count) ? BDF_KEY(&Old->List[a]) : MAX_UINT32;
+    UINT32 Kb = (b < New->Count) ? BDF_KEY(&New->List[b]) : MAX_UINT32;
+
+    if (Ka < Kb) {
+      ReportAdd(Rep, L"%02x/%02x/%02x  removed", Old->List[a].Bus, Old->List[a].Dev, Old->List[a].Func);
+      Changes++; a++;
+      continue;
+    }
+    if (Kb < Ka) {
+      ReportAdd(Rep, L"%02x/%02x/%02x  added", New->List[b].Bus, New->List[b].Dev, New->List[b].Func);
+      Changes++; b++;
+      continue;
+    }
+
+    CONST PCI_DEV_INFO *p = &New->List[b];
+    for (UINTN Blk = 0; Blk < SNAP_BLOCKS_PER_FUNC; Blk++) {
+      if (PciSnapshotBlockEqual(Old, a, New, b, Blk)) continue;
+
+      for (UINT16 off = (UINT16)(Blk * SNAP_BLOCK_SIZE); off < (Blk + 1) * SNAP_BLOCK_SIZE; off += 4) {
+        UINT32 Va = PciSnapshotRead32(Old, a, off);
+        UINT32 Vb = PciSnapshotRead32(New, b, off);
+        if (Va == Vb) continue;
+        ReportAdd(Rep, L"%02x/%02x/%02x  +%03x  %08x -> %08x  (bits %08x)",
+                  p->Bus, p->Dev, p->Func, off, Va, Vb, Va ^ Vb);
+        Changes++;
+      }
+    }
+    a++; b++;
+  }
+
+  return Changes;
+}
+
+VOID
+PciSnapshotStats(IN CONST PCI_SNAPSHOT *Snap, OUT PCI_REPORT *Rep)
+{
+  UINTN Raw    = Snap->Count * SNAP_FUNC_SIZE;
+  UINTN Stored = (UINTN)Snap->PoolCap * SNAP_BLOCK_SIZE + (UINTN)Snap->HashSize * sizeof(UINT32) +
+                 Snap->Count * (SNAP_BLOCKS_PER_FUNC * sizeof(UINT32) + sizeof(PCI_DEV_INFO));
+
+  ReportAdd(Rep, L"Functions: %u   Blocks: %u x %u bytes",
+            (UINT32)Snap->Count, (UINT32)(Snap->Count * SNAP_BLOCKS_PER_FUNC), SNAP_BLOCK_SIZE);
+  ReportAdd(Rep, L"  implicit 00/FF : %u", Snap->Implicit);
+  ReportAdd(Rep, L"  deduplicated   : %u", Snap->Shared);
+  ReportAdd(Rep, L"  stored         : %u", Snap->PoolCount);
+  ReportAdd(Rep, L"Memory: %u KB (raw %u KB, %u%%)",
+            (UINT32)(Stored / 1024), (UINT32)(Raw / 1024), Raw ? (UINT32)((Stored * 100) / Raw) : 0);
+}
@@ -0,0 +1,325 @@
+#include "PciUtility.h"
+
+//
+// SR-IOV: virtual functions are not found by the bus walk (a VF's Vendor
+// ID reads FFFFh, and with ARI they sit on function numbers 8-255 or on
+// the next bus), so they are computed from each PF's SR-IOV capability:
+//
+//   VF k routing ID = PF RID + First VF Offset + k * VF Stride
+//
+// PciSriovAddVfs() generates every enabled VF in one pass over the PFs,
+// drops the ones already listed (bitmap by RID), sorts them and merges
+// them into the bus ordered list in place. PciSriovLink() makes each VF a
+// child of its PF in the topology through a RID -> index table; neither
+// step searches the list.
+//
+#define SRIOV_EXT_CAP_ID   0x0010
+#define SRIOV_DWORDS       16      // 0x00-0x3F
+
+#define SRIOV_CTL_VF_EN    BIT0
+#define SRIOV_CTL_VF_MSE   BIT3
+#define SRIOV_CTL_ARI      BIT4
+
+#define RID(Bus, Dev, Func)  ((UINT32)(((Bus) << 8) | ((Dev) << 3) | (Func)))
+
+typedef struct {
+  UINT16 Ctl;
+  UINT16 Initial;
+  UINT16 Total;
+  UINT16 Num;
+  UINT16 First;
+  UINT16 Stride;
+  UINT16 VfDid;
+  UINT32 PageSize;       // System Page Size, bit n = 4KB << n
+  UINT32 Bar[6];
+} SRIOV_CAP;
+
+typedef struct {
+  UINTN Pfs;
+  UINTN Added;
+  UINTN Listed;          // already found by the bus walk
+  UINTN Dropped;         // device table full
+  UINTN Beyond;          // routing ID past bus FFh
+} SRIOV_STATS;
+
+STATIC SRIOV_STATS mSriov;
+
+STATIC
+BOOLEAN
+SriovRead(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Cap, OUT SRIOV_CAP *S)
+{
+  UINT32 R[SRIOV_DWORDS];
+
+  if (EFI_ERROR(PciCfgReadBulk32(Bus, Dev, Func, Cap, SRIOV_DWORDS, R))) return FALSE;
+
+  S->Ctl      = (UINT16)R[2];
+  S->Initial  = (UINT16)R[3];
+  S->Total    = (UINT16)(R[3] >> 16);
+  S->Num      = (UINT16)R[4];
+  S->First    = (UINT16)R[5];
+  S->Stride   = (UINT16)(R[5] >> 16);
+  S->VfDid    = (UINT16)(R[6] >> 16);
+  S->PageSize = R[8];
+  CopyMem(S->Bar, &R[9], sizeof(S->Bar));
+  return TRUE;
+}
+
+// VFs that exist right now: VF Enable set and NumVFs non-zero.
+STATIC
+UINTN
+SriovActive(IN SRIOV_CAP *S)
+{
+  return ((S->Ctl & SRIOV_CTL_VF_EN) != 0) ? MIN(S->Num, S->Total) : 0;
+}
+
+STATIC
+INTN
+EFIAPI
+CompareRid(IN CONST VOID *A, IN CONST VOID *B)
+{
+  CONST PCI_DEV_INFO *a = (CONST PCI_DEV_INFO *)A;
+  CONST PCI_DEV_INFO *b = (CONST PCI_DEV_INFO *)B;
+  UINT32 ka = RID(a->Bus, a->Dev, a->Func);
+  UINT32 kb = RID(b->Bus, b->Dev, b->Func);
+  return (ka < kb) ? -1 : (ka > kb) ? 1 : 0;
+}
+
+// -----------------------------
+// Device table
+// -----------------------------
+// List is bus ordered with room for MAX_PCI_DEVS entries. Returns the VFs added.
+UINTN
+PciSriovAddVfs(IN OUT PCI_DEV_INFO *List, IN OUT UINTN *Count)
+{
+  UINTN         Old  = *Count;
+  UINTN         Room = MAX_PCI_DEVS - MIN(Old, (UINTN)MAX_PCI_DEVS);
+  UINTN         n    = 0;
+  UINT8        *Seen = AllocateZeroPool(0x10000 / 8);
+  PCI_DEV_INFO *Vf   = AllocatePool(sizeof(PCI_DEV_INFO) * (Room ? Room : 1));
+
+  ZeroMem(&mSriov, sizeof(mSriov));
+  if (Seen == NULL || Vf == NULL) {
+    if (Seen) FreePool(Seen);
+    if (Vf) FreePool(Vf);
+    return 0;
+  }
+
+  for (UINTN i = 0; i < Old; i++) {
+    UINT32 r = RID(List[i].Bus, List[i].Dev, List[i].Func);
+    Seen[r >> 3] |= (UINT8)(1 << (r & 7));
+  }
+
+  for (UINTN i = 0; i < Old; i++) {
+    PCI_DEV_INFO *p   = &List[i];
+    UINT16        Cap = PciCfgFindExtCapability(p->Bus, p->Dev, p->Func, SRIOV_EXT_CAP_ID);
+    SRIOV_CAP     S;
+
+    if (Cap == 0 || !SriovRead(p->Bus, p->Dev, p->Func, Cap, &S)) continue;
+    mSriov.Pfs++;
+
+    UINTN  Active = SriovActive(&S);
+    UINT32 r      = RID(p->Bus, p->Dev, p->Func) + S.First;
+    for (UINTN k = 0; k < Active; k++, r += S.Stride) {
+      if (r > 0xFFFF) {
+        mSriov.Beyond += Active - k;
+        break;
+      }
+      if (Seen[r >> 3] & (1 << (r & 7))) {
+        mSriov.Listed++;
+        continue;
+      }
+      if (n >= Room) {
+        mSriov.Dropped++;
+        continue;
+      }
+      Seen[r >> 3] |= (UINT8)(1 << (r & 7));
+
+      PCI_DEV_INFO *v = &Vf[n++];
+      v->Bus  = (UINT8)(r >> 8);
+      v->Dev  = (UINT8)((r >> 3) & 0x1F);
+      v->Func = (UINT8)(r & 7);
+      v->Vid  = p->Vid;     // a VF's own Vendor ID reads FFFFh
+      v->Did  = S.VfDid;
+
+      UINT32 ClassRev = 0xFFFFFFFF;
+      PciCfgRead32(v->Bus, v->Dev, v->Func, 0x08, &ClassRev);
+      if (ClassRev == 0xFFFFFFFF) {
+        v->BaseClass = p->BaseClass; v->SubClass = p->SubClass; v->ProgIf = p->ProgIf;
+      } else {
+        v->ProgIf    = (UINT8)(ClassRev >> 8);
+        v->SubClass  = (UINT8)(ClassRev >> 16);
+        v->BaseClass = (UINT8)(ClassRev >> 24);
+      }
+    }
+  }
+
+  // Strided VFs of different PFs interleave; then merge from the back
+  if (n > 0) {
+    PCI_DEV_INFO Tmp;
+    QuickSort(Vf, n, sizeof(PCI_DEV_INFO), CompareRid, &Tmp);
+
+    UINTN a = Old, b = n, w = Old + n;
+    while (b > 0) {
+      if (a > 0 && CompareRid(&List[a - 1], &Vf[b - 1]) > 0) List[--w] = List[--a];
+      else List[--w] = Vf[--b];
+    }
+    *Count = Old + n;
+  }
+  mSriov.Added = n;
+
+  FreePool(Seen);
+  FreePool(Vf);
+  return n;
+}
+
+// -----------------------------
+// Topology
+// -----------------------------
+// Called by PciBuildTopology once Node[].SriovCap and the bridge parents
+// are known: every VF in the list is re-parented to its PF.
+VOID
+PciSriovLink(IN OUT PCI_TOPOLOGY *Topo)
+{
+  UINT16 *Index = NULL;
+
+  for (UINTN i = 0; i < Topo->Count; i++) {
+    PCI_DEV_INFO *p = &Topo->List[i];
+    SRIOV_CAP     S;
+
+    if (Topo->Node[i].SriovCap == 0) continue;
+    if (!SriovRead(p->Bus, p->Dev, p->Func, Topo->Node[i].SriovCap, &S)) continue;
+
+    UINTN Active = SriovActive(&S);
+    if (Active == 0) continue;
+
+    if (Index == NULL) {
+      Index = AllocatePool(sizeof(UINT16) * 0x10000);
+      if (Index == NULL) return;
+      SetMem(Index, sizeof(UINT16) * 0x10000, 0xFF);   // PCI_NO_NODE
+      for (UINTN k = 0; k < Topo->Count; k++) {
+        Index[RID(Topo->List[k].Bus, Topo->List[k].Dev, Topo->List[k].Func)] = (UINT16)k;
+      }
+    }
+
+    UINT32 r = RID(p->Bus, p->Dev, p->Func) + S.First;
+    for (UINTN k = 0; k < Active && r <= 0xFFFF; k++, r += S.Stride) {
+      UINT16 v = Index[r];
+      if (v == PCI_NO_NODE || v == (UINT16)i) continue;
+      Topo->Node[v].Parent = (UINT16)i;
+      Topo->Node[v].IsVf   = TRUE;
+    }
+  }
+
+  if (Index != NULL) FreePool(Index);
+}
+
+// -----------------------------
+// Report
+// -----------------------------
+// Size mask of one VF BAR register: all ones through the write policy
+// (VF BARs are BAR bytes, so this needs the F9 unlock), read back, then
+// the old value restored. The all-ones read back never matches, so the
+// status of the first write is not checked.
+STATIC
+UINT32
+SriovProbe(IN PCI_DEV_INFO *p, UINT16 Reg, UINT32 Old)
+{
+  UINT32 Mask = 0;
+
+  PolicyWrite(p->Bus, p->Dev, p->Func, Reg, DISP_DWORD, 0xFFFFFFFF, 0xFFFFFFFF, &Mask);
+  PolicyWrite(p->Bus, p->Dev, p->Func, Reg, DISP_DWORD, 0xFFFFFFFF, Old, NULL);
+  return Mask;
+}
+
+// One VF BAR (Bar is the register index). Sized only when the dangerous
+// writes are unlocked and VF MSE is clear, so the all-ones pattern never
+// decodes; otherwise type and base as programmed. Returns the next index.
+STATIC
+UINTN
+SriovBar(IN PCI_DEV_INFO *p, UINT16 Cap, IN SRIOV_CAP *S, UINTN Bar, OUT PCI_REPORT *Rep)
+{
+  UINT16  Reg  = (UINT16)(Cap + 0x24 + Bar * 4);
+  UINT32  Lo   = S->Bar[Bar];
+  BOOLEAN Is64 = ((Lo & 0x6) == 0x4) && Bar < 5;
+  UINT64  Base = (Lo & ~0xFULL) | (Is64 ? LShiftU64(S->Bar[Bar + 1], 32) : 0);
+  UINTN   Next = Bar + (Is64 ? 2 : 1);
+
+  if (!DangerousWritesUnlocked() || (S->Ctl & SRIOV_CTL_VF_MSE) != 0) {
+    if (Lo == 0) return Bar + 1;                                // not implemented
+    ReportAdd(Rep, L"  VF BAR%u  %s%s  base %016lx%s  (%s)",
+              (UINT32)Bar, Is64 ? L"mem64" : L"mem32", (Lo & BIT3) ? L" pref" : L"",
+              Base, (Base == 0) ? L"  unassigned" : L"",
+              (S->Ctl & SRIOV_CTL_VF_MSE) ? L"VF MSE on, not sized" : L"size: F9 to probe");
+    return Next;
+  }
+
+  UINT32 MaskLo = SriovProbe(p, Reg, Lo);
+  UINT32 MaskHi = Is64 ? SriovProbe(p, (UINT16)(Reg + 4), S->Bar[Bar + 1]) : 0xFFFFFFFF;
+  if ((MaskLo & ~0xFU) == 0) return Bar + 1;                    // not implemented
+
+  UINT64 Size = ~(LShiftU64(MaskHi, 32) | (MaskLo & ~0xFULL)) + 1;
+  CHAR16 One[16], All[16];
+  ReportSizeText(Size, One, sizeof(One));
+  ReportSizeText(MultU64x32(Size, S->Num), All, sizeof(All));
+  ReportAdd(Rep, L"  VF BAR%u  %s%s  %s per VF, %s for %u VFs  base %016lx%s",
+            (UINT32)Bar, Is64 ? L"mem64" : L"mem32", (Lo & BIT3) ? L" pref" : L"",
+            One, All, (UINT32)S->Num, Base, (Base == 0) ? L"  unassigned" : L"");
+  return Next;
+}
+
+// Every PF: VF counts, routing, VFs found in the table, VF BARs.
+VOID
+PciSriovReport(IN PCI_TOPOLOGY *Topo, OUT PCI_REPORT *Rep)
+{
+  UINTN Pfs = 0, Vfs = 0;
+
+  for (UINTN i = 0; i < Topo->Count; i++) {
+    PCI_DEV_INFO *p   = &Topo->List[i];
+    UINT16        Cap = Topo->Node[i].SriovCap;
+    SRIOV_CAP     S;
+
+    if (Cap == 0 || !SriovRead(p->Bus, p->Dev, p->Func, Cap, &S)) continue;
+    Pfs++;
+
+    UINTN Listed = 0;
+    for (UINT16 c = Topo->Node[i].FirstChild; c != PCI_NO_NODE; c = Topo->Node[c].NextSibling) {
+      if (Topo->Node[c].IsVf) Listed++;
+    }
+    Vfs += Listed;
+
+    ReportAdd(Rep, L"%02x:%02x.%x  %04x:%04x  TotalVFs %u  InitialVFs %u  NumVFs %u  %s%s",
+              p->Bus, p->Dev, p->Func, p->Vid, p->Did, S.Total, S.Initial, S.Num,
+              (S.Ctl & SRIOV_CTL_VF_EN) ? L"enabled" : L"disabled",
+              (S.Ctl & SRIOV_CTL_ARI) ? L", ARI" : L"");
+
+    UINTN Active = SriovActive(&S);
+    if (Active > 0) {
+      UINT32 First = RID(p->Bus, p->Dev, p->Func) + S.First;
+      UINT32 Last  = First + (UINT32)(Active - 1) * S.Stride;
+      ReportAdd(Rep, L"  VF %04x  offset %u stride %u  RID %02x:%02x.%x - %02x:%02x.%x  listed %u",
+                S.VfDid, S.First, S.Stride,
+                (First >> 8) & 0xFF, (First >> 3) & 0x1F, First & 7,
+                (Last >> 8) & 0xFF, (Last >> 3) & 0x1F, Last & 7, (UINT32)Listed);
+      if (Last > 0xFFFF) ReportAdd(Rep, L"  ! last VF routing ID is past bus ff");
+    } else {
+      ReportAdd(Rep, L"  VF %04x  no VFs enabled", S.VfDid);
+    }
+
+    for (UINTN b = 0; b < 6; ) b = SriovBar(p, Cap, &S, b, Rep);
+    if (S.PageSize != 0 && S.PageSize != BIT0) {
+      ReportAdd(Rep, L"  System Page Size %uK (VF BARs aligned to it)", (UINT32)(S.PageSize * 4));
+    }
+  }
+
+  if (Pfs == 0) {
+    ReportAdd(Rep, L"No function with an SR-IOV capability.");
+    return;
+  }
+  ReportAdd(Rep, L"");
+  ReportAdd(Rep, L"PFs: %u  VFs in the device table: %u  (added by scan: %u, found by bus walk: %u)",
+            (UINT32)Pfs, (UINT32)Vfs, (UINT32)mSriov.Added, (UINT32)mSriov.Listed);
+  if (mSriov.Dropped + mSriov.Beyond > 0) {
+    ReportAdd(Rep, L"Not listed: %u (device table full), %u (routing ID past bus ff)",
+              (UINT32)mSriov.Dropped, (UINT32)mSriov.Beyond);
+  }
+}
@@ -0,0 +1,130 @@
+#include "PciUtility.h"
+
+//
+// Topology index built once after the scan.  Node[i] describes List[i];
+// parents are resolved through BusOwner[] (secondary bus -> bridge) so no
+// per-device search is needed.  SR-IOV VFs are re-parented to their PF.
+//
+EFI_STATUS
+PciBuildTopology(PCI_DEV_INFO *List, UINTN Count, OUT PCI_TOPOLOGY *Topo)
+{
+  ZeroMem(Topo, sizeof(*Topo));
+
+  Topo->Node = AllocateZeroPool(sizeof(PCI_TOPO_NODE) * (Count ? Count : 1));
+  if (Topo->Node == NULL) return EFI_OUT_OF_RESOURCES;
+
+  Topo->List  = List;
+  Topo->Count = Count;
+  SetMem(Topo->BusOwner, sizeof(Topo->BusOwner), 0xFF); // PCI_NO_NODE
+  SetMem(Topo->BusFirst, sizeof(Topo->BusFirst), 0xFF);
+
+  // Pass 1: header type, bus numbers, PCIe capability
+  for (UINTN i = 0; i < Count; i++) {
+    PCI_DEV_INFO  *p = &List[i];
+    PCI_TOPO_NODE *n = &Topo->Node[i];
+
+    n->Parent = PCI_NO_NODE;
+    if (Topo->BusFirst[p->Bus] == PCI_NO_NODE) Topo->BusFirst[p->Bus] = (UINT16)i;
+
+    UINT8 Hdr = 0;
+    PciCfgRead8(p->Bus, p->Dev, p->Func, 0x0E, &Hdr);
+    n->HdrType = (UINT8)(Hdr & 0x7F);
+
+    if (n->HdrType == 0x01) {
+      UINT32 Buses = 0;
+      PciCfgRead32(p->Bus, p->Dev, p->Func, 0x18, &Buses);
+      n->SecBus = (UINT8)(Buses >> 8);
+      n->SubBus = (UINT8)(Buses >> 16);
+
+      // First bridge claiming a bus wins (e.g. ignore unconfigured bridges with SecBus 0)
+      if (n->SecBus != 0 && Topo->BusOwner[n->SecBus] == PCI_NO_NODE) {
+        Topo->BusOwner[n->SecBus] = (UINT16)i;
+      }
+    }
+
+    n->PcieCap = PciCfgFindCapability(p->Bus, p->Dev, p->Func, 0x10);
+    if (n->PcieCap != 0) {
+      UINT16 PcieCaps = 0;
+      PciCfgRead16(p->Bus, p->Dev, p->Func, (UINT16)(n->PcieCap + 0x02), &PcieCaps);
+      n->PcieVer  = (UINT8)(PcieCaps & 0x0F);
+      n->PortType = (UINT8)((PcieCaps >> 4) & 0x0F);
+      n->SriovCap = PciCfgFindExtCapability(p->Bus, p->Dev, p->Func, 0x0010);
+    }
+  }
+
+  // Pass 2: parents
+  for (UINTN i = 0; i < Count; i++) {
+    UINT16 Owner = Topo->BusOwner[List[i].Bus];
+    if (Owner != (UINT16)i) Topo->Node[i].Parent = Owner;
+  }
+  PciSriovLink(Topo);
+
+  // Pass 3: child / sibling links. Walking backwards and pushing to the
+  // front keeps every child list in bus order.
+  Topo->FirstRoot = PCI_NO_NODE;
+  for (UINTN i = 0; i < Count; i++) {
+    Topo->Node[i].FirstChild  = PCI_NO_NODE;
+    Topo->Node[i].NextSibling = PCI_NO_NODE;
+  }
+  for (UINTN k = Count; k-- > 0; ) {
+    UINT16 Parent = Topo->Node[k].Parent;
+    UINT16 *Head  = (Parent == PCI_NO_NODE) ? &Topo->FirstRoot : &Topo->Node[Parent].FirstChild;
+    Topo->Node[k].NextSibling = *Head;
+    *Head = (UINT16)k;
+  }
+
+  return EFI_SUCCESS;
+}
+
+VOID
+PciFreeTopology(IN OUT PCI_TOPOLOGY *Topo)
+{
+  if (Topo->Node != NULL) FreePool(Topo->Node);
+  ZeroMem(Topo, sizeof(*Topo));
+}
+
+// Downstream-facing port: the upper end of a link.
+BOOLEAN
+PciIsDownstreamPort(IN PCI_TOPO_NODE *Node)
+{
+  return Node->PcieCap != 0 &&
+         (Node->PortType == PCIE_PORT_ROOT || Node->PortType == PCIE_PORT_SWITCH_DOWN);
+}
+
+// Function 0 of device 0 on the port's secondary bus, or PCI_NO_NODE.
+// The scan list is bus ordered, so that is the first entry of SecBus.
+UINT16
+PciLinkPartner(IN PCI_TOPOLOGY *Topo, UINTN PortIndex)
+{
+  PCI_TOPO_NODE *Port = &Topo->Node[PortIndex];
+
+  if (!PciIsDownstreamPort(Port) || Port->SecBus == 0) return PCI_NO_NODE;
+
+  UINT16 First = Topo->BusFirst[Port->SecBus];
+  if (First == PCI_NO_NODE) return PCI_NO_NODE;
+
+  PCI_DEV_INFO *c = &Topo->List[First];
+  if (c->Dev != 0 || c->Func != 0 || Topo->Node[First].PcieCap == 0) return PCI_NO_NODE;
+  return First;
+}
+
+// Port type label for the tree view and the audits.
+CONST CHAR16 *
+PortTypeName(PCI_TOPO_NODE *n)
+{
+  if (n->PcieCap == 0) return (n->HdrType == 0x01) ? L"PCI bridge" : L"PCI";
+  if (n->IsVf) return L"VF";
+
+  switch (n->PortType) {
+    case PCIE_PORT_ENDPOINT:        return L"Endpoint";
+    case PCIE_PORT_LEGACY_ENDPOINT: return L"Legacy EP";
+    case PCIE_PORT_ROOT:            return L"Root Port";
+    case PCIE_PORT_SWITCH_UP:       return L"Switch Up";
+    case PCIE_PORT_SWITCH_DOWN:     return L"Switch Down";
+    case PCIE_PORT_PCIE_TO_PCI:     return L"PCIe-PCI";
+    case PCIE_PORT_PCI_TO_PCIE:     return L"PCI-PCIe";
+    case PCIE_PORT_RCIEP:           return L"RCiEP";
+    case PCIE_PORT_RCEC:            return L"RCEC";
+    default:                        return L"PCIe";
+  }
+}
@@ -0,0 +1,243 @@
+#include "PciUtility.h"
+
+#define TREE_PAGE_SIZE   18
+#define TREE_MAX_INDENT  12
+
+//
+// The visible rows are the pre-order walk of the topology tree, skipping
+// children of collapsed nodes. Nothing is flattened: the view keeps the
+// first visible node (Top) and the cursor's row, and steps with
+// NextVisible/PrevVisible. Expand/collapse flips one flag; rendering
+// formats only the rows on screen.
+//
+typedef struct {
+  PCI_TOPOLOGY *Topo;
+  UINT16       *PrevSibling;
+  UINT16       *LastChild;
+  UINT8        *Depth;
+  BOOLEAN      *Expanded;
+  UINT16        Top;
+  UINT16        Sel;
+  UINTN         SelRow;     // Sel's row counted from Top
+} TREE_VIEW;
+
+STATIC
+BOOLEAN
+HasChildren(TREE_VIEW *T, UINT16 i)
+{
+  return T->Topo->Node[i].FirstChild != PCI_NO_NODE;
+}
+
+STATIC
+UINT16
+NextVisible(TREE_VIEW *T, UINT16 i)
+{
+  PCI_TOPO_NODE *Node = T->Topo->Node;
+
+  if (T->Expanded[i] && Node[i].FirstChild != PCI_NO_NODE) return Node[i].FirstChild;
+
+  for (; i != PCI_NO_NODE; i = Node[i].Parent) {
+    if (Node[i].NextSibling != PCI_NO_NODE) return Node[i].NextSibling;
+  }
+  return PCI_NO_NODE;
+}
+
+STATIC
+UINT16
+PrevVisible(TREE_VIEW *T, UINT16 i)
+{
+  UINT16 p = T->PrevSibling[i];
+  if (p == PCI_NO_NODE) return T->Topo->Node[i].Parent;
+
+  // Deepest last visible descendant of the previous sibling
+  while (T->Expanded[p] && T->LastChild[p] != PCI_NO_NODE) p = T->LastChild[p];
+  return p;
+}
+
+STATIC
+VOID
+MoveDown(TREE_VIEW *T)
+{
+  UINT16 n = NextVisible(T, T->Sel);
+  if (n == PCI_NO_NODE) return;
+
+  T->Sel = n;
+  if (T->SelRow + 1 < TREE_PAGE_SIZE) T->SelRow++;
+  else T->Top = NextVisible(T, T->Top);
+}
+
+STATIC
+VOID
+MoveUp(TREE_VIEW *T)
+{
+  UINT16 n = PrevVisible(T, T->Sel);
+  if (n == PCI_NO_NODE) return;
+
+  T->Sel = n;
+  if (T->SelRow > 0) T->SelRow--;
+  else T->Top = n;
+}
+
+// Makes Target visible by expanding its ancestors and puts it on top.
+STATIC
+VOID
+RevealNode(TREE_VIEW *T, UINT16 Target)
+{
+  for (UINT16 a = T->Topo->Node[Target].Parent; a != PCI_NO_NODE; a = T->Topo->Node[a].Parent) {
+    T->Expanded[a] = TRUE;
+  }
+  T->Top    = Target;
+  T->Sel    = Target;
+  T->SelRow = 0;
+}
+
+STATIC
+VOID
+SetAllExpanded(TREE_VIEW *T, BOOLEAN Expand)
+{
+  for (UINTN i = 0; i < T->Topo->Count; i++) T->Expanded[i] = Expand;
+
+  // The cursor may now sit inside a collapsed subtree: move it to the top-level ancestor
+  UINT16 s = T->Sel;
+  if (!Expand) {
+    while (T->Topo->Node[s].Parent != PCI_NO_NODE) s = T->Topo->Node[s].Parent;
+  }
+  RevealNode(T, s);
+}
+
+STATIC
+VOID
+RenderTree(TREE_VIEW *T)
+{
+  CHAR16 Indent[TREE_MAX_INDENT * 2 + 1];
+  CHAR16 Bridge[16];
+
+  ScreenBegin();
+  ScreenLine(L"PCI Topology Tree   functions:%u", (UINT32)T->Topo->Count);
+  ScreenLine(L"----------------------------------------------------------------------");
+
+  UINT16 i = T->Top;
+  for (UINTN Row = 0; Row < TREE_PAGE_SIZE && i != PCI_NO_NODE; Row++, i = NextVisible(T, i)) {
+    PCI_DEV_INFO  *p = &T->Topo->List[i];
+    PCI_TOPO_NODE *n = &T->Topo->Node[i];
+
+    UINTN Depth = MIN(T->Depth[i], TREE_MAX_INDENT);
+    SetMem16(Indent, Depth * 2 * sizeof(CHAR16), L' ');
+    Indent[Depth * 2] = L'\0';
+
+    CONST CHAR16 *Mark = !HasChildren(T, i) ? L"   " : T->Expanded[i] ? L"[-]" : L"[+]";
+
+    Bridge[0] = L'\0';
+    if (n->HdrType == 0x01) UnicodeSPrint(Bridge, sizeof(Bridge), L"  bus %02x-%02x", n->SecBus, n->SubBus);
+
+    ScreenLine(L"%s%s%s %02x/%02x/%02x  %04x:%04x  %-11s%s",
+               (i == T->Sel) ? L"> " : L"  ", Indent, Mark,
+               p->Bus, p->Dev, p->Func, p->Vid, p->Did, PortTypeName(n), Bridge);
+  }
+
+  ScreenLine(L"");
+  ScreenLine(L"Up/Down:Move  Right:Expand  Left:Collapse/Parent  Space:Toggle  Enter:Open");
+  ScreenLine(L"+:Expand all  -:Collapse all  F1:PgDn  F2:PgUp  Esc:Back");
+  ScreenEnd();
+}
+
+// Tree browser over the topology index. Starts with Sel revealed and
+// returns the function selected on exit.
+UINTN
+PciTreeView(IN PCI_TOPOLOGY *Topo, UINTN Sel)
+{
+  UINTN Count = Topo->Count;
+  if (Count == 0) return Sel;
+
+  TREE_VIEW T;
+  ZeroMem(&T, sizeof(T));
+  T.Topo        = Topo;
+  T.PrevSibling = AllocatePool(sizeof(UINT16) * Count);
+  T.LastChild   = AllocatePool(sizeof(UINT16) * Count);
+  T.Depth       = AllocateZeroPool(Count);
+  T.Expanded    = AllocateZeroPool(sizeof(BOOLEAN) * Count);
+  if (T.PrevSibling == NULL || T.LastChild == NULL || T.Depth == NULL || T.Expanded == NULL) {
+    if (T.PrevSibling) FreePool(T.PrevSibling);
+    if (T.LastChild) FreePool(T.LastChild);
+    if (T.Depth) FreePool(T.Depth);
+    if (T.Expanded) FreePool(T.Expanded);
+    return Sel;
+  }
+
+  // Back links and depth, once. Parents precede children in the list.
+  SetMem(T.PrevSibling, sizeof(UINT16) * Count, 0xFF);
+  SetMem(T.LastChild, sizeof(UINT16) * Count, 0xFF);
+  for (UINTN i = 0; i < Count; i++) {
+    PCI_TOPO_NODE *n = &Topo->Node[i];
+    if (n->NextSibling != PCI_NO_NODE) T.PrevSibling[n->NextSibling] = (UINT16)i;
+    if (n->Parent != PCI_NO_NODE) {
+      T.LastChild[n->Parent] = (UINT16)i;   // children are linked in list order
+      if (n->Parent < i) T.Depth[i] = (UINT8)MIN(T.Depth[n->Parent] + 1, 0xFF);
+    }
+  }
+
+  RevealNode(&T, (UINT16)Sel);
+
+  while (TRUE) {
+    RenderTree(&T);
+
+    EFI_INPUT_KEY Key;
+    WaitKey(&Key);
+    if (IsEsc(&Key)) break;
+
+    if (Key.UnicodeChar == CHAR_CARRIAGE_RETURN) {
+      PCI_DEV_INFO *p = &Topo->List[T.Sel];
+      ConfigViewLoop(p->Bus, p->Dev, p->Func, 0);
+      continue;
+    }
+
+    switch (Key.UnicodeChar) {
+      case L' ':
+        T.Expanded[T.Sel] = !T.Expanded[T.Sel];
+        continue;
+      case L'+':
+        SetAllExpanded(&T, TRUE);
+        continue;
+      case L'-':
+        SetAllExpanded(&T, FALSE);
+        continue;
+      default:
+        break;
+    }
+
+    switch (Key.ScanCode) {
+      case SCAN_UP:
+        MoveUp(&T);
+        break;
+      case SCAN_DOWN:
+        MoveDown(&T);
+        break;
+      case SCAN_RIGHT:
+        if (HasChildren(&T, T.Sel)) T.Expanded[T.Sel] = TRUE;
+        break;
+      case SCAN_LEFT:
+        if (T.Expanded[T.Sel] && HasChildren(&T, T.Sel)) {
+          T.Expanded[T.Sel] = FALSE;
+        } else {
+          UINT16 Parent = Topo->Node[T.Sel].Parent;
+          while (Parent != PCI_NO_NODE && T.Sel != Parent) MoveUp(&T);
+        }
+        break;
+      case SCAN_F1: // PageDown
+        for (UINTN k = 0; k < TREE_PAGE_SIZE; k++) MoveDown(&T);
+        break;
+      case SCAN_F2: // PageUp
+        for (UINTN k = 0; k < TREE_PAGE_SIZE; k++) MoveUp(&T);
+        break;
+      default:
+        break;
+    }
+  }
+
+  Sel = T.Sel;
+  FreePool(T.Expanded);
+  FreePool(T.Depth);
+  FreePool(T.LastChild);
+  FreePool(T.PrevSibling);
+  return Sel;
+}
@@ -1,60 +1,68 @@
-#include <Uefi.h>
+#include "PciUtility.h"
 
-#include <Protocol/PciRootBridgeIo.h>
+#include <Protocol/ShellParameters.h>
 
-#include <Library/UefiLib.h>
-#include <Library/UefiBootServicesTableLib.h>
-#include <Library/MemoryAllocationLib.h>
-#include <Library/BaseLib.h>
-#include <Library/BaseMemoryLib.h>
-#include <Library/PrintLib.h>
+EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *mRbIo = NULL;
 
-#define MAX_PCI_DEVS  4096
-
-typedef enum {
-  DISP_BYTE  = 0,
-  DISP_WORD  = 1,
-  DISP_DWORD = 2
-} DISP_MODE;
-
-typedef struct {
-  UINT8  Bus;
-  UINT8  Dev;
-  UINT8  Func;
-  UINT16 Vid;
-  UINT16 Did;
-  UINT8  BaseClass;
-  UINT8  SubClass;
-  UINT8  ProgIf;
-} PCI_DEV_INFO;
-
-STATIC EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *mRbIo = NULL;
 STATIC BOOLEAN gDangerousUnlocked = FALSE;
 
+STATIC BOOLEAN mOptMp   = FALSE;
+STATIC BOOLEAN mOptDump = FALSE;
+STATIC BOOLEAN mOptLink = FALSE;
+STATIC CONST CHAR16 *mOptCheck = NULL;   // golden rule file
+STATIC UINT32  mOptCrsMs = PCI_CRS_DEFAULT_DEADLINE_MS;
+STATIC CONST CHAR16 *mOptImage = NULL;   // config space image instead of hardware
+STATIC CONST CHAR16 *mOptSample = NULL;  // sampler spec file
+STATIC BOOLEAN mOptVpd    = FALSE;       // print the VPD inventory and exit
+STATIC BOOLEAN mOptSerial = FALSE;       // headless: compact frames, changed rows only
+STATIC BOOLEAN mOptGop    = FALSE;       // draw frames on GOP from a glyph cache
+STATIC CONST CHAR16 *mOptJournal = NULL; // write journal file, flushed on rollback / exit
+
+STATIC PCI_TOPOLOGY mTopo;
+
+#define MAX_SNAPSHOTS 4
+STATIC PCI_SNAPSHOT mSnap[MAX_SNAPSHOTS];   // ring, newest at mSnapNext - 1
+STATIC UINTN        mSnapNext  = 0;
+STATIC UINTN        mSnapCount = 0;
+
 // -----------------------------
 // Helpers: Console / Keys
 // -----------------------------
-STATIC
 VOID
 WaitKey(OUT EFI_INPUT_KEY *Key)
 {
-  while (gST->ConIn->ReadKeyStroke(gST->ConIn, Key) == EFI_NOT_READY) {}
+  UINTN Index;
+
+  // Sleep on the key event instead of polling ReadKeyStroke
+  while (gST->ConIn->ReadKeyStroke(gST->ConIn, Key) == EFI_NOT_READY) {
+    gBS->WaitForEvent(1, &gST->ConIn->WaitForKey, &Index);
+  }
 }
 
-STATIC
 VOID
 ClearScreen(VOID)
 {
   gST->ConOut->ClearScreen(gST->ConOut);
+  ScreenInvalidate();
 }
 
-STATIC
 BOOLEAN
 IsEsc(IN EFI_INPUT_KEY *Key)
 {
   return (Key->UnicodeChar == 0 && Key->ScanCode == SCAN_ESC);
 }
 
+// Prompt and wait for one key; TRUE only for Y/y.
+BOOLEAN
+ConfirmKey(IN CONST CHAR16 *Prompt)
+{
+  EFI_INPUT_KEY Key;
+  Print(L"%s (Y/N) ", Prompt);
+  WaitKey(&Key);
+  Print(L"\n");
+  return (Key.UnicodeChar == L'y' || Key.UnicodeChar == L'Y');
+}
+
 STATIC
 BOOLEAN
 IsEnter(IN EFI_INPUT_KEY *Key)
@@ -72,31 +80,31 @@ IsTab(IN EFI_INPUT_KEY *Key)
 // -----------------------------
 // Helpers: PCI RBIO access
 // -----------------------------
+// Config access goes through PciConfigAccessLib; mRbIo stays for MMIO (MSI-X tables).
 STATIC
 EFI_STATUS
 InitRbIo(VOID)
 {
-  return gBS->LocateProtocol(&gEfiPciRootBridgeIoProtocolGuid, NULL, (VOID**)&mRbIo);
+  EFI_STATUS Status = gBS->LocateProtocol(&gEfiPciRootBridgeIoProtocolGuid, NULL, (VOID**)&mRbIo);
+  if (EFI_ERROR(Status) || mRbIo == NULL) return EFI_ERROR(Status) ? Status : EFI_NOT_FOUND;
+  return PciCfgUseRootBridgeIo(mRbIo);
 }
 
-// Address[7:0]=Reg, [15:8]=Func, [23:16]=Dev, [31:24]=Bus  (0x00~0xFF)
+// Offline mode: every tool runs on a config space image (writes stay in memory).
 STATIC
-UINT64
-PciCfgAddr(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg)
+EFI_STATUS
+InitImage(IN CONST CHAR16 *Path)
 {
-  return (UINT64)(Reg & 0xFF) |
-         ((UINT64)Func << 8) |
-         ((UINT64)Dev  << 16) |
-         ((UINT64)Bus  << 24);
-}
+  UINT8 *Data = NULL;
+  UINTN  Size = 0;
 
-STATIC EFI_STATUS PciRead8 (UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINT8  *V){ return mRbIo->Pci.Read (mRbIo, EfiPciWidthUint8,  PciCfgAddr(B,D,F,R), 1, V); }
-STATIC EFI_STATUS PciRead16(UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINT16 *V){ return mRbIo->Pci.Read (mRbIo, EfiPciWidthUint16, PciCfgAddr(B,D,F,R), 1, V); }
-STATIC EFI_STATUS PciRead32(UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINT32 *V){ return mRbIo->Pci.Read (mRbIo, EfiPciWidthUint32, PciCfgAddr(B,D,F,R), 1, V); }
+  EFI_STATUS Status = PciFileRead(Path, SIZE_32MB, &Data, &Size);
+  if (EFI_ERROR(Status)) return Status;
 
-STATIC EFI_STATUS PciWrite8 (UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINT8  V){ return mRbIo->Pci.Write(mRbIo, EfiPciWidthUint8,  PciCfgAddr(B,D,F,R), 1, &V); }
-STATIC EFI_STATUS PciWrite16(UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINT16 V){ return mRbIo->Pci.Write(mRbIo, EfiPciWidthUint16, PciCfgAddr(B,D,F,R), 1, &V); }
-STATIC EFI_STATUS PciWrite32(UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINT32 V){ return mRbIo->Pci.Write(mRbIo, EfiPciWidthUint32, PciCfgAddr(B,D,F,R), 1, &V); }
+  Status = PciCfgUseImage(Data, Size);
+  FreePool(Data);
+  return Status;
+}
 
 // -----------------------------
 // Cursor helpers
@@ -120,39 +128,13 @@ StepByMode(DISP_MODE Mode)
 }
 
 // -----------------------------
-// Safety / Policy
+// Safety / Policy (table: PciWritePolicy.c)
 // -----------------------------
-typedef enum {
-  WP_BLOCK_RO,
-  WP_RW_DIRECT,
-  WP_RW1C,
-  WP_DANGEROUS_BAR,
-  WP_DANGEROUS_CAP
-} WRITE_POLICY;
-
 STATIC
-WRITE_POLICY
-GetWritePolicy(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode)
+BOOLEAN
+PolicyBlocked(WRITE_POLICY Pol)
 {
-  (VOID)Bus; (VOID)Dev; (VOID)Func;
-  Off = AlignCursor(Off, Mode);
-
-  // RO standard fields
-  if (Off < 0x04) return WP_BLOCK_RO; // VID/DID
-  if (Off == 0x08) return WP_BLOCK_RO; // Revision
-  if (Off == 0x09 || Off == 0x0A || Off == 0x0B) return WP_BLOCK_RO; // Class/ProgIF
-  if (Off == 0x0E) return WP_BLOCK_RO; // HeaderType
-
-  // RW1C (Status, WORD)
-  if (Off == 0x06 && Mode == DISP_WORD) return WP_RW1C;
-
-  // BAR/resource
-  if (Off >= 0x10 && Off <= 0x24) return WP_DANGEROUS_BAR;
-
-  // Capabilities / extended area
-  if (Off >= 0x34) return WP_DANGEROUS_CAP;
-
-  return WP_RW_DIRECT;
+  return Pol == WP_BLOCK_RO || (PolicyIsDangerous(Pol) && !gDangerousUnlocked);
 }
 
 STATIC
@@ -190,16 +172,16 @@ ProbeWritableMaskAtCursor(
 
   if (Mode == DISP_BYTE) {
     UINT8 Old=0, Rb=0, Test=0;
-    Status = PciRead8(Bus,Dev,Func,Cursor,&Old);
+    Status = PciCfgRead8(Bus,Dev,Func,Cursor,&Old);
     if (EFI_ERROR(Status)) return Status;
 
     Test = (UINT8)~Old;
 
-    Status = PciWrite8(Bus,Dev,Func,Cursor,Test);
+    Status = PciCfgWrite8(Bus,Dev,Func,Cursor,Test);
     if (EFI_ERROR(Status)) return Status;
 
-    Status = PciRead8(Bus,Dev,Func,Cursor,&Rb);
-    PciWrite8(Bus,Dev,Func,Cursor,Old); // restore anyway
+    Status = PciCfgRead8(Bus,Dev,Func,Cursor,&Rb);
+    PciCfgWrite8(Bus,Dev,Func,Cursor,Old); // restore anyway
     if (EFI_ERROR(Status)) return Status;
 
     *OutOld = Old;
@@ -210,16 +192,16 @@ ProbeWritableMaskAtCursor(
 
   } else if (Mode == DISP_WORD) {
     UINT16 Old=0, Rb=0, Test=0;
-    Status = PciRead16(Bus,Dev,Func,Cursor,&Old);
+    Status = PciCfgRead16(Bus,Dev,Func,Cursor,&Old);
     if (EFI_ERROR(Status)) return Status;
 
     Test = (UINT16)~Old;
 
-    Status = PciWrite16(Bus,Dev,Func,Cursor,Test);
+    Status = PciCfgWrite16(Bus,Dev,Func,Cursor,Test);
     if (EFI_ERROR(Status)) return Status;
 
-    Status = PciRead16(Bus,Dev,Func,Cursor,&Rb);
-    PciWrite16(Bus,Dev,Func,Cursor,Old); // restore anyway
+    Status = PciCfgRead16(Bus,Dev,Func,Cursor,&Rb);
+    PciCfgWrite16(Bus,Dev,Func,Cursor,Old); // restore anyway
     if (EFI_ERROR(Status)) return Status;
 
     *OutOld = Old;
@@ -230,16 +212,16 @@ ProbeWritableMaskAtCursor(
 
   } else {
     UINT32 Old=0, Rb=0, Test=0;
-    Status = PciRead32(Bus,Dev,Func,Cursor,&Old);
+    Status = PciCfgRead32(Bus,Dev,Func,Cursor,&Old);
     if (EFI_ERROR(Status)) return Status;
 
     Test = ~Old;
 
-    Status = PciWrite32(Bus,Dev,Func,Cursor,Test);
+    Status = PciCfgWrite32(Bus,Dev,Func,Cursor,Test);
     if (EFI_ERROR(Status)) return Status;
 
-    Status = PciRead32(Bus,Dev,Func,Cursor,&Rb);
-    PciWrite32(Bus,Dev,Func,Cursor,Old); // restore anyway
+    Status = PciCfgRead32(Bus,Dev,Func,Cursor,&Rb);
+    PciCfgWrite32(Bus,Dev,Func,Cursor,Old); // restore anyway
     if (EFI_ERROR(Status)) return Status;
 
     *OutOld = Old;
@@ -253,28 +235,74 @@ ProbeWritableMaskAtCursor(
 // -----------------------------
 // PCI scan
 // -----------------------------
-STATIC
-BOOLEAN
-ReadPciFuncInfo(UINT8 Bus, UINT8 Dev, UINT8 Func, OUT PCI_DEV_INFO *Out)
+PCI_PROBE
+PciProbeFunc(UINT8 Bus, UINT8 Dev, UINT8 Func, OUT PCI_DEV_INFO *Out)
 {
   UINT16 Vid;
-  if (EFI_ERROR(PciRead16(Bus, Dev, Func, 0x00, &Vid)) || Vid == 0xFFFF) {
-    return FALSE;
+  if (EFI_ERROR(PciCfgRead16(Bus, Dev, Func, 0x00, &Vid)) || Vid == 0xFFFF) {
+    return PCI_PROBE_ABSENT;
+  }
+  if (Vid == 0x0001) {
+    return PCI_PROBE_RETRY;
   }
 
-  UINT16 Did; PciRead16(Bus, Dev, Func, 0x02, &Did);
+  UINT16 Did; PciCfgRead16(Bus, Dev, Func, 0x02, &Did);
   UINT8  ProgIf, Sub, Base;
-  PciRead8(Bus, Dev, Func, 0x09, &ProgIf);
-  PciRead8(Bus, Dev, Func, 0x0A, &Sub);
-  PciRead8(Bus, Dev, Func, 0x0B, &Base);
+  PciCfgRead8(Bus, Dev, Func, 0x09, &ProgIf);
+  PciCfgRead8(Bus, Dev, Func, 0x0A, &Sub);
+  PciCfgRead8(Bus, Dev, Func, 0x0B, &Base);
 
   Out->Bus = Bus; Out->Dev = Dev; Out->Func = Func;
   Out->Vid = Vid; Out->Did = Did;
   Out->ProgIf = ProgIf; Out->SubClass = Sub; Out->BaseClass = Base;
-  return TRUE;
+  return PCI_PROBE_PRESENT;
 }
 
+// Appends a present function; a retrying one goes to the CRS queue.
 STATIC
+PCI_PROBE
+AddPciFunc(UINT8 Bus, UINT8 Dev, UINT8 Func, PCI_DEV_INFO *List, IN OUT UINTN *Count)
+{
+  PCI_DEV_INFO Info;
+  PCI_PROBE r = PciProbeFunc(Bus, Dev, Func, &Info);
+
+  if (r == PCI_PROBE_PRESENT && *Count < MAX_PCI_DEVS) List[(*Count)++] = Info;
+  if (r == PCI_PROBE_RETRY) PciCrsDefer(Bus, Dev, Func);
+  return r;
+}
+
+// Functions 1-7 of a present function 0, if it is multi-function.
+VOID
+ScanPciDevFuncs(UINT8 Bus, UINT8 Dev, PCI_DEV_INFO *List, IN OUT UINTN *Count)
+{
+  UINT8 HdrType = 0;
+  PciCfgRead8(Bus, Dev, 0, 0x0E, &HdrType);
+  if ((HdrType & 0x80) == 0) {
+    return;
+  }
+
+  for (UINT8 Func = 1; Func <= 7; Func++) {
+    AddPciFunc(Bus, Dev, Func, List, Count);
+  }
+}
+
+// Scan one bus (dev 0-31, multi-function aware) and append to List.
+VOID
+ScanPciBus(UINT8 Bus, PCI_DEV_INFO *List, IN OUT UINTN *Count)
+{
+  for (UINT8 Dev = 0; Dev <= 31; Dev++) {
+    UINT64 t0 = PciCrsNowNs();
+
+    if (AddPciFunc(Bus, Dev, 0, List, Count) == PCI_PROBE_PRESENT) {
+      ScanPciDevFuncs(Bus, Dev, List, Count);
+    }
+
+    PciCrsNoteProbe(Bus, Dev, PciCrsNowNs() - t0);
+  }
+}
+
+// PciCrsBegin() must have been called; CRS devices are re-polled between
+// buses and the rest waits for the deadline in PciCrsFinish().
 UINTN
 ScanAllPci(OUT PCI_DEV_INFO **OutList)
 {
@@ -284,29 +312,10 @@ ScanAllPci(OUT PCI_DEV_INFO **OutList)
   UINTN Count = 0;
 
   for (UINT16 Bus = 0; Bus <= 255; Bus++) {
-    for (UINT16 Dev = 0; Dev <= 31; Dev++) {
-
-      PCI_DEV_INFO Info0;
-      if (!ReadPciFuncInfo((UINT8)Bus, (UINT8)Dev, 0, &Info0)) {
-        continue;
-      }
-
-      if (Count < MAX_PCI_DEVS) List[Count++] = Info0;
-
-      UINT8 HdrType = 0;
-      PciRead8((UINT8)Bus, (UINT8)Dev, 0, 0x0E, &HdrType);
-      if ((HdrType & 0x80) == 0) {
-        continue;
-      }
-
-      for (UINT16 Func = 1; Func <= 7; Func++) {
-        PCI_DEV_INFO Info;
-        if (ReadPciFuncInfo((UINT8)Bus, (UINT8)Dev, (UINT8)Func, &Info)) {
-          if (Count < MAX_PCI_DEVS) List[Count++] = Info;
-        }
-      }
-    }
+    ScanPciBus((UINT8)Bus, List, &Count);
+    PciCrsPoll(List, &Count);
   }
+  PciCrsFinish(List, &Count);
 
   *OutList = List;
   return Count;
@@ -315,14 +324,23 @@ ScanAllPci(OUT PCI_DEV_INFO **OutList)
 // -----------------------------
 // UI: List screen
 // -----------------------------
+// Headless: one header row, one row per device, one help row.
 STATIC
 VOID
 RenderListScreen(PCI_DEV_INFO *List, UINTN Count, UINTN Sel, UINTN Page, UINTN PageSize)
 {
-  ClearScreen();
+  BOOLEAN Compact = ScreenHeadless();
+
+  ScreenBegin();
 
-  Print(L"VendorID  DeviceID  Class     Bus/Dev/Func\n");
-  Print(L"------------------------------------------\n");
+  if (Compact) {
+    ScreenLine(L"PCI %u dev  page %u/%u  %s  %s",
+               (UINT32)Count, (UINT32)(Page + 1), (UINT32)((Count + PageSize - 1) / PageSize),
+               PciCfgGetBackend()->Name, gDangerousUnlocked ? L"UNLOCKED" : L"LOCKED");
+  } else {
+    ScreenLine(L"VendorID  DeviceID  Class     Bus/Dev/Func");
+    ScreenLine(L"------------------------------------------");
+  }
 
   UINTN Start = Page * PageSize;
   UINTN End   = Start + PageSize;
@@ -330,86 +348,114 @@ RenderListScreen(PCI_DEV_INFO *List, UINTN Count, UINTN Sel, UINTN Page, UINTN P
 
   for (UINTN i = Start; i < End; i++) {
     PCI_DEV_INFO *p = &List[i];
-    BOOLEAN isSel = (i == Sel);
+    CONST CHAR16 *Mark = (i == Sel) ? L">" : L" ";
 
-    if (isSel) Print(L"> ");
-    else       Print(L"  ");
+    if (Compact) {
+      ScreenLine(L"%s%02x:%02x.%x %04x:%04x %02x%02x%02x",
+                 Mark, p->Bus, p->Dev, p->Func, p->Vid, p->Did, p->BaseClass, p->SubClass, p->ProgIf);
+    } else {
+      ScreenLine(L"%s %04x      %04x      %02x%02x%02x   %02x/%02x/%02x",
+                 Mark, p->Vid, p->Did, p->BaseClass, p->SubClass, p->ProgIf,
+                 p->Bus, p->Dev, p->Func);
+    }
+  }
 
-    Print(L"%04x      %04x      %02x%02x%02x   %02x/%02x/%02x\n",
-          p->Vid, p->Did, p->BaseClass, p->SubClass, p->ProgIf,
-          p->Bus, p->Dev, p->Func);
+  if (Compact) {
+    ScreenLine(L"Enter T C L M A E X O S F V I B J R D P  F1/F2:Pg  F9:Unlock  Esc");
+  } else {
+    ScreenLine(L"Up/Down:Select  Enter:Open  T:Tree  C:Scan timing  Esc:Exit  F1:PgDn  F2:PgUp");
+    ScreenLine(L"L:Link audit  M:MPS/MRRS  A:ASPM  E:AER  X:MSI-X  O:Oversub  D:DMA features  R:ReBAR");
+    ScreenLine(L"S:Snapshot  F:Find  V:VPD  I:SR-IOV  B:BAR map  J:Write journal  P:P2P / ACS");
+    ScreenLine(L"[Page:%u/%u]  Devices:%u  Access:%s  F9:Unlock(%s)",
+               (UINT32)(Page + 1),
+               (UINT32)((Count + PageSize - 1) / PageSize),
+               (UINT32)Count,
+               PciCfgGetBackend()->Name,
+               gDangerousUnlocked ? L"UNLOCKED" : L"LOCKED");
   }
 
-  Print(L"\nUp/Down:Select  Enter:Open  Esc:Exit  F1:PgDn  F2:PgUp\n");
-  Print(L"[Page:%u/%u]  Devices:%u\n",
-        (UINT32)(Page + 1),
-        (UINT32)((Count + PageSize - 1) / PageSize),
-        (UINT32)Count);
+  ScreenEnd();
 }
 
 // -----------------------------
 // UI: Config view / edit
 // -----------------------------
-STATIC
 VOID
 ReadConfig256(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT8 *Buf256)
 {
-  for (UINT16 off = 0; off < 0x100; off++) {
-    UINT8 v = 0;
-    PciRead8(Bus, Dev, Func, off, &v);
-    Buf256[off] = v;
+  if (EFI_ERROR(PciCfgReadBytes(Bus, Dev, Func, 0, 0x100, Buf256))) {
+    SetMem(Buf256, 0x100, 0xFF);
   }
 }
 
+// 256-byte window of the 4KB space in one bulk read (Base = 0x000..0xF00)
 STATIC
 VOID
-RenderConfigScreen(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT8 *Buf, DISP_MODE Mode, UINT16 Cursor)
+ReadConfigWindow(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Base, UINT8 *Buf256)
 {
-  ClearScreen();
+  if (EFI_ERROR(PciCfgReadBulk32(Bus, Dev, Func, Base, 0x100 / 4, (UINT32 *)Buf256))) {
+    SetMem(Buf256, 0x100, 0xFF);
+  }
+}
 
-  Print(L"PCI Config Space (0x00-0xFF)   Bus:%02x Dev:%02x Func:%02x\n", Bus, Dev, Func);
-  Print(L"Mode:%s  Tab:Switch  Arrows:Move  Enter:Write  P:Probe  F9:Unlock  Esc:Back\n",
-        (Mode == DISP_BYTE) ? L"BYTE" : (Mode == DISP_WORD) ? L"WORD" : L"DWORD");
-  Print(L"Dangerous Writes: %s\n", gDangerousUnlocked ? L"UNLOCKED" : L"LOCKED");
-  Print(L"------------------------------------------------------------\n");
+// One 16-byte row; Cursor is window relative.
+STATIC
+VOID
+FormatConfigRow(OUT CHAR16 *Row, UINTN RowSize, UINT8 *Buf, UINT16 Base, UINT16 RowOff, DISP_MODE Mode, UINT16 Cursor)
+{
+  UINTN Step = StepByMode(Mode);
+  UINTN Len  = UnicodeSPrint(Row, RowSize, L"%03x  ", Base + RowOff);
 
-  Cursor = AlignCursor(Cursor, Mode);
+  for (UINT16 i = 0; i < 0x10; i = (UINT16)(i + Step)) {
+    UINT16 off = (UINT16)(RowOff + i);
+    UINT32 v   = (Mode == DISP_BYTE) ? Buf[off] : (Mode == DISP_WORD) ? *(UINT16*)&Buf[off] : *(UINT32*)&Buf[off];
+    BOOLEAN At = (off == Cursor);
 
-  for (UINT16 row = 0; row < 0x100; row += 0x10) {
-    Print(L"%02x  ", row);
+    Len += UnicodeSPrint(Row + Len, RowSize - Len * sizeof(CHAR16),
+                         (Mode == DISP_BYTE) ? L"%s%02x%s " : (Mode == DISP_WORD) ? L"%s%04x%s " : L"%s%08x%s ",
+                         At ? L"[" : L"", v, At ? L"]" : L"");
+  }
+}
 
-    if (Mode == DISP_BYTE) {
-      for (UINT16 i = 0; i < 0x10; i++) {
-        UINT16 off = (UINT16)(row + i);
-        if (off == Cursor) Print(L"[");
-        Print(L"%02x", Buf[off]);
-        if (off == Cursor) Print(L"]");
-        Print(L" ");
-      }
-    } else if (Mode == DISP_WORD) {
-      for (UINT16 i = 0; i < 0x10; i += 2) {
-        UINT16 off = (UINT16)(row + i);
-        UINT16 v = *(UINT16*)&Buf[off];
-        if (off == Cursor) Print(L"[");
-        Print(L"%04x", v);
-        if (off == Cursor) Print(L"]");
-        Print(L" ");
-      }
-    } else {
-      for (UINT16 i = 0; i < 0x10; i += 4) {
-        UINT16 off = (UINT16)(row + i);
-        UINT32 v = *(UINT32*)&Buf[off];
-        if (off == Cursor) Print(L"[");
-        Print(L"%08x", v);
-        if (off == Cursor) Print(L"]");
-        Print(L" ");
-      }
-    }
+// Headless: one status row, the 16 data rows, one help row.
+STATIC
+VOID
+RenderConfigScreen(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT8 *Buf, UINT16 Base, DISP_MODE Mode, UINT16 Cursor)
+{
+  BOOLEAN       Compact  = ScreenHeadless();
+  CONST CHAR16 *ModeName = (Mode == DISP_BYTE) ? L"BYTE" : (Mode == DISP_WORD) ? L"WORD" : L"DWORD";
+  CHAR16        Row[REPORT_LINE_LEN];
+
+  ScreenBegin();
 
-    Print(L"\n");
+  if (Compact) {
+    ScreenLine(L"%02x:%02x.%x  %03x-%03x  %s  @%03x  %s",
+               Bus, Dev, Func, Base, Base + 0xFF, ModeName,
+               AlignCursor(Cursor, Mode), gDangerousUnlocked ? L"UNLOCKED" : L"LOCKED");
+  } else {
+    ScreenLine(L"PCI Config Space (0x%03x-0x%03x)   Bus:%02x Dev:%02x Func:%02x   F1/F2:Next/Prev 256",
+               Base, Base + 0xFF, Bus, Dev, Func);
+    ScreenLine(L"Mode:%s  Tab:Switch  Arrows:Move  Enter:Write  R:Range  P:Probe  X:MSI-X  V:VPD  Esc:Back%s",
+               ModeName, (ScreenGetMode() == SCREEN_GOP) ? L"  G:4KB" : L"");
+    ScreenLine(L"Dangerous Writes: %s  (F9:Unlock)  J:Write journal", gDangerousUnlocked ? L"UNLOCKED" : L"LOCKED");
+    ScreenLine(L"------------------------------------------------------------");
   }
 
-  Print(L"\nCursor Offset: 0x%02x\n", Cursor);
+  Cursor = (UINT16)(AlignCursor(Cursor, Mode) - Base);   // window relative
+
+  for (UINT16 row = 0; row < 0x100; row += 0x10) {
+    FormatConfigRow(Row, sizeof(Row), Buf, Base, row, Mode, Cursor);
+    ScreenLine(L"%s", Row);
+  }
+
+  if (Compact) {
+    ScreenLine(L"Tab Arrows Enter R P X V J  F1/F2:256  F9:Unlock  Esc");
+  } else {
+    ScreenLine(L"");
+    ScreenLine(L"Cursor Offset: 0x%03x", Base + Cursor);
+  }
+
+  ScreenEnd();
 }
 
 // -----------------------------
@@ -431,7 +477,6 @@ HexVal(CHAR16 c)
   return 10U + (UINTN)(c - L'A');
 }
 
-STATIC
 EFI_STATUS
 ReadFixedHex(UINTN Digits, OUT UINT64 *OutVal)
 {
@@ -455,124 +500,304 @@ ReadFixedHex(UINTN Digits, OUT UINT64 *OutVal)
 }
 
 // -----------------------------
-// Write at cursor (safe)
+// Policy-checked write (non-interactive)
 // -----------------------------
 STATIC
 EFI_STATUS
-DoWriteAtCursor(UINT8 Bus, UINT8 Dev, UINT8 Func, DISP_MODE Mode, UINT16 Cursor)
+PciReadByMode(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode, OUT UINT32 *Val)
 {
-  Cursor = AlignCursor(Cursor, Mode);
-  WRITE_POLICY Pol = GetWritePolicy(Bus, Dev, Func, Cursor, Mode);
+  EFI_STATUS Status;
+  *Val = 0;
+  if (Mode == DISP_BYTE)      { UINT8  v = 0; Status = PciCfgRead8 (Bus, Dev, Func, Off, &v); *Val = v; }
+  else if (Mode == DISP_WORD) { UINT16 v = 0; Status = PciCfgRead16(Bus, Dev, Func, Off, &v); *Val = v; }
+  else                        { Status = PciCfgRead32(Bus, Dev, Func, Off, Val); }
+  return Status;
+}
 
-  if (Pol == WP_BLOCK_RO) {
-    ClearScreen();
-    Print(L"WRITE BLOCKED (RO)\nBus:%02x Dev:%02x Func:%02x Offset:0x%02x\n\n", Bus, Dev, Func, Cursor);
-    Print(L"Press any key...\n");
-    EFI_INPUT_KEY K; WaitKey(&K);
-    return EFI_ACCESS_DENIED;
+STATIC
+EFI_STATUS
+PciWriteByMode(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode, UINT32 Val)
+{
+  if (Mode == DISP_BYTE) return PciCfgWrite8 (Bus, Dev, Func, Off, (UINT8)Val);
+  if (Mode == DISP_WORD) return PciCfgWrite16(Bus, Dev, Func, Off, (UINT16)Val);
+  return PciCfgWrite32(Bus, Dev, Func, Off, Val);
+}
+
+// Same policy as DoWriteAtCursor, for the analyzers' bulk "apply" actions.
+// Only Mask bits change (RMW); RW1C registers get Value & Mask as the clear mask.
+// Returns EFI_ACCESS_DENIED when the policy blocks the write and
+// EFI_DEVICE_ERROR when the Mask bits do not read back as written.
+EFI_STATUS
+PolicyWrite(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode,
+            UINT32 Mask, UINT32 Value, OUT UINT32 *ReadBack OPTIONAL)
+{
+  Off = AlignCursor(Off, Mode);
+  WRITE_POLICY Pol = PolicyLookup(Bus, Dev, Func, Off, Mode);
+
+  if (PolicyBlocked(Pol)) return EFI_ACCESS_DENIED;
+
+  UINT32 Old = 0, Final, Rb = 0;
+  EFI_STATUS Status = PciReadByMode(Bus, Dev, Func, Off, Mode, &Old);
+  if (EFI_ERROR(Status)) return Status;
+
+  // RMW writes 0 to the RW1C bits of a mixed register (e.g. Control + Status, PMCSR)
+  if (PolicyIsRw1c(Pol)) Final = Value & Mask;
+  else Final = (Old & ~Mask & ~PolicyRw1cLanes(Bus, Dev, Func, Off, Mode)) | (Value & Mask);
+
+  Status = PciWriteByMode(Bus, Dev, Func, Off, Mode, Final);
+  if (EFI_ERROR(Status)) return Status;
+  JournalAdd(Bus, Dev, Func, Off, Mode, Old, Final, PolicyIsRw1c(Pol));
+
+  PciReadByMode(Bus, Dev, Func, Off, Mode, &Rb);
+  if (ReadBack != NULL) *ReadBack = Rb;
+
+  if (!PolicyIsRw1c(Pol) && (Rb & Mask) != (Value & Mask)) return EFI_DEVICE_ERROR;
+  return EFI_SUCCESS;
+}
+
+// Write-1-to-clear through the same lock checks; writes exactly ClearMask
+// (no RMW, which would also clear every other set bit) and reads back.
+EFI_STATUS
+PolicyClearRw1c(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode,
+                UINT32 ClearMask, OUT UINT32 *After OPTIONAL)
+{
+  Off = AlignCursor(Off, Mode);
+  if (PolicyBlocked(PolicyLookup(Bus, Dev, Func, Off, Mode))) return EFI_ACCESS_DENIED;
+
+  // Only real clears go to the journal (the AER auto-clear writes 0 on every sample)
+  UINT32 Before = 0;
+  if (ClearMask != 0) PciReadByMode(Bus, Dev, Func, Off, Mode, &Before);
+
+  EFI_STATUS Status = PciWriteByMode(Bus, Dev, Func, Off, Mode, ClearMask);
+  if (!EFI_ERROR(Status) && ClearMask != 0) JournalAdd(Bus, Dev, Func, Off, Mode, Before, ClearMask, TRUE);
+  if (!EFI_ERROR(Status) && After != NULL) {
+    PciReadByMode(Bus, Dev, Func, Off, Mode, After);
   }
+  return Status;
+}
+
+BOOLEAN
+DangerousWritesUnlocked(VOID)
+{
+  return gDangerousUnlocked;
+}
+
+// Range form of the policy for fill / pattern / copy: every byte must be
+// writable as a byte, and no RW1C byte may be covered (a bulk write would
+// clear its set bits). BAR / CAP bytes need the F9 unlock. A byte with
+// only some RW1C bits passes; RangeWrite refuses data with a 1 there.
+EFI_STATUS
+PolicyCheckRange(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Start, UINTN Length, OUT UINT16 *BadOff OPTIONAL)
+{
+  for (UINTN k = 0; k < Length; k++) {
+    UINT16 Off = (UINT16)(Start + k);
+    WRITE_POLICY Pol = PolicyLookup(Bus, Dev, Func, Off, DISP_BYTE);
+
+    if (PolicyBlocked(Pol) || PolicyIsRw1c(Pol)) {
+      if (BadOff != NULL) *BadOff = Off;
+      return EFI_ACCESS_DENIED;
+    }
+  }
+  return EFI_SUCCESS;
+}
+
+// -----------------------------
+// Write at cursor (safe)
+// -----------------------------
+STATIC
+EFI_STATUS
+DoWriteAtCursor(UINT8 Bus, UINT8 Dev, UINT8 Func, DISP_MODE Mode, UINT16 Cursor)
+{
+  PCI_REPORT Rep;
 
-  if ((Pol == WP_DANGEROUS_BAR || Pol == WP_DANGEROUS_CAP) && !gDangerousUnlocked) {
-    ClearScreen();
-    Print(L"WRITE BLOCKED (Dangerous)\nBus:%02x Dev:%02x Func:%02x Offset:0x%02x\n\n", Bus, Dev, Func, Cursor);
-    Print(L"BAR(0x10-0x24) / CAP(>=0x34) blocked. Press F9 to unlock.\n");
-    Print(L"Press any key...\n");
-    EFI_INPUT_KEY K; WaitKey(&K);
+  Cursor = AlignCursor(Cursor, Mode);
+  WRITE_POLICY Pol = PolicyLookup(Bus, Dev, Func, Cursor, Mode);
+
+  if (Pol == WP_BLOCK_RO || PolicyBlocked(Pol)) {
+    ReportInit(&Rep);
+    ReportAdd(&Rep, L"Bus:%02x Dev:%02x Func:%02x Offset:0x%03x", Bus, Dev, Func, Cursor);
+    ReportAdd(&Rep, L"");
+    if (Pol == WP_BLOCK_RO) ReportAdd(&Rep, L"Read-only.");
+    else                    ReportAdd(&Rep, L"%s blocked. Press F9 to unlock.", PolicyName(Pol));
+    ReportShow((Pol == WP_BLOCK_RO) ? L"WRITE BLOCKED (RO)" : L"WRITE BLOCKED (Dangerous)", &Rep);
+    ReportFree(&Rep);
     return EFI_ACCESS_DENIED;
   }
 
-  ClearScreen();
-  Print(L"WRITE PCI CONFIG  Bus:%02x Dev:%02x Func:%02x  Offset:0x%02x\n", Bus, Dev, Func, Cursor);
-  Print(L"Input HEX (%u digits).  Esc:Cancel\n\n", (Mode==DISP_BYTE)?2U:(Mode==DISP_WORD)?4U:8U);
-  if (Pol == WP_RW1C) {
-    Print(L"(RW1C) Input is ClearMask (write-1-to-clear)\n\n");
+  ScreenBegin();
+  ScreenLine(L"WRITE PCI CONFIG  Bus:%02x Dev:%02x Func:%02x  Offset:0x%03x", Bus, Dev, Func, Cursor);
+  ScreenLine(L"Input HEX (%u digits).  Esc:Cancel", (Mode==DISP_BYTE)?2U:(Mode==DISP_WORD)?4U:8U);
+  if (PolicyIsRw1c(Pol)) {
+    ScreenLine(L"");
+    ScreenLine(L"(RW1C) Input is ClearMask (write-1-to-clear)");
   }
-  Print(L"Value: ");
+  ScreenEnd();
+  ScreenPrompt();
+  Print(L"\nValue: ");
 
   UINT64 Val = 0;
   EFI_STATUS Status = ReadFixedHex((Mode==DISP_BYTE)?2U:(Mode==DISP_WORD)?4U:8U, &Val);
   if (EFI_ERROR(Status)) return Status;
 
-  Print(L"\n\nWriting...\n");
+  ReportInit(&Rep);
 
   // Special handling
   if (Mode == DISP_WORD && Cursor == 0x04) {
     // Command RMW: keep reserved bits, allow safe bits
     UINT16 Old = 0;
     UINT16 New = (UINT16)Val;
-    PciRead16(Bus, Dev, Func, 0x04, &Old);
+    PciCfgRead16(Bus, Dev, Func, 0x04, &Old);
 
     UINT16 Mask  = (UINT16)((1U<<0) | (1U<<1) | (1U<<2) | (1U<<10)); // IO/MEM/BM/INTxDisable
     UINT16 Final = (UINT16)((Old & ~Mask) | (New & Mask));
 
-    Status = PciWrite16(Bus, Dev, Func, 0x04, Final);
-    Print(L"Command Old:0x%04x  Input:0x%04x  Final(RMW):0x%04x\n", Old, New, Final);
+    Status = PciCfgWrite16(Bus, Dev, Func, 0x04, Final);
+    if (!EFI_ERROR(Status)) JournalAdd(Bus, Dev, Func, 0x04, DISP_WORD, Old, Final, FALSE);
+    ReportAdd(&Rep, L"Command Old:0x%04x  Input:0x%04x  Final(RMW):0x%04x", Old, New, Final);
 
     if (!EFI_ERROR(Status)) {
       UINT16 Rb = 0;
-      PciRead16(Bus, Dev, Func, 0x04, &Rb);
-      if (Rb != Final) Print(L"NOTE: Read-back mismatch. Read=0x%04x (masked/RO?)\n", Rb);
+      PciCfgRead16(Bus, Dev, Func, 0x04, &Rb);
+      if (Rb != Final) ReportAdd(&Rep, L"NOTE: Read-back mismatch. Read=0x%04x (masked/RO?)", Rb);
     }
 
   } else if (Pol == WP_RW1C && Mode == DISP_WORD && Cursor == 0x06) {
     // Status RW1C: input is clear mask
     UINT16 Before = 0;
     UINT16 ClearMask = (UINT16)Val;
-    PciRead16(Bus, Dev, Func, 0x06, &Before);
+    PciCfgRead16(Bus, Dev, Func, 0x06, &Before);
 
-    Status = PciWrite16(Bus, Dev, Func, 0x06, ClearMask);
-    Print(L"Status Before:0x%04x  ClearMask:0x%04x\n", Before, ClearMask);
+    Status = PciCfgWrite16(Bus, Dev, Func, 0x06, ClearMask);
+    if (!EFI_ERROR(Status)) JournalAdd(Bus, Dev, Func, 0x06, DISP_WORD, Before, ClearMask, TRUE);
+    ReportAdd(&Rep, L"Status Before:0x%04x  ClearMask:0x%04x", Before, ClearMask);
 
     if (!EFI_ERROR(Status)) {
       UINT16 After = 0;
-      PciRead16(Bus, Dev, Func, 0x06, &After);
-      Print(L"Status After :0x%04x\n", After);
+      PciCfgRead16(Bus, Dev, Func, 0x06, &After);
+      ReportAdd(&Rep, L"Status After :0x%04x", After);
     }
 
   } else {
     // Direct write + read-back verify
+    UINT32 Old = 0;
+    PciReadByMode(Bus, Dev, Func, Cursor, Mode, &Old);
+
     if (Mode == DISP_BYTE) {
-      Status = PciWrite8(Bus, Dev, Func, Cursor, (UINT8)Val);
+      Status = PciCfgWrite8(Bus, Dev, Func, Cursor, (UINT8)Val);
       if (!EFI_ERROR(Status)) {
-        UINT8 rb = 0; PciRead8(Bus, Dev, Func, Cursor, &rb);
-        if (rb != (UINT8)Val) Print(L"NOTE: Read-back mismatch. Read=0x%02x (masked/RO/ignored)\n", rb);
+        UINT8 rb = 0; PciCfgRead8(Bus, Dev, Func, Cursor, &rb);
+        if (rb != (UINT8)Val) ReportAdd(&Rep, L"NOTE: Read-back mismatch. Read=0x%02x (masked/RO/ignored)", rb);
       }
     } else if (Mode == DISP_WORD) {
-      Status = PciWrite16(Bus, Dev, Func, Cursor, (UINT16)Val);
+      Status = PciCfgWrite16(Bus, Dev, Func, Cursor, (UINT16)Val);
       if (!EFI_ERROR(Status)) {
-        UINT16 rb = 0; PciRead16(Bus, Dev, Func, Cursor, &rb);
-        if (rb != (UINT16)Val) Print(L"NOTE: Read-back mismatch. Read=0x%04x (masked/RO/ignored)\n", rb);
+        UINT16 rb = 0; PciCfgRead16(Bus, Dev, Func, Cursor, &rb);
+        if (rb != (UINT16)Val) ReportAdd(&Rep, L"NOTE: Read-back mismatch. Read=0x%04x (masked/RO/ignored)", rb);
       }
     } else {
-      Status = PciWrite32(Bus, Dev, Func, Cursor, (UINT32)Val);
+      Status = PciCfgWrite32(Bus, Dev, Func, Cursor, (UINT32)Val);
       if (!EFI_ERROR(Status)) {
-        UINT32 rb = 0; PciRead32(Bus, Dev, Func, Cursor, &rb);
-        if (rb != (UINT32)Val) Print(L"NOTE: Read-back mismatch. Read=0x%08x (masked/RO/ignored)\n", rb);
+        UINT32 rb = 0; PciCfgRead32(Bus, Dev, Func, Cursor, &rb);
+        if (rb != (UINT32)Val) ReportAdd(&Rep, L"NOTE: Read-back mismatch. Read=0x%08x (masked/RO/ignored)", rb);
       }
     }
+    if (!EFI_ERROR(Status)) JournalAdd(Bus, Dev, Func, Cursor, Mode, Old, (UINT32)Val, PolicyIsRw1c(Pol));
   }
 
-  Print(L"\nWrite Status: %r\n", Status);
-  Print(L"Press any key...\n");
-  EFI_INPUT_KEY K; WaitKey(&K);
+  ReportAdd(&Rep, L"");
+  ReportAdd(&Rep, L"Write Status: %r", Status);
+  ReportShow(L"Write result", &Rep);
+  ReportFree(&Rep);
   return Status;
 }
 
+// Newest snapshot in the ring, or NULL before the first capture.
+STATIC
+PCI_SNAPSHOT *
+LatestSnapshot(VOID)
+{
+  return (mSnapCount > 0) ? &mSnap[(mSnapNext + MAX_SNAPSHOTS - 1) % MAX_SNAPSHOTS] : NULL;
+}
+
 // -----------------------------
-// Config view loop
+// Range write (fill / pattern / copy)
 // -----------------------------
 STATIC
 VOID
-ConfigViewLoop(UINT8 Bus, UINT8 Dev, UINT8 Func)
+DoRangeWrite(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Cursor)
+{
+  UINT64 Start = 0, Length = 0, Val = 0;
+
+  ScreenBegin();
+  ScreenLine(L"RANGE WRITE  Bus:%02x Dev:%02x Func:%02x   Dangerous Writes: %s",
+             Bus, Dev, Func, gDangerousUnlocked ? L"UNLOCKED" : L"LOCKED");
+  ScreenLine(L"Start and length are DWORD aligned (0x000-0xFFF).  Esc:Cancel");
+  ScreenEnd();
+  ScreenPrompt();
+
+  Print(L"\nStart  (3 hex, cursor %03x): ", AlignCursor(Cursor, DISP_DWORD));
+  if (EFI_ERROR(ReadFixedHex(3, &Start))) return;
+  Print(L"\nLength (3 hex, bytes)      : ");
+  if (EFI_ERROR(ReadFixedHex(3, &Length))) return;
+
+  Print(L"\n\nF:Fill  P:Pattern  C:Copy from last snapshot  Esc:Cancel\n");
+  EFI_INPUT_KEY Key;
+  WaitKey(&Key);
+  CHAR16 Op = CharToUpper(Key.UnicodeChar);
+  if (IsEsc(&Key) || (Op != L'F' && Op != L'P' && Op != L'C')) return;
+
+  UINT8 Pattern[8];
+  UINTN PatLen = 0;
+
+  if (Op == L'F') {
+    Print(L"Fill value (8 hex): ");
+    if (EFI_ERROR(ReadFixedHex(8, &Val))) return;
+  } else if (Op == L'P') {
+    Print(L"Pattern bytes (1-8): ");
+    if (EFI_ERROR(ReadFixedHex(1, &Val)) || Val == 0 || Val > 8) return;
+    PatLen = (UINTN)Val;
+    Print(L"\nPattern (%u hex, first byte first): ", (UINT32)(PatLen * 2));
+    if (EFI_ERROR(ReadFixedHex(PatLen * 2, &Val))) return;
+    for (UINTN k = 0; k < PatLen; k++) Pattern[k] = (UINT8)(Val >> ((PatLen - 1 - k) * 8));
+  } else if (mSnapCount == 0) {
+    Print(L"No snapshot yet (S in the device list). Press any key...\n");
+    WaitKey(&Key);
+    return;
+  }
+
+  Print(L"\n\n");
+  if (!ConfirmKey(L"Write the range?")) return;
+
+  PCI_REPORT Rep;
+  ReportInit(&Rep);
+  if (Op == L'F') {
+    PciRangeFill(Bus, Dev, Func, (UINT16)Start, (UINTN)Length, (UINT32)Val, &Rep);
+  } else if (Op == L'P') {
+    PciRangePattern(Bus, Dev, Func, (UINT16)Start, (UINTN)Length, Pattern, PatLen, &Rep);
+  } else {
+    PciRangeCopy(Bus, Dev, Func, (UINT16)Start, (UINTN)Length, LatestSnapshot(), &Rep);
+  }
+  ReportShow(L"Range write result", &Rep);
+  ReportFree(&Rep);
+}
+
+// -----------------------------
+// Config view loop
+// -----------------------------
+// Opens at Offset (0x000-0xFFF); the cursor is an absolute offset and the
+// screen shows the 256-byte window containing it.
+VOID
+ConfigViewLoop(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Offset)
 {
   UINT8 Buf[0x100];
   DISP_MODE Mode = DISP_DWORD;
-  UINT16 Cursor = 0;
+  UINT16 Cursor = AlignCursor((UINT16)(Offset & 0xFFF), Mode);
+  UINT16 Base   = (UINT16)(Cursor & 0xF00);
 
-  ReadConfig256(Bus, Dev, Func, Buf);
+  ReadConfigWindow(Bus, Dev, Func, Base, Buf);
 
   while (TRUE) {
-    RenderConfigScreen(Bus, Dev, Func, Buf, Mode, Cursor);
+    RenderConfigScreen(Bus, Dev, Func, Buf, Base, Mode, Cursor);
 
     EFI_INPUT_KEY Key;
     WaitKey(&Key);
@@ -584,69 +809,114 @@ ConfigViewLoop(UINT8 Bus, UINT8 Dev, UINT8 Func)
       continue;
     }
 
+    // MSI / MSI-X vectors
+    if (Key.UnicodeChar == L'x' || Key.UnicodeChar == L'X') {
+      PCI_REPORT Rep;
+      ReportInit(&Rep);
+      PciMsiDetail(Bus, Dev, Func, &Rep);
+      ReportShow(L"MSI / MSI-X vectors", &Rep);
+      ReportFree(&Rep);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'v' || Key.UnicodeChar == L'V') {
+      PCI_REPORT Rep;
+      ReportInit(&Rep);
+      PciVpdDetail(Bus, Dev, Func, &Rep);
+      ReportShow(L"Vital Product Data", &Rep);
+      ReportFree(&Rep);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'j' || Key.UnicodeChar == L'J') {
+      PciJournalDialog();
+      ReadConfigWindow(Bus, Dev, Func, Base, Buf);
+      continue;
+    }
+
+    // Whole extended space on one screen (GOP only)
+    if ((Key.UnicodeChar == L'g' || Key.UnicodeChar == L'G') && ScreenGetMode() == SCREEN_GOP) {
+      UINT32 Cfg[0x1000 / 4];
+      UINT16 Cur = AlignCursor(Cursor, DISP_DWORD);
+      if (EFI_ERROR(PciCfgReadBulk32(Bus, Dev, Func, 0, ARRAY_SIZE(Cfg), Cfg))) SetMem(Cfg, sizeof(Cfg), 0xFF);
+      if (!EFI_ERROR(PciGopHex4K(Bus, Dev, Func, Cfg, &Cur))) {
+        Cursor = AlignCursor(Cur, Mode);
+        if ((Cursor & 0xF00) != Base) {
+          Base = (UINT16)(Cursor & 0xF00);
+          ReadConfigWindow(Bus, Dev, Func, Base, Buf);
+        }
+      }
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'r' || Key.UnicodeChar == L'R') {
+      DoRangeWrite(Bus, Dev, Func, Cursor);
+      ReadConfigWindow(Bus, Dev, Func, Base, Buf);
+      continue;
+    }
+
     // Probe hotkey
     if (Key.UnicodeChar == L'p' || Key.UnicodeChar == L'P') {
       UINT16 Cur = AlignCursor(Cursor, Mode);
-      WRITE_POLICY Pol = GetWritePolicy(Bus, Dev, Func, Cur, Mode);
+      WRITE_POLICY Pol = PolicyLookup(Bus, Dev, Func, Cur, Mode);
 
-      ClearScreen();
-      Print(L"PROBE WRITABLE MASK\n");
-      Print(L"Bus:%02x Dev:%02x Func:%02x  Offset:0x%02x  Mode:%s\n",
-            Bus, Dev, Func, Cur,
-            (Mode==DISP_BYTE)?L"BYTE":(Mode==DISP_WORD)?L"WORD":L"DWORD");
+      PCI_REPORT Rep;
+      ReportInit(&Rep);
+      ReportAdd(&Rep, L"Bus:%02x Dev:%02x Func:%02x  Offset:0x%03x  Mode:%s",
+                Bus, Dev, Func, Cur,
+                (Mode==DISP_BYTE)?L"BYTE":(Mode==DISP_WORD)?L"WORD":L"DWORD");
 
-      Print(L"Policy: ");
-      if (Pol == WP_BLOCK_RO) Print(L"RO (blocked)\n");
-      else if (Pol == WP_RW1C) Print(L"RW1C (Status-like)\n");
-      else if (Pol == WP_DANGEROUS_BAR) Print(L"DANGEROUS BAR\n");
-      else if (Pol == WP_DANGEROUS_CAP) Print(L"DANGEROUS CAP\n");
-      else Print(L"RW (verify)\n");
+      ReportAdd(&Rep, L"Policy: %s", PolicyName(Pol));
 
       if (!IsProbeSafe(Cur, Mode)) {
-        Print(L"\nProbe blocked: only allow 0x40~0xFF to avoid side effects.\n");
-        Print(L"Press any key...\n");
-        EFI_INPUT_KEY K; WaitKey(&K);
+        ReportAdd(&Rep, L"");
+        ReportAdd(&Rep, L"Probe blocked: only allow 0x40~0xFF to avoid side effects.");
+        ReportShow(L"PROBE WRITABLE MASK", &Rep);
+        ReportFree(&Rep);
         continue;
       }
 
       UINT64 Old, Test, Rb, Mask;
       EFI_STATUS St = ProbeWritableMaskAtCursor(Bus, Dev, Func, Mode, Cur, &Old, &Test, &Rb, &Mask);
 
-      Print(L"\nProbe Status: %r\n", St);
+      ReportAdd(&Rep, L"");
+      ReportAdd(&Rep, L"Probe Status: %r", St);
       if (!EFI_ERROR(St)) {
+        PolicyNoteProbe(Bus, Dev, Func, Cur, Mode, (UINT32)Mask);
         if (Mode == DISP_BYTE) {
-          Print(L"Old     : 0x%02x\n", (UINT8)Old);
-          Print(L"Test(~) : 0x%02x\n", (UINT8)Test);
-          Print(L"ReadBack: 0x%02x\n", (UINT8)Rb);
-          Print(L"Mask    : 0x%02x\n", (UINT8)Mask);
+          ReportAdd(&Rep, L"Old     : 0x%02x", (UINT8)Old);
+          ReportAdd(&Rep, L"Test(~) : 0x%02x", (UINT8)Test);
+          ReportAdd(&Rep, L"ReadBack: 0x%02x", (UINT8)Rb);
+          ReportAdd(&Rep, L"Mask    : 0x%02x", (UINT8)Mask);
         } else if (Mode == DISP_WORD) {
-          Print(L"Old     : 0x%04x\n", (UINT16)Old);
-          Print(L"Test(~) : 0x%04x\n", (UINT16)Test);
-          Print(L"ReadBack: 0x%04x\n", (UINT16)Rb);
-          Print(L"Mask    : 0x%04x\n", (UINT16)Mask);
+          ReportAdd(&Rep, L"Old     : 0x%04x", (UINT16)Old);
+          ReportAdd(&Rep, L"Test(~) : 0x%04x", (UINT16)Test);
+          ReportAdd(&Rep, L"ReadBack: 0x%04x", (UINT16)Rb);
+          ReportAdd(&Rep, L"Mask    : 0x%04x", (UINT16)Mask);
         } else {
-          Print(L"Old     : 0x%08x\n", (UINT32)Old);
-          Print(L"Test(~) : 0x%08x\n", (UINT32)Test);
-          Print(L"ReadBack: 0x%08x\n", (UINT32)Rb);
-          Print(L"Mask    : 0x%08x\n", (UINT32)Mask);
+          ReportAdd(&Rep, L"Old     : 0x%08x", (UINT32)Old);
+          ReportAdd(&Rep, L"Test(~) : 0x%08x", (UINT32)Test);
+          ReportAdd(&Rep, L"ReadBack: 0x%08x", (UINT32)Rb);
+          ReportAdd(&Rep, L"Mask    : 0x%08x", (UINT32)Mask);
         }
 
-        Print(L"\nInterpretation:\n");
+        ReportAdd(&Rep, L"");
+        ReportAdd(&Rep, L"Interpretation:");
         if (Mask == 0) {
-          Print(L"- Likely RO / write ignored.\n");
+          ReportAdd(&Rep, L"- Likely RO / write ignored.");
         } else {
           BOOLEAN FullRw = FALSE;
           if (Mode == DISP_BYTE)  FullRw = ((UINT8)Rb  == (UINT8)Test);
           if (Mode == DISP_WORD)  FullRw = ((UINT16)Rb == (UINT16)Test);
           if (Mode == DISP_DWORD) FullRw = ((UINT32)Rb == (UINT32)Test);
 
-          if (FullRw) Print(L"- RW: Most bits writable.\n");
-          else        Print(L"- Masked RW: Only Mask bits respond.\n");
+          if (FullRw) ReportAdd(&Rep, L"- RW: Most bits writable.");
+          else        ReportAdd(&Rep, L"- Masked RW: Only Mask bits respond.");
         }
       }
 
-      Print(L"\nPress any key...\n");
-      EFI_INPUT_KEY K; WaitKey(&K);
+      ReportShow(L"PROBE WRITABLE MASK", &Rep);
+      ReportFree(&Rep);
       continue;
     }
 
@@ -658,7 +928,7 @@ ConfigViewLoop(UINT8 Bus, UINT8 Dev, UINT8 Func)
 
     if (IsEnter(&Key)) {
       DoWriteAtCursor(Bus, Dev, Func, Mode, Cursor);
-      ReadConfig256(Bus, Dev, Func, Buf);
+      ReadConfigWindow(Bus, Dev, Func, Base, Buf);
       continue;
     }
 
@@ -666,16 +936,30 @@ ConfigViewLoop(UINT8 Bus, UINT8 Dev, UINT8 Func)
 
     switch (Key.ScanCode) {
       case SCAN_UP:
-        if (Cursor >= 0x10) Cursor = (UINT16)(Cursor - 0x10);
+        if (Cursor >= Base + 0x10) Cursor = (UINT16)(Cursor - 0x10);
         break;
       case SCAN_DOWN:
-        if (Cursor + 0x10 < 0x100) Cursor = (UINT16)(Cursor + 0x10);
+        if (Cursor + 0x10 < Base + 0x100) Cursor = (UINT16)(Cursor + 0x10);
         break;
       case SCAN_LEFT:
-        if (Cursor >= Step) Cursor = (UINT16)(Cursor - Step);
+        if (Cursor >= Base + Step) Cursor = (UINT16)(Cursor - Step);
         break;
       case SCAN_RIGHT:
-        if (Cursor + Step < 0x100) Cursor = (UINT16)(Cursor + Step);
+        if (Cursor + Step < Base + 0x100) Cursor = (UINT16)(Cursor + Step);
+        break;
+      case SCAN_F1: // next 256 bytes (extended config space)
+        if (Base < 0xF00) {
+          Base   = (UINT16)(Base + 0x100);
+          Cursor = (UINT16)(Cursor + 0x100);
+          ReadConfigWindow(Bus, Dev, Func, Base, Buf);
+        }
+        break;
+      case SCAN_F2:
+        if (Base > 0) {
+          Base   = (UINT16)(Base - 0x100);
+          Cursor = (UINT16)(Cursor - 0x100);
+          ReadConfigWindow(Bus, Dev, Func, Base, Buf);
+        }
         break;
       default:
         break;
@@ -685,6 +969,225 @@ ConfigViewLoop(UINT8 Bus, UINT8 Dev, UINT8 Func)
   }
 }
 
+// -----------------------------
+// Audit views
+// -----------------------------
+STATIC
+VOID
+ShowLinkAudit(PCI_TOPOLOGY *Topo, BOOLEAN Interactive)
+{
+  PCI_REPORT Rep;
+  ReportInit(&Rep);
+  PciLinkAudit(Topo, &Rep);
+
+  if (Interactive) ReportShow(L"PCIe Link Health (downtrained links, worst first)", &Rep);
+  else             ReportPrint(&Rep);
+
+  ReportFree(&Rep);
+}
+
+STATIC
+VOID
+ShowMpsAnalyzer(PCI_TOPOLOGY *Topo)
+{
+  PCI_REPORT Rep;
+  ReportInit(&Rep);
+  UINTN Changes = PciMpsAnalyze(Topo, FALSE, &Rep);
+  ReportShow(L"MPS / MRRS per Root Port subtree", &Rep);
+  ReportFree(&Rep);
+
+  if (Changes == 0) return;
+
+  ScreenBegin();
+  ScreenLine(L"%u function(s) differ from the recommended MPS/MRRS.", (UINT32)Changes);
+  ScreenLine(L"Dangerous Writes: %s (Device Control is in the CAP area)",
+             gDangerousUnlocked ? L"UNLOCKED" : L"LOCKED - writes will be blocked, F9 to unlock");
+  ScreenEnd();
+  ScreenPrompt();
+  Print(L"\n");
+  if (!ConfirmKey(L"Apply recommended values?")) return;
+
+  ReportInit(&Rep);
+  PciMpsAnalyze(Topo, TRUE, &Rep);
+  ReportShow(L"MPS / MRRS apply result", &Rep);
+  ReportFree(&Rep);
+}
+
+STATIC
+VOID
+ShowDmaAudit(PCI_TOPOLOGY *Topo)
+{
+  PCI_REPORT Rep;
+  ReportInit(&Rep);
+  UINTN Changes = PciDmaAudit(Topo, FALSE, &Rep);
+  ReportShow(L"DMA features: Extended Tag, 10-bit Tag, Relaxed Ordering, No Snoop", &Rep);
+  ReportFree(&Rep);
+
+  if (Changes == 0) return;
+
+  ScreenBegin();
+  ScreenLine(L"%u endpoint(s) leave supported DMA features disabled.", (UINT32)Changes);
+  ScreenLine(L"Dangerous Writes: %s (Device Control is in the CAP area)",
+             gDangerousUnlocked ? L"UNLOCKED" : L"LOCKED - writes will be blocked, F9 to unlock");
+  ScreenEnd();
+  ScreenPrompt();
+  Print(L"\n");
+  if (!ConfirmKey(L"Enable them?")) return;
+
+  ReportInit(&Rep);
+  PciDmaAudit(Topo, TRUE, &Rep);
+  ReportShow(L"DMA features: enable result", &Rep);
+  ReportFree(&Rep);
+}
+
+STATIC
+VOID
+ShowAspmAudit(PCI_TOPOLOGY *Topo, UINTN Sel)
+{
+  PCI_REPORT Rep;
+  ReportInit(&Rep);
+  PciAspmAudit(Topo, &Rep);
+  ReportShow(L"ASPM / L1 Substates per link, endpoint exit latency", &Rep);
+  ReportFree(&Rep);
+
+  PCI_DEV_INFO  *p = &Topo->List[Sel];
+  PCI_TOPO_NODE *n = &Topo->Node[Sel];
+
+  ScreenBegin();
+  if (n->HdrType == 0x01) {
+    ScreenLine(L"Selected: %02x/%02x/%02x  bridge, subtree buses %02x-%02x", p->Bus, p->Dev, p->Func, n->SecBus, n->SubBus);
+  } else {
+    ScreenLine(L"Selected: %02x/%02x/%02x  (single function)", p->Bus, p->Dev, p->Func);
+  }
+  ScreenLine(L"Dangerous Writes: %s", gDangerousUnlocked ? L"UNLOCKED" : L"LOCKED - writes will be blocked, F9 to unlock");
+  ScreenEnd();
+  ScreenPrompt();
+  Print(L"\n");
+  if (!ConfirmKey(L"Disable ASPM (and ASPM L1.1/L1.2) on this subtree?")) return;
+
+  ReportInit(&Rep);
+  PciAspmDisableSubtree(Topo, Sel, &Rep);
+  ReportShow(L"Disable ASPM result (children first)", &Rep);
+  ReportFree(&Rep);
+}
+
+// Captures into the ring, dropping the oldest of MAX_SNAPSHOTS.
+STATIC
+PCI_SNAPSHOT *
+CaptureSnapshot(PCI_DEV_INFO *List, UINTN Count)
+{
+  ScreenBegin();
+  ScreenLine(L"Capturing config space of %u functions...", (UINT32)Count);
+  ScreenEnd();
+
+  PCI_SNAPSHOT *New = &mSnap[mSnapNext];
+  PciSnapshotFree(New);
+  EFI_STATUS St = PciSnapshotCapture(List, Count, New);
+  if (EFI_ERROR(St)) {
+    PCI_REPORT Rep;
+    ReportInit(&Rep);
+    ReportAdd(&Rep, L"Snapshot failed: %r", St);
+    ReportShow(L"Snapshot", &Rep);
+    ReportFree(&Rep);
+    return NULL;
+  }
+
+  mSnapNext = (mSnapNext + 1) % MAX_SNAPSHOTS;
+  if (mSnapCount < MAX_SNAPSHOTS) mSnapCount++;
+  return New;
+}
+
+// Takes a deduplicated snapshot of every function and diffs it against the
+// previous one.
+STATIC
+VOID
+ShowSnapshot(PCI_DEV_INFO *List, UINTN Count)
+{
+  PCI_SNAPSHOT *Prev = LatestSnapshot();
+  PCI_SNAPSHOT *New  = CaptureSnapshot(List, Count);
+  if (New == NULL) return;
+  if (Prev == New) Prev = NULL;   // only one slot: the previous one was just replaced
+
+  PCI_REPORT Rep;
+  ReportInit(&Rep);
+  ReportAdd(&Rep, L"Snapshot %u of %u kept", (UINT32)mSnapCount, MAX_SNAPSHOTS);
+  PciSnapshotStats(New, &Rep);
+
+  if (Prev != NULL) {
+    ReportAdd(&Rep, L"");
+    ReportAdd(&Rep, L"Changes since previous snapshot:");
+    if (PciSnapshotDiff(Prev, New, &Rep) == 0) ReportAdd(&Rep, L"  none");
+  }
+
+  ReportShow(L"Config space snapshot", &Rep);
+  ReportFree(&Rep);
+}
+
+// Searches the newest snapshot, taking one first if there is none.
+STATIC
+VOID
+ShowFind(PCI_DEV_INFO *List, UINTN Count)
+{
+  PCI_SNAPSHOT *Snap = LatestSnapshot();
+  if (Snap == NULL) Snap = CaptureSnapshot(List, Count);
+  if (Snap != NULL) PciFindDialog(Snap);
+}
+
+// -----------------------------
+// Command line
+// -----------------------------
+// PciUtility.efi [-mp] [-dump] [-link] [-check <file>] [-crs <ms>] [-image <file>] [-sample <file>] [-vpd] [-serial | -gop]
+//   -mp    : scan (and dump) on all processors via ECAM
+//   -dump  : print config space of every function and exit
+//   -link  : print the PCIe link health audit and exit
+//   -check : evaluate a golden rule file and exit; EFI_ABORTED on any failure
+//   -crs   : scan deadline in ms for functions answering CRS (default 1000)
+//   -image : use a config space image file instead of the hardware
+//   -sample: run the register sampler described by a spec file and exit
+//   -vpd   : print serial / part numbers of every function with VPD and exit
+//   -serial: headless layout for serial / SOL consoles (changed rows only)
+//   -gop   : render on the Graphics Output Protocol (full-mode grid, dense 4KB view)
+//   -journal: write journal file (CSV), rewritten after each rollback and on exit
+STATIC
+VOID
+ParseCommandLine(IN EFI_HANDLE ImageHandle)
+{
+  EFI_SHELL_PARAMETERS_PROTOCOL *Params = NULL;
+
+  if (EFI_ERROR(gBS->HandleProtocol(ImageHandle, &gEfiShellParametersProtocolGuid, (VOID**)&Params)) ||
+      Params == NULL) {
+    return;
+  }
+
+  for (UINTN i = 1; i < Params->Argc; i++) {
+    if (StrCmp(Params->Argv[i], L"-mp") == 0) {
+      mOptMp = TRUE;
+    } else if (StrCmp(Params->Argv[i], L"-dump") == 0) {
+      mOptDump = TRUE;
+    } else if (StrCmp(Params->Argv[i], L"-link") == 0) {
+      mOptLink = TRUE;
+    } else if (StrCmp(Params->Argv[i], L"-check") == 0 && i + 1 < Params->Argc) {
+      mOptCheck = Params->Argv[++i];
+    } else if (StrCmp(Params->Argv[i], L"-crs") == 0 && i + 1 < Params->Argc) {
+      mOptCrsMs = (UINT32)StrDecimalToUintn(Params->Argv[++i]);
+    } else if (StrCmp(Params->Argv[i], L"-image") == 0 && i + 1 < Params->Argc) {
+      mOptImage = Params->Argv[++i];
+    } else if (StrCmp(Params->Argv[i], L"-sample") == 0 && i + 1 < Params->Argc) {
+      mOptSample = Params->Argv[++i];
+    } else if (StrCmp(Params->Argv[i], L"-vpd") == 0) {
+      mOptVpd = TRUE;
+    } else if (StrCmp(Params->Argv[i], L"-serial") == 0) {
+      mOptSerial = TRUE;
+    } else if (StrCmp(Params->Argv[i], L"-gop") == 0) {
+      mOptGop = TRUE;
+    } else if (StrCmp(Params->Argv[i], L"-journal") == 0 && i + 1 < Params->Argc) {
+      mOptJournal = Params->Argv[++i];
+    } else {
+      Print(L"Unknown option: %s\n", Params->Argv[i]);
+    }
+  }
+}
+
 // -----------------------------
 // Main
 // -----------------------------
@@ -692,23 +1195,105 @@ EFI_STATUS
 EFIAPI
 UefiMain(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
 {
-  (VOID)ImageHandle; (VOID)SystemTable;
+  (VOID)SystemTable;
 
-  EFI_STATUS Status = InitRbIo();
-  if (EFI_ERROR(Status) || mRbIo == NULL) {
-    Print(L"LocateProtocol(PciRootBridgeIo) failed: %r\n", Status);
-    return Status;
+  ParseCommandLine(ImageHandle);
+  if (mOptJournal != NULL) JournalSetFile(mOptJournal);
+
+  EFI_STATUS Status;
+
+  if (mOptImage != NULL) {
+    Status = InitImage(mOptImage);
+    if (EFI_ERROR(Status)) {
+      Print(L"Config image %s: %r\n", mOptImage, Status);
+      return Status;
+    }
+    mOptMp = FALSE;   // the MP scan reads ECAM directly
+  } else {
+    Status = InitRbIo();
+    if (EFI_ERROR(Status) || mRbIo == NULL) {
+      Print(L"LocateProtocol(PciRootBridgeIo) failed: %r\n", Status);
+      return Status;
+    }
+
+    if (mOptMp && EFI_ERROR(PciCfgEcamInit((UINT16)mRbIo->SegmentNumber))) {
+      // APs may only touch ECAM (MMIO); RBIO is not MP-safe.
+      Print(L"-mp: no MCFG/ECAM for segment %u, using serial RBIO scan.\n", mRbIo->SegmentNumber);
+      mOptMp = FALSE;
+    }
   }
 
   PCI_DEV_INFO *List = NULL;
-  UINTN Count = ScanAllPci(&List);
+  PciCrsBegin(mOptCrsMs);
+  UINTN Count = mOptMp ? ScanAllPciMp(&List) : ScanAllPci(&List);
   if (Count == 0 || List == NULL) {
     Print(L"No PCI devices found (or alloc failed).\n");
     return EFI_NOT_FOUND;
   }
+  PciSriovAddVfs(List, &Count);
+
+  if (mOptDump) {
+    Status = DumpAllPci(List, Count, mOptMp);
+    FreePool(List);
+    return Status;
+  }
+
+  if (mOptCheck != NULL) {
+    PCI_REPORT Rep;
+    UINTN Failed = 0;
+    ReportInit(&Rep);
+    Status = PciComplianceRun(List, Count, mOptCheck, &Rep, &Failed);
+    ReportPrint(&Rep);
+    ReportFree(&Rep);
+    FreePool(List);
+    // startup.nsh: %lasterror% is 0 only when every rule passed
+    if (!EFI_ERROR(Status) && Failed != 0) Status = EFI_ABORTED;
+    return Status;
+  }
+
+  if (mOptSample != NULL) {
+    PCI_REPORT Rep;
+    ReportInit(&Rep);
+    Status = PciSamplerRun(mOptSample, &Rep);
+    ReportPrint(&Rep);
+    ReportFree(&Rep);
+    FreePool(List);
+    return Status;
+  }
+
+  if (mOptVpd) {
+    PCI_REPORT Rep;
+    ReportInit(&Rep);
+    PciVpdInventory(List, Count, &Rep);
+    ReportPrint(&Rep);
+    ReportFree(&Rep);
+    FreePool(List);
+    return EFI_SUCCESS;
+  }
+
+  Status = PciBuildTopology(List, Count, &mTopo);
+  if (EFI_ERROR(Status)) {
+    Print(L"Topology index failed: %r\n", Status);
+    FreePool(List);
+    return Status;
+  }
+
+  if (mOptLink) {
+    ShowLinkAudit(&mTopo, FALSE);
+    PciFreeTopology(&mTopo);
+    FreePool(List);
+    return EFI_SUCCESS;
+  }
+
+  if (mOptSerial) {
+    ScreenSetMode(SCREEN_SERIAL);
+  } else if (mOptGop && EFI_ERROR(ScreenSetMode(SCREEN_GOP))) {
+    Print(L"-gop: no Graphics Output / HII font, using the text console.\n");
+  }
 
+  // The GOP grid holds a lot more than a text mode page (2 header + 4 footer rows)
   UINTN Sel = 0;
-  UINTN PageSize = 18;
+  UINTN PageSize = (ScreenGetMode() == SCREEN_GOP) ? ScreenRows() - 6 : 18;
   UINTN Page = 0;
 
   while (TRUE) {
@@ -727,7 +1312,117 @@ UefiMain(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
 
     if (IsEnter(&Key)) {
       PCI_DEV_INFO *p = &List[Sel];
-      ConfigViewLoop(p->Bus, p->Dev, p->Func);
+      ConfigViewLoop(p->Bus, p->Dev, p->Func, 0);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L't' || Key.UnicodeChar == L'T') {
+      Sel = PciTreeView(&mTopo, Sel);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'l' || Key.UnicodeChar == L'L') {
+      ShowLinkAudit(&mTopo, TRUE);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'm' || Key.UnicodeChar == L'M') {
+      ShowMpsAnalyzer(&mTopo);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'a' || Key.UnicodeChar == L'A') {
+      ShowAspmAudit(&mTopo, Sel);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'e' || Key.UnicodeChar == L'E') {
+      PciAerDashboard(&mTopo);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'x' || Key.UnicodeChar == L'X') {
+      PCI_REPORT Rep;
+      ReportInit(&Rep);
+      PciMsiSummary(&mTopo, &Rep);
+      ReportShow(L"MSI / MSI-X summary", &Rep);
+      ReportFree(&Rep);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'f' || Key.UnicodeChar == L'F') {
+      ShowFind(List, Count);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'c' || Key.UnicodeChar == L'C') {
+      PCI_REPORT Rep;
+      ReportInit(&Rep);
+      PciCrsReport(&mTopo, &Rep);
+      ReportShow(L"Scan timing / CRS retries", &Rep);
+      ReportFree(&Rep);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L's' || Key.UnicodeChar == L'S') {
+      ShowSnapshot(List, Count);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'v' || Key.UnicodeChar == L'V') {
+      PCI_REPORT Rep;
+      ReportInit(&Rep);
+      PciVpdInventory(List, Count, &Rep);
+      ReportShow(L"VPD inventory (serial / part numbers)", &Rep);
+      ReportFree(&Rep);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'i' || Key.UnicodeChar == L'I') {
+      PCI_REPORT Rep;
+      ReportInit(&Rep);
+      PciSriovReport(&mTopo, &Rep);
+      ReportShow(L"SR-IOV physical functions and their VFs", &Rep);
+      ReportFree(&Rep);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'b' || Key.UnicodeChar == L'B') {
+      PciResMapDialog(&mTopo);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'j' || Key.UnicodeChar == L'J') {
+      PciJournalDialog();
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'r' || Key.UnicodeChar == L'R') {
+      PciRebarDialog(&mTopo);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'd' || Key.UnicodeChar == L'D') {
+      ShowDmaAudit(&mTopo);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'p' || Key.UnicodeChar == L'P') {
+      PciP2pDialog(&mTopo, Sel);
+      continue;
+    }
+
+    if (Key.UnicodeChar == L'o' || Key.UnicodeChar == L'O') {
+      PCI_REPORT Rep;
+      ReportInit(&Rep);
+      PciOversubscription(&mTopo, &Rep);
+      ReportShow(L"Fabric oversubscription per Root Port / Switch (worst first)", &Rep);
+      ReportFree(&Rep);
+      continue;
+    }
+
+    if (Key.ScanCode == SCAN_F9) {
+      gDangerousUnlocked = !gDangerousUnlocked;
       continue;
     }
 
@@ -759,7 +1454,11 @@ UefiMain(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
     }
   }
 
+  if (mOptJournal != NULL) JournalFlush();
+  for (UINTN k = 0; k < MAX_SNAPSHOTS; k++) PciSnapshotFree(&mSnap[k]);
+  PciFreeTopology(&mTopo);
   if (List) FreePool(List);
+  ScreenSetMode(SCREEN_TEXT);
   ClearScreen();
   return EFI_SUCCESS;
 }
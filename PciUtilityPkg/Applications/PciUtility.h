@@ -0,0 +1,558 @@
+#ifndef _PCI_UTILITY_H_
+#define _PCI_UTILITY_H_
+
+#include <Uefi.h>
+
+#include <Protocol/PciRootBridgeIo.h>
+
+#include <Library/UefiLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/PrintLib.h>
+#include <Library/PciConfigAccessLib.h>
+
+#define MAX_PCI_DEVS  4096
+
+typedef enum {
+  DISP_BYTE  = 0,
+  DISP_WORD  = 1,
+  DISP_DWORD = 2
+} DISP_MODE;
+
+typedef struct {
+  UINT8  Bus;
+  UINT8  Dev;
+  UINT8  Func;
+  UINT16 Vid;
+  UINT16 Did;
+  UINT8  BaseClass;
+  UINT8  SubClass;
+  UINT8  ProgIf;
+} PCI_DEV_INFO;
+
+#define PCI_NO_NODE  0xFFFF
+
+// PCI Express Capabilities Register [7:4]
+#define PCIE_PORT_ENDPOINT         0x0
+#define PCIE_PORT_LEGACY_ENDPOINT  0x1
+#define PCIE_PORT_ROOT             0x4
+#define PCIE_PORT_SWITCH_UP        0x5
+#define PCIE_PORT_SWITCH_DOWN      0x6
+#define PCIE_PORT_PCIE_TO_PCI      0x7
+#define PCIE_PORT_PCI_TO_PCIE      0x8
+#define PCIE_PORT_RCIEP            0x9
+#define PCIE_PORT_RCEC             0xA
+
+typedef struct {
+  UINT8  HdrType;       // 0x0E [6:0]
+  UINT8  SecBus;        // type-1 only
+  UINT8  SubBus;
+  UINT8  PcieCap;       // PCI Express capability offset, 0 = none
+  UINT8  PcieVer;
+  UINT8  PortType;
+  UINT16 Parent;        // upstream bridge index, PCI_NO_NODE at the root complex
+  UINT16 FirstChild;    // functions on the secondary bus, in bus order
+  UINT16 NextSibling;
+  UINT16 SriovCap;      // SR-IOV extended capability (PF), 0 = none
+  BOOLEAN IsVf;         // Parent is the PF, not a bridge
+} PCI_TOPO_NODE;
+
+typedef struct {
+  PCI_DEV_INFO  *List;
+  UINTN          Count;
+  PCI_TOPO_NODE *Node;          // Node[i] describes List[i]
+  UINT16         BusOwner[256]; // bridge whose secondary bus is the index
+  UINT16         BusFirst[256]; // first List index on the bus
+  UINT16         FirstRoot;     // first function with no parent bridge
+} PCI_TOPOLOGY;
+
+#define REPORT_LINE_LEN  100
+
+typedef struct {
+  CHAR16 (*Line)[REPORT_LINE_LEN];
+  UINTN  Count;
+  UINTN  Capacity;
+} PCI_REPORT;
+
+extern EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *mRbIo;
+
+// -----------------------------
+// PciUtility.c: console / keys
+// -----------------------------
+VOID
+WaitKey(OUT EFI_INPUT_KEY *Key);
+
+VOID
+ClearScreen(VOID);
+
+BOOLEAN
+IsEsc(IN EFI_INPUT_KEY *Key);
+
+BOOLEAN
+ConfirmKey(IN CONST CHAR16 *Prompt);
+
+EFI_STATUS
+ReadFixedHex(UINTN Digits, OUT UINT64 *OutVal);
+
+VOID
+ConfigViewLoop(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Offset);
+
+// -----------------------------
+// PciUtility.c: scan (config access: PciConfigAccessLib)
+// -----------------------------
+typedef enum {
+  PCI_PROBE_ABSENT = 0,
+  PCI_PROBE_PRESENT,
+  PCI_PROBE_RETRY       // CRS: Vendor ID reads 0x0001 while the function initializes
+} PCI_PROBE;
+
+PCI_PROBE
+PciProbeFunc(UINT8 Bus, UINT8 Dev, UINT8 Func, OUT PCI_DEV_INFO *Out);
+
+VOID
+ScanPciDevFuncs(UINT8 Bus, UINT8 Dev, PCI_DEV_INFO *List, IN OUT UINTN *Count);
+
+VOID
+ScanPciBus(UINT8 Bus, PCI_DEV_INFO *List, IN OUT UINTN *Count);
+
+UINTN
+ScanAllPci(OUT PCI_DEV_INFO **OutList);
+
+VOID
+ReadConfig256(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT8 *Buf256);
+
+// -----------------------------
+// PciWritePolicy.c: per-function policy table (byte / word / dword per offset)
+// -----------------------------
+typedef enum {
+  WP_BLOCK_RO,
+  WP_RW_DIRECT,
+  WP_RW1C,
+  WP_DANGEROUS_BAR,     // BARs, bridge bus numbers / windows / control, VF BARs
+  WP_DANGEROUS_CAP,
+  WP_RW1C_CAP           // status registers inside capabilities: RW1C behind the unlock
+} WRITE_POLICY;
+
+WRITE_POLICY
+PolicyLookup(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode);
+
+UINT32
+PolicyRw1cLanes(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode);
+
+VOID
+PolicyNoteProbe(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode, UINT32 Mask);
+
+BOOLEAN
+PolicyIsRw1c(WRITE_POLICY Pol);
+
+BOOLEAN
+PolicyIsDangerous(WRITE_POLICY Pol);
+
+CONST CHAR16 *
+PolicyName(WRITE_POLICY Pol);
+
+// -----------------------------
+// PciUtility.c: guarded write path
+// -----------------------------
+EFI_STATUS
+PolicyWrite(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode,
+            UINT32 Mask, UINT32 Value, OUT UINT32 *ReadBack OPTIONAL);
+
+EFI_STATUS
+PolicyClearRw1c(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode,
+                UINT32 ClearMask, OUT UINT32 *After OPTIONAL);
+
+BOOLEAN
+DangerousWritesUnlocked(VOID);
+
+EFI_STATUS
+PolicyCheckRange(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Start, UINTN Length, OUT UINT16 *BadOff OPTIONAL);
+
+// -----------------------------
+// PciJournal.c: write journal / rollback
+// -----------------------------
+VOID
+JournalAdd(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode,
+           UINT32 Old, UINT32 New, BOOLEAN Clear);
+
+EFI_STATUS
+JournalReserve(UINTN Count);
+
+UINTN
+JournalSetMark(VOID);
+
+VOID
+JournalSetFile(IN CONST CHAR16 *Path);
+
+EFI_STATUS
+JournalFlush(VOID);
+
+UINTN
+JournalRollback(UINTN From, OUT PCI_REPORT *Rep);
+
+VOID
+PciJournalDialog(VOID);
+
+// -----------------------------
+// PciMpScan.c: multi-processor scan / dump
+// -----------------------------
+UINTN
+ScanAllPciMp(OUT PCI_DEV_INFO **OutList);
+
+EFI_STATUS
+DumpAllPci(PCI_DEV_INFO *List, UINTN Count, BOOLEAN UseMp);
+
+// -----------------------------
+// PciReport.c: line buffer + scrollable view
+// -----------------------------
+VOID
+ReportInit(OUT PCI_REPORT *Rep);
+
+VOID
+ReportFree(IN OUT PCI_REPORT *Rep);
+
+VOID
+EFIAPI
+ReportAdd(IN OUT PCI_REPORT *Rep, IN CONST CHAR16 *Fmt, ...);
+
+VOID
+ReportSizeText(UINT64 Size, OUT CHAR16 *Out, UINTN OutSize);
+
+VOID
+ReportPrint(IN PCI_REPORT *Rep);
+
+VOID
+ReportShow(IN CONST CHAR16 *Title, IN PCI_REPORT *Rep);
+
+// -----------------------------
+// PciCapability.c
+// -----------------------------
+UINT32
+PcieLaneMBps(UINT8 Speed);
+
+CONST CHAR16 *
+PcieSpeedName(UINT8 Speed);
+
+// -----------------------------
+// PciTopology.c
+// -----------------------------
+EFI_STATUS
+PciBuildTopology(PCI_DEV_INFO *List, UINTN Count, OUT PCI_TOPOLOGY *Topo);
+
+VOID
+PciFreeTopology(IN OUT PCI_TOPOLOGY *Topo);
+
+BOOLEAN
+PciIsDownstreamPort(IN PCI_TOPO_NODE *Node);
+
+UINT16
+PciLinkPartner(IN PCI_TOPOLOGY *Topo, UINTN PortIndex);
+
+CONST CHAR16 *
+PortTypeName(PCI_TOPO_NODE *n);
+
+// -----------------------------
+// PciLinkAudit.c
+// -----------------------------
+UINTN
+PciLinkAudit(IN PCI_TOPOLOGY *Topo, OUT PCI_REPORT *Rep);
+
+// -----------------------------
+// PciMpsTuning.c
+// -----------------------------
+UINTN
+PciMpsAnalyze(IN PCI_TOPOLOGY *Topo, BOOLEAN Apply, OUT PCI_REPORT *Rep);
+
+// -----------------------------
+// PciAspmAudit.c
+// -----------------------------
+UINTN
+PciAspmAudit(IN PCI_TOPOLOGY *Topo, OUT PCI_REPORT *Rep);
+
+UINTN
+PciAspmDisableSubtree(IN PCI_TOPOLOGY *Topo, UINTN Root, OUT PCI_REPORT *Rep);
+
+// -----------------------------
+// PciDmaAudit.c
+// -----------------------------
+UINTN
+PciDmaAudit(IN PCI_TOPOLOGY *Topo, BOOLEAN Apply, OUT PCI_REPORT *Rep);
+
+// -----------------------------
+// PciP2p.c: peer-to-peer path / ACS
+// -----------------------------
+VOID
+PciP2pDialog(IN PCI_TOPOLOGY *Topo, UINTN Sel);
+
+// -----------------------------
+// PciAerDashboard.c
+// -----------------------------
+VOID
+PciAerDashboard(IN PCI_TOPOLOGY *Topo);
+
+// -----------------------------
+// PciMsiViewer.c
+// -----------------------------
+EFI_STATUS
+PciMemReadBulk32(UINT64 Addr, UINTN Count, OUT UINT32 *Buf);
+
+VOID
+PciMsiDetail(UINT8 Bus, UINT8 Dev, UINT8 Func, OUT PCI_REPORT *Rep);
+
+VOID
+PciMsiSummary(IN PCI_TOPOLOGY *Topo, OUT PCI_REPORT *Rep);
+
+// -----------------------------
+// PciBandwidth.c
+// -----------------------------
+UINT32
+PciLinkCurrentMBps(IN PCI_TOPOLOGY *Topo, UINTN PortIndex);
+
+UINTN
+PciOversubscription(IN PCI_TOPOLOGY *Topo, OUT PCI_REPORT *Rep);
+
+// -----------------------------
+// PciTreeView.c
+// -----------------------------
+UINTN
+PciTreeView(IN PCI_TOPOLOGY *Topo, UINTN Sel);
+
+// -----------------------------
+// PciSnapshot.c
+// -----------------------------
+#define SNAP_BLOCK_SIZE       256
+#define SNAP_FUNC_SIZE        0x1000
+#define SNAP_BLOCKS_PER_FUNC  (SNAP_FUNC_SIZE / SNAP_BLOCK_SIZE)
+
+#define SNAP_BLOCK_ZERO       0     // implicit all-0x00 block
+#define SNAP_BLOCK_ONES       1     // implicit all-0xFF block
+#define SNAP_BLOCK_FIRST      2     // first pool block id
+
+#define BDF_KEY(p)  (((UINT32)(p)->Bus << 8) | ((UINT32)(p)->Dev << 3) | (p)->Func)
+
+typedef struct {
+  PCI_DEV_INFO *List;       // private copy
+  UINTN         Count;
+  UINT32       *Map;        // Count * SNAP_BLOCKS_PER_FUNC block ids
+  UINT8        *Pool;       // unique blocks
+  UINT32        PoolCount;
+  UINT32        PoolCap;
+  UINT32       *Hash;       // open addressing, pool ids
+  UINT32        HashSize;
+  UINT32        Implicit;   // all-00 / all-FF blocks
+  UINT32        Shared;     // blocks that matched an earlier one
+} PCI_SNAPSHOT;
+
+EFI_STATUS
+PciSnapshotCapture(IN PCI_DEV_INFO *List, UINTN Count, OUT PCI_SNAPSHOT *Snap);
+
+VOID
+PciSnapshotFree(IN OUT PCI_SNAPSHOT *Snap);
+
+CONST UINT8 *
+PciSnapshotBlock(IN CONST PCI_SNAPSHOT *Snap, UINTN Index, UINT16 Offset);
+
+UINT32
+PciSnapshotRead32(IN CONST PCI_SNAPSHOT *Snap, UINTN Index, UINT16 Offset);
+
+VOID
+PciSnapshotCopy(IN CONST PCI_SNAPSHOT *Snap, UINTN Index, UINT16 Offset, UINTN Length, OUT UINT8 *Buf);
+
+BOOLEAN
+PciSnapshotBlockEqual(IN CONST PCI_SNAPSHOT *A, UINTN Ia, IN CONST PCI_SNAPSHOT *B, UINTN Ib, UINTN Block);
+
+UINTN
+PciSnapshotDiff(IN CONST PCI_SNAPSHOT *Old, IN CONST PCI_SNAPSHOT *New, OUT PCI_REPORT *Rep);
+
+VOID
+PciSnapshotStats(IN CONST PCI_SNAPSHOT *Snap, OUT PCI_REPORT *Rep);
+
+// -----------------------------
+// PciFile.c
+// -----------------------------
+EFI_STATUS
+PciFileRead(IN CONST CHAR16 *Path, UINTN MaxSize, OUT UINT8 **Data, OUT UINTN *Size);
+
+EFI_STATUS
+PciFileReadText(IN CONST CHAR16 *Path, OUT CHAR16 **Text);
+
+EFI_STATUS
+PciFileWrite(IN CONST CHAR16 *Path, IN CONST VOID *Data, UINTN Size);
+
+// -----------------------------
+// PciCompliance.c
+// -----------------------------
+CHAR16 *
+PciNextToken(IN OUT CHAR16 **Cursor);
+
+BOOLEAN
+PciParseHex(IN CONST CHAR16 *s, UINTN MaxDigits, CHAR16 Stop, OUT UINT32 *Value, OUT CONST CHAR16 **End);
+
+EFI_STATUS
+PciComplianceRun(IN PCI_DEV_INFO *List, UINTN Count, IN CONST CHAR16 *Path, OUT PCI_REPORT *Rep, OUT UINTN *Failed);
+
+// -----------------------------
+// PciRangeOps.c
+// -----------------------------
+EFI_STATUS
+PciRangeFill(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Start, UINTN Length, UINT32 Value, OUT PCI_REPORT *Rep);
+
+EFI_STATUS
+PciRangePattern(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Start, UINTN Length,
+                IN CONST UINT8 *Pattern, UINTN PatternLength, OUT PCI_REPORT *Rep);
+
+EFI_STATUS
+PciRangeCopy(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Start, UINTN Length,
+             IN CONST PCI_SNAPSHOT *Snap, OUT PCI_REPORT *Rep);
+
+// -----------------------------
+// PciFind.c
+// -----------------------------
+VOID
+PciFindDialog(IN CONST PCI_SNAPSHOT *Snap);
+
+// -----------------------------
+// PciCrsScan.c: CRS deferred queue / scan timing
+// -----------------------------
+#define PCI_CRS_DEFAULT_DEADLINE_MS  1000    // PCIe: 1.0 s after reset before a CRS device is broken
+
+UINT64
+PciCrsNowNs(VOID);
+
+VOID
+PciCrsBegin(UINT32 DeadlineMs);
+
+VOID
+PciCrsDefer(UINT8 Bus, UINT8 Dev, UINT8 Func);
+
+VOID
+PciCrsNoteProbe(UINT8 Bus, UINT8 Dev, UINT64 Ns);
+
+VOID
+PciCrsPoll(PCI_DEV_INFO *List, IN OUT UINTN *Count);
+
+UINTN
+PciCrsFinish(PCI_DEV_INFO *List, IN OUT UINTN *Count);
+
+VOID
+PciCrsReport(IN PCI_TOPOLOGY *Topo, OUT PCI_REPORT *Rep);
+
+// -----------------------------
+// PciSampler.c
+// -----------------------------
+EFI_STATUS
+PciSamplerRun(IN CONST CHAR16 *Path, OUT PCI_REPORT *Rep);
+
+// -----------------------------
+// PciVpd.c: VPD reader (adaptive polling, devices read interleaved)
+// -----------------------------
+VOID
+PciVpdDetail(UINT8 Bus, UINT8 Dev, UINT8 Func, OUT PCI_REPORT *Rep);
+
+UINTN
+PciVpdInventory(IN PCI_DEV_INFO *List, UINTN Count, OUT PCI_REPORT *Rep);
+
+// -----------------------------
+// PciSriov.c: SR-IOV virtual functions
+// -----------------------------
+UINTN
+PciSriovAddVfs(IN OUT PCI_DEV_INFO *List, IN OUT UINTN *Count);
+
+VOID
+PciSriovLink(IN OUT PCI_TOPOLOGY *Topo);
+
+VOID
+PciSriovReport(IN PCI_TOPOLOGY *Topo, OUT PCI_REPORT *Rep);
+
+// -----------------------------
+// PciResMap.c: BAR / bridge window address map
+// -----------------------------
+VOID
+PciResMapDialog(IN PCI_TOPOLOGY *Topo);
+
+BOOLEAN
+PciResMapWindow(IN PCI_DEV_INFO *p, BOOLEAN Pref, OUT UINT64 *Base, OUT UINT64 *Limit);
+
+VOID
+PciResMapInvalidate(VOID);
+
+// -----------------------------
+// PciRebar.c: Resizable BAR sizes, fit check and guarded resize
+// -----------------------------
+VOID
+PciRebarDialog(IN PCI_TOPOLOGY *Topo);
+
+// -----------------------------
+// PciScreen.c: frame output (serial: changed rows only, interruptible; GOP: glyph blit)
+// -----------------------------
+typedef enum {
+  SCREEN_TEXT = 0,      // ClearScreen + Print per frame
+  SCREEN_SERIAL,        // compact layout, changed rows only
+  SCREEN_GOP            // changed rows drawn by PciGop.c
+} SCREEN_MODE;
+
+EFI_STATUS
+ScreenSetMode(SCREEN_MODE Mode);
+
+SCREEN_MODE
+ScreenGetMode(VOID);
+
+BOOLEAN
+ScreenHeadless(VOID);
+
+UINTN
+ScreenRows(VOID);
+
+VOID
+ScreenInvalidate(VOID);
+
+VOID
+ScreenBegin(VOID);
+
+VOID
+EFIAPI
+ScreenLine(IN CONST CHAR16 *Fmt, ...);
+
+BOOLEAN
+ScreenEnd(VOID);
+
+VOID
+ScreenPrompt(VOID);
+
+// -----------------------------
+// PciGop.c: GOP text renderer (glyph cache, one Blt per frame)
+// -----------------------------
+typedef enum {
+  GOP_NORMAL = 0,
+  GOP_HILITE,
+  GOP_DIM,
+  GOP_PALETTES
+} GOP_PALETTE;
+
+EFI_STATUS
+GopInit(VOID);
+
+VOID
+GopFree(VOID);
+
+UINTN
+GopCols(VOID);
+
+UINTN
+GopRows(VOID);
+
+VOID
+GopClear(VOID);
+
+VOID
+GopDrawText(UINTN Col, UINTN Row, IN CONST CHAR16 *Text, UINTN Width, GOP_PALETTE Palette);
+
+VOID
+GopFlush(VOID);
+
+EFI_STATUS
+PciGopHex4K(UINT8 Bus, UINT8 Dev, UINT8 Func, IN CONST UINT32 *Cfg, IN OUT UINT16 *Cursor);
+
+#endif
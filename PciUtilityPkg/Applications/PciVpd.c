@@ -0,0 +1,362 @@
+#include "PciUtility.h"
+
+#include <Library/TimerLib.h>
+
+//
+// Vital Product Data through the VPD capability: write the DWORD address
+// to cap+2 with F (bit 15) clear, wait for the device to set F, read the
+// DWORD at cap+4. The device side is slow (an EEPROM behind it), so:
+//
+// - polling is adaptive: back-to-back flag reads while something is making
+//   progress, then delays doubling from 1 us to VPD_MAX_DELAY_US
+// - each DWORD has its own timeout
+// - reading stops at the End tag instead of walking the whole 32 KB
+// - the bulk reader interleaves devices: while one waits, the others are
+//   polled; functions of one device go one after another, since they
+//   often share a single VPD engine
+//
+#define VPD_CAP_ID          0x03
+#define VPD_MAX_SIZE        0x8000      // 15-bit address
+#define VPD_GROW            0x100
+#define VPD_SPIN_PASSES     64          // idle passes before the first delay
+#define VPD_MAX_DELAY_US    100
+#define VPD_TIMEOUT_NS      50000000ULL // per DWORD
+#define VPD_FLAG            BIT15
+
+#define VPD_TAG_ID_STRING   0x82
+#define VPD_TAG_RO          0x90
+#define VPD_TAG_RW          0x91
+#define VPD_TAG_END         0x78        // small item 0Fh, length 0
+
+#define VPD_TEXT_LEN        40
+
+typedef struct {
+  UINT8      Bus, Dev, Func;
+  UINT8      Cap;
+  UINT8     *Data;
+  UINTN      Len;         // bytes read so far
+  UINTN      Size;        // allocated
+  UINTN      Walk;        // next tag to check
+  BOOLEAN    Pending;     // address written, waiting for F
+  BOOLEAN    Done;
+  EFI_STATUS Status;
+  UINT64     IssueNs;
+  UINT64     StartNs;
+  UINT64     EndNs;
+} VPD_READ;
+
+// -----------------------------
+// Tag walk
+// -----------------------------
+// Advances over complete tags; stops at End, a bad tag or the 32 KB limit.
+STATIC
+VOID
+VpdWalk(IN OUT VPD_READ *r)
+{
+  while (!r->Done) {
+    if (r->Walk >= r->Len) return;
+
+    UINT8 Tag = r->Data[r->Walk];
+    if (Tag == VPD_TAG_END) {
+      r->Done = TRUE;
+      r->Status = EFI_SUCCESS;
+      return;
+    }
+    if ((Tag & BIT7) == 0 || Tag == 0xFF) {   // only large items before End; blank EEPROM reads FF
+      r->Done = TRUE;
+      r->Status = (r->Walk == 0) ? EFI_NOT_FOUND : EFI_VOLUME_CORRUPTED;
+      return;
+    }
+    if (r->Walk + 3 > r->Len) return;
+
+    UINTN Next = r->Walk + 3 + (r->Data[r->Walk + 1] | ((UINTN)r->Data[r->Walk + 2] << 8));
+    if (Next >= VPD_MAX_SIZE) {
+      r->Done = TRUE;
+      r->Status = EFI_VOLUME_CORRUPTED;
+      return;
+    }
+    r->Walk = Next;
+  }
+}
+
+// -----------------------------
+// Reader
+// -----------------------------
+// One poll step. TRUE when the device moved (address taken or data back).
+STATIC
+BOOLEAN
+VpdStep(IN OUT VPD_READ *r, UINT64 Now)
+{
+  UINT16 Ctl = 0;
+
+  if (!r->Pending) {
+    if (r->Len + 4 > r->Size) {
+      VOID *New = ReallocatePool(r->Size, r->Size + VPD_GROW, r->Data);
+      if (New == NULL) {
+        r->Done = TRUE;
+        r->Status = EFI_OUT_OF_RESOURCES;
+        return TRUE;
+      }
+      r->Data = New;
+      r->Size += VPD_GROW;
+    }
+    PciCfgWrite16(r->Bus, r->Dev, r->Func, (UINT16)(r->Cap + 2), (UINT16)r->Len);
+    r->Pending = TRUE;
+    r->IssueNs = Now;
+    return TRUE;
+  }
+
+  PciCfgRead16(r->Bus, r->Dev, r->Func, (UINT16)(r->Cap + 2), &Ctl);
+  if ((Ctl & VPD_FLAG) == 0) {
+    if (Now - r->IssueNs > VPD_TIMEOUT_NS) {
+      r->Done = TRUE;
+      r->Status = EFI_TIMEOUT;
+    }
+    return FALSE;
+  }
+
+  UINT32 v = 0xFFFFFFFF;
+  PciCfgRead32(r->Bus, r->Dev, r->Func, (UINT16)(r->Cap + 4), &v);
+  WriteUnaligned32((UINT32 *)(r->Data + r->Len), v);
+  r->Len += 4;
+  r->Pending = FALSE;
+
+  VpdWalk(r);
+  if (!r->Done && r->Len >= VPD_MAX_SIZE) {
+    r->Done = TRUE;
+    r->Status = EFI_VOLUME_CORRUPTED;   // no End tag in 32 KB
+  }
+  return TRUE;
+}
+
+// A function may start once the previous function of the same device is done.
+STATIC
+BOOLEAN
+VpdMayRun(IN VPD_READ *R, UINTN i)
+{
+  return i == 0 || R[i - 1].Bus != R[i].Bus || R[i - 1].Dev != R[i].Dev || R[i - 1].Done;
+}
+
+// R sorted by B/D/F. Returns the number of passes that had to sleep.
+STATIC
+UINTN
+VpdReadAll(IN OUT VPD_READ *R, UINTN Count)
+{
+  UINTN Idle = 0, Sleeps = 0, Delay = 0;
+
+  for (UINTN i = 0; i < Count; i++) R[i].Status = EFI_NOT_READY;
+
+  while (TRUE) {
+    BOOLEAN Busy = FALSE, Moved = FALSE;
+    UINT64  Now  = PciCrsNowNs();
+
+    for (UINTN i = 0; i < Count; i++) {
+      VPD_READ *r = &R[i];
+      if (r->Done || !VpdMayRun(R, i)) continue;
+
+      if (r->StartNs == 0) r->StartNs = Now;
+      Busy = TRUE;
+      if (VpdStep(r, Now)) Moved = TRUE;
+      if (r->Done) r->EndNs = PciCrsNowNs();
+    }
+    if (!Busy) break;
+
+    // Tight spin while data keeps coming, then back off
+    if (Moved) {
+      Idle  = 0;
+      Delay = 0;
+    } else if (++Idle > VPD_SPIN_PASSES) {
+      Delay = (Delay == 0) ? 1 : MIN(Delay * 2, (UINTN)VPD_MAX_DELAY_US);
+      MicroSecondDelay(Delay);
+      Sleeps++;
+    }
+  }
+  return Sleeps;
+}
+
+// -----------------------------
+// Decode
+// -----------------------------
+STATIC
+VOID
+VpdText(IN CONST UINT8 *p, UINTN Len, OUT CHAR16 *Out, UINTN OutLen)
+{
+  UINTN n = 0;
+  for (UINTN k = 0; k < Len && n + 1 < OutLen; k++) {
+    if (p[k] == 0) break;
+    Out[n++] = (p[k] >= 0x20 && p[k] < 0x7F) ? (CHAR16)p[k] : L'.';
+  }
+  while (n > 0 && Out[n - 1] == L' ') n--;
+  Out[n] = L'\0';
+}
+
+// Finds keyword K0K1 in the VPD-R / VPD-W items.
+STATIC
+CONST UINT8 *
+VpdKeyword(IN VPD_READ *r, CHAR8 K0, CHAR8 K1, OUT UINTN *Len)
+{
+  for (UINTN t = 0; t + 3 <= r->Len && r->Data[t] != VPD_TAG_END && (r->Data[t] & BIT7); ) {
+    UINTN ItemLen = r->Data[t + 1] | ((UINTN)r->Data[t + 2] << 8);
+    UINTN End     = MIN(t + 3 + ItemLen, r->Len);
+
+    if (r->Data[t] == VPD_TAG_RO || r->Data[t] == VPD_TAG_RW) {
+      for (UINTN k = t + 3; k + 3 <= End; k += 3 + r->Data[k + 2]) {
+        if (r->Data[k] == K0 && r->Data[k + 1] == K1) {
+          *Len = MIN((UINTN)r->Data[k + 2], End - (k + 3));
+          return &r->Data[k + 3];
+        }
+      }
+    }
+    t = End;
+  }
+  return NULL;
+}
+
+STATIC
+VOID
+VpdKeywordText(IN VPD_READ *r, CHAR8 K0, CHAR8 K1, OUT CHAR16 *Out, UINTN OutLen)
+{
+  UINTN        Len = 0;
+  CONST UINT8 *p   = VpdKeyword(r, K0, K1, &Len);
+  if (p == NULL) StrCpyS(Out, OutLen, L"-");
+  else VpdText(p, Len, Out, OutLen);
+}
+
+// RV: bytes from the start of VPD through the RV checksum byte sum to 0.
+STATIC
+CONST CHAR16 *
+VpdChecksum(IN VPD_READ *r)
+{
+  UINTN        Len = 0;
+  CONST UINT8 *p   = VpdKeyword(r, 'R', 'V', &Len);
+  if (p == NULL || Len == 0) return L"no RV";
+
+  UINT8 Sum = 0;
+  for (CONST UINT8 *q = r->Data; q <= p; q++) Sum = (UINT8)(Sum + *q);
+  return (Sum == 0) ? L"OK" : L"BAD";
+}
+
+STATIC
+VOID
+VpdName(IN VPD_READ *r, OUT CHAR16 *Out, UINTN OutLen)
+{
+  Out[0] = L'\0';
+  if (r->Len >= 3 && r->Data[0] == VPD_TAG_ID_STRING) {
+    UINTN Len = r->Data[1] | ((UINTN)r->Data[2] << 8);
+    VpdText(r->Data + 3, MIN(Len, r->Len - 3), Out, OutLen);
+  }
+}
+
+STATIC
+VOID
+VpdFree(IN OUT VPD_READ *R, UINTN Count)
+{
+  for (UINTN i = 0; i < Count; i++) {
+    if (R[i].Data != NULL) FreePool(R[i].Data);
+  }
+  FreePool(R);
+}
+
+// -----------------------------
+// Views
+// -----------------------------
+// Every keyword of one function.
+VOID
+PciVpdDetail(UINT8 Bus, UINT8 Dev, UINT8 Func, OUT PCI_REPORT *Rep)
+{
+  CHAR16    Text[REPORT_LINE_LEN];
+  UINT8     Cap = PciCfgFindCapability(Bus, Dev, Func, VPD_CAP_ID);
+  VPD_READ *r;
+
+  if (Cap == 0) {
+    ReportAdd(Rep, L"%02x:%02x.%x has no VPD capability", Bus, Dev, Func);
+    return;
+  }
+
+  r = AllocateZeroPool(sizeof(VPD_READ));
+  if (r == NULL) return;
+  r->Bus = Bus; r->Dev = Dev; r->Func = Func; r->Cap = Cap;
+  VpdReadAll(r, 1);
+
+  ReportAdd(Rep, L"%02x:%02x.%x  VPD cap @%02x  %u bytes in %lu us  %r",
+            Bus, Dev, Func, Cap, (UINT32)r->Len, DivU64x32(r->EndNs - r->StartNs, 1000), r->Status);
+
+  VpdName(r, Text, ARRAY_SIZE(Text));
+  if (Text[0] != L'\0') ReportAdd(Rep, L"Name  %s", Text);
+
+  for (UINTN t = 0; t + 3 <= r->Len && r->Data[t] != VPD_TAG_END && (r->Data[t] & BIT7); ) {
+    UINTN ItemLen = r->Data[t + 1] | ((UINTN)r->Data[t + 2] << 8);
+    UINTN End     = MIN(t + 3 + ItemLen, r->Len);
+
+    if (r->Data[t] == VPD_TAG_RO || r->Data[t] == VPD_TAG_RW) {
+      ReportAdd(Rep, L"%s (%u bytes)", (r->Data[t] == VPD_TAG_RO) ? L"VPD-R" : L"VPD-W", (UINT32)ItemLen);
+      for (UINTN k = t + 3; k + 3 <= End; k += 3 + r->Data[k + 2]) {
+        CHAR8 K0 = (CHAR8)r->Data[k], K1 = (CHAR8)r->Data[k + 1];
+        UINTN Len = MIN((UINTN)r->Data[k + 2], End - (k + 3));
+        if (K0 == 'R' && K1 == 'V') {
+          ReportAdd(Rep, L"  RV  checksum %s", VpdChecksum(r));
+        } else if (K0 == 'R' && K1 == 'W') {
+          ReportAdd(Rep, L"  RW  %u bytes free", (UINT32)Len);
+        } else {
+          VpdText(&r->Data[k + 3], Len, Text, ARRAY_SIZE(Text) - 8);
+          ReportAdd(Rep, L"  %c%c  %s", (CHAR16)K0, (CHAR16)K1, Text);
+        }
+      }
+    }
+    t = End;
+  }
+
+  if (r->Data != NULL) FreePool(r->Data);
+  FreePool(r);
+}
+
+// Serial / part numbers of every function with VPD, read interleaved.
+UINTN
+PciVpdInventory(IN PCI_DEV_INFO *List, UINTN Count, OUT PCI_REPORT *Rep)
+{
+  VPD_READ *R = AllocateZeroPool(sizeof(VPD_READ) * Count);
+  UINTN     n = 0;
+
+  if (R == NULL) return 0;
+
+  // List is in B/D/F order, so functions of one device stay adjacent
+  for (UINTN i = 0; i < Count; i++) {
+    UINT8 Cap = PciCfgFindCapability(List[i].Bus, List[i].Dev, List[i].Func, VPD_CAP_ID);
+    if (Cap == 0) continue;
+    R[n].Bus = List[i].Bus; R[n].Dev = List[i].Dev; R[n].Func = List[i].Func;
+    R[n].Cap = Cap;
+    n++;
+  }
+
+  UINT64 Start  = PciCrsNowNs();
+  UINTN  Sleeps = VpdReadAll(R, n);
+  UINT64 Ns     = PciCrsNowNs() - Start;
+  UINTN  Bytes  = 0, Good = 0;
+
+  ReportAdd(Rep, L"B:D.F    Serial               Part                 EC      Csum   Name");
+  for (UINTN i = 0; i < n; i++) {
+    VPD_READ *r = &R[i];
+    CHAR16 Sn[21], Pn[21], Ec[8], Name[VPD_TEXT_LEN];
+
+    Bytes += r->Len;
+    if (EFI_ERROR(r->Status)) {
+      ReportAdd(Rep, L"%02x:%02x.%x  (%r after %u bytes)", r->Bus, r->Dev, r->Func, r->Status, (UINT32)r->Len);
+      continue;
+    }
+
+    Good++;
+    VpdKeywordText(r, 'S', 'N', Sn, ARRAY_SIZE(Sn));
+    VpdKeywordText(r, 'P', 'N', Pn, ARRAY_SIZE(Pn));
+    VpdKeywordText(r, 'E', 'C', Ec, ARRAY_SIZE(Ec));
+    VpdName(r, Name, ARRAY_SIZE(Name));
+    ReportAdd(Rep, L"%02x:%02x.%x  %-20s %-20s %-7s %-6s %s",
+              r->Bus, r->Dev, r->Func, Sn, Pn, Ec, VpdChecksum(r), Name);
+  }
+
+  ReportAdd(Rep, L"");
+  ReportAdd(Rep, L"Functions with VPD: %u  read: %u  bytes: %u  time: %lu us  idle sleeps: %u",
+            (UINT32)n, (UINT32)Good, (UINT32)Bytes, DivU64x32(Ns, 1000), (UINT32)Sleeps);
+
+  VpdFree(R, n);
+  return Good;
+}
@@ -0,0 +1,377 @@
+#include "PciUtility.h"
+
+//
+// Write policy as a table. For one function the whole 4 KB config space
+// gets a policy per byte, taken from the header type (type 0 / bridge /
+// CardBus), the capability lists (headers and read-only fields, RW1C
+// status registers, VF BARs) and writable masks found by the Config View
+// probe. The byte policies are then merged per naturally aligned WORD and
+// DWORD, so a lookup for any width is one read of Pol[Off]:
+//
+//   bits 2:0  byte   bits 5:3  word   bits 8:6  dword
+//
+// Tables of the last POLICY_CACHE functions are kept (LRU); a range check
+// over a whole window builds the table once and then only indexes it.
+//
+// RW1C is tracked per bit next to the byte policies: a byte that mixes RW
+// and RW1C bits (PMCSR [15:8]: PME_Status RW1C, Data_Select / PME_En RW)
+// keeps the policy of its RW bits and only the RW1C bits are zeroed on a
+// read-modify-write.
+//
+#define POLICY_SPACE     0x1000
+#define POLICY_CACHE     8
+#define POLICY_PROBES    64
+#define POLICY_BITS      3
+#define POLICY_FIELD     0x7
+
+#define NO_RID           0xFFFFFFFF
+#define RID(Bus, Dev, Func)  ((UINT32)(((Bus) << 8) | ((Dev) << 3) | (Func)))
+
+typedef struct {
+  UINT32 Rid;
+  UINT32 Used;
+  UINT16 Pol[POLICY_SPACE];
+  UINT8  Rw1c[POLICY_SPACE];   // RW1C bits of each byte
+} POLICY_TABLE;
+
+typedef struct {
+  UINT32 Rid;
+  UINT16 Off;
+  UINT8  Width;
+  UINT32 Mask;                 // bits that changed when probed
+} POLICY_PROBE;
+
+STATIC POLICY_TABLE  mTab[POLICY_CACHE];
+STATIC POLICY_TABLE *mLast   = NULL;
+STATIC UINT32        mTick   = 0;
+STATIC BOOLEAN       mInit   = FALSE;
+STATIC POLICY_PROBE  mProbe[POLICY_PROBES];   // ring
+STATIC UINTN         mProbeNext  = 0;
+STATIC UINTN         mProbeCount = 0;
+
+// -----------------------------
+// Policy helpers
+// -----------------------------
+BOOLEAN
+PolicyIsRw1c(WRITE_POLICY Pol)
+{
+  return Pol == WP_RW1C || Pol == WP_RW1C_CAP;
+}
+
+// Needs the F9 unlock
+BOOLEAN
+PolicyIsDangerous(WRITE_POLICY Pol)
+{
+  return Pol == WP_DANGEROUS_BAR || Pol == WP_DANGEROUS_CAP || Pol == WP_RW1C_CAP;
+}
+
+CONST CHAR16 *
+PolicyName(WRITE_POLICY Pol)
+{
+  switch (Pol) {
+    case WP_BLOCK_RO:      return L"RO (blocked)";
+    case WP_RW_DIRECT:     return L"RW";
+    case WP_RW1C:          return L"RW1C (Status-like)";
+    case WP_RW1C_CAP:      return L"RW1C in capability (unlock)";
+    case WP_DANGEROUS_BAR: return L"DANGEROUS BAR / routing";
+    case WP_DANGEROUS_CAP: return L"DANGEROUS CAP";
+    default:               return L"?";
+  }
+}
+
+// Several bytes written together: RO only if every byte is; otherwise the
+// strictest writable kind. RW1C only when no byte is plain RW (a mixed
+// register is written RMW with its RW1C lanes zeroed, see PolicyWrite).
+STATIC
+WRITE_POLICY
+Merge(IN CONST UINT16 *Pol, UINTN Width)
+{
+  BOOLEAN Ro = TRUE, Bar = FALSE, Cap = FALSE, Rw = FALSE, Rw1cCap = FALSE;
+
+  for (UINTN k = 0; k < Width; k++) {
+    WRITE_POLICY b = (WRITE_POLICY)(Pol[k] & POLICY_FIELD);
+    if (b == WP_BLOCK_RO) continue;
+    Ro = FALSE;
+    if (b == WP_DANGEROUS_BAR) Bar = TRUE;
+    else if (b == WP_DANGEROUS_CAP) Cap = TRUE;
+    else if (b == WP_RW_DIRECT) Rw = TRUE;
+    else if (b == WP_RW1C_CAP) Rw1cCap = TRUE;
+  }
+
+  if (Ro)  return WP_BLOCK_RO;
+  if (Bar) return WP_DANGEROUS_BAR;
+  if (Cap) return WP_DANGEROUS_CAP;
+  if (Rw)  return Rw1cCap ? WP_DANGEROUS_CAP : WP_RW_DIRECT;
+  return Rw1cCap ? WP_RW1C_CAP : WP_RW1C;
+}
+
+// Recomputes the word / dword fields of the aligned offsets covering [Start, End).
+STATIC
+VOID
+Remerge(IN OUT POLICY_TABLE *T, UINTN Start, UINTN End)
+{
+  for (UINTN o = Start & ~3U; o < End && o < POLICY_SPACE; o++) {
+    UINT16 v = (UINT16)(T->Pol[o] & POLICY_FIELD);
+    if ((o & 1) == 0) v |= (UINT16)(Merge(&T->Pol[o], 2) << POLICY_BITS);
+    if ((o & 3) == 0) v |= (UINT16)(Merge(&T->Pol[o], 4) << (2 * POLICY_BITS));
+    T->Pol[o] = v;
+  }
+}
+
+STATIC
+VOID
+SetRange(IN OUT POLICY_TABLE *T, UINTN Start, UINTN Length, WRITE_POLICY Pol)
+{
+  for (UINTN k = Start; k < Start + Length && k < POLICY_SPACE; k++) {
+    T->Pol[k]  = (UINT16)Pol;
+    T->Rw1c[k] = PolicyIsRw1c(Pol) ? 0xFF : 0;
+  }
+}
+
+// -----------------------------
+// Build
+// -----------------------------
+STATIC
+VOID
+SetHeader(IN OUT POLICY_TABLE *T, UINT8 HdrType)
+{
+  SetRange(T, 0x00, 0x04, WP_BLOCK_RO);         // Vendor / Device ID
+  SetRange(T, 0x04, 0x02, WP_RW_DIRECT);        // Command
+  SetRange(T, 0x06, 0x02, WP_RW1C);             // Status
+  SetRange(T, 0x08, 0x04, WP_BLOCK_RO);         // Revision, Class Code
+  SetRange(T, 0x0C, 0x02, WP_RW_DIRECT);        // Cache Line, Latency Timer
+  SetRange(T, 0x0E, 0x01, WP_BLOCK_RO);         // Header Type
+  SetRange(T, 0x0F, 0x01, WP_RW_DIRECT);        // BIST
+  SetRange(T, 0x34, 0x0C, WP_BLOCK_RO);         // Capabilities Pointer, reserved
+  SetRange(T, 0x3C, 0x01, WP_RW_DIRECT);        // Interrupt Line
+  SetRange(T, 0x3D, 0x01, WP_BLOCK_RO);         // Interrupt Pin
+
+  if (HdrType == 0x00) {
+    SetRange(T, 0x10, 0x18, WP_DANGEROUS_BAR);  // BAR0-5
+    SetRange(T, 0x28, 0x08, WP_BLOCK_RO);       // CardBus CIS, Subsystem IDs
+    SetRange(T, 0x30, 0x04, WP_DANGEROUS_BAR);  // Expansion ROM
+    SetRange(T, 0x3E, 0x02, WP_BLOCK_RO);       // Min_Gnt, Max_Lat
+  } else if (HdrType == 0x01) {
+    SetRange(T, 0x10, 0x08, WP_DANGEROUS_BAR);  // BAR0-1
+    SetRange(T, 0x18, 0x03, WP_DANGEROUS_BAR);  // bus numbers
+    SetRange(T, 0x1B, 0x01, WP_RW_DIRECT);      // Secondary Latency Timer
+    SetRange(T, 0x1C, 0x02, WP_DANGEROUS_BAR);  // I/O base / limit
+    SetRange(T, 0x1E, 0x02, WP_RW1C);           // Secondary Status
+    SetRange(T, 0x20, 0x14, WP_DANGEROUS_BAR);  // memory / prefetchable windows, I/O upper
+    SetRange(T, 0x38, 0x04, WP_DANGEROUS_BAR);  // Expansion ROM
+    SetRange(T, 0x3E, 0x02, WP_DANGEROUS_BAR);  // Bridge Control (Secondary Bus Reset)
+  } else {
+    SetRange(T, 0x10, 0x24, WP_DANGEROUS_BAR);  // CardBus windows and the rest
+    SetRange(T, 0x3E, 0x02, WP_DANGEROUS_BAR);
+  }
+}
+
+STATIC
+VOID
+SetCapability(IN OUT POLICY_TABLE *T, UINT8 Id, UINTN c)
+{
+  SetRange(T, c, 2, WP_BLOCK_RO);               // ID, Next
+
+  switch (Id) {
+    case 0x01:                                  // Power Management
+      SetRange(T, c + 0x02, 2, WP_BLOCK_RO);
+      SetRange(T, c + 0x04, 2, WP_DANGEROUS_CAP);   // PMCSR: PowerState, PME_En, Data_Select
+      T->Rw1c[c + 0x05] = BIT7;                 // PME_Status (PMCSR bit 15)
+      SetRange(T, c + 0x06, 2, WP_BLOCK_RO);
+      break;
+    case 0x0D:                                  // Subsystem ID (bridges)
+      SetRange(T, c + 0x04, 4, WP_BLOCK_RO);
+      break;
+    case 0x10:                                  // PCI Express
+      SetRange(T, c + 0x02, 6, WP_BLOCK_RO);    // PCIe Capabilities, Device Capabilities
+      SetRange(T, c + 0x0A, 2, WP_RW1C_CAP);    // Device Status
+      SetRange(T, c + 0x0C, 4, WP_BLOCK_RO);    // Link Capabilities
+      SetRange(T, c + 0x12, 2, WP_RW1C_CAP);    // Link Status
+      SetRange(T, c + 0x14, 4, WP_BLOCK_RO);    // Slot Capabilities
+      SetRange(T, c + 0x1A, 2, WP_RW1C_CAP);    // Slot Status
+      SetRange(T, c + 0x1E, 2, WP_BLOCK_RO);    // Root Capabilities
+      SetRange(T, c + 0x20, 4, WP_RW1C_CAP);    // Root Status
+      SetRange(T, c + 0x24, 4, WP_BLOCK_RO);    // Device Capabilities 2
+      SetRange(T, c + 0x2A, 6, WP_BLOCK_RO);    // Device Status 2, Link Capabilities 2
+      SetRange(T, c + 0x32, 2, WP_RW1C_CAP);    // Link Status 2
+      SetRange(T, c + 0x34, 4, WP_BLOCK_RO);    // Slot Capabilities 2
+      break;
+    case 0x11:                                  // MSI-X
+      SetRange(T, c + 0x04, 8, WP_BLOCK_RO);    // Table / PBA offset and BIR
+      break;
+    default:
+      break;
+  }
+}
+
+STATIC
+VOID
+SetExtCapability(IN OUT POLICY_TABLE *T, UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Id, UINTN c)
+{
+  SetRange(T, c, 4, WP_BLOCK_RO);               // ID, Version, Next
+
+  switch (Id) {
+    case 0x0001:                                // AER
+      SetRange(T, c + 0x04, 4, WP_RW1C_CAP);    // Uncorrectable Status
+      SetRange(T, c + 0x10, 4, WP_RW1C_CAP);    // Correctable Status
+      SetRange(T, c + 0x1C, 0x10, WP_BLOCK_RO); // Header Log
+      SetRange(T, c + 0x30, 4, WP_RW1C_CAP);    // Root Error Status
+      SetRange(T, c + 0x34, 4, WP_BLOCK_RO);    // Error Source ID
+      SetRange(T, c + 0x38, 0x10, WP_BLOCK_RO); // TLP Prefix Log
+      break;
+    case 0x0003:                                // Device Serial Number
+      SetRange(T, c + 0x04, 8, WP_BLOCK_RO);
+      break;
+    case 0x000D:                                // ACS
+      SetRange(T, c + 0x04, 2, WP_BLOCK_RO);
+      break;
+    case 0x0010:                                // SR-IOV
+      SetRange(T, c + 0x04, 4, WP_BLOCK_RO);
+      SetRange(T, c + 0x0A, 2, WP_RW1C_CAP);    // SR-IOV Status
+      SetRange(T, c + 0x0C, 4, WP_BLOCK_RO);    // InitialVFs, TotalVFs
+      SetRange(T, c + 0x12, 0x0E, WP_BLOCK_RO); // FDL, offset / stride, VF Device ID, page sizes
+      SetRange(T, c + 0x24, 0x18, WP_DANGEROUS_BAR);   // VF BAR0-5
+      SetRange(T, c + 0x3C, 4, WP_BLOCK_RO);
+      break;
+    case 0x0015: {                              // Resizable BAR: capability words are RO
+      UINT32 Ctl = 0;
+      PciCfgRead32(Bus, Dev, Func, (UINT16)(c + 0x08), &Ctl);
+      UINTN  Bars = MIN((UINTN)((Ctl >> 5) & 0x7), (UINTN)6);
+      for (UINTN k = 0; k < Bars; k++) SetRange(T, c + 0x04 + k * 8, 4, WP_BLOCK_RO);
+      break;
+    }
+    case 0x0019:                                // Secondary PCIe
+      SetRange(T, c + 0x08, 4, WP_RW1C_CAP);    // Lane Error Status
+      break;
+    case 0x001E:                                // L1 PM Substates
+      SetRange(T, c + 0x04, 4, WP_BLOCK_RO);
+      break;
+    default:
+      break;
+  }
+}
+
+STATIC
+VOID
+ApplyProbe(IN OUT POLICY_TABLE *T, IN POLICY_PROBE *p)
+{
+  for (UINTN k = 0; k < p->Width; k++) {
+    UINTN o = p->Off + k;
+    if (o >= POLICY_SPACE || ((p->Mask >> (8 * k)) & 0xFF) != 0) continue;
+    if (T->Rw1c[o] != 0) continue;              // RW1C reads back unchanged
+    T->Pol[o] = (UINT16)((T->Pol[o] & ~POLICY_FIELD) | WP_BLOCK_RO);
+  }
+  Remerge(T, p->Off, p->Off + p->Width);
+}
+
+STATIC
+VOID
+BuildTable(IN OUT POLICY_TABLE *T, UINT8 Bus, UINT8 Dev, UINT8 Func)
+{
+  UINT8   Hdr = 0;
+  UINT16  Id  = 0;
+  UINT8   CapId = 0;
+  BOOLEAN Pcie  = FALSE;
+
+  PciCfgRead8(Bus, Dev, Func, 0x0E, &Hdr);
+  ZeroMem(T->Rw1c, sizeof (T->Rw1c));
+
+  // Unknown bytes in the device specific / capability area stay behind the unlock
+  SetRange(T, 0x40, 0xC0, WP_DANGEROUS_CAP);
+  SetHeader(T, (UINT8)(Hdr & 0x7F));
+
+  UINT8 c = 0;
+  for (UINTN n = 0; n < 48 && (c = PciCfgNextCapability(Bus, Dev, Func, c, &CapId)) != 0; n++) {
+    SetCapability(T, CapId, c);
+    if (CapId == 0x10) Pcie = TRUE;
+  }
+
+  // Extended space exists only behind a PCI Express capability
+  SetRange(T, 0x100, POLICY_SPACE - 0x100, Pcie ? WP_DANGEROUS_CAP : WP_BLOCK_RO);
+  if (Pcie) {
+    UINT16 e = 0;
+    for (UINTN n = 0; n < (POLICY_SPACE - 0x100) / 4 && (e = PciCfgNextExtCapability(Bus, Dev, Func, e, &Id)) != 0; n++) {
+      SetExtCapability(T, Bus, Dev, Func, Id, e);
+    }
+  }
+
+  Remerge(T, 0, POLICY_SPACE);
+
+  T->Rid = RID(Bus, Dev, Func);
+  for (UINTN k = 0; k < mProbeCount; k++) {
+    if (mProbe[k].Rid == T->Rid) ApplyProbe(T, &mProbe[k]);
+  }
+}
+
+STATIC
+POLICY_TABLE *
+GetTable(UINT8 Bus, UINT8 Dev, UINT8 Func)
+{
+  UINT32        Rid    = RID(Bus, Dev, Func);
+  POLICY_TABLE *Oldest = &mTab[0];
+
+  if (mLast != NULL && mLast->Rid == Rid) return mLast;
+
+  if (!mInit) {
+    for (UINTN k = 0; k < POLICY_CACHE; k++) mTab[k].Rid = NO_RID;
+    mInit = TRUE;
+  }
+
+  for (UINTN k = 0; k < POLICY_CACHE; k++) {
+    if (mTab[k].Rid == Rid) {
+      mLast = &mTab[k];
+      mLast->Used = ++mTick;
+      return mLast;
+    }
+    if (mTab[k].Used < Oldest->Used) Oldest = &mTab[k];
+  }
+
+  BuildTable(Oldest, Bus, Dev, Func);
+  Oldest->Used = ++mTick;
+  mLast = Oldest;
+  return Oldest;
+}
+
+// -----------------------------
+// Lookup
+// -----------------------------
+WRITE_POLICY
+PolicyLookup(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode)
+{
+  UINTN Width = (Mode == DISP_DWORD) ? 4 : (Mode == DISP_WORD) ? 2 : 1;
+  Off = (UINT16)((Off & (POLICY_SPACE - 1)) & ~(Width - 1));
+  return (WRITE_POLICY)((GetTable(Bus, Dev, Func)->Pol[Off] >> (POLICY_BITS * Mode)) & POLICY_FIELD);
+}
+
+// RW1C bits of an aligned Mode access (a RMW must write 0 there).
+UINT32
+PolicyRw1cLanes(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode)
+{
+  UINTN         Width = (Mode == DISP_DWORD) ? 4 : (Mode == DISP_WORD) ? 2 : 1;
+  POLICY_TABLE *T     = GetTable(Bus, Dev, Func);
+  UINT32        Lanes = 0;
+
+  Off = (UINT16)((Off & (POLICY_SPACE - 1)) & ~(Width - 1));
+  for (UINTN k = 0; k < Width; k++) {
+    Lanes |= (UINT32)T->Rw1c[Off + k] << (8 * k);
+  }
+  return Lanes;
+}
+
+// Config View probe result: bytes that did not change are read-only from now on.
+VOID
+PolicyNoteProbe(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Off, DISP_MODE Mode, UINT32 Mask)
+{
+  POLICY_PROBE *p = &mProbe[mProbeNext];
+
+  p->Rid   = RID(Bus, Dev, Func);
+  p->Off   = Off;
+  p->Width = (UINT8)((Mode == DISP_DWORD) ? 4 : (Mode == DISP_WORD) ? 2 : 1);
+  p->Mask  = Mask;
+  mProbeNext = (mProbeNext + 1) % POLICY_PROBES;
+  if (mProbeCount < POLICY_PROBES) mProbeCount++;
+
+  for (UINTN k = 0; mInit && k < POLICY_CACHE; k++) {
+    if (mTab[k].Rid == p->Rid) ApplyProbe(&mTab[k], p);
+  }
+}
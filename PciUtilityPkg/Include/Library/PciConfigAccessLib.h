@@ -0,0 +1,193 @@
+/** @file
+  PCI configuration space access shared by the PciUtilityPkg tools.
+
+  Every access goes through the active backend (RBIO by default). Backends:
+  - Root Bridge I/O: EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL.Pci, multi-count calls
+  - ECAM: MCFG window, plain MMIO (also safe on APs)
+  - Image: a config space image file loaded into memory (offline analysis)
+  - Simulated: functions added by the caller, with per-byte write masks
+
+  Addresses are bus/dev/func/register; registers above 0xFF reach the
+  PCIe extended space on backends that decode it.
+**/
+
+#ifndef _PCI_CONFIG_ACCESS_LIB_H_
+#define _PCI_CONFIG_ACCESS_LIB_H_
+
+#include <Uefi.h>
+#include <Protocol/PciRootBridgeIo.h>
+
+// ECAM-style packed address: Bus[27:20] Dev[19:15] Func[14:12] Reg[11:0]
+#define PCI_CFG_ADDRESS(Bus, Dev, Func, Reg) \
+  (((UINT32)(Bus) << 20) | ((UINT32)(Dev) << 15) | ((UINT32)(Func) << 12) | ((UINT32)(Reg) & 0xFFF))
+
+#define PCI_CFG_ADDRESS_BUS(A)   ((UINT8)((A) >> 20))
+#define PCI_CFG_ADDRESS_DEV(A)   ((UINT8)(((A) >> 15) & 0x1F))
+#define PCI_CFG_ADDRESS_FUNC(A)  ((UINT8)(((A) >> 12) & 0x07))
+#define PCI_CFG_ADDRESS_REG(A)   ((UINT16)((A) & 0xFFF))
+
+// -----------------------------
+// Backend vtable
+// -----------------------------
+typedef struct _PCI_CFG_BACKEND PCI_CFG_BACKEND;
+
+// Count elements of Width (1 / 2 / 4) bytes from Address upwards. Width
+// aligned, never crossing a function. Unbacked bytes read as 0xFF.
+typedef
+EFI_STATUS
+(EFIAPI *PCI_CFG_BACKEND_READ)(
+  IN  PCI_CFG_BACKEND *This,
+  IN  UINT32           Address,
+  IN  UINTN            Width,
+  IN  UINTN            Count,
+  OUT VOID            *Buffer
+  );
+
+// As Read; with Fill set Buffer holds one element written to every address.
+typedef
+EFI_STATUS
+(EFIAPI *PCI_CFG_BACKEND_WRITE)(
+  IN PCI_CFG_BACKEND *This,
+  IN UINT32           Address,
+  IN UINTN            Width,
+  IN UINTN            Count,
+  IN BOOLEAN          Fill,
+  IN CONST VOID      *Buffer
+  );
+
+struct _PCI_CFG_BACKEND {
+  CONST CHAR16          *Name;
+  PCI_CFG_BACKEND_READ   Read;
+  PCI_CFG_BACKEND_WRITE  Write;
+  VOID                  *Context;
+};
+
+// Installs a caller-provided backend (drivers, tests). NULL restores RBIO.
+VOID
+EFIAPI
+PciCfgSetBackend(IN PCI_CFG_BACKEND *Backend OPTIONAL);
+
+PCI_CFG_BACKEND *
+EFIAPI
+PciCfgGetBackend(VOID);
+
+// -----------------------------
+// Backend selection
+// -----------------------------
+// RbIo NULL: the first EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL instance.
+EFI_STATUS
+EFIAPI
+PciCfgUseRootBridgeIo(IN EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *RbIo OPTIONAL);
+
+EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *
+EFIAPI
+PciCfgRootBridgeIo(VOID);
+
+// Looks up the MCFG window of Segment; PciCfgUseEcam() then switches to it.
+EFI_STATUS
+EFIAPI
+PciCfgEcamInit(UINT16 Segment);
+
+BOOLEAN
+EFIAPI
+PciCfgEcamAvailable(VOID);
+
+BOOLEAN
+EFIAPI
+PciCfgEcamCoversBus(UINT8 Bus);
+
+EFI_STATUS
+EFIAPI
+PciCfgUseEcam(VOID);
+
+// Direct MMIO read, no backend dispatch: for AP procedures.
+UINT32
+EFIAPI
+PciCfgEcamRead32(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg);
+
+// Starts an empty simulated segment (every function absent).
+EFI_STATUS
+EFIAPI
+PciCfgUseSimulated(VOID);
+
+// Config is 256 or 4096 bytes. WriteMask (same size) marks writable bits;
+// NULL makes every bit writable.
+EFI_STATUS
+EFIAPI
+PciCfgSimAddFunction(UINT8 Bus, UINT8 Dev, UINT8 Func, IN CONST UINT8 *Config,
+                     UINTN Size, IN CONST UINT8 *WriteMask OPTIONAL);
+
+// -----------------------------
+// Config space image
+// -----------------------------
+// PCI_CFG_IMAGE_HEADER, then Count records of PCI_CFG_IMAGE_RECORD each
+// followed by Size (256 or 4096) bytes of config space.
+#define PCI_CFG_IMAGE_SIGNATURE  SIGNATURE_32('P', 'C', 'F', 'G')
+#define PCI_CFG_IMAGE_VERSION    1
+
+#pragma pack(1)
+typedef struct {
+  UINT32 Signature;
+  UINT16 Version;
+  UINT16 Segment;
+  UINT32 Count;
+} PCI_CFG_IMAGE_HEADER;
+
+typedef struct {
+  UINT8  Bus;
+  UINT8  Dev;
+  UINT8  Func;
+  UINT8  Reserved;
+  UINT32 Size;
+} PCI_CFG_IMAGE_RECORD;
+#pragma pack()
+
+// Loads Image into a simulated segment; writes change the copy only.
+EFI_STATUS
+EFIAPI
+PciCfgUseImage(IN CONST VOID *Image, UINTN Size);
+
+// -----------------------------
+// Access
+// -----------------------------
+EFI_STATUS EFIAPI PciCfgRead8 (UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg, OUT UINT8  *Value);
+EFI_STATUS EFIAPI PciCfgRead16(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg, OUT UINT16 *Value);
+EFI_STATUS EFIAPI PciCfgRead32(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg, OUT UINT32 *Value);
+
+EFI_STATUS EFIAPI PciCfgWrite8 (UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg, UINT8  Value);
+EFI_STATUS EFIAPI PciCfgWrite16(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg, UINT16 Value);
+EFI_STATUS EFIAPI PciCfgWrite32(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg, UINT32 Value);
+
+// Count DWORDs from Reg in one backend call.
+EFI_STATUS EFIAPI PciCfgReadBulk32 (UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg, UINTN Count, OUT UINT32 *Buffer);
+EFI_STATUS EFIAPI PciCfgWriteBulk32(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg, UINTN Count, IN UINT32 *Buffer);
+EFI_STATUS EFIAPI PciCfgFill32     (UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg, UINTN Count, UINT32 Value);
+
+// Any byte range; the aligned middle goes out as DWORDs.
+EFI_STATUS
+EFIAPI
+PciCfgReadBytes(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg, UINTN Length, OUT UINT8 *Buffer);
+
+// -----------------------------
+// Capabilities
+// -----------------------------
+// Offset of capability CapId, or 0.
+UINT8
+EFIAPI
+PciCfgFindCapability(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT8 CapId);
+
+// Offset of extended capability ExtId (0x100+), or 0.
+UINT16
+EFIAPI
+PciCfgFindExtCapability(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 ExtId);
+
+// Iterates the list: Prev 0 starts at the head. Returns the next offset or 0.
+UINT8
+EFIAPI
+PciCfgNextCapability(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT8 Prev, OUT UINT8 *CapId OPTIONAL);
+
+UINT16
+EFIAPI
+PciCfgNextExtCapability(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Prev, OUT UINT16 *ExtId OPTIONAL);
+
+#endif
@@ -0,0 +1,199 @@
+#include "PciConfigAccessInternal.h"
+
+#define MAX_CAP_WALK      48    // (0x100 - 0x40) / 4: bounds a looping list
+#define MAX_EXT_CAP_WALK  960   // (0x1000 - 0x100) / 4
+
+STATIC PCI_CFG_BACKEND *mBackend = &gPciCfgRbIoBackend;
+
+// -----------------------------
+// Backend selection
+// -----------------------------
+VOID
+PciCfgActivate(IN PCI_CFG_BACKEND *Backend)
+{
+  mBackend = Backend;
+}
+
+VOID
+EFIAPI
+PciCfgSetBackend(IN PCI_CFG_BACKEND *Backend OPTIONAL)
+{
+  mBackend = (Backend != NULL) ? Backend : &gPciCfgRbIoBackend;
+}
+
+PCI_CFG_BACKEND *
+EFIAPI
+PciCfgGetBackend(VOID)
+{
+  return mBackend;
+}
+
+VOID
+PciCfgFillOnes(OUT VOID *Buffer, UINTN Width, UINTN Count)
+{
+  SetMem(Buffer, Width * Count, 0xFF);
+}
+
+// -----------------------------
+// Dispatch
+// -----------------------------
+// The whole transfer stays inside one function's 4 KB.
+STATIC
+EFI_STATUS
+CfgRead(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg, UINTN Width, UINTN Count, OUT VOID *Buf)
+{
+  if ((Reg & (Width - 1)) != 0 || Reg + Width * Count > 0x1000 || Dev > 31 || Func > 7) {
+    return EFI_INVALID_PARAMETER;
+  }
+  return mBackend->Read(mBackend, PCI_CFG_ADDRESS(Bus, Dev, Func, Reg), Width, Count, Buf);
+}
+
+STATIC
+EFI_STATUS
+CfgWrite(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg, UINTN Width, UINTN Count, BOOLEAN Fill, IN CONST VOID *Buf)
+{
+  if ((Reg & (Width - 1)) != 0 || Reg + Width * Count > 0x1000 || Dev > 31 || Func > 7) {
+    return EFI_INVALID_PARAMETER;
+  }
+  return mBackend->Write(mBackend, PCI_CFG_ADDRESS(Bus, Dev, Func, Reg), Width, Count, Fill, Buf);
+}
+
+EFI_STATUS EFIAPI PciCfgRead8 (UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINT8  *V){ return CfgRead(B, D, F, R, 1, 1, V); }
+EFI_STATUS EFIAPI PciCfgRead16(UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINT16 *V){ return CfgRead(B, D, F, R, 2, 1, V); }
+EFI_STATUS EFIAPI PciCfgRead32(UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINT32 *V){ return CfgRead(B, D, F, R, 4, 1, V); }
+
+EFI_STATUS EFIAPI PciCfgWrite8 (UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINT8  V){ return CfgWrite(B, D, F, R, 1, 1, FALSE, &V); }
+EFI_STATUS EFIAPI PciCfgWrite16(UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINT16 V){ return CfgWrite(B, D, F, R, 2, 1, FALSE, &V); }
+EFI_STATUS EFIAPI PciCfgWrite32(UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINT32 V){ return CfgWrite(B, D, F, R, 4, 1, FALSE, &V); }
+
+EFI_STATUS EFIAPI PciCfgReadBulk32 (UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINTN Count, UINT32 *Buf){ return CfgRead(B, D, F, R, 4, Count, Buf); }
+EFI_STATUS EFIAPI PciCfgWriteBulk32(UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINTN Count, UINT32 *Buf){ return CfgWrite(B, D, F, R, 4, Count, FALSE, Buf); }
+EFI_STATUS EFIAPI PciCfgFill32     (UINT8 B, UINT8 D, UINT8 F, UINT16 R, UINTN Count, UINT32 V)   { return CfgWrite(B, D, F, R, 4, Count, TRUE, &V); }
+
+EFI_STATUS
+EFIAPI
+PciCfgReadBytes(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg, UINTN Length, OUT UINT8 *Buffer)
+{
+  EFI_STATUS St = EFI_SUCCESS;
+
+  if (Reg + Length > 0x1000) return EFI_INVALID_PARAMETER;
+
+  // Unaligned head / tail byte by byte, the middle in one DWORD transfer
+  UINTN Head = MIN((UINTN)((4 - (Reg & 3)) & 3), Length);
+  UINTN Mid  = (Length - Head) & ~(UINTN)3;
+  UINTN Tail = Length - Head - Mid;
+
+  for (UINTN k = 0; k < Head && !EFI_ERROR(St); k++) {
+    St = CfgRead(Bus, Dev, Func, (UINT16)(Reg + k), 1, 1, Buffer + k);
+  }
+  if (!EFI_ERROR(St) && Mid > 0) {
+    if (((UINTN)(Buffer + Head) & 3) == 0) {
+      St = CfgRead(Bus, Dev, Func, (UINT16)(Reg + Head), 4, Mid / 4, Buffer + Head);
+    } else {
+      for (UINTN k = 0; k < Mid && !EFI_ERROR(St); k += 4) {
+        UINT32 v;
+        St = CfgRead(Bus, Dev, Func, (UINT16)(Reg + Head + k), 4, 1, &v);
+        WriteUnaligned32((UINT32 *)(Buffer + Head + k), v);
+      }
+    }
+  }
+  for (UINTN k = Length - Tail; k < Length && !EFI_ERROR(St); k++) {
+    St = CfgRead(Bus, Dev, Func, (UINT16)(Reg + k), 1, 1, Buffer + k);
+  }
+  return St;
+}
+
+// -----------------------------
+// Capabilities
+// -----------------------------
+UINT8
+EFIAPI
+PciCfgFindCapability(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT8 CapId)
+{
+  UINT16 Sts = 0;
+  if (EFI_ERROR(PciCfgRead16(Bus, Dev, Func, 0x06, &Sts)) || (Sts & BIT4) == 0) {
+    return 0;
+  }
+
+  UINT8 Ptr = 0;
+  PciCfgRead8(Bus, Dev, Func, 0x34, &Ptr);
+  Ptr &= 0xFC;
+
+  // One 16-bit read per hop: ID and next pointer together
+  for (UINTN n = 0; n < MAX_CAP_WALK && Ptr >= 0x40; n++) {
+    UINT16 Hdr = 0;
+    PciCfgRead16(Bus, Dev, Func, Ptr, &Hdr);
+
+    if ((UINT8)Hdr == CapId) return Ptr;
+    if ((UINT8)Hdr == 0xFF) break;
+
+    Ptr = (UINT8)((Hdr >> 8) & 0xFC);
+  }
+
+  return 0;
+}
+
+UINT16
+EFIAPI
+PciCfgFindExtCapability(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 ExtId)
+{
+  UINT16 Off = 0x100;
+
+  for (UINTN n = 0; n < MAX_EXT_CAP_WALK && Off >= 0x100; n++) {
+    UINT32 Hdr = 0;
+    if (EFI_ERROR(PciCfgRead32(Bus, Dev, Func, Off, &Hdr)) || Hdr == 0 || Hdr == 0xFFFFFFFF) {
+      return 0;
+    }
+
+    if ((UINT16)Hdr == ExtId) return Off;
+
+    Off = (UINT16)((Hdr >> 20) & 0xFFC);
+  }
+
+  return 0;
+}
+
+UINT8
+EFIAPI
+PciCfgNextCapability(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT8 Prev, OUT UINT8 *CapId OPTIONAL)
+{
+  UINT8 Ptr = 0;
+
+  if (Prev == 0) {
+    UINT16 Sts = 0;
+    if (EFI_ERROR(PciCfgRead16(Bus, Dev, Func, 0x06, &Sts)) || (Sts & BIT4) == 0) return 0;
+    PciCfgRead8(Bus, Dev, Func, 0x34, &Ptr);
+  } else {
+    PciCfgRead8(Bus, Dev, Func, (UINT16)(Prev + 1), &Ptr);
+  }
+
+  Ptr &= 0xFC;
+  if (Ptr < 0x40 || Ptr == Prev) return 0;
+
+  UINT8 Id = 0xFF;
+  PciCfgRead8(Bus, Dev, Func, Ptr, &Id);
+  if (Id == 0xFF) return 0;
+  if (CapId != NULL) *CapId = Id;
+  return Ptr;
+}
+
+UINT16
+EFIAPI
+PciCfgNextExtCapability(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Prev, OUT UINT16 *ExtId OPTIONAL)
+{
+  UINT16 Off = 0x100;
+
+  if (Prev != 0) {
+    UINT32 PrevHdr = 0;
+    if (EFI_ERROR(PciCfgRead32(Bus, Dev, Func, Prev, &PrevHdr))) return 0;
+    Off = (UINT16)((PrevHdr >> 20) & 0xFFC);
+    if (Off < 0x100 || Off == Prev) return 0;
+  }
+
+  UINT32 Hdr = 0;
+  if (EFI_ERROR(PciCfgRead32(Bus, Dev, Func, Off, &Hdr)) || Hdr == 0 || Hdr == 0xFFFFFFFF) {
+    return 0;
+  }
+  if (ExtId != NULL) *ExtId = (UINT16)Hdr;
+  return Off;
+}
@@ -0,0 +1,26 @@
+#ifndef _PCI_CONFIG_ACCESS_INTERNAL_H_
+#define _PCI_CONFIG_ACCESS_INTERNAL_H_
+
+#include <Uefi.h>
+
+#include <Library/PciConfigAccessLib.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+// Backend instances (one per file)
+extern PCI_CFG_BACKEND  gPciCfgRbIoBackend;
+extern PCI_CFG_BACKEND  gPciCfgEcamBackend;
+extern PCI_CFG_BACKEND  gPciCfgSimBackend;
+
+// Switches the active backend without any setup.
+VOID
+PciCfgActivate(IN PCI_CFG_BACKEND *Backend);
+
+// Unbacked reads: 0xFF in every byte.
+VOID
+PciCfgFillOnes(OUT VOID *Buffer, UINTN Width, UINTN Count);
+
+#endif
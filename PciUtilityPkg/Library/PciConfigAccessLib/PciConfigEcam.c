@@ -0,0 +1,181 @@
+#include "PciConfigAccessInternal.h"
+
+#include <Guid/Acpi.h>
+#include <IndustryStandard/Acpi.h>
+#include <IndustryStandard/MemoryMappedConfigurationSpaceAccessTable.h>
+
+#include <Library/IoLib.h>
+
+typedef struct {
+  UINT64 Base;      // MCFG base (corresponds to bus 0 of the segment)
+  UINT16 Segment;
+  UINT8  StartBus;
+  UINT8  EndBus;
+} PCI_ECAM_WINDOW;
+
+STATIC PCI_ECAM_WINDOW mEcam;
+STATIC BOOLEAN         mEcamValid = FALSE;
+
+// -----------------------------
+// ACPI table lookup
+// -----------------------------
+STATIC
+EFI_ACPI_DESCRIPTION_HEADER *
+FindAcpiTable(UINT32 Signature)
+{
+  EFI_ACPI_2_0_ROOT_SYSTEM_DESCRIPTION_POINTER *Rsdp = NULL;
+
+  if (EFI_ERROR(EfiGetSystemConfigurationTable(&gEfiAcpi20TableGuid, (VOID**)&Rsdp)) || Rsdp == NULL) {
+    return NULL;
+  }
+
+  // Prefer XSDT (64-bit entries), fall back to RSDT (32-bit entries)
+  if (Rsdp->Revision >= 2 && Rsdp->XsdtAddress != 0) {
+    EFI_ACPI_DESCRIPTION_HEADER *Xsdt = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN)Rsdp->XsdtAddress;
+    UINTN  Entries = (Xsdt->Length - sizeof(EFI_ACPI_DESCRIPTION_HEADER)) / sizeof(UINT64);
+    UINT8 *Ptr     = (UINT8 *)(Xsdt + 1);
+
+    for (UINTN i = 0; i < Entries; i++) {
+      UINT64 Addr = ReadUnaligned64((UINT64 *)(Ptr + i * sizeof(UINT64)));
+      EFI_ACPI_DESCRIPTION_HEADER *Hdr = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN)Addr;
+      if (Hdr != NULL && Hdr->Signature == Signature) return Hdr;
+    }
+    return NULL;
+  }
+
+  if (Rsdp->RsdtAddress != 0) {
+    EFI_ACPI_DESCRIPTION_HEADER *Rsdt = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN)Rsdp->RsdtAddress;
+    UINTN   Entries = (Rsdt->Length - sizeof(EFI_ACPI_DESCRIPTION_HEADER)) / sizeof(UINT32);
+    UINT32 *Ptr     = (UINT32 *)(Rsdt + 1);
+
+    for (UINTN i = 0; i < Entries; i++) {
+      EFI_ACPI_DESCRIPTION_HEADER *Hdr = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN)Ptr[i];
+      if (Hdr != NULL && Hdr->Signature == Signature) return Hdr;
+    }
+  }
+
+  return NULL;
+}
+
+// -----------------------------
+// ECAM window
+// -----------------------------
+EFI_STATUS
+EFIAPI
+PciCfgEcamInit(UINT16 Segment)
+{
+  mEcamValid = FALSE;
+
+  EFI_ACPI_DESCRIPTION_HEADER *Mcfg = FindAcpiTable(
+    EFI_ACPI_3_0_PCI_EXPRESS_MEMORY_MAPPED_CONFIGURATION_SPACE_BASE_ADDRESS_DESCRIPTION_TABLE_SIGNATURE);
+  if (Mcfg == NULL) return EFI_NOT_FOUND;
+
+  UINTN HdrLen = sizeof(EFI_ACPI_MEMORY_MAPPED_CONFIGURATION_BASE_ADDRESS_TABLE_HEADER);
+  UINTN EntLen = sizeof(EFI_ACPI_MEMORY_MAPPED_ENHANCED_CONFIGURATION_SPACE_BASE_ADDRESS_ALLOCATION_STRUCTURE);
+  if (Mcfg->Length < HdrLen) return EFI_NOT_FOUND;
+
+  UINTN  Entries = (Mcfg->Length - HdrLen) / EntLen;
+  UINT8 *Ptr     = (UINT8 *)Mcfg + HdrLen;
+
+  for (UINTN i = 0; i < Entries; i++) {
+    EFI_ACPI_MEMORY_MAPPED_ENHANCED_CONFIGURATION_SPACE_BASE_ADDRESS_ALLOCATION_STRUCTURE Ent;
+    CopyMem(&Ent, Ptr + i * EntLen, EntLen);
+
+    if (Ent.PciSegmentGroupNumber != Segment) continue;
+
+    mEcam.Base     = Ent.BaseAddress;
+    mEcam.Segment  = Ent.PciSegmentGroupNumber;
+    mEcam.StartBus = Ent.StartBusNumber;
+    mEcam.EndBus   = Ent.EndBusNumber;
+    mEcamValid = TRUE;
+    return EFI_SUCCESS;
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+BOOLEAN
+EFIAPI
+PciCfgEcamAvailable(VOID)
+{
+  return mEcamValid;
+}
+
+BOOLEAN
+EFIAPI
+PciCfgEcamCoversBus(UINT8 Bus)
+{
+  return mEcamValid && Bus >= mEcam.StartBus && Bus <= mEcam.EndBus;
+}
+
+// Plain MMIO read: no protocol call, safe to use from APs.
+UINT32
+EFIAPI
+PciCfgEcamRead32(UINT8 Bus, UINT8 Dev, UINT8 Func, UINT16 Reg)
+{
+  UINTN Addr = (UINTN)mEcam.Base +
+               ((UINTN)Bus  << 20) +
+               ((UINTN)Dev  << 15) +
+               ((UINTN)Func << 12) +
+               (UINTN)(Reg & 0xFFC);
+  return MmioRead32(Addr);
+}
+
+// -----------------------------
+// Backend
+// -----------------------------
+// The packed address is the ECAM offset from bus 0 of the segment.
+STATIC
+EFI_STATUS
+EFIAPI
+EcamRead(IN PCI_CFG_BACKEND *This, IN UINT32 Address, IN UINTN Width, IN UINTN Count, OUT VOID *Buffer)
+{
+  if (!PciCfgEcamCoversBus(PCI_CFG_ADDRESS_BUS(Address))) {
+    PciCfgFillOnes(Buffer, Width, Count);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  UINTN Addr = (UINTN)mEcam.Base + Address;
+  switch (Width) {
+    case 4:
+      for (UINTN k = 0; k < Count; k++) ((UINT32 *)Buffer)[k] = MmioRead32(Addr + k * 4);
+      break;
+    case 2:
+      for (UINTN k = 0; k < Count; k++) ((UINT16 *)Buffer)[k] = MmioRead16(Addr + k * 2);
+      break;
+    default:
+      for (UINTN k = 0; k < Count; k++) ((UINT8 *)Buffer)[k] = MmioRead8(Addr + k);
+      break;
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+EcamWrite(IN PCI_CFG_BACKEND *This, IN UINT32 Address, IN UINTN Width, IN UINTN Count, IN BOOLEAN Fill, IN CONST VOID *Buffer)
+{
+  if (!PciCfgEcamCoversBus(PCI_CFG_ADDRESS_BUS(Address))) return EFI_INVALID_PARAMETER;
+
+  UINTN Addr = (UINTN)mEcam.Base + Address;
+  for (UINTN k = 0; k < Count; k++) {
+    UINTN i = Fill ? 0 : k;
+    switch (Width) {
+      case 4:  MmioWrite32(Addr + k * 4, ((CONST UINT32 *)Buffer)[i]); break;
+      case 2:  MmioWrite16(Addr + k * 2, ((CONST UINT16 *)Buffer)[i]); break;
+      default: MmioWrite8 (Addr + k,     ((CONST UINT8  *)Buffer)[i]); break;
+    }
+  }
+  return EFI_SUCCESS;
+}
+
+PCI_CFG_BACKEND gPciCfgEcamBackend = { L"ECAM", EcamRead, EcamWrite, NULL };
+
+EFI_STATUS
+EFIAPI
+PciCfgUseEcam(VOID)
+{
+  if (!mEcamValid) return EFI_NOT_READY;
+  PciCfgActivate(&gPciCfgEcamBackend);
+  return EFI_SUCCESS;
+}
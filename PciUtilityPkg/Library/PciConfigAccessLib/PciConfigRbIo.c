@@ -0,0 +1,70 @@
+#include "PciConfigAccessInternal.h"
+
+STATIC EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *mRbIo = NULL;
+
+// Address[7:0]=Reg, [15:8]=Func, [23:16]=Dev, [31:24]=Bus  (0x00~0xFF)
+// Address[63:32]=ExtendedRegister, used by RBIO instead of Reg when non-zero (0x100~0xFFF)
+STATIC
+UINT64
+RbIoAddr(UINT32 Address)
+{
+  UINT16 Reg = PCI_CFG_ADDRESS_REG(Address);
+
+  return (UINT64)(Reg & 0xFF) |
+         ((UINT64)PCI_CFG_ADDRESS_FUNC(Address) << 8) |
+         ((UINT64)PCI_CFG_ADDRESS_DEV(Address)  << 16) |
+         ((UINT64)PCI_CFG_ADDRESS_BUS(Address)  << 24) |
+         ((Reg > 0xFF) ? ((UINT64)Reg << 32) : 0);
+}
+
+STATIC
+EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_WIDTH
+RbIoWidth(UINTN Width, BOOLEAN Fill)
+{
+  EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_WIDTH w = (Width == 4) ? EfiPciWidthUint32 :
+                                            (Width == 2) ? EfiPciWidthUint16 : EfiPciWidthUint8;
+  return Fill ? (EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL_WIDTH)(w + EfiPciWidthFillUint8) : w;
+}
+
+// One multi-count call: the root bridge steps the address itself.
+STATIC
+EFI_STATUS
+EFIAPI
+RbIoRead(IN PCI_CFG_BACKEND *This, IN UINT32 Address, IN UINTN Width, IN UINTN Count, OUT VOID *Buffer)
+{
+  if (mRbIo == NULL) return EFI_NOT_READY;
+  return mRbIo->Pci.Read(mRbIo, RbIoWidth(Width, FALSE), RbIoAddr(Address), Count, Buffer);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+RbIoWrite(IN PCI_CFG_BACKEND *This, IN UINT32 Address, IN UINTN Width, IN UINTN Count, IN BOOLEAN Fill, IN CONST VOID *Buffer)
+{
+  if (mRbIo == NULL) return EFI_NOT_READY;
+  return mRbIo->Pci.Write(mRbIo, RbIoWidth(Width, Fill), RbIoAddr(Address), Count, (VOID *)Buffer);
+}
+
+PCI_CFG_BACKEND gPciCfgRbIoBackend = { L"RBIO", RbIoRead, RbIoWrite, NULL };
+
+EFI_STATUS
+EFIAPI
+PciCfgUseRootBridgeIo(IN EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *RbIo OPTIONAL)
+{
+  if (RbIo == NULL) {
+    EFI_STATUS St = gBS->LocateProtocol(&gEfiPciRootBridgeIoProtocolGuid, NULL, (VOID**)&RbIo);
+    if (EFI_ERROR(St)) return St;
+    if (RbIo == NULL) return EFI_NOT_FOUND;
+  }
+
+  mRbIo = RbIo;
+  PciCfgActivate(&gPciCfgRbIoBackend);
+  return EFI_SUCCESS;
+}
+
+EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *
+EFIAPI
+PciCfgRootBridgeIo(VOID)
+{
+  return mRbIo;
+}
@@ -0,0 +1,170 @@
+#include "PciConfigAccessInternal.h"
+
+//
+// Simulated segment: every function owns a 4 KB config block and a 4 KB
+// write mask. A 64K-entry index (bus/dev/func -> slot + 1) makes each
+// access one table lookup and one CopyMem, with no search.
+//
+#define SIM_FUNC_SIZE   0x1000
+#define SIM_BDF_COUNT   0x10000
+#define SIM_GROW        32
+
+typedef struct {
+  UINT8 Config[SIM_FUNC_SIZE];
+  UINT8 Mask[SIM_FUNC_SIZE];
+} SIM_FUNC;
+
+typedef struct {
+  UINT16   *Index;       // 0 = absent
+  SIM_FUNC *Func;
+  UINTN     Count;
+  UINTN     Cap;
+} SIM_SEGMENT;
+
+STATIC SIM_SEGMENT mSim;
+
+STATIC
+VOID
+SimFree(VOID)
+{
+  if (mSim.Index) FreePool(mSim.Index);
+  if (mSim.Func) FreePool(mSim.Func);
+  ZeroMem(&mSim, sizeof(mSim));
+}
+
+STATIC
+SIM_FUNC *
+SimLookup(UINT32 Address)
+{
+  if (mSim.Index == NULL) return NULL;
+  UINT16 Slot = mSim.Index[Address >> 12];
+  return (Slot == 0) ? NULL : &mSim.Func[Slot - 1];
+}
+
+// -----------------------------
+// Backend
+// -----------------------------
+STATIC
+EFI_STATUS
+EFIAPI
+SimRead(IN PCI_CFG_BACKEND *This, IN UINT32 Address, IN UINTN Width, IN UINTN Count, OUT VOID *Buffer)
+{
+  SIM_FUNC *f = SimLookup(Address);
+  if (f == NULL) {
+    PciCfgFillOnes(Buffer, Width, Count);
+    return EFI_SUCCESS;      // master abort, like hardware
+  }
+
+  CopyMem(Buffer, f->Config + PCI_CFG_ADDRESS_REG(Address), Width * Count);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimWrite(IN PCI_CFG_BACKEND *This, IN UINT32 Address, IN UINTN Width, IN UINTN Count, IN BOOLEAN Fill, IN CONST VOID *Buffer)
+{
+  SIM_FUNC *f = SimLookup(Address);
+  if (f == NULL) return EFI_SUCCESS;   // dropped
+
+  UINTN        Reg = PCI_CFG_ADDRESS_REG(Address);
+  CONST UINT8 *Src = (CONST UINT8 *)Buffer;
+
+  for (UINTN k = 0; k < Width * Count; k++) {
+    UINT8 v = Fill ? Src[k % Width] : Src[k];
+    UINT8 m = f->Mask[Reg + k];
+    f->Config[Reg + k] = (UINT8)((f->Config[Reg + k] & ~m) | (v & m));
+  }
+  return EFI_SUCCESS;
+}
+
+PCI_CFG_BACKEND gPciCfgSimBackend = { L"Simulated", SimRead, SimWrite, NULL };
+
+// -----------------------------
+// Setup
+// -----------------------------
+EFI_STATUS
+EFIAPI
+PciCfgUseSimulated(VOID)
+{
+  SimFree();
+  mSim.Index = AllocateZeroPool(sizeof(UINT16) * SIM_BDF_COUNT);
+  if (mSim.Index == NULL) return EFI_OUT_OF_RESOURCES;
+
+  gPciCfgSimBackend.Name = L"Simulated";
+  PciCfgActivate(&gPciCfgSimBackend);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+PciCfgSimAddFunction(UINT8 Bus, UINT8 Dev, UINT8 Func, IN CONST UINT8 *Config,
+                     UINTN Size, IN CONST UINT8 *WriteMask OPTIONAL)
+{
+  if (mSim.Index == NULL) return EFI_NOT_READY;
+  if (Dev > 31 || Func > 7 || (Size != 0x100 && Size != SIM_FUNC_SIZE)) return EFI_INVALID_PARAMETER;
+
+  UINT32 Key = PCI_CFG_ADDRESS(Bus, Dev, Func, 0) >> 12;
+  if (mSim.Index[Key] == 0) {
+    if (mSim.Count == MAX_UINT16) return EFI_OUT_OF_RESOURCES;
+    if (mSim.Count == mSim.Cap) {
+      UINTN     NewCap = mSim.Cap + SIM_GROW;
+      SIM_FUNC *New    = ReallocatePool(sizeof(SIM_FUNC) * mSim.Cap, sizeof(SIM_FUNC) * NewCap, mSim.Func);
+      if (New == NULL) return EFI_OUT_OF_RESOURCES;
+      mSim.Func = New;
+      mSim.Cap  = NewCap;
+    }
+    mSim.Index[Key] = (UINT16)(++mSim.Count);
+  }
+
+  // A 256-byte function has no extended space: reads 0xFF, ignores writes
+  SIM_FUNC *f = &mSim.Func[mSim.Index[Key] - 1];
+  SetMem(f->Config, SIM_FUNC_SIZE, 0xFF);
+  ZeroMem(f->Mask, SIM_FUNC_SIZE);
+  CopyMem(f->Config, Config, Size);
+  if (WriteMask != NULL) CopyMem(f->Mask, WriteMask, Size);
+  else SetMem(f->Mask, Size, 0xFF);
+  return EFI_SUCCESS;
+}
+
+// -----------------------------
+// Config space image
+// -----------------------------
+EFI_STATUS
+EFIAPI
+PciCfgUseImage(IN CONST VOID *Image, UINTN Size)
+{
+  CONST UINT8          *p = (CONST UINT8 *)Image;
+  PCI_CFG_IMAGE_HEADER  Hdr;
+
+  if (Size < sizeof(Hdr)) return EFI_VOLUME_CORRUPTED;
+  CopyMem(&Hdr, p, sizeof(Hdr));
+  if (Hdr.Signature != PCI_CFG_IMAGE_SIGNATURE || Hdr.Version != PCI_CFG_IMAGE_VERSION) {
+    return EFI_UNSUPPORTED;
+  }
+
+  EFI_STATUS St = PciCfgUseSimulated();
+  if (EFI_ERROR(St)) return St;
+
+  UINTN Off = sizeof(Hdr);
+  for (UINT32 n = 0; n < Hdr.Count; n++) {
+    PCI_CFG_IMAGE_RECORD Rec;
+    if (Size - Off < sizeof(Rec)) { St = EFI_VOLUME_CORRUPTED; break; }
+    CopyMem(&Rec, p + Off, sizeof(Rec));
+    Off += sizeof(Rec);
+
+    if (Size - Off < Rec.Size) { St = EFI_VOLUME_CORRUPTED; break; }
+    St = PciCfgSimAddFunction(Rec.Bus, Rec.Dev, Rec.Func, p + Off, Rec.Size, NULL);
+    if (EFI_ERROR(St)) break;
+    Off += Rec.Size;
+  }
+
+  if (EFI_ERROR(St)) {
+    SimFree();
+    PciCfgSetBackend(NULL);
+    return St;
+  }
+
+  gPciCfgSimBackend.Name = L"Image";
+  return EFI_SUCCESS;
+}